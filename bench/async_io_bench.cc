@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "async_io.h"
+#include "format.h"
+
+using namespace autumn;
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// 逐个同步读取
+double sequential(const std::vector<std::string>& paths, size_t* bytes) {
+    auto begin = std::chrono::steady_clock::now();
+    std::string data;
+    for (auto& path : paths) {
+        async_io::read_file(path, &data);
+        *bytes += data.size();
+    }
+    return seconds_since(begin);
+}
+
+// 全部提交之后一起等待
+double async(async_io::Reader& reader, const std::vector<std::string>& paths, size_t* bytes) {
+    auto begin = std::chrono::steady_clock::now();
+    std::vector<std::shared_ptr<async_io::Request>> requests;
+    requests.reserve(paths.size());
+    for (auto& path : paths) {
+        requests.push_back(reader.submit(path));
+    }
+    reader.wait(requests);
+    for (auto& request : requests) {
+        *bytes += request->data().size();
+    }
+    return seconds_since(begin);
+}
+
+// 丢弃页缓存，需要 root
+bool drop_caches() {
+    sync();
+    std::ofstream out("/proc/sys/vm/drop_caches");
+    out << "3";
+    out.close();
+    return static_cast<bool>(out);
+}
+
+void report(const char* name, double seconds, size_t files, size_t bytes, double baseline) {
+    printf("%-12s %8zu files  %10zu bytes  %12.0f files/s  x%.1f\n",
+            name, files, bytes, files / seconds, baseline / seconds);
+}
+
+}
+
+// 读取几千个小文件，对比顺序读取、io_uring 和线程池
+// 默认文件都在页缓存里，只比较系统调用的开销；第二个参数为 cold 时每一轮之前丢弃页缓存
+// （需要 root），读取要等磁盘，异步读取可以让多个请求同时在途
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000;
+    bool cold = argc > 2 && std::string(argv[2]) == "cold";
+    std::string dir = format("/tmp/autumn_async_io_bench_{}", getpid());
+    std::string mkdir = format("mkdir -p {}", dir);
+    if (system(mkdir.c_str()) != 0) {
+        fprintf(stderr, "cannot create %s\n", dir.c_str());
+        return 1;
+    }
+    std::vector<std::string> paths;
+    for (size_t i = 0; i < count; ++i) {
+        paths.push_back(format("{}/{}.txt", dir, i));
+        std::ofstream out(paths.back(), std::ios::binary | std::ios::trunc);
+        out << std::string(100 + i % 1000, 'a' + i % 26);
+    }
+
+    // 每一轮开始前的缓存状态相同
+    auto prepare = [&]() {
+        size_t bytes = 0;
+        if (!cold) {
+            sequential(paths, &bytes);
+        } else if (!drop_caches()) {
+            fprintf(stderr, "cannot drop page cache, running warm\n");
+            cold = false;
+        }
+    };
+    size_t bytes = 0;
+    prepare();
+    printf("%s page cache\n", cold ? "cold" : "warm");
+    double baseline = sequential(paths, &bytes);
+    report("sequential", baseline, count, bytes, baseline);
+
+    std::string error;
+    auto uring = async_io::create_uring(256, &error);
+    if (uring != nullptr) {
+        prepare();
+        bytes = 0;
+        double seconds = async(*uring, paths, &bytes);
+        report("io_uring", seconds, count, bytes, baseline);
+    } else {
+        printf("%-12s unavailable: %s\n", "io_uring", error.c_str());
+    }
+
+    auto pool = async_io::create_thread_pool(8);
+    prepare();
+    bytes = 0;
+    double seconds = async(*pool, paths, &bytes);
+    report("threads", seconds, count, bytes, baseline);
+
+    for (auto& path : paths) {
+        unlink(path.c_str());
+    }
+    rmdir(dir.c_str());
+    return 0;
+}
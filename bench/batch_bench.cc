@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "batch.h"
+#include "perf_counters.h"
+
+using namespace autumn;
+
+namespace {
+
+double seconds_since(std::chrono::steady_clock::time_point begin) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+}
+
+// AUTUMN_PERF_COUNTERS=1 时输出每行的平均硬件计数
+bool counters_enabled() {
+    return perf_counters::enabled() && perf_counters::available();
+}
+
+perf_counters::Values read_counters() {
+    perf_counters::Values values;
+    if (counters_enabled()) {
+        perf_counters::read(&values);
+    }
+    return values;
+}
+
+void print_counters(const char* name, const perf_counters::Values& values, size_t rows) {
+    printf("    %-8s", name);
+    for (int i = 0; i < perf_counters::EVENT_COUNT; ++i) {
+        if (perf_counters::supported(i)) {
+            printf("  %s/row %.2f", perf_counters::event_name(i), static_cast<double>(values.value[i]) / rows);
+        }
+    }
+    printf("\n");
+}
+
+// 对比按列求值和逐行求值的吞吐
+void run(const std::string& source, size_t rows) {
+    std::vector<std::string> errors;
+    auto exp = BatchExpression::compile(source, &errors);
+    if (exp == nullptr) {
+        fprintf(stderr, "compile failed: %s\n", source.c_str());
+        return;
+    }
+
+    std::mt19937 rng(42);
+    std::vector<std::vector<int64_t>> data(exp->variables().size());
+    std::vector<Span<int64_t>> columns;
+    for (auto& column : data) {
+        column.resize(rows);
+        for (auto& value : column) {
+            value = static_cast<int64_t>(rng() % 1000) + 1;
+        }
+        columns.emplace_back(column.data(), column.size());
+    }
+
+    auto counters = read_counters();
+    auto begin = std::chrono::steady_clock::now();
+    auto batch = exp->eval(columns, rows);
+    double batch_seconds = seconds_since(begin);
+    auto batch_counters = read_counters() - counters;
+
+    counters = read_counters();
+    begin = std::chrono::steady_clock::now();
+    auto per_row = exp->eval_rows(columns, rows);
+    double row_seconds = seconds_since(begin);
+    auto row_counters = read_counters() - counters;
+
+    printf("%-32s %10zu rows  batch %12.0f rows/s  per-row %12.0f rows/s  x%.1f%s\n",
+            source.c_str(),
+            rows,
+            rows / batch_seconds,
+            rows / row_seconds,
+            row_seconds / batch_seconds,
+            exp->vectorized() ? "" : "  (fallback)");
+    if (counters_enabled()) {
+        print_counters("batch", batch_counters, rows);
+        print_counters("per-row", row_counters, rows);
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    size_t rows = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1000000;
+    run("price * qty > limit", rows);
+    run("a + b + c + d", rows);
+    run("(a - b) * 3 / c <= d", rows);
+    run("if (a > b) { a } else { b }", rows);
+    return 0;
+}
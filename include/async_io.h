@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace autumn {
+namespace async_io {
+
+// 异步读取整个文件，供 read_async/wait_all 使用
+//
+// Linux 上优先使用 io_uring（直接调用系统调用，不依赖 liburing）：打开和读取都作为
+// 完成事件提交，同时在途的请求数不超过环的大小，多出的排队；内核不支持、被 seccomp 禁止
+// 或不是 Linux 时退回到线程池，每个工作线程同步地 open/read。
+// AUTUMN_ASYNC_IO=threads 强制使用线程池
+//
+// 每个线程第一次使用时创建自己的 Reader，线程退出时等待在途的请求完成
+
+class Reader;
+
+// 一次读取请求，完成之后 data() 是文件内容，失败时 error() 是 errno
+class Request {
+public:
+    explicit Request(const std::string& path) : _path(path) {
+    }
+
+    const std::string& path() const {
+        return _path;
+    }
+
+    bool done() const {
+        return _done.load(std::memory_order_acquire);
+    }
+
+    // 以下在 done() 之后有效
+    int error() const {
+        return _error;
+    }
+
+    const std::string& data() const {
+        return _data;
+    }
+private:
+    friend class UringReader;
+    friend class ThreadPoolReader;
+
+    void finish(int error) {
+        _error = error;
+        _done.store(true, std::memory_order_release);
+    }
+private:
+    std::string _path;
+    std::string _data;
+    int _error = 0;
+    std::atomic<bool> _done{false};
+
+    // io_uring 使用：正在进行的操作、文件描述符、已读取的字节数、文件大小是否已知
+    enum Stage {
+        QUEUED,
+        OPENING,
+        READING,
+    };
+    Stage _stage = QUEUED;
+    int _fd = -1;
+    size_t _offset = 0;
+    bool _sized = false;
+};
+
+class Reader {
+public:
+    virtual ~Reader() {}
+
+    // 提交读取 path 的请求，立即返回
+    virtual std::shared_ptr<Request> submit(const std::string& path) = 0;
+
+    // 等待 requests 全部完成
+    virtual void wait(const std::vector<std::shared_ptr<Request>>& requests) = 0;
+
+    // "io_uring" 或 "threads"
+    virtual const char* backend() const = 0;
+};
+
+// 当前线程的 Reader
+Reader& reader();
+
+// io_uring 不可用时返回 nullptr，原因写入 error
+std::unique_ptr<Reader> create_uring(unsigned entries, std::string* error);
+
+std::unique_ptr<Reader> create_thread_pool(size_t threads);
+
+// 同步读取整个文件，失败时返回 errno
+int read_file(const std::string& path, std::string* data);
+
+} // namespace async_io
+} // namespace autumn
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "object.h"
+#include "program.h"
+#include "span.h"
+
+namespace autumn {
+
+class Evaluator;
+
+// 批量求值的结果
+struct BatchResult {
+    enum Kind {
+        INTEGER,
+        BOOLEAN,
+        // 逐行求值的结果，每行一个对象，可能是 Error
+        OBJECT,
+    };
+
+    Kind kind = OBJECT;
+    // INTEGER 和 BOOLEAN 按列存放，布尔值为 0/1
+    std::vector<int64_t> values;
+    std::vector<std::shared_ptr<object::Object>> objects;
+
+    size_t size() const {
+        return kind == OBJECT ? objects.size() : values.size();
+    }
+
+    // 第 row 行的结果对象
+    std::shared_ptr<object::Object> at(size_t row) const;
+};
+
+// 编译后的表达式，对一批输入按列求值，用于规则表达式，例如 price * qty > limit
+//
+// 表达式中的自由变量绑定为整数列。整数和布尔值的字面量、标识符、前缀运算、
+// 中缀运算和 + 链按语法树节点逐个计算整列，每个节点是一个紧凑的循环；
+// 其它写法以及类型不匹配的表达式退回逐行求值，结果与 Evaluator 一致
+class BatchExpression {
+public:
+    // 解析表达式，失败时返回 nullptr，错误信息写入 errors
+    static std::unique_ptr<BatchExpression> compile(
+            const std::string& source,
+            std::vector<std::string>* errors);
+
+    ~BatchExpression();
+
+    // 自由变量，按首次出现的顺序排列，内置函数不计入
+    const std::vector<std::string>& variables() const {
+        return _variables;
+    }
+
+    // 是否可以按列求值
+    bool vectorized() const {
+        return _vectorized;
+    }
+
+    // columns 与 variables() 一一对应，每列至少 rows 个元素
+    BatchResult eval(const std::vector<Span<int64_t>>& columns, size_t rows) const;
+
+    // 逐行求值，用于不支持按列计算的表达式，也用作对照
+    BatchResult eval_rows(const std::vector<Span<int64_t>>& columns, size_t rows) const;
+private:
+    struct Vector;
+
+    BatchExpression(std::unique_ptr<ast::Program> program);
+
+    bool typecheck(const ast::Expression* exp, BatchResult::Kind* kind) const;
+    bool eval_vector(
+            const ast::Expression* exp,
+            const std::vector<Span<int64_t>>& columns,
+            size_t rows,
+            Vector* out) const;
+    int variable_index(const std::string& name) const;
+
+    // 二元运算，按操作数是否为常量分成不同的循环
+    template <typename Op>
+    static void apply(const Vector& a, const Vector& b, size_t rows, Op op, Vector* out);
+private:
+    std::unique_ptr<ast::Program> _program;
+    const ast::Expression* _expression = nullptr;
+    std::vector<std::string> _variables;
+    bool _vectorized = false;
+    BatchResult::Kind _kind = BatchResult::OBJECT;
+    std::unique_ptr<Evaluator> _evaluator;
+};
+
+} // namespace autumn
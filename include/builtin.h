@@ -10,12 +10,58 @@ namespace builtin {
 
 extern std::map<std::string, object::BuiltinFunction> BUILTINS;
 
-std::shared_ptr<object::Object> len(const std::vector<std::shared_ptr<object::Object>>& args);
-std::shared_ptr<object::Object> first(const std::vector<std::shared_ptr<object::Object>>& args);
-std::shared_ptr<object::Object> last(const std::vector<std::shared_ptr<object::Object>>& args);
-std::shared_ptr<object::Object> push(const std::vector<std::shared_ptr<object::Object>>& args);
-std::shared_ptr<object::Object> rest(const std::vector<std::shared_ptr<object::Object>>& args);
-std::shared_ptr<object::Object> puts(const std::vector<std::shared_ptr<object::Object>>& args);
+std::shared_ptr<object::Object> len(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> first(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> last(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> push(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> rest(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> puts(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> to_str(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+
+// 计时
+std::shared_ptr<object::Object> clock_ns(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> bench(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> bench_compare(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+
+// 把运行时对象图写入文件
+std::shared_ptr<object::Object> heap_dump(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+
+// 集合类型
+std::shared_ptr<object::Object> to_array(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> set(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> add(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> has(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> remove(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> deque(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> push_back(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> push_front(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> pop_back(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> pop_front(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> priority_queue(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> pq_push(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> pq_pop(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> pq_top(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+
+// 二进制编码，见 serialize.h
+std::shared_ptr<object::Object> serialize(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> deserialize(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+
+// 只读的列式数据文件，见 table.h
+std::shared_ptr<object::Object> load_table(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> save_table(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+
+// 正则表达式，见 regexp.h；编译结果缓存在调用者中
+std::shared_ptr<object::Object> match(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> find_all(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> regex_replace(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> regex_split(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+
+// 异步读取文件，见 async_io.h
+std::shared_ptr<object::Object> read_async(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+std::shared_ptr<object::Object> wait_all(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
+
+// 深度冻结，返回可以跨线程共享的只读值
+std::shared_ptr<object::Object> freeze(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller);
 
 } // namespace builtin
 } // namespace autumn
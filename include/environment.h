@@ -4,22 +4,34 @@
 #include <string>
 #include <map>
 
+#include "region.h"
+
 namespace autumn {
 namespace object {
 
 class Object;
 class Environment {
 public:
+    friend void region::remember(Environment* env, const object::Object* value);
+    friend class region::Promoter;
+
     Environment() {}
     Environment(std::shared_ptr<Environment>& outer) :
             _outer(outer) {}
-    std::shared_ptr<Object> get(const std::string& name) {
+    ~Environment() {
+        if (_remembered) {
+            region::forget(this);
+        }
+    }
+    // 找不到时返回空指针，返回的引用在下一次修改绑定前有效
+    const std::shared_ptr<Object>& get(const std::string& name) const {
+        static const std::shared_ptr<Object> none;
         auto it = _store.find(name);
         if (it == _store.end()) {
             if (_outer != nullptr) {
                 return _outer->get(name);
             }
-            return nullptr;
+            return none;
         }
 
         return it->second;
@@ -27,12 +39,29 @@ public:
 
     std::shared_ptr<Object> set(const std::string& name,
             std::shared_ptr<Object>& val) {
+        region::barrier(this, val.get());
         _store[name] = val;
         return val;
     }
+
+    // 清空当前作用域，用于断开闭包和环境之间的循环引用
+    void clear() {
+        _store.clear();
+    }
+
+    // 当前作用域内的绑定，不包含外层
+    const std::map<std::string, std::shared_ptr<Object>>& store() const {
+        return _store;
+    }
+
+    const std::shared_ptr<Environment>& outer() const {
+        return _outer;
+    }
 private:
     std::map<std::string, std::shared_ptr<Object>> _store;
     std::shared_ptr<Environment> _outer;
+    // 是否被写屏障记下，见 region::remember
+    bool _remembered = false;
 };
 
 } // namespace object
@@ -1,21 +1,84 @@
 #pragma once
 
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "environment.h"
 #include "format.h"
+#include "module.h"
 #include "object.h"
 #include "parser.h"
+#include "regexp.h"
 
 namespace autumn {
  
-class Evaluator {
+class Evaluator : public object::Caller {
 public:
+    friend class Optimizer;
+    friend class BatchExpression;
     Evaluator();
     // 使用 shared_ptr 的原因是有些对象是可以共享复用的
     // 比如 true/false/null
     std::shared_ptr<const object::Object> eval(const std::string& input);
+    // 执行脚本文件，脚本中的相对 import 以脚本所在目录为起点
+    std::shared_ptr<const object::Object> eval_file(const std::string& path);
 
     void reset_env();
+
+    // 供内置函数调用脚本中的函数
+    std::shared_ptr<object::Object> call(
+            const object::Object* fn,
+            std::vector<std::shared_ptr<object::Object>>& args) const override;
+
+    // 从全局环境和已导入的模块出发写出对象图，以及这个 Evaluator 创建的不可达闭包，见 heap.h
+    std::shared_ptr<object::Object> heap_dump(const std::string& path) const override;
+
+    regexp::Cache& regex_cache() const override {
+        return _regex_cache;
+    }
+
+    // 冻结全局环境中的值（通常在执行完 prelude 之后调用），闭包保持原样，返回冻结的绑定个数
+    // 冻结的绑定同时发布给 share_globals
+    size_t freeze_globals();
+    // 把 other 最近一次 freeze_globals 发布的绑定加入当前的全局环境
+    // 只读取 other 在锁内保存的快照，other 可以同时在其他线程执行
+    void share_globals(const Evaluator& other);
+
+    // 区域模式：每次 eval/eval_file 新建的对象从请求级的区域分配，结束时把逃逸到全局环境、
+    // 模块和返回值中的对象拷贝到堆上，再整体回卷区域，见 region.h
+    // 默认值由环境变量 AUTUMN_REGION=1 决定
+    void set_region_mode(bool on) {
+        _region_mode = on;
+    }
+
+    bool region_mode() const {
+        return _region_mode;
+    }
+
+    struct RegionStats {
+        // 区域模式下执行的请求数
+        size_t requests = 0;
+        // 请求结束时整体回卷的次数
+        size_t resets = 0;
+        // 仍有对象存活、只能弃用区域的次数
+        size_t retired = 0;
+        // 拷贝到堆上的对象和环境个数
+        size_t promoted = 0;
+        // 请求中写入了区域对象、结束时就地修正的堆上容器和环境个数
+        size_t fixed = 0;
+        // 从区域分配出去的字节数
+        size_t bytes = 0;
+    };
+
+    const RegionStats& region_stats() const {
+        return _region_stats;
+    }
 private:
+    // 结束一次区域模式的请求：提升逃逸的对象，断开遗留的闭包环，回卷区域
+    std::shared_ptr<object::Object> finish_request(std::shared_ptr<object::Object> result);
+
     bool is_error(const object::Object* obj) const;
     std::shared_ptr<object::Object> eval(const ast::Node* node, std::shared_ptr<object::Environment>& env) const;
     std::shared_ptr<object::Object> eval_program(const std::vector<std::unique_ptr<ast::Statment>>& statments, std::shared_ptr<object::Environment>& env) const;
@@ -44,6 +107,12 @@ private:
             const object::Object* left,
             const object::Object* right,
             std::shared_ptr<object::Environment>& env) const;
+    std::shared_ptr<object::Object> eval_concat_expression(
+            const ast::ConcatExpression* exp,
+            std::shared_ptr<object::Environment>& env) const;
+    std::shared_ptr<object::Object> eval_interpolated_string(
+            const ast::InterpolatedString* exp,
+            std::shared_ptr<object::Environment>& env) const;
     std::shared_ptr<object::Object> eval_bang_operator_expression(
             const object::Object* right) const;
     std::shared_ptr<object::Object> eval_minus_prefix_operator_expression(const object::Object* right) const;
@@ -67,24 +136,71 @@ private:
     std::shared_ptr<object::Object> eval_index_expression(
             const object::Object* obj,
             const object::Object* index) const;
+    // hash[常量字符串]，不创建键对象，shape 方式的 hash 通过内联缓存找到槽位
+    std::shared_ptr<object::Object> eval_field_access(
+            const ast::IndexExpression* exp,
+            const object::Hash* hash) const;
+    // start/end 为 nullptr 表示省略
+    std::shared_ptr<object::Object> eval_slice_expression(
+            const std::shared_ptr<object::Object>& obj,
+            const object::Object* start,
+            const object::Object* end) const;
 
     std::shared_ptr<object::Object> eval_hash_literal(
             const ast::HashLiteral* exp,
             std::shared_ptr<object::Environment>& env) const;
+    // 第一次求值时确定字面量的键布局
+    const object::Shape* hash_literal_shape(const ast::HashLiteral* exp) const;
+
+    std::shared_ptr<object::Object> eval_import_expression(
+            const ast::ImportExpression* exp) const;
+    std::shared_ptr<object::Object> eval_module(
+            const module::Compiled* compiled,
+            std::shared_ptr<object::Environment>& env) const;
 private:
     bool is_truthy(const object::Object* obj) const;
 
     template <typename... Args>
     std::shared_ptr<object::Error> new_error(std::string_view fmt, Args&&... args) const {
-        return std::make_shared<object::Error>(format(fmt, std::forward<Args>(args)...));
+        return object::make<object::Error>(format(fmt, std::forward<Args>(args)...));
     }
 
     std::shared_ptr<object::Error> new_error(std::string_view message) const {
-        return std::make_shared<object::Error>(std::string(message));
+        return object::make<object::Error>(std::string(message));
     }
 private:
     Parser _parser;
+    // 求值期间新建的闭包，heap_dump 从中找出不可达的闭包
+    mutable object::Closures _closures;
     mutable std::shared_ptr<object::Environment> _env;
+    // freeze_globals 发布的冻结绑定，由 _shared_mutex 保护
+    std::vector<std::pair<std::string, std::shared_ptr<object::Object>>> _shared_globals;
+    mutable std::mutex _shared_mutex;
+    // 求值步数上限，0 表示不限制，供编译期求值使用
+    size_t _step_limit = 0;
+    mutable size_t _steps = 0;
+    // 函数调用深度上限，0 表示不限制，供编译期求值使用
+    size_t _call_limit = 0;
+    mutable size_t _calls = 0;
+
+    struct Module {
+        std::filesystem::file_time_type mtime;
+        std::shared_ptr<object::Object> exports;
+    };
+    // 每个模块在一个 Evaluator 中只执行一次，按规范路径缓存导出的绑定
+    mutable std::unordered_map<std::string, Module> _modules;
+    // 正在执行的模块所在的目录，栈顶用于解析相对路径
+    mutable std::vector<std::string> _module_dirs;
+    // 正在执行的模块，用于发现循环导入
+    mutable std::unordered_set<std::string> _loading;
+    // 按模式字符串缓存编译好的正则表达式
+    mutable regexp::Cache _regex_cache;
+
+    bool _region_mode = region::enabled();
+    region::Handle _region = region::create();
+    // 区域模式下当前请求创建的闭包，请求结束时只检查它们
+    mutable object::Closures _request_closures;
+    RegionStats _region_stats;
 };
 
 } // namespace autumn
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "environment.h"
+#include "object.h"
+
+namespace autumn {
+namespace heap {
+
+// 堆转储：从根出发遍历运行时对象和环境，写出对象图、估算的大小和保留路径
+// 另外遍历若干组存活的闭包（通常是一个 Evaluator 创建的），从根不可达的闭包（以及它们的环境）记为不可达，
+// 它们通常是闭包与环境的循环引用造成的泄漏
+//
+// 文件是按行的文本，字段以空格分隔，最后一个字段可以包含空格:
+//   node <id> <kind> <self> <retained> <idom> <reachable> <parent> <step>
+//   edge <from> <to> <name>
+//   root <id> <name>
+// self 是对象自身的估算字节数；retained 是对象在支配树中的子树大小，即释放该对象后
+// 能一起释放的字节数；idom 是直接支配者，0 表示虚拟根；从根出发的一条最短路径是沿 parent
+// 依次拼接各个节点的 step，例如 globals、.a、[1]，根的 parent 是 0，step 是根的名字
+
+struct Root {
+    std::string name;
+    std::shared_ptr<object::Environment> env;
+    std::shared_ptr<object::Object> object;
+};
+
+struct Stats {
+    size_t objects = 0;
+    size_t bytes = 0;
+    size_t unreachable_objects = 0;
+    size_t unreachable_bytes = 0;
+};
+
+// 写出从 roots 可达的对象以及 closures 中不可达的闭包
+Stats dump(const std::vector<Root>& roots, const std::vector<const object::Closures*>& closures,
+        std::ostream& out);
+
+// 读取 dump 写出的文件，按绑定名汇总被该绑定独占保留的字节数，输出前 top 项
+// 文件格式不对时返回 false
+bool summarize(std::istream& in, std::ostream& out, size_t top);
+
+} // namespace heap
+} // namespace autumn
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "parser.h"
+
+namespace autumn {
+
+// 增量解析，供编辑器和语言服务器使用
+//
+// 源码按顶层语句切分，每条语句记录字节区间 [begin, end)（end 是下一条语句的起点）
+// 和 token 序列的哈希。编辑后只从受影响的语句开始重新词法分析和解析，
+// 当新解析到的语句起点与编辑区之后某条旧语句平移后的起点重合、且该语句的 token 哈希
+// 不变时，后面的语句整体复用，只平移区间
+//
+// 顶层语句的解析只依赖它自己的 token 和后面的第一个 token，因此编辑点所在语句的
+// 前一条语句也要重新解析
+// 复用的语法树中 token 的行号和偏移仍是它们被解析时的位置，位置以语句区间为准
+class IncrementalParser {
+public:
+    struct Statment {
+        size_t begin = 0;
+        size_t end = 0;
+        uint64_t hash = 0;
+        std::unique_ptr<ast::Statment> node;
+        std::vector<std::string> errors;
+    };
+
+    // 诊断信息，区间不包含语句末尾的空白
+    struct Diagnostic {
+        size_t begin = 0;
+        size_t end = 0;
+        std::string message;
+    };
+public:
+    // 用新的源码替换，和旧源码比较出相同的前后缀，按一次编辑处理
+    void update(const std::string& source);
+    // 把 [begin, end) 替换为 text
+    void edit(size_t begin, size_t end, const std::string& text);
+
+    const std::string& source() const {
+        return _source;
+    }
+
+    const std::vector<Statment>& statments() const {
+        return _statments;
+    }
+
+    // 所有语句的解析错误，去掉了终端颜色
+    std::vector<Diagnostic> diagnostics() const;
+
+    // 最近一次更新中重新解析和复用的语句数
+    size_t reparsed() const {
+        return _reparsed;
+    }
+
+    size_t reused() const {
+        return _reused;
+    }
+
+    // [begin, end) 内 token 序列的哈希，begin 必须位于 token 的边界上
+    static uint64_t token_hash(const std::string& source, size_t begin, size_t end);
+private:
+    Parser _parser;
+    std::string _source;
+    std::vector<Statment> _statments;
+    size_t _reparsed = 0;
+    size_t _reused = 0;
+};
+
+} // namespace autumn
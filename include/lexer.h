@@ -1,5 +1,8 @@
 #pragma once
 
+#include <string_view>
+
+#include "perf_counters.h"
 #include "token.h"
 
 namespace autumn {
@@ -7,8 +10,34 @@ namespace autumn {
 class Lexer {
 public:
     Lexer(const std::string& input);
+    // 从字节偏移 offset 开始读取，offset 必须位于 token 的边界上
+    Lexer(const std::string& input, size_t offset);
+    ~Lexer();
     Token next_token();
+
+    // 从 line 开始计算行号，用于在原输入的某一行上解析它的子串
+    void set_line(int line) {
+        _line = line;
+    }
+
+    // 字符串字面量中的插值 ${...}：pos 是 ${ 之后的位置，返回匹配的 } 的位置
+    // 表达式中可以有嵌套的花括号和字符串，没有匹配时返回 npos
+    static size_t interpolation_end(std::string_view input, size_t pos);
+    // 字符串字面量中从 pos 开始第一个插值的 ${ 的位置，没有时返回 npos
+    // \${ 是转义，表示字面的 ${，不开始插值
+    static size_t interpolation_begin(std::string_view input, size_t pos);
+    // 把字面量片段中的转义 \$ 还原为 $
+    static std::string unescape(std::string_view text);
+    // 没有结尾引号的字符串（不含开头的引号）是否停在没有匹配的插值中
+    static bool in_interpolation(std::string_view input);
 private:
+    // pos 是字符串开头引号之后的位置，返回结尾引号的位置，跳过其中的插值
+    static size_t string_end(std::string_view input, size_t pos);
+    // string 为 true 时 pos 在字符串内部，否则在插值内部，返回最外层结束的位置
+    // 没有结束时返回 npos，并把是否停在插值中写入 open
+    static size_t closing(std::string_view input, size_t pos, bool string, bool* open = nullptr);
+
+    Token scan_token();
     void read_char();
     char peek_char() const;
     bool is_letter(char c) const;
@@ -23,6 +52,11 @@ private:
     char _ch = 0; // 当前读取的字符
     int _pos = 0; // 当前读取的字符位置
     int _read_pos = 0; // 即将要读取的字符位置
+    int _line = 1; // 当前字符所在行
+
+    // 开启硬件计数器时累计各次 next_token 的计数，析构时记为一次 lex
+    perf_counters::Values _perf;
+    bool _perf_sampled = false;
 };
 
 }; // namespace autumn
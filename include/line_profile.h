@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "program.h"
+#include "timeline.h"
+
+namespace autumn {
+namespace line_profile {
+
+// 按源码行统计语句的执行次数，类似 gcov
+// AUTUMN_LINE_PROFILE=1 只统计次数，AUTUMN_LINE_PROFILE=time 同时统计累计耗时
+// 进程退出时把带计数的源码清单输出到 stderr
+//
+// 计数保存在以节点编号为下标的旁路表中，语法树本身不变
+// 每个线程有自己的表，输出清单时合并，多个线程可以同时执行被统计的代码
+
+namespace internal {
+// 0: 关闭, 1: 计数, 2: 计数和耗时
+// enable 可能在其它线程执行时调用
+extern std::atomic<int> g_mode;
+}
+
+inline bool enabled() {
+    return internal::g_mode.load(std::memory_order_relaxed) != 0;
+}
+
+inline bool timing() {
+    return internal::g_mode.load(std::memory_order_relaxed) == 2;
+}
+
+void enable(bool timing);
+
+// 设置需要输出清单的源码，以及属于它的节点编号区间 [first_id, last_id)
+void set_source(
+        const std::string& name,
+        const std::string& source,
+        uint32_t first_id,
+        uint32_t last_id);
+
+void hit(const ast::Node* node, uint64_t ns);
+
+// 输出带计数的源码清单
+void report(std::ostream& out);
+
+// 清空计数
+void reset();
+
+// 语句执行的作用域，析构时计数
+class Scope {
+public:
+    Scope(const ast::Node* node) {
+        if (!enabled()) {
+            return;
+        }
+        if (dynamic_cast<const ast::Statment*>(node) == nullptr
+                || typeid(*node) == typeid(ast::BlockStatment)) {
+            return;
+        }
+        _node = node;
+        if (timing()) {
+            _begin_ns = timeline::now_ns();
+        }
+    }
+
+    ~Scope() {
+        if (_node == nullptr) {
+            return;
+        }
+        hit(_node, timing() ? timeline::now_ns() - _begin_ns : 0);
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+private:
+    const ast::Node* _node = nullptr;
+    uint64_t _begin_ns = 0;
+};
+
+} // namespace line_profile
+} // namespace autumn
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "incremental_parser.h"
+
+namespace autumn {
+namespace lsp {
+
+// 语言服务器协议（LSP）的最小实现，只提供诊断
+// 消息体是 JSON-RPC，分帧（Content-Length 头）由调用方处理，见 repl/autumn_lsp.cc
+
+// 只覆盖 LSP 用到的 JSON 子集，数字统一按 double 保存
+class Json {
+public:
+    enum Type {
+        NUL,
+        BOOLEAN,
+        NUMBER,
+        STRING,
+        ARRAY,
+        OBJECT,
+    };
+
+    using Array = std::vector<Json>;
+    // 保持键的插入顺序，输出稳定
+    using Object = std::vector<std::pair<std::string, Json>>;
+
+    Json() {}
+    Json(bool value) : _type(BOOLEAN), _boolean(value) {}
+    Json(int value) : _type(NUMBER), _number(value) {}
+    Json(int64_t value) : _type(NUMBER), _number(static_cast<double>(value)) {}
+    Json(size_t value) : _type(NUMBER), _number(static_cast<double>(value)) {}
+    Json(double value) : _type(NUMBER), _number(value) {}
+    Json(const char* value) : _type(STRING), _string(value) {}
+    Json(const std::string& value) : _type(STRING), _string(value) {}
+    Json(Array value) : _type(ARRAY), _array(std::move(value)) {}
+    Json(Object value) : _type(OBJECT), _object(std::move(value)) {}
+
+    Type type() const {
+        return _type;
+    }
+
+    bool is_null() const {
+        return _type == NUL;
+    }
+
+    bool boolean() const {
+        return _boolean;
+    }
+
+    double number() const {
+        return _number;
+    }
+
+    const std::string& string() const {
+        return _string;
+    }
+
+    const Array& array() const {
+        return _array;
+    }
+
+    const Object& object() const {
+        return _object;
+    }
+
+    // 对象的成员，不存在或者不是对象时返回 null
+    const Json& operator[](std::string_view key) const;
+
+    // 解析失败返回 false
+    static bool parse(std::string_view text, Json* out);
+    std::string dump() const;
+private:
+    void dump(std::string* out) const;
+private:
+    Type _type = NUL;
+    bool _boolean = false;
+    double _number = 0;
+    std::string _string;
+    Array _array;
+    Object _object;
+};
+
+// LSP 的位置：行和 UTF-16 码元下标，都从 0 开始
+struct Position {
+    size_t line = 0;
+    size_t character = 0;
+};
+
+// 位置和字节偏移的转换，超出范围时截断到行尾或文件末尾
+size_t offset_of(const std::string& text, const Position& position);
+Position position_of(const std::string& text, size_t offset);
+
+class Server {
+public:
+    // 处理一条消息，返回需要发出的消息（响应和通知）
+    std::vector<std::string> handle(const std::string& message);
+
+    bool exited() const {
+        return _exited;
+    }
+
+    // 收到 exit 前收到过 shutdown 时为 0，否则为 1
+    int exit_code() const {
+        return _shutdown ? 0 : 1;
+    }
+
+    const IncrementalParser* document(const std::string& uri) const;
+private:
+    std::string publish_diagnostics(const std::string& uri) const;
+private:
+    std::map<std::string, IncrementalParser> _documents;
+    bool _shutdown = false;
+    bool _exited = false;
+};
+
+} // namespace lsp
+} // namespace autumn
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "program.h"
+
+namespace autumn {
+
+namespace object {
+class Environment;
+}
+
+namespace module {
+
+// 编译后的模块。语法树只读，可以被多个 Evaluator 同时使用
+struct Compiled {
+    std::string path; // 规范化后的绝对路径
+    std::filesystem::file_time_type mtime;
+    std::shared_ptr<const ast::Program> program;
+    std::vector<std::string> errors; // 解析错误，非空时 program 不可用
+    std::string source;
+    // 语法树节点编号区间 [first_id, last_id)
+    uint32_t first_id = 0;
+    uint32_t last_id = 0;
+    // 编译期求值依赖的内置函数，在重新绑定了它们的环境中执行时需要重新编译
+    std::vector<std::string> builtins;
+};
+
+// 把 import 中的路径解析为规范化的绝对路径，相对路径以 base 目录为起点
+// 文件不存在时返回空字符串
+std::string resolve(const std::string& path, const std::string& base);
+
+// 读取并解析模块。进程内按规范路径和修改时间缓存，文件被修改后重新解析
+// globals 是模块将要执行的环境，缓存的结果依赖了其中重新绑定的内置函数时重新编译，不写入缓存
+// 线程安全；读文件失败时返回 nullptr
+std::shared_ptr<const Compiled> compile(
+        const std::string& canonical_path,
+        const object::Environment* globals = nullptr);
+
+} // namespace module
+} // namespace autumn
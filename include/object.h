@@ -1,15 +1,36 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 #include "color.h"
 #include "program.h"
+#include "region.h"
 #include "format.h"
+#include "span.h"
+#include "table.h"
+#include "utf8.h"
 
 namespace autumn {
+
+namespace serialize {
+class Reader;
+} // namespace serialize
+
+namespace regexp {
+class Cache;
+} // namespace regexp
+
+namespace async_io {
+class Request;
+} // namespace async_io
+
 namespace object {
 class Type {
 public:
@@ -24,6 +45,12 @@ public:
         BUILTIN_OBJECT,
         ARRAY_OBJECT,
         HASH_OBJECT,
+        SET_OBJECT,
+        DEQUE_OBJECT,
+        PRIORITY_QUEUE_OBJECT,
+        TABLE_OBJECT,
+        COLUMN_OBJECT,
+        ASYNC_READ_OBJECT,
     };
 
     Type(TypeValue type) : _type(type) {
@@ -47,22 +74,72 @@ private:
     TypeValue _type;
 };
 
+// 切片长度不足被引用内存的 1/SLICE_COMPACT_RATIO，且被引用内存
+// 不小于 SLICE_COMPACT_MIN_SIZE 时，切片拷贝出独立的存储，避免小切片钉住大对象
+constexpr size_t SLICE_COMPACT_RATIO = 4;
+constexpr size_t SLICE_COMPACT_MIN_SIZE = 64;
+// 不超过该长度的字符串切片直接拷贝（落在 std::string 的 SSO 内，不需要分配内存）
+constexpr size_t SLICE_INLINE_SIZE = 15;
+// 不超过该长度的字符串预先计算哈希值，String::make 通过每个线程的缓存复用它们
+constexpr size_t SMALL_STRING_SIZE = SLICE_INLINE_SIZE;
+// 每个线程的短字符串缓存的槽位数，按哈希值直接映射，冲突时替换
+constexpr size_t SMALL_STRING_CACHE_SIZE = 1024;
+
+// 不超过该长度的数组把元素放在对象内部，不单独分配缓冲区
+constexpr size_t ARRAY_INLINE_SIZE = 4;
+// 不超过该大小的 hash 用线性扫描的数组保存
+constexpr size_t SMALL_HASH_SIZE = 8;
+
 class Hasher {
 public:
     virtual ~Hasher() {}
     virtual size_t hash() const = 0;
 };
 
+// 当前线程创建的对象个数，bench 用它统计每次调用的分配次数
+inline thread_local uint64_t t_allocations = 0;
+
+// 创建运行时对象：当前线程处于区域模式时从区域分配（见 region.h），否则使用普通的堆
+// 长期存活的缓存（shape 的键、字面量的值等）不能用它，或者先用 region::Scope(nullptr) 切回堆
+template <typename T, typename... Args>
+std::shared_ptr<T> make(Args&&... args) {
+    auto region = region::current();
+    if (region != nullptr) {
+        return std::allocate_shared<T>(region::Allocator<T>(region), std::forward<Args>(args)...);
+    }
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+class Object;
+
+// 把 obj 出发可达的对象图冻结：之后不可修改，也永远不会释放，可以在多个线程间共享
+// 图中有闭包（捕获的环境可变）时不做任何修改并返回 Error，成功时返回 nullptr
+// 区域中的对象就地冻结，所在的区域因此无法回卷，请求结束时被弃用
+std::shared_ptr<Object> freeze(const std::shared_ptr<Object>& obj);
+
 class Object {
 public:
+    friend std::shared_ptr<Object> freeze(const std::shared_ptr<Object>& obj);
+    friend void region::remember(Object* container, const Object* value);
+    friend class region::Promoter;
 
-    Object(Type type) : _type(type) {}
-    virtual ~Object() {}
+    Object(Type type) : _type(type) {
+        ++t_allocations;
+    }
+    virtual ~Object() {
+        if (_remembered) {
+            region::forget(this);
+        }
+    }
 
     const Type& type() const {
         return _type;
     }
 
+    bool frozen() const {
+        return _frozen;
+    }
+
     virtual std::string inspect() const = 0;
 
     template <typename T>
@@ -77,8 +154,23 @@ public:
 
 protected:
     Type _type;
+    bool _frozen = false;
+    // 是否被写屏障记下，见 region::remember
+    bool _remembered = false;
 };
 
+// 冻结对象的引用计数不起作用，读取时借用本线程的锚点的控制块，计数只在本线程的缓存行上变化，
+// 多个线程读同一张冻结的表不会争抢对象自身控制块所在的缓存行
+inline thread_local const std::shared_ptr<const void> t_frozen_anchor = std::make_shared<char>(0);
+
+// 从容器或环境中取出的值经过它再返回给求值过程
+inline std::shared_ptr<Object> share(const std::shared_ptr<Object>& obj) {
+    if (obj != nullptr && obj->frozen()) {
+        return std::shared_ptr<Object>(t_frozen_anchor, obj.get());
+    }
+    return obj;
+}
+
 namespace constants {
 
 extern std::shared_ptr<object::Object> Null;
@@ -89,7 +181,7 @@ extern std::shared_ptr<object::Object> False;
 
 class Integer : public Object, public Hasher {
 public:
-    Integer(int value) :
+    Integer(int64_t value) :
             Object(Type::INTEGER_OBJECT),
             _value(value) {
     }
@@ -99,15 +191,15 @@ public:
         return color::light::yellow + ret + color::off;
     }
 
-    int value() const {
+    int64_t value() const {
         return _value;
     }
 
     size_t hash() const override {
-        return std::hash<int>{}(_value);
+        return std::hash<int64_t>{}(_value);
     }
 private:
-    int _value = 0;
+    int64_t _value = 0;
 };
 
 class Boolean : public Object, public Hasher {
@@ -133,29 +225,160 @@ private:
     bool _value = 0;
 };
 
+// 字符串按 UTF-8 处理：长度、下标、切片都以码点为单位
+// 纯 ASCII 字符串在构造时识别出来，码点与字节一一对应
+// 其它字符串在第一次按码点访问时构建稀疏索引
+// 不超过 SMALL_STRING_SIZE 字节的短字符串（落在 std::string 的 SSO 内）
+// 在构造时算好哈希值，比较和查找都不需要再扫描内容；String::make 缓存并复用它们
 class String: public Object, public Hasher {
 public:
+    friend class region::Promoter;
+    friend class serialize::Reader;
     String(const std::string& value) :
             Object(Type::STRING_OBJECT),
-            _value(value) {
+            _value(value),
+            _ascii(utf8::is_ascii(_value)) {
+        init_hash();
+    }
+
+    String(std::string&& value) :
+            Object(Type::STRING_OBJECT),
+            _value(std::move(value)),
+            _ascii(utf8::is_ascii(_value)) {
+        init_hash();
+    }
+
+    // 视图：引用 owner 持有的一段内存，不拷贝
+    // pinned 是 owner 实际占用的字节数，用于判断切片是否需要压缩
+    // ascii 由调用方给出（ASCII 字符串的切片一定是 ASCII），避免重新扫描
+    String(const std::shared_ptr<const void>& owner,
+            const char* data,
+            size_t length,
+            size_t pinned,
+            bool ascii) :
+            Object(Type::STRING_OBJECT),
+            _owner(owner),
+            _data(data),
+            _length(length),
+            _pinned(pinned),
+            _ascii(ascii) {
+        init_hash();
+    }
+
+    // 空串和单个 ASCII 字符返回共享的对象；不超过 SMALL_STRING_SIZE 字节的短字符串
+    // 先查当前线程的缓存，最近用过的相同内容直接复用，不分配；其他情况新建
+    static std::shared_ptr<String> make(std::string_view value);
+    static std::shared_ptr<String> make(std::string&& value);
+
+    static std::shared_ptr<String> make(const char* value) {
+        return make(std::string_view(value));
     }
 
     std::string inspect() const override {
         return format(R"("{}{}{}")",
                 color::green,
-                _value,
+                value(),
                 color::off) ;
     }
 
-    const std::string& value() const {
+    std::string_view value() const {
+        if (_owner != nullptr) {
+            return std::string_view(_data, _length);
+        }
         return _value;
     }
 
     size_t hash() const override {
-        return std::hash<std::string>{}(_value);
+        if (_small) {
+            return _hash;
+        }
+        return std::hash<std::string_view>{}(value());
+    }
+
+    bool equals(const String& other) const {
+        if (this == &other) {
+            return true;
+        }
+        auto a = value();
+        auto b = other.value();
+        if (a.size() != b.size()) {
+            return false;
+        }
+        if (_small && other._small && _hash != other._hash) {
+            return false;
+        }
+        return a == b;
+    }
+
+    bool is_ascii() const {
+        return _ascii;
+    }
+
+    // 视图引用的父字符串；不是视图，或者引用的是表的映射等其它内存时返回 nullptr
+    const String* parent() const {
+        return _string_owner ? static_cast<const String*>(_owner.get()) : nullptr;
+    }
+
+    // 码点个数
+    size_t length() const;
+
+    // 第 codepoint 个码点的字节偏移，codepoint 等于 length() 时返回字节长度
+    size_t offset(size_t codepoint) const;
+
+    // 返回字节区间 [begin, end) 的切片，调用方保证区间合法
+    static std::shared_ptr<String> slice(
+            const std::shared_ptr<const String>& str,
+            size_t begin,
+            size_t end);
+private:
+    void init_hash() {
+        auto str = value();
+        if (str.size() <= SMALL_STRING_SIZE) {
+            _hash = std::hash<std::string_view>{}(str);
+            _small = true;
+        }
     }
+
+    void build_index() const;
 private:
     std::string _value;
+    std::shared_ptr<const void> _owner;
+    const char* _data = nullptr;
+    size_t _length = 0;
+    size_t _pinned = 0;
+    bool _ascii = true;
+    bool _small = false;
+    // _owner 是否指向一个 String
+    bool _string_owner = false;
+    size_t _hash = 0;
+    // 非 ASCII 字符串的码点个数与稀疏索引，按需构建
+    mutable size_t _codepoints = 0;
+    mutable std::unique_ptr<std::vector<uint32_t>> _index;
+};
+
+// to_str 和字符串插值的拼接：先记录各段，算出总长度后一次分配、写入
+// 字符串是自身的内容，整数直接写出十进制数字，布尔值和 null 是字面量，其它类型与 inspect 相同
+// 记录的字符串内容不拷贝，调用方保证 build 之前它们仍然存活
+class StringBuilder {
+public:
+    void append(std::string_view text);
+    void append(const Object* value);
+
+    size_t size() const {
+        return _size;
+    }
+
+    std::string build() const;
+private:
+    struct Piece {
+        std::string_view text;
+        int64_t integer = 0;
+        bool is_integer = false;
+    };
+    std::vector<Piece> _pieces;
+    // 其它类型的 inspect 结果
+    std::vector<std::unique_ptr<std::string>> _owned;
+    size_t _size = 0;
 };
 
 class Null : public Object {
@@ -208,42 +431,107 @@ private:
 };
 
 class Environment;
+class Function;
+
+// 一组存活的闭包，heap_dump 用它找出从根不可达却没有释放的对象
+// （闭包和它捕获的环境互相引用时引用计数不会归零）
+// 只有当前线程通过 Scope 指定了一组时，新建的闭包才会登记到这一组中；每个 Evaluator
+// 在求值期间指定自己的一组，锁只在同一组的闭包之间竞争
+class Closures {
+public:
+    Closures() {}
+    Closures(const Closures&) = delete;
+    Closures& operator=(const Closures&) = delete;
+    // 仍然存活的闭包从组中摘下，之后不再登记
+    ~Closures();
+
+    // 在锁内从最早登记的闭包开始遍历，fn 中不能释放闭包
+    void for_each(const std::function<void(const Function*)>& fn) const;
+
+    // 把 other 中的闭包全部移到本组，other 变为空
+    void splice(Closures& other);
+
+    // 当前线程新建的闭包登记到哪一组，nullptr 表示不登记
+    static Closures* current();
+
+    // 在作用域内切换当前线程登记闭包的组
+    class Scope {
+    public:
+        explicit Scope(Closures* closures);
+        ~Scope();
+    private:
+        Closures* _previous;
+    };
+private:
+    friend class Function;
+
+    void add(Function* fn);
+    void remove(Function* fn);
+private:
+    mutable std::mutex _mutex;
+    // 双向链表，_head 是最新登记的闭包
+    Function* _head = nullptr;
+    Function* _tail = nullptr;
+};
+
 class Function : public Object {
 public:
+    friend class region::Promoter;
+    friend class Closures;
+    // 闭包只持有共享的原型和捕获的环境
     Function(
-            std::vector<std::shared_ptr<ast::Identifier>>& parameters,
-            std::shared_ptr<ast::BlockStatment> body,
+            std::shared_ptr<const ast::FunctionPrototype> prototype,
             std::shared_ptr<Environment>& env) :
                 Object(Type::FUNCTION_OBJECT),
-                _parameters(parameters),
-                _body(body),
-                _env(env) {
+                _prototype(std::move(prototype)),
+                _env(env),
+                _closures(Closures::current()) {
+        if (_closures != nullptr) {
+            _closures->add(this);
+        }
+    }
+
+    ~Function() {
+        if (_closures != nullptr) {
+            _closures->remove(this);
+        }
+    }
+
+    const ast::FunctionPrototype* prototype() const {
+        return _prototype.get();
+    }
+
+    // let 绑定时的名字，匿名函数为空
+    const std::string& name() const {
+        return _prototype->name;
     }
 
     const std::vector<std::shared_ptr<ast::Identifier>>& parameters() const {
-        return _parameters;
+        return _prototype->parameters;
     }
 
     const ast::BlockStatment* body() const {
-        return _body.get();
+        return _prototype->body.get();
     }
 
     std::string inspect() const override {
-        if (_body == nullptr) {
+        auto& parameters = _prototype->parameters;
+        auto& body = _prototype->body;
+        if (body == nullptr) {
             return std::string();
         }
 
         std::string ret = "fn";
 
         ret.append(1, '(');
-        for (size_t i = 0; i < _parameters.size(); ++i) {
+        for (size_t i = 0; i < parameters.size(); ++i) {
             if (i != 0) {
                 ret.append(", ");
             }
-            ret.append(_parameters[i]->to_string());
+            ret.append(parameters[i]->to_string());
         }
         ret.append(") { ");
-        ret.append(_body->to_string());
+        ret.append(body->to_string());
         ret.append(" }");
 
         return color::cyan + ret + color::off;
@@ -253,36 +541,85 @@ public:
         return _env;
     }
 private:
-    std::vector<std::shared_ptr<ast::Identifier>> _parameters;
-    std::shared_ptr<ast::BlockStatment> _body;
+    std::shared_ptr<const ast::FunctionPrototype> _prototype;
     mutable std::shared_ptr<Environment> _env;
+    // 登记到的组以及组内的双向链表
+    Closures* _closures;
+    Function* _prev = nullptr;
+    Function* _next = nullptr;
 };
 
-using BuiltinFunction = std::function<std::shared_ptr<object::Object>(const std::vector<std::shared_ptr<object::Object>>&)>;
+// 内置函数通过它调用脚本中的函数，比如优先队列的比较函数
+class Caller {
+public:
+    virtual ~Caller() {}
+    virtual std::shared_ptr<Object> call(
+            const Object* fn,
+            std::vector<std::shared_ptr<Object>>& args) const = 0;
+    // 把运行时对象图写入 path，返回统计信息或 Error
+    virtual std::shared_ptr<Object> heap_dump(const std::string& path) const = 0;
+    // 正则表达式内置函数使用的编译缓存
+    virtual regexp::Cache& regex_cache() const = 0;
+};
+
+using BuiltinFunction = std::function<std::shared_ptr<object::Object>(
+        const std::vector<std::shared_ptr<object::Object>>&,
+        const Caller&)>;
 
 class Builtin : public Object {
 public:
-    Builtin(const BuiltinFunction& fn) :
+    friend class region::Promoter;
+    Builtin(const BuiltinFunction& fn, const std::string& name = std::string()) :
         Object(Type::BUILTIN_OBJECT),
-        _fn(fn) {
+        _fn(fn),
+        _name(name) {
+    }
+
+    const std::string& name() const {
+        return _name;
     }
 
     std::string inspect() const override {
         return color::cyan + "builtin function" + color::off;
     }
 
-    std::shared_ptr<Object> run(const std::vector<std::shared_ptr<Object>>& args) const {
-        return _fn(args);
+    std::shared_ptr<Object> run(
+            const std::vector<std::shared_ptr<Object>>& args,
+            const Caller& caller) const {
+        return _fn(args, caller);
     }
 private:
     BuiltinFunction _fn;
+    std::string _name;
 };
 
+// 三种存储方式：不超过 ARRAY_INLINE_SIZE 个元素时放在对象内部；
+// 更多元素时放在 _elements 中；切片视图引用根数组的元素
 class Array : public Object {
 public:
-    Array(const std::vector<std::shared_ptr<Object>>& elements) :
-        Object(Type::ARRAY_OBJECT),
-        _elements(elements) {
+    friend class region::Promoter;
+    using Elements = std::vector<std::shared_ptr<Object>>;
+
+    Array(const Elements& elements) :
+        Object(Type::ARRAY_OBJECT) {
+        assign(elements.data(), elements.size());
+    }
+
+    Array(Elements&& elements) :
+        Object(Type::ARRAY_OBJECT) {
+        if (elements.size() <= ARRAY_INLINE_SIZE) {
+            for (auto& elem : elements) {
+                _inline[_inline_size++] = std::move(elem);
+            }
+        } else {
+            _elements = std::move(elements);
+            _spilled = true;
+        }
+    }
+
+    Array(Span<std::shared_ptr<Object>> elements) :
+        Object(Type::ARRAY_OBJECT) {
+        assign(elements.data(), elements.size());
     }
 
     Array() :
@@ -290,61 +627,226 @@ public:
     }
 
     std::string inspect() const override {
+        auto elems = elements();
         std::string ret;
         ret.append(1, '[');
-        for (size_t i = 0; i < _elements.size(); ++i) {
+        for (size_t i = 0; i < elems.size(); ++i) {
             if (i != 0) {
                 ret.append(", ");
             }
-            ret.append(_elements[i]->inspect());
+            ret.append(elems[i]->inspect());
         }
         ret.append(1, ']');
         return ret;
     }
 
-    const std::vector<std::shared_ptr<Object>>& elements() const {
-        return _elements;
+    Span<std::shared_ptr<Object>> elements() const {
+        if (_owner != nullptr) {
+            return {_owner->elements().data() + _offset, _length};
+        }
+        if (!_spilled) {
+            return {_inline, _inline_size};
+        }
+        return {_elements.data(), _elements.size()};
+    }
+
+    // 元素是否放在对象内部
+    bool is_inline() const {
+        return _owner == nullptr && !_spilled;
+    }
+
+    // 切片视图引用的根数组，不是视图时返回 nullptr
+    const Array* parent() const {
+        return _owner.get();
     }
 
+    // 预留空间，超过 ARRAY_INLINE_SIZE 时提前转到 _elements
+    void reserve(size_t size);
+
     void append(const std::shared_ptr<object::Object>& obj) {
+        region::barrier(this, obj.get());
+        if (_spilled) {
+            _elements.push_back(obj);
+            return;
+        }
+        if (_owner == nullptr && _inline_size < ARRAY_INLINE_SIZE) {
+            _inline[_inline_size++] = obj;
+            return;
+        }
+        reserve(elements().size() + 1);
         _elements.push_back(obj);
     }
+
+    // 返回区间 [begin, end) 的切片，调用方保证区间合法
+    static std::shared_ptr<Array> slice(
+            const std::shared_ptr<const Array>& array,
+            size_t begin,
+            size_t end);
 private:
-    std::vector<std::shared_ptr<Object>> _elements;
+    void assign(const std::shared_ptr<Object>* data, size_t size);
+private:
+    std::shared_ptr<Object> _inline[ARRAY_INLINE_SIZE];
+    uint8_t _inline_size = 0;
+    bool _spilled = false;
+    Elements _elements;
+    // 切片视图共享根数组的元素，_owner 总是指向根数组
+    std::shared_ptr<const Array> _owner;
+    size_t _offset = 0;
+    size_t _length = 0;
 };
 
+// 隐藏类：键都是常量字符串的 hash 字面量共享的键布局
+// 相同键序列（按字面量中的顺序）的 shape 全局唯一，创建后不再释放，
+// 因此可以用 id 或指针比较，内联缓存里只需记住 (id, 槽位)
+class Shape {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    // 键不能重复，调用方保证
+    static const Shape* intern(const std::vector<std::string>& keys);
+    // 只查找已经存在的 shape，不存在时返回 nullptr
+    static const Shape* lookup(const std::vector<std::string>& keys);
+
+    // 从 1 开始编号，0 留给空的内联缓存
+    uint32_t id() const {
+        return _id;
+    }
+
+    size_t size() const {
+        return _keys.size();
+    }
+
+    // 第 slot 个键对应的字符串对象，所有同 shape 的 hash 共享
+    const std::shared_ptr<Object>& key(size_t slot) const {
+        return _keys[slot];
+    }
+
+    // 第 slot 个键的哈希值，与 String::hash() 一致
+    size_t hash(size_t slot) const {
+        return _hashes[slot];
+    }
+
+    // 找不到时返回 npos
+    size_t find(std::string_view key) const;
+    size_t find_hash(size_t hashcode) const;
+private:
+    Shape(uint32_t id, const std::vector<std::string>& keys);
+private:
+    uint32_t _id;
+    std::vector<std::shared_ptr<Object>> _keys;
+    std::vector<size_t> _hashes;
+};
+
+// 按键的哈希值索引（哈希值相同即视为同一个键），根据内容选择存储方式：
+// SMALL：不超过 SMALL_HASH_SIZE 个键值对，按插入顺序线性扫描；
+// DENSE：键都是整数且取值稠密，按 键 - 最小键 直接下标访问；
+// SHAPED：常量字符串键的字面量，键布局放在共享的 shape 里，自身只保存值数组；
+// MAP：其他情况
+// append 时按需转换，对调用方透明
 class Hash : public Object {
 public:
+    friend class serialize::Reader;
+    friend class region::Promoter;
     using Pair = std::pair<std::shared_ptr<Object>, std::shared_ptr<Object>>;
     using Pairs = std::unordered_map<size_t, Pair>;
 
+    enum Storage : uint8_t {
+        SMALL,
+        DENSE,
+        SHAPED,
+        MAP,
+    };
+
+    // SMALL 和 DENSE 方式的一个位置，DENSE 方式中空位的 key 为 nullptr
+    struct Entry {
+        size_t hash = 0;
+        Pair pair;
+    };
+
     Hash(const Pairs& pairs) :
         Object(Type::HASH_OBJECT),
+        _storage(MAP),
         _pairs(pairs) {
     }
 
     Hash() : Object(Type::HASH_OBJECT) {
     }
 
+    // slots 的长度必须等于 shape->size()
+    Hash(const Shape* shape, std::vector<std::shared_ptr<Object>>&& slots) :
+        Object(Type::HASH_OBJECT),
+        _storage(SHAPED),
+        _shape(shape),
+        _slots(std::move(slots)) {
+    }
+
     std::string inspect() const override {
         std::string ret;
         ret.append(1, '{');
         bool first = true;
-        for (auto& pair : _pairs) {
+        for_each([&](const std::shared_ptr<Object>& key, const std::shared_ptr<Object>& value) {
             if (!first) {
                 ret.append(", ");
             }
             first = false;
             ret.append(format("{}:{}",
-                    pair.second.first->inspect(),
-                    pair.second.second->inspect()));
-        }
+                    key->inspect(),
+                    value->inspect()));
+        });
         ret.append(1, '}');
         return ret;
     }
 
-    const Pairs& pairs() const {
-        return _pairs;
+    Storage storage() const {
+        return _storage;
+    }
+
+    // SHAPED 以外的方式为 nullptr
+    const Shape* shape() const {
+        return _shape;
+    }
+
+    const std::vector<std::shared_ptr<Object>>& slots() const {
+        return _slots;
+    }
+
+    const std::vector<Entry>& entries() const {
+        return _entries;
+    }
+
+    size_t size() const {
+        switch (_storage) {
+        case SMALL: return _entries.size();
+        case DENSE: return _dense_size;
+        case SHAPED: return _slots.size();
+        default: return _pairs.size();
+        }
+    }
+
+    // 依次以 (key, value) 调用 f
+    // SMALL 和 SHAPED 按插入顺序，DENSE 按键从小到大
+    template <typename F>
+    void for_each(F&& f) const {
+        switch (_storage) {
+        case SMALL:
+        case DENSE:
+            for (auto& entry : _entries) {
+                if (entry.pair.first != nullptr) {
+                    f(entry.pair.first, entry.pair.second);
+                }
+            }
+            break;
+        case SHAPED:
+            for (size_t i = 0; i < _slots.size(); ++i) {
+                f(_shape->key(i), _slots[i]);
+            }
+            break;
+        case MAP:
+            for (auto& pair : _pairs) {
+                f(pair.second.first, pair.second.second);
+            }
+            break;
+        }
     }
 
     const std::shared_ptr<Object>& get(const Object* key) const {
@@ -352,27 +854,260 @@ public:
         if (hasher == nullptr) {
             return constants::Null;
         }
+        auto value = find(hasher->hash());
+        return value != nullptr ? *value : constants::Null;
+    }
 
-        size_t hashcode = hasher->hash();
-        auto it = _pairs.find(hashcode);
-        if (it == _pairs.end()) {
-            return constants::Null;
+    // 字符串键的查找，不需要创建键对象
+    const std::shared_ptr<Object>& get(std::string_view key) const {
+        if (_storage == SHAPED) {
+            size_t slot = _shape->find(key);
+            return slot == Shape::npos ? constants::Null : _slots[slot];
         }
+        auto value = find(std::hash<std::string_view>{}(key));
+        return value != nullptr ? *value : constants::Null;
+    }
 
-        return it->second.second;
+    // 键已存在时保留原来的值
+    bool append(const std::shared_ptr<Object>& key, const std::shared_ptr<Object>& value);
+private:
+    // 找不到时返回 nullptr
+    const std::shared_ptr<Object>* find(size_t hashcode) const;
+    // 以下转换都只发生在 append 中
+    void to_small();
+    // 现有的键加上 key 满足稠密条件时转为 DENSE，否则不变并返回 false
+    bool to_dense(size_t hashcode, const Object* key);
+    void to_map();
+    // 插入后不再稠密时返回 false，不修改
+    bool insert_dense(size_t hashcode, const Object* key, Pair&& pair);
+private:
+    Storage _storage = SMALL;
+    const Shape* _shape = nullptr;
+    std::vector<std::shared_ptr<Object>> _slots;
+    std::vector<Entry> _entries;
+    // DENSE 方式：_entries[0] 对应的键的哈希值，非空位置的个数，现有键的最小值和最大值
+    // （_entries 的头部和尾部可能留有空位，稠密条件按实际的键计算）
+    size_t _dense_base = 0;
+    size_t _dense_size = 0;
+    int64_t _dense_lo = 0;
+    int64_t _dense_hi = 0;
+    Pairs _pairs;
+};
+
+// 开放寻址的哈希集合，线性探测，删除时留下墓碑
+// 元素必须实现 Hasher，哈希值相同时再比较类型和值
+class Set : public Object {
+public:
+    friend class region::Promoter;
+    Set() : Object(Type::SET_OBJECT) {
     }
 
-    bool append(const std::shared_ptr<Object>& key, const std::shared_ptr<Object>& value) {
-        auto hasher = key->cast<Hasher>();
-        if (hasher == nullptr) {
-            return false;
-        }
+    std::string inspect() const override;
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool contains(const Object* key) const;
+    // 插入成功返回 true，已存在时返回 false
+    bool insert(const std::shared_ptr<Object>& key);
+    bool erase(const Object* key);
+
+    // 按槽位顺序返回所有元素
+    std::vector<std::shared_ptr<Object>> elements() const;
 
-        _pairs.emplace(hasher->hash(), std::make_pair(key, value));
-        return true;
+    static bool is_hashable(const Object* key) {
+        return key->cast<Hasher>() != nullptr;
     }
 private:
-    Pairs _pairs;
+    struct Slot {
+        size_t hash = 0;
+        std::shared_ptr<Object> key;
+        bool deleted = false;
+    };
+
+    // 返回 key 所在的槽位，不存在时返回 -1
+    long find(const Object* key, size_t hash) const;
+    void rehash(size_t capacity);
+private:
+    std::vector<Slot> _slots;
+    size_t _size = 0;
+    // 已占用的槽位，包括墓碑
+    size_t _used = 0;
+};
+
+// 环形缓冲区实现的双端队列，两端的插入和删除都是 O(1)
+class Deque : public Object {
+public:
+    friend class region::Promoter;
+    Deque() : Object(Type::DEQUE_OBJECT) {
+    }
+
+    std::string inspect() const override;
+
+    size_t size() const {
+        return _size;
+    }
+
+    // 第 i 个元素，调用方保证 i < size()
+    const std::shared_ptr<Object>& at(size_t i) const {
+        return _buffer[(_head + i) & (_buffer.size() - 1)];
+    }
+
+    void push_back(const std::shared_ptr<Object>& value);
+    void push_front(const std::shared_ptr<Object>& value);
+    // 队列为空时返回 Null
+    std::shared_ptr<Object> pop_back();
+    std::shared_ptr<Object> pop_front();
+private:
+    void grow();
+private:
+    // 容量总是 2 的幂
+    std::vector<std::shared_ptr<Object>> _buffer;
+    size_t _head = 0;
+    size_t _size = 0;
+};
+
+// 二叉堆实现的优先队列，堆顶是优先级最高的元素
+// 没有比较函数时按整数或字符串从小到大出队；
+// 比较函数 fn(a, b) 返回真值表示 a 先于 b 出队
+class PriorityQueue : public Object {
+public:
+    friend class region::Promoter;
+    PriorityQueue(const std::shared_ptr<Object>& comparator = nullptr) :
+        Object(Type::PRIORITY_QUEUE_OBJECT),
+        _comparator(comparator) {
+    }
+
+    std::string inspect() const override;
+
+    size_t size() const {
+        return _heap.size();
+    }
+
+    // 队列为空时返回 Null
+    const std::shared_ptr<Object>& top() const {
+        return _heap.empty() ? constants::Null : _heap.front();
+    }
+
+    // 按堆中的顺序
+    const std::vector<std::shared_ptr<Object>>& elements() const {
+        return _heap;
+    }
+
+    const std::shared_ptr<Object>& comparator() const {
+        return _comparator;
+    }
+
+    // 比较出错时返回 Error，否则返回 nullptr
+    // 比较函数在调整堆的过程中再次修改同一个队列时返回 Error，队列保持不变
+    std::shared_ptr<Object> push(const std::shared_ptr<Object>& value, const Caller& caller);
+    // 出队的元素写入 out，比较出错时返回 Error
+    std::shared_ptr<Object> pop(const Caller& caller, std::shared_ptr<Object>* out);
+private:
+    std::shared_ptr<Object> reentered() const;
+    // a 是否先于 b 出队，出错时写入 error
+    bool before(
+            const std::shared_ptr<Object>& a,
+            const std::shared_ptr<Object>& b,
+            const Caller& caller,
+            std::shared_ptr<Object>* error) const;
+private:
+    std::vector<std::shared_ptr<Object>> _heap;
+    std::shared_ptr<Object> _comparator;
+    // 正在 push 或 pop，调用比较函数期间不允许再修改
+    bool _busy = false;
+};
+
+// load_table 返回的只读表，数据留在映射的文件中
+// table["列名"] 得到一列，table[i] 得到第 i 行（以列名为键的 hash）
+class Table : public Object {
+public:
+    Table(const std::shared_ptr<const table::Mapping>& mapping) :
+        Object(Type::TABLE_OBJECT),
+        _mapping(mapping) {
+    }
+
+    std::string inspect() const override;
+
+    const std::shared_ptr<const table::Mapping>& mapping() const {
+        return _mapping;
+    }
+
+    size_t size() const {
+        return _mapping->rows();
+    }
+
+    // 没有该列时返回 Null
+    std::shared_ptr<Object> column(std::string_view name) const;
+
+    // 调用方保证 row 合法，字符串偏移损坏时返回 Error
+    std::shared_ptr<Object> row(size_t row) const;
+private:
+    std::shared_ptr<const table::Mapping> _mapping;
+};
+
+// 表中一列的连续一段，按下标访问时才解码出 Integer 或 String
+// 长字符串是映射内存的视图，不拷贝
+class Column : public Object {
+public:
+    Column(const std::shared_ptr<const table::Mapping>& mapping,
+            size_t column,
+            size_t begin,
+            size_t size) :
+        Object(Type::COLUMN_OBJECT),
+        _mapping(mapping),
+        _column(column),
+        _begin(begin),
+        _size(size) {
+    }
+
+    std::string inspect() const override;
+
+    const std::shared_ptr<const table::Mapping>& mapping() const {
+        return _mapping;
+    }
+
+    size_t column() const {
+        return _column;
+    }
+
+    size_t begin() const {
+        return _begin;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    // 调用方保证 i < size()，字符串偏移损坏时返回 Error
+    std::shared_ptr<Object> at(size_t i) const;
+private:
+    std::shared_ptr<const table::Mapping> _mapping;
+    size_t _column;
+    size_t _begin;
+    size_t _size;
+};
+
+// read_async 返回的句柄，wait_all 等待它完成
+// 请求属于提交它的线程，不能冻结
+class AsyncRead : public Object {
+public:
+    AsyncRead(const std::shared_ptr<async_io::Request>& request) :
+        Object(Type::ASYNC_READ_OBJECT),
+        _request(request) {
+    }
+
+    std::string inspect() const override;
+
+    const std::shared_ptr<async_io::Request>& request() const {
+        return _request;
+    }
+
+    // 请求完成之后调用：文件内容（长内容是请求缓冲区的视图，不拷贝）或 Error
+    std::shared_ptr<Object> result() const;
+private:
+    std::shared_ptr<async_io::Request> _request;
 };
 
 } // namespace object
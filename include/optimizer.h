@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "program.h"
+
+namespace autumn {
+
+class Evaluator;
+
+namespace object {
+class Environment;
+}
+
+// 部分求值：执行前把参数全部是常量的纯函数调用替换为结果字面量
+//
+// 纯函数指顶层 let 绑定的函数字面量，名字在整个程序中只绑定一次且没有被用作参数，
+// 函数体只引用参数、局部变量、其它纯函数和无副作用的内置函数，并且不包含 import
+// 内置函数的名字在程序中或者执行程序的全局环境中被绑定过时不再视为内置函数
+// 每次调用在步数预算和调用深度内求值，超出限制、出错或者结果不是整数、字符串、布尔值时保持原样
+class Optimizer {
+public:
+    // 单次调用的求值步数上限
+    static constexpr size_t STEP_BUDGET = 10000;
+    // 单次调用的函数调用深度上限，避免编译期求值耗尽栈空间
+    static constexpr size_t CALL_DEPTH = 200;
+
+    // globals 是程序将要执行的全局环境，可以为空
+    explicit Optimizer(const object::Environment* globals = nullptr);
+    ~Optimizer();
+
+    void optimize(ast::Program* program);
+
+    // 纯函数依赖的内置函数名，结果只在这些名字没有被重新绑定时成立
+    std::vector<std::string> builtins() const;
+
+    // 被替换的调用个数
+    size_t folded() const {
+        return _folded;
+    }
+private:
+    struct Candidate {
+        const ast::LetStatment* let = nullptr;
+        const ast::FunctionLiteral* literal = nullptr;
+        // 依赖的纯函数中最晚的定义，调用点必须在它之后
+        uint32_t last_definition = 0;
+    };
+
+    using StatmentVisitor = std::function<void(ast::Statment*)>;
+    using ExpressionVisitor = std::function<void(std::unique_ptr<ast::Expression>&)>;
+
+    // 遍历节点的子表达式槽位，语句和语句块向下展开
+    // on_expression 负责继续遍历槽位中的表达式，也可以替换它
+    static void walk(
+            ast::Node* node,
+            const StatmentVisitor& on_statment,
+            const ExpressionVisitor& on_expression);
+
+    void analyze(ast::Program* program);
+    void infer_purity();
+    bool is_builtin(const std::string& name) const;
+    uint32_t last_definition(const std::string& name, std::unordered_set<std::string>& visiting);
+    void fold(std::unique_ptr<ast::Expression>& slot);
+    std::unique_ptr<ast::Expression> evaluate(const ast::CallExpression* call);
+private:
+    const object::Environment* _globals;
+    std::unordered_map<std::string, size_t> _let_counts;
+    std::unordered_set<std::string> _parameters;
+    std::unordered_map<std::string, Candidate> _pure;
+    std::unique_ptr<Evaluator> _evaluator;
+    size_t _folded = 0;
+};
+
+} // namespace autumn
@@ -25,12 +25,36 @@ public:
         CALL, // fn(x)
         INDEX, // array[index]
     };
+    // 默认的最大嵌套层数，可以用环境变量 AUTUMN_MAX_DEPTH 修改
+    // 解析和求值都按嵌套层数递归，超出上限时报错，而不是耗尽栈
+    static constexpr size_t MAX_DEPTH = 1000;
 public:
     Parser();
     std::unique_ptr<ast::Program> parse(const std::string& input);
     const std::vector<std::string>& errors() const;
+
+    void set_max_depth(size_t max_depth) {
+        _max_depth = max_depth;
+    }
+
+    // 解析出一条顶层语句后调用，[begin, end) 是语句的字节区间，end 是下一条语句的起点
+    // 或者输入的末尾；errors 是这条语句的解析错误；返回 false 时停止解析
+    using StatmentCallback = std::function<bool(
+            std::unique_ptr<ast::Statment> stmt,
+            size_t begin,
+            size_t end,
+            std::vector<std::string> errors)>;
+
+    // 从 input 的 offset 处开始逐条解析顶层语句，供增量解析使用
+    void parse_statments(const std::string& input, size_t offset, const StatmentCallback& callback);
 private:
+    class Nesting;
+
+    void reset(Lexer* lexer);
     void next_token();
+    void add_error(std::string error);
+    // 嵌套超出上限时报错，并跳过剩余的输入
+    void abort_too_deep();
     bool expect_peek(Token::Type type);
     bool current_token_is(Token::Type type) const;
     bool peek_token_is(Token::Type type) const;
@@ -53,6 +77,9 @@ private:
     std::unique_ptr<ast::Expression> parse_identifier();
     std::unique_ptr<ast::Expression> parse_integer_literal();
     std::unique_ptr<ast::Expression> parse_string_literal();
+    std::unique_ptr<ast::Expression> parse_interpolated_string();
+    // 在同一个解析器中解析 ${} 里的表达式，line 是字符串所在的行
+    std::unique_ptr<ast::Expression> parse_interpolation(const std::string& source, int line);
     std::unique_ptr<ast::Expression> parse_boolean_literal();
     std::unique_ptr<ast::Expression> parse_function_literal();
     std::unique_ptr<ast::Expression> parse_array_literal();
@@ -60,9 +87,14 @@ private:
     std::unique_ptr<ast::Expression> parse_group_expression();
     std::unique_ptr<ast::Expression> parse_prefix_expression();
     std::unique_ptr<ast::Expression> parse_if_expression();
+    std::unique_ptr<ast::Expression> parse_import_expression();
     std::unique_ptr<ast::Expression> parse_infix_expression(ast::Expression* left);
     std::unique_ptr<ast::Expression> parse_call_expression(ast::Expression* left);
     std::unique_ptr<ast::Expression> parse_index_expression(ast::Expression* left);
+    std::unique_ptr<ast::Expression> parse_slice_expression(
+            const Token& token,
+            ast::Expression* left,
+            ast::Expression* start);
 private:
     using PrefixParseFunc = std::function<std::unique_ptr<ast::Expression>()>;
     using InfixParseFunc = std::function<std::unique_ptr<ast::Expression>(ast::Expression* expression)>;
@@ -78,6 +110,12 @@ private:
     std::map<Token::Type, InfixParseFunc> _infix_parse_funcs;
 
     Tracer _tracer;
+
+    // 表达式和代码块的当前嵌套层数
+    size_t _depth = 0;
+    size_t _max_depth = MAX_DEPTH;
+    // 放弃解析后不再记录错误，避免逐层展开时报出大量的缺少括号
+    bool _aborted = false;
 };
 
 } // namespace autumn
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+namespace autumn {
+namespace perf_counters {
+
+// 硬件性能计数器，基于 Linux perf_event_open，只统计用户态
+// 设置环境变量 AUTUMN_PERF_COUNTERS=1 开启，按阶段（lex/parse/optimize/eval）
+// 和内置函数累计 cycles、instructions、branch-misses、cache-misses，进程退出时输出到 stderr
+//
+// 每个线程在第一次使用时打开自己的一组计数器；打开失败（权限、虚拟机、非 Linux）时
+// 只在报告中注明不可用，不影响执行。单个事件不被支持时跳过该事件
+// 阶段之间是包含关系，例如 parse 包含 lex，eval 包含其中调用的内置函数
+
+enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    BRANCH_MISSES,
+    CACHE_MISSES,
+    EVENT_COUNT,
+};
+
+// 报告中使用的事件名，例如 branch-misses
+const char* event_name(int event);
+
+struct Values {
+    uint64_t value[EVENT_COUNT] = {};
+
+    Values& operator+=(const Values& rhs) {
+        for (int i = 0; i < EVENT_COUNT; ++i) {
+            value[i] += rhs.value[i];
+        }
+        return *this;
+    }
+
+    Values operator-(const Values& rhs) const {
+        Values ret;
+        for (int i = 0; i < EVENT_COUNT; ++i) {
+            ret.value[i] = value[i] - rhs.value[i];
+        }
+        return ret;
+    }
+};
+
+namespace internal {
+// enable 可能在其它线程执行时调用
+extern std::atomic<bool> g_enabled;
+}
+
+inline bool enabled() {
+    return internal::g_enabled.load(std::memory_order_relaxed);
+}
+
+// 开启统计，进程退出时输出报告
+void enable();
+
+// 当前线程的计数器是否可用，第一次调用时打开
+bool available();
+
+// 事件是否被当前线程的计数器支持
+bool supported(int event);
+
+// 计数器不可用的原因
+std::string unavailable_reason();
+
+// 读取当前线程计数器的累计值，不可用时返回 false
+bool read(Values* values);
+
+// 累计一次 name 的计数
+void record(std::string_view name, const Values& values);
+
+// 输出各阶段的累计计数
+void report(std::ostream& out);
+
+// 清空累计计数
+void reset();
+
+// 作用域内的计数，析构时按 category 和 name 累计，name 为空时只用 category
+class Scope {
+public:
+    Scope(const char* category, std::string_view name = std::string_view()) {
+        if (!enabled() || !read(&_begin)) {
+            return;
+        }
+        _category = category;
+        _name = name;
+    }
+
+    ~Scope() {
+        if (_category == nullptr) {
+            return;
+        }
+        Values end;
+        if (!read(&end)) {
+            return;
+        }
+        if (_name.empty()) {
+            record(_category, end - _begin);
+        } else {
+            record(std::string(_category) + ":" + std::string(_name), end - _begin);
+        }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+private:
+    const char* _category = nullptr;
+    std::string_view _name;
+    Values _begin;
+};
+
+} // namespace perf_counters
+} // namespace autumn
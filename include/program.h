@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -10,6 +12,12 @@
 namespace autumn {
 
 class Parser;
+class Optimizer;
+
+namespace object {
+class Object;
+class Shape;
+} // namespace object
 
 namespace ast {
 
@@ -17,10 +25,21 @@ namespace ast {
 // 抽象节点
 class Node {
 public:
+    Node() : _id(next_id()) {}
     virtual std::string token_literal() const = 0;
     virtual std::string to_string() const = 0;
     virtual ~Node() {}
 
+    // 进程内唯一的节点编号，按创建顺序递增，用作旁路统计表的下标
+    uint32_t id() const {
+        return _id;
+    }
+
+    // 下一个将要分配的编号
+    static uint32_t peek_next_id() {
+        return s_next_id.load(std::memory_order_relaxed);
+    }
+
     template<typename T>
     const T* cast() const {
         return dynamic_cast<const T*>(this);
@@ -30,6 +49,13 @@ public:
     T* cast() {
         return dynamic_cast<T*>(this);
     };
+private:
+    static uint32_t next_id() {
+        return s_next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+private:
+    static inline std::atomic<uint32_t> s_next_id{0};
+    uint32_t _id;
 };
 
 // 语句
@@ -43,6 +69,11 @@ public:
         return _token.literal;
     }
 
+    // 语句起始 token 所在的行
+    int line() const {
+        return _token.line;
+    }
+
 protected:
     Token _token;
 };
@@ -58,6 +89,10 @@ public:
         return _token.literal;
     }
 
+    int line() const {
+        return _token.line;
+    }
+
 protected:
     Token _token;
 };
@@ -85,19 +120,19 @@ class IntegerLiteral : public Expression {
 public:
     IntegerLiteral (const Token& token) :
             Expression(token) {
-        _value = std::stoi(token.literal);
+        _value = std::stoll(token.literal);
     }
 
     std::string to_string() const override {
         return token_literal();
     }
 
-    int value() const {
+    int64_t value() const {
         return _value;
     }
 
 private:
-    int _value;
+    int64_t _value;
 };
 
 class StringLiteral : public Expression {
@@ -107,6 +142,12 @@ public:
             _value(token.literal)  {
     }
 
+    // value 是去掉转义之后的内容，to_string 仍然输出源码中的写法
+    StringLiteral (const Token& token, std::string value) :
+            Expression(token),
+            _value(std::move(value))  {
+    }
+
     std::string to_string() const override {
         return token_literal();
     }
@@ -115,8 +156,65 @@ public:
         return _value;
     }
 
+    // 求值结果的缓存：字符串不可变，同一个字面量每次求值返回同一个对象
+    std::shared_ptr<object::Object> object() const {
+        return std::atomic_load(&_object);
+    }
+
+    void set_object(const std::shared_ptr<object::Object>& object) const {
+        std::atomic_store(&_object, object);
+    }
+
 private:
     std::string _value;
+    mutable std::shared_ptr<object::Object> _object;
+};
+
+// 带插值的字符串字面量，形如 "x=${x}, y=${y}"
+// 解析时拆成 n + 1 个字面量片段和 n 个表达式，求值时先算出总长度，再一次写入
+class InterpolatedString : public Expression {
+public:
+    friend class autumn::Parser;
+    friend class autumn::Optimizer;
+    using Expression::Expression;
+
+    // 第 i 个表达式位于 literals()[i] 和 literals()[i + 1] 之间
+    const std::vector<std::string>& literals() const {
+        return _literals;
+    }
+
+    const std::vector<std::unique_ptr<Expression>>& expressions() const {
+        return _expressions;
+    }
+
+    // 与 StringLiteral 一致，不带引号
+    std::string to_string() const override {
+        std::string ret;
+        for (size_t i = 0; i < _literals.size(); ++i) {
+            if (i != 0) {
+                ret += "${" + _expressions[i - 1]->to_string() + "}";
+            }
+            // 片段中字面的 ${ 写回转义的形式
+            size_t pos = 0;
+            for (size_t found; (found = _literals[i].find("${", pos)) != std::string::npos; pos = found + 2) {
+                ret.append(_literals[i], pos, found - pos);
+                ret += "\\${";
+            }
+            ret.append(_literals[i], pos, std::string::npos);
+        }
+        return ret;
+    }
+private:
+    void append_literal(std::string literal) {
+        _literals.push_back(std::move(literal));
+    }
+
+    void append_expression(Expression* expression) {
+        _expressions.emplace_back(expression);
+    }
+private:
+    std::vector<std::string> _literals;
+    std::vector<std::unique_ptr<Expression>> _expressions;
 };
 
 class BooleanLiteral : public Expression {
@@ -141,6 +239,7 @@ private:
 class PrefixExpression : public Expression {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     PrefixExpression(const Token& token) :
             Expression(token), _operator(token.literal) {
     }
@@ -171,6 +270,7 @@ private:
 class InfixExpression : public Expression {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     InfixExpression(const Token& token) :
             Expression(token), _operator(token.literal) {
     }
@@ -207,15 +307,55 @@ private:
     void set_right(Expression* expression) {
         _right.reset(expression);
     }
+
+    Expression* release_left() {
+        return _left.release();
+    }
+
+    Expression* release_right() {
+        return _right.release();
+    }
 private:
     std::string _operator;
     std::unique_ptr<Expression> _left;
     std::unique_ptr<Expression> _right;
 };
 
+// 三个及以上操作数的 + 链，形如 a + b + c
+// 解析器把左结合的 + 展平为一个节点，字符串和数组的拼接可以一次分配完成
+class ConcatExpression : public Expression {
+public:
+    friend class autumn::Parser;
+    friend class autumn::Optimizer;
+    using Expression::Expression;
+
+    const std::vector<std::unique_ptr<Expression>>& operands() const {
+        return _operands;
+    }
+
+    // 输出与展平前的嵌套形式一致
+    std::string to_string() const override {
+        if (_operands.empty()) {
+            return "()";
+        }
+        std::string ret = _operands[0]->to_string();
+        for (size_t i = 1; i < _operands.size(); ++i) {
+            ret = "(" + ret + " + " + _operands[i]->to_string() + ")";
+        }
+        return ret;
+    }
+private:
+    void append_operand(Expression* operand) {
+        _operands.emplace_back(operand);
+    }
+private:
+    std::vector<std::unique_ptr<Expression>> _operands;
+};
+
 class BlockStatment : public Statment {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     using Statment::Statment;
     const std::vector<std::unique_ptr<Statment>>& statments() const {
         return _statments;
@@ -240,6 +380,7 @@ private:
 class IfExpression : public Expression {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     using Expression::Expression;
 
     const Expression* condition() const {
@@ -289,59 +430,93 @@ private:
     std::unique_ptr<BlockStatment> _alternative;
 };
 
+// 函数字面量的不可变描述，由解析器在函数解析完成时构建
+// 同一个字面量创建的所有闭包共享一个原型，创建闭包时不再复制参数列表
+struct FunctionPrototype {
+    std::vector<std::shared_ptr<Identifier>> parameters;
+    std::shared_ptr<BlockStatment> body;
+    // 通过 let 绑定的函数记录绑定名，匿名函数为空
+    std::string name;
+    size_t arity = 0;
+    // 函数作用域内绑定的名字个数：参数以及函数体中的 let，不含嵌套函数
+    size_t local_count = 0;
+    // 函数体引用但没有在函数内绑定的名字，按首次出现的顺序排列
+    std::vector<std::string> free_variables;
+};
+
 class FunctionLiteral : public Expression {
 public:
     friend class autumn::Parser;
-    using Expression::Expression;
+    friend class autumn::Optimizer;
+    FunctionLiteral(const Token& token) :
+            Expression(token),
+            _prototype(std::make_shared<FunctionPrototype>()) {
+    }
 
-    std::vector<std::shared_ptr<Identifier>>& parameters() const {
-        return _parameters;
+    const std::vector<std::shared_ptr<Identifier>>& parameters() const {
+        return _prototype->parameters;
     }
 
-    std::shared_ptr<BlockStatment>& body() const {
-        return _body;
+    const BlockStatment* body() const {
+        return _prototype->body.get();
+    }
+
+    const std::string& name() const {
+        return _prototype->name;
+    }
+
+    std::shared_ptr<const FunctionPrototype> prototype() const {
+        return _prototype;
     }
 
     std::string to_string() const override {
-        if (_body == nullptr) {
+        auto& parameters = _prototype->parameters;
+        auto& body = _prototype->body;
+        if (body == nullptr) {
             return std::string();
         }
 
         std::string ret(_token.literal);
 
         ret.append(1, '(');
-        for (size_t i = 0; i < _parameters.size(); ++i) {
+        for (size_t i = 0; i < parameters.size(); ++i) {
             if (i != 0) {
                 ret.append(", ");
             }
-            ret.append(_parameters[i]->to_string());
+            ret.append(parameters[i]->to_string());
         }
         ret.append(") { ");
-        ret.append(_body->to_string());
+        ret.append(body->to_string());
         ret.append(" }");
         return ret;
     }
 private:
-    void append_parameter(Identifier* parameter) {
-        _parameters.emplace_back(parameter);
-    }
-
     void set_parameters(std::vector<std::shared_ptr<Identifier>>& parameters) {
-        _parameters = parameters;
+        _prototype->parameters = parameters;
+        _prototype->arity = parameters.size();
     }
 
     void set_body(BlockStatment* body) {
-        _body.reset(body);
+        _prototype->body.reset(body);
+    }
+
+    void set_name(const std::string& name) {
+        _prototype->name = name;
+    }
+
+    void set_scope(size_t local_count, std::vector<std::string>& free_variables) {
+        _prototype->local_count = local_count;
+        _prototype->free_variables.swap(free_variables);
     }
 private:
-    // shared_ptr 的原因在于，这两个字段未来会被 object::Function 共享
-    mutable std::vector<std::shared_ptr<Identifier>> _parameters;
-    mutable std::shared_ptr<BlockStatment> _body;
+    // 只有解析器会修改原型，求值阶段只读
+    std::shared_ptr<FunctionPrototype> _prototype;
 };
 
 class CallExpression : public Expression {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     using Expression::Expression;
     
     const Expression* function() const {
@@ -386,6 +561,7 @@ private:
 class LetStatment : public Statment {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     using Statment::Statment;
 
     std::string token_literal() const override {
@@ -428,6 +604,7 @@ private:
 class ReturnStatment : public Statment {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     using Statment::Statment;
 
     const Expression* expression() const {
@@ -454,6 +631,7 @@ private:
 class ExpressionStatment : public Statment {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     using Statment::Statment;
     const Expression* expression() const {
         return _expression.get();
@@ -477,6 +655,7 @@ private:
 class ArrayLiteral : public Expression {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     using Expression::Expression;
 
     const std::vector<std::unique_ptr<Expression>>& elements() const {
@@ -508,14 +687,35 @@ private:
 class HashLiteral : public Expression {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     using Expression::Expression;
     using Pair = std::pair<std::unique_ptr<Expression>, std::unique_ptr<Expression>>;
     using Pairs = std::vector<Pair>;
 
+    // 键布局，求值器第一次求值时判断：键都是互不相同的字符串字面量时使用 shape
+    enum Layout : uint8_t {
+        UNKNOWN,
+        SHAPED,
+        GENERIC,
+    };
+
     const Pairs& pairs() const {
         return _pairs;
     }
 
+    Layout layout() const {
+        return _layout.load(std::memory_order_acquire);
+    }
+
+    const object::Shape* shape() const {
+        return _shape.load(std::memory_order_relaxed);
+    }
+
+    void set_layout(Layout layout, const object::Shape* shape) const {
+        _shape.store(shape, std::memory_order_relaxed);
+        _layout.store(layout, std::memory_order_release);
+    }
+
     std::string to_string() const override {
         std::string ret;
 
@@ -544,11 +744,14 @@ private:
     }
 private:
     Pairs _pairs;
+    mutable std::atomic<const object::Shape*> _shape{nullptr};
+    mutable std::atomic<Layout> _layout{UNKNOWN};
 };
 
 class IndexExpression : public Expression {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     using Expression::Expression;
 
     const Expression* left() const {
@@ -559,6 +762,16 @@ public:
         return _index.get();
     }
 
+    // 常量字符串键访问的单态内联缓存：(shape id << 32) | 槽位，0 表示未命中过
+    // 打包成一个整数，多个求值器并发读写时不会读到不一致的一对值
+    uint64_t inline_cache() const {
+        return _inline_cache.load(std::memory_order_relaxed);
+    }
+
+    void set_inline_cache(uint64_t cache) const {
+        _inline_cache.store(cache, std::memory_order_relaxed);
+    }
+
     std::string to_string() const override {
         std::string ret;
 
@@ -581,11 +794,89 @@ private:
 private:
     std::unique_ptr<Expression> _index;
     std::unique_ptr<Expression> _left;
+    mutable std::atomic<uint64_t> _inline_cache{0};
+};
+
+// 切片表达式 left[start:end]，start 和 end 都可以省略
+class SliceExpression : public Expression {
+public:
+    friend class autumn::Parser;
+    friend class autumn::Optimizer;
+    using Expression::Expression;
+
+    const Expression* left() const {
+        return _left.get();
+    }
+
+    // 省略时为 nullptr
+    const Expression* start() const {
+        return _start.get();
+    }
+
+    // 省略时为 nullptr
+    const Expression* end() const {
+        return _end.get();
+    }
+
+    std::string to_string() const override {
+        std::string ret;
+
+        if (_left == nullptr) {
+            return ret;
+        }
+
+        ret = format("({}[{}:{}])",
+                _left->to_string(),
+                _start == nullptr ? "" : _start->to_string(),
+                _end == nullptr ? "" : _end->to_string());
+        return ret;
+    }
+
+private:
+    void set_left(Expression* left) {
+        _left.reset(left);
+    }
+
+    void set_start(Expression* start) {
+        _start.reset(start);
+    }
+
+    void set_end(Expression* end) {
+        _end.reset(end);
+    }
+private:
+    std::unique_ptr<Expression> _left;
+    std::unique_ptr<Expression> _start;
+    std::unique_ptr<Expression> _end;
+};
+
+// 导入模块 import "path"，求值结果是模块导出的绑定
+class ImportExpression : public Expression {
+public:
+    friend class autumn::Parser;
+    friend class autumn::Optimizer;
+    using Expression::Expression;
+
+    const std::string& path() const {
+        return _path;
+    }
+
+    std::string to_string() const override {
+        return format(R"({} "{}")", token_literal(), _path);
+    }
+
+private:
+    void set_path(const std::string& path) {
+        _path = path;
+    }
+private:
+    std::string _path;
 };
 
 class Program : public Node {
 public:
     friend class autumn::Parser;
+    friend class autumn::Optimizer;
     const std::vector<std::unique_ptr<Statment>>& statments() const {
         return _statments;
     }
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace autumn {
+namespace regexp {
+
+// 线性时间的正则表达式：模式编译成 NFA 指令，匹配时用 Pike VM 同时推进所有线程，
+// 每个输入位置上每条指令最多有一个线程，耗时为 O(指令数 × 输入长度)，不回溯
+//
+// 支持的语法：
+//   字面量、.（除换行外的任意码点）、[...] [^...]、\d \w \s \D \W \S、\n \t \r 和符号的转义
+//   ^ $（输入的开头和结尾）、\b \B
+//   (...) 捕获分组、(?:...) 非捕获分组、|
+//   * + ? {n} {n,} {n,m}，后面加 ? 是非贪婪形式
+// 按 UTF-8 码点匹配，多个匹配时取最左边的，同一位置上按分支的先后（与 Perl、RE2 相同）
+class Regex {
+public:
+    // 指令数上限，限制 {n,m} 展开后的大小
+    static constexpr size_t MAX_PROGRAM_SIZE = 10000;
+    // {n,m} 中计数的上限
+    static constexpr int MAX_REPEAT = 1000;
+    // 分组的最大嵌套层数
+    static constexpr int MAX_DEPTH = 250;
+
+    static constexpr size_t npos = std::string::npos;
+
+    // 失败时返回 nullptr，原因写入 error
+    static std::shared_ptr<const Regex> compile(std::string_view pattern, std::string* error);
+
+    // 捕获分组的个数，不含整体匹配
+    size_t groups() const {
+        return _groups;
+    }
+
+    // 从字节偏移 begin 开始查找第一个匹配
+    // 找到时 captures 是 2 * (groups() + 1) 个字节偏移，第 i 组是 [captures[2i], captures[2i + 1])，
+    // 没有参与匹配的分组为 npos
+    bool search(std::string_view input, size_t begin, std::vector<size_t>* captures) const;
+public:
+    enum Opcode : uint8_t {
+        CHAR,
+        ANY,
+        CLASS,
+        SPLIT,
+        JMP,
+        SAVE,
+        ASSERT,
+        MATCH,
+    };
+
+    enum Assertion : uint8_t {
+        BEGIN_TEXT,
+        END_TEXT,
+        WORD_BOUNDARY,
+        NOT_WORD_BOUNDARY,
+    };
+
+    // CHAR: arg 是码点；CLASS: arg 是 _classes 的下标；SPLIT: 优先 x，其次 y；
+    // JMP: x；SAVE: arg 是捕获位置的下标；ASSERT: arg 是 Assertion
+    struct Inst {
+        Opcode op;
+        uint32_t arg = 0;
+        uint32_t x = 0;
+        uint32_t y = 0;
+    };
+
+    // 有序、不重叠的码点区间
+    struct Class {
+        std::vector<std::pair<uint32_t, uint32_t>> ranges;
+        bool negated = false;
+
+        bool contains(uint32_t c) const;
+    };
+private:
+    friend class Compiler;
+    Regex() {}
+private:
+    std::vector<Inst> _program;
+    std::vector<Class> _classes;
+    size_t _groups = 0;
+    // 模式以 ^ 开头时只需要从 begin 处开始尝试
+    bool _anchored = false;
+};
+
+// 按模式字符串缓存编译结果，超出容量时淘汰最久未使用的，编译失败的模式不缓存
+class Cache {
+public:
+    static constexpr size_t CAPACITY = 64;
+
+    explicit Cache(size_t capacity = CAPACITY) : _capacity(capacity) {
+    }
+
+    // 失败时返回 nullptr，原因写入 error
+    std::shared_ptr<const Regex> get(std::string_view pattern, std::string* error);
+
+    size_t size() const {
+        return _entries.size();
+    }
+
+    size_t hits() const {
+        return _hits;
+    }
+
+    size_t misses() const {
+        return _misses;
+    }
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const Regex>>;
+    size_t _capacity;
+    // 最近使用的在前面
+    std::list<Entry> _entries;
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> _index;
+    size_t _hits = 0;
+    size_t _misses = 0;
+};
+
+} // namespace regexp
+} // namespace autumn
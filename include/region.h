@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace autumn {
+
+namespace object {
+class Object;
+class Environment;
+} // namespace object
+
+namespace region {
+
+// 请求级的 bump 区域
+//
+// 区域模式下新建的运行时对象（含 shared_ptr 控制块）从区域中顺序分配，释放只是计数减一；
+// 请求结束时先把逃逸的对象拷贝到普通堆上（见 Promoter），没有存活对象时 reset 把
+// 游标退回第一个块，整个区域以 O(1) 回收，块留给下一个请求复用
+// 仍有对象存活时（例如闭包和环境的循环引用）不能回卷，区域被弃用，最后一个对象释放时才归还内存
+class Region {
+public:
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+    Region() {}
+    Region(const Region&) = delete;
+    Region& operator=(const Region&) = delete;
+
+    void* allocate(size_t size, size_t align);
+
+    void deallocate() {
+        if (_live.fetch_sub(1, std::memory_order_acq_rel) == 1
+                && _abandoned.load(std::memory_order_acquire)) {
+            delete this;
+        }
+    }
+
+    // 没有存活对象时回卷并返回 true，否则不做任何事
+    bool reset();
+
+    // 交出所有权：没有存活对象时立即释放，否则在最后一个对象释放时释放
+    void abandon();
+
+    // p 是否位于区域的内存中
+    bool contains(const void* p) const;
+
+    size_t live() const {
+        return _live.load(std::memory_order_acquire);
+    }
+
+    // 当前已分配出去的字节数和申请的块的总字节数
+    size_t used() const;
+
+    size_t capacity() const {
+        return _capacity;
+    }
+private:
+    ~Region() {}
+
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+    };
+private:
+    std::vector<Block> _blocks;
+    // 按地址排序的块区间，用于 contains
+    std::vector<std::pair<const char*, const char*>> _ranges;
+    size_t _block = 0;
+    char* _cursor = nullptr;
+    char* _end = nullptr;
+    size_t _capacity = 0;
+    std::atomic<size_t> _live{0};
+    std::atomic<bool> _abandoned{false};
+};
+
+// 放弃 Region 所有权的删除器，配合 std::unique_ptr 使用
+struct Abandon {
+    void operator()(Region* region) const {
+        region->abandon();
+    }
+};
+
+using Handle = std::unique_ptr<Region, Abandon>;
+
+inline Handle create() {
+    return Handle(new Region());
+}
+
+inline thread_local Region* t_current = nullptr;
+
+// 当前线程的活动区域，nullptr 表示使用普通的堆
+inline Region* current() {
+    return t_current;
+}
+
+// 在作用域内切换当前线程的活动区域，传入 nullptr 可以临时回到普通的堆
+class Scope {
+public:
+    explicit Scope(Region* region);
+    ~Scope();
+private:
+    Region* _previous;
+};
+
+// 供 std::allocate_shared 使用的分配器
+template <typename T>
+class Allocator {
+public:
+    using value_type = T;
+
+    explicit Allocator(Region* region) : _region(region) {}
+
+    template <typename U>
+    Allocator(const Allocator<U>& other) : _region(other.region()) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(_region->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {
+        _region->deallocate();
+    }
+
+    Region* region() const {
+        return _region;
+    }
+
+    template <typename U>
+    bool operator==(const Allocator<U>& other) const {
+        return _region == other.region();
+    }
+
+    template <typename U>
+    bool operator!=(const Allocator<U>& other) const {
+        return _region != other.region();
+    }
+private:
+    Region* _region;
+};
+
+// 写屏障：向容器或环境写入 value 之前调用
+// 区域模式下容器在堆上而 value 在当前区域里时，把容器记在本线程的记录中，请求结束时
+// Promoter 只修正记下的容器和环境，不需要遍历整个堆；记下的容器在此之前析构时调用 forget
+void remember(object::Object* container, const object::Object* value);
+void remember(object::Environment* env, const object::Object* value);
+void forget(const object::Object* container);
+void forget(const object::Environment* env);
+
+inline void barrier(object::Object* container, const object::Object* value) {
+    if (t_current != nullptr && value != nullptr) {
+        remember(container, value);
+    }
+}
+
+inline void barrier(object::Environment* env, const object::Object* value) {
+    if (t_current != nullptr && value != nullptr) {
+        remember(env, value);
+    }
+}
+
+// 把从根出发可达的区域内对象拷贝到普通堆上，保持对象之间的共享和环
+// 堆上的对象只有经过写屏障才会引用区域内的对象，先用 fix_remembered 就地替换这些引用，
+// 之后遇到堆上的对象不再进入
+// 调用时当前线程不能处于区域模式
+class Promoter {
+public:
+    explicit Promoter(const Region* region) : _region(region) {}
+
+    std::shared_ptr<object::Object> promote(const std::shared_ptr<object::Object>& obj);
+    std::shared_ptr<object::Environment> promote(const std::shared_ptr<object::Environment>& env);
+
+    // 修正本线程记下的、在请求中写入了这个区域的对象的堆上容器和环境，并清空这部分记录
+    void fix_remembered();
+
+    // 拷贝出来的对象和环境个数
+    size_t promoted() const {
+        return _promoted;
+    }
+
+    // fix_remembered 修正的容器和环境个数
+    size_t fixed() const {
+        return _fixed;
+    }
+private:
+    void fix(object::Object* obj);
+    void fix(object::Environment* env);
+private:
+    const Region* _region;
+    std::unordered_map<const void*, std::shared_ptr<object::Object>> _objects;
+    std::unordered_map<const void*, std::shared_ptr<object::Environment>> _envs;
+    size_t _promoted = 0;
+    size_t _fixed = 0;
+};
+
+// 是否通过环境变量 AUTUMN_REGION=1 默认开启区域模式
+bool enabled();
+
+} // namespace region
+} // namespace autumn
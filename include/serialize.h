@@ -0,0 +1,38 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include "object.h"
+
+namespace autumn {
+namespace serialize {
+
+// 运行时值的二进制编码，用于在求值器（进程、线程）之间传递数据
+//
+// 格式：魔数 "AU"，版本号 1 个字节，之后是一个值。每个值以 1 个字节的标记开头:
+//   NUL / FALSE / TRUE
+//   INTEGER  zigzag 编码的 varint
+//   STRING   varint 长度 + 字节
+//   ARRAY    varint 个数 + 元素
+//   HASH     varint 个数 + (键, 值)...
+//   RECORD   varint 个数 + 字符串键... + 值...（shape 方式的 hash，键布局的 shape 已经存在时解码为 shape 方式）
+//   SET      varint 个数 + 元素
+//   DEQUE    varint 个数 + 元素
+//   REF      varint 下标，指向之前出现过的字符串或容器
+// 字符串和容器按首次出现的顺序编号，再次出现时写 REF，所以共享的子图（DAG）只编码一次，
+// 集合和双端队列之间的环也能还原
+constexpr uint8_t VERSION = 1;
+
+// 编码 value，成功时返回 nullptr，值中有闭包、内置函数、优先队列等不能编码的对象时返回 Error
+std::shared_ptr<object::Object> encode(const object::Object* value, std::string* out);
+
+// 解码一个值，输入不合法时返回 Error
+std::shared_ptr<object::Object> decode(std::string_view bytes);
+
+// zero_copy 为 true 时解码出的字符串是 bytes 的视图，不拷贝内容，它们会一直持有 bytes
+std::shared_ptr<object::Object> decode(const std::shared_ptr<const object::String>& bytes, bool zero_copy);
+
+} // namespace serialize
+} // namespace autumn
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+
+namespace autumn {
+
+// 只读的连续内存视图，不持有数据（C++17 没有 std::span）
+template <typename T>
+class Span {
+public:
+    Span() {}
+    Span(const T* data, size_t size) :
+        _data(data), _size(size) {
+    }
+
+    const T* begin() const {
+        return _data;
+    }
+
+    const T* end() const {
+        return _data + _size;
+    }
+
+    const T* data() const {
+        return _data;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    bool empty() const {
+        return _size == 0;
+    }
+
+    const T& front() const {
+        return _data[0];
+    }
+
+    const T& back() const {
+        return _data[_size - 1];
+    }
+
+    const T& operator[](size_t i) const {
+        return _data[i];
+    }
+
+private:
+    const T* _data = nullptr;
+    size_t _size = 0;
+};
+
+} // namespace autumn
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "span.h"
+
+namespace autumn {
+
+namespace object {
+class Object;
+class Shape;
+} // namespace object
+
+namespace table {
+
+// 列式的只读数据文件，通过 mmap 映射，多个进程共享同一份页缓存
+//
+// 文件布局（小端，所有偏移从文件开头算起，整数区按 8 字节对齐）:
+//   Header   magic "AUTB"，version(u32)，rows(u64)，columns(u64)
+//   Column[] 每列一项：type(u32)，保留(u32)，name 的偏移和长度(u64, u64)，
+//            data 的偏移(u64)，offsets 的偏移(u64)
+//   INT64 列：data 处是 rows 个 int64
+//   STRING 列：offsets 处是 rows + 1 个 u64，第 i 行是 data[offsets[i], offsets[i + 1])
+// 加载时只检查文件头和列目录，字符串的偏移在访问该行时检查
+constexpr uint32_t VERSION = 1;
+
+enum ColumnType : uint32_t {
+    INT64 = 1,
+    STRING = 2,
+};
+
+class Mapping {
+public:
+    struct Column {
+        std::string name;
+        ColumnType type;
+        // INT64 列的数据，或 STRING 列的字节区
+        const char* data = nullptr;
+        size_t data_size = 0;
+        // STRING 列的 rows + 1 个偏移
+        const uint64_t* offsets = nullptr;
+    };
+
+    ~Mapping();
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    // 失败时返回 nullptr，原因写入 error
+    static std::shared_ptr<const Mapping> open(const std::string& path, std::string* error);
+
+    size_t rows() const {
+        return _rows;
+    }
+
+    const std::vector<Column>& columns() const {
+        return _columns;
+    }
+
+    // 找不到时返回 -1
+    int find(std::string_view name) const;
+
+    // INT64 列的原始数据，可以直接交给 BatchExpression 按列求值
+    Span<int64_t> integers(size_t column) const;
+
+    // STRING 列第 row 行，偏移不合法时返回 false
+    bool string(size_t column, size_t row, std::string_view* out) const;
+
+    // 以列名为键的 shape，行对象共享它；有重复列名或者程序中没有这样的 shape 时为 nullptr
+    const object::Shape* shape() const {
+        return _shape;
+    }
+private:
+    Mapping() {}
+private:
+    void* _base = nullptr;
+    size_t _size = 0;
+    size_t _rows = 0;
+    std::vector<Column> _columns;
+    const object::Shape* _shape = nullptr;
+};
+
+// 写出数据文件，每列是整数或字符串的数组，所有列的长度必须相同，失败时返回 false 并写入 error
+struct ColumnData {
+    std::string name;
+    ColumnType type;
+    std::vector<int64_t> integers;
+    std::vector<std::string> strings;
+};
+
+bool write(const std::string& path, const std::vector<ColumnData>& columns, std::string* error);
+
+} // namespace table
+} // namespace autumn
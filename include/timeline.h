@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "utf8.h"
+
+namespace autumn {
+namespace timeline {
+
+// 执行时间线，输出 Chrome trace-event 格式的 JSON，可以用 Perfetto 或 chrome://tracing 查看
+// 设置环境变量 AUTUMN_TIMELINE=trace.json 开启，进程退出时写入文件
+// AUTUMN_TIMELINE_THRESHOLD_US 控制函数调用的最小记录时长，默认 100 微秒
+//
+// 每个线程把事件写入自己的缓冲区，写入不加锁；缓冲区按块分配，
+// 已发布的事件不会再被移动，因此 flush 可以和写入并发进行
+
+namespace internal {
+// enable 可能在其它线程写入事件时调用
+extern std::atomic<bool> g_enabled;
+}
+
+inline bool enabled() {
+    return internal::g_enabled.load(std::memory_order_relaxed);
+}
+
+// 开启记录，进程退出时写入 path
+void enable(const std::string& path);
+
+// 函数调用事件的最小时长
+uint64_t threshold_ns();
+
+inline uint64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 记录一个已经结束的区间，name 超过 64 字节的部分被截断
+void record(const char* category, std::string_view name, uint64_t begin_ns, uint64_t end_ns);
+
+// 把所有线程已记录的事件写入 path，返回是否成功
+bool flush(const std::string& path);
+
+// 作用域区间，析构时记录；时长小于 threshold_ns 的区间被丢弃
+class Span {
+public:
+    Span(const char* category, std::string_view name, uint64_t threshold_ns = 0) {
+        if (!enabled()) {
+            return;
+        }
+        _category = category;
+        // 和 record 一样在字符边界截断，不拆开 UTF-8 字符
+        size_t length = std::min(name.size(), sizeof(_buf));
+        while (length < name.size() && length > 0 && utf8::is_continuation(name[length])) {
+            --length;
+        }
+        name.copy(_buf, length);
+        _name = std::string_view(_buf, length);
+        _threshold_ns = threshold_ns;
+        _begin_ns = now_ns();
+    }
+
+    ~Span() {
+        if (_category == nullptr) {
+            return;
+        }
+        uint64_t end_ns = now_ns();
+        if (end_ns - _begin_ns >= _threshold_ns) {
+            record(_category, _name, _begin_ns, end_ns);
+        }
+    }
+
+    Span(const Span&) = delete;
+    Span& operator=(const Span&) = delete;
+private:
+    const char* _category = nullptr;
+    std::string_view _name;
+    char _buf[64];
+    uint64_t _threshold_ns = 0;
+    uint64_t _begin_ns = 0;
+};
+
+} // namespace timeline
+} // namespace autumn
@@ -39,6 +39,7 @@ struct Token {
         IF,
         ELSE,
         RETURN,
+        IMPORT,
         STRING,
         END,
     };
@@ -52,6 +53,8 @@ struct Token {
 
     Type type;
     std::string literal;
+    int line = 0; // 所在行，从 1 开始
+    int offset = 0; // 在输入中的字节偏移
 
     bool operator==(const Token& rhs) const;
     friend std::ostream& operator<<(std::ostream& out, const Token& token);
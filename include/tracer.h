@@ -18,7 +18,11 @@ public:
         }
     }
 
+    // 未开启调试时不做任何格式化，返回空函数
     std::function<void()> trace(const std::string& message, const std::string& token_literal) {
+        if (!_debug_env) {
+            return nullptr;
+        }
         ++_level;
         print(format("{:dark}BEGIN: {:message}: {:yellow}{:token}{:off}",
                     color::dark::dark,
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace autumn {
+namespace utf8 {
+
+// 稀疏码点索引的步长：每 INDEX_STRIDE 个码点记录一次字节偏移
+constexpr size_t INDEX_STRIDE = 64;
+
+// 判断是否全部为 ASCII 字符，x86 下使用 SSE2 每次检查 16 字节
+bool is_ascii(std::string_view str);
+
+// 是否为 UTF-8 的后续字节（10xxxxxx）
+inline bool is_continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// 码点个数，非法的后续字节归入前一个码点
+size_t length(std::string_view str);
+
+// 从字节偏移 offset 开始向后跳过 n 个码点，返回新的字节偏移
+size_t advance(std::string_view str, size_t offset, size_t n);
+
+// 构建稀疏索引：index[k] 是第 k * INDEX_STRIDE 个码点的字节偏移
+// 返回码点个数
+size_t build_index(std::string_view str, std::vector<uint32_t>* index);
+
+} // namespace utf8
+} // namespace autumn
@@ -1,3 +1,4 @@
+#include <fstream>
 #include <functional>
 #include <iostream>
 #include <map>
@@ -7,6 +8,7 @@
 #include "lexer.h"
 #include "parser.h"
 #include "evaluator.h"
+#include "heap.h"
 
 #include <readline/readline.h>
 #include <readline/history.h>
@@ -17,6 +19,10 @@ void lexer_repl(const std::string& line);
 void parser_repl(const std::string& line);
 void eval_repl(const std::string& line);
 void do_nothing(const std::string& line);
+int run_file(const std::string& path);
+bool load_prelude();
+int heap_summary(const std::string& path, size_t top);
+bool run_command(const std::string& line);
 
 autumn::Evaluator evaluator;
 
@@ -28,6 +34,18 @@ const std::map<std::string, std::function<void(const std::string&)>> REPLS = {
 
 int main(int argc, char* argv[]) {
     std::function<void(const std::string&)> repl(do_nothing);
+    if (!load_prelude()) {
+        return 1;
+    }
+    // 执行脚本文件：./autumn run script.au
+    if (argc > 2 && std::string(argv[1]) == "run") {
+        return run_file(argv[2]);
+    }
+    // 汇总堆转储文件：./autumn heap_summary dump.txt [top]
+    if (argc > 2 && std::string(argv[1]) == "heap_summary") {
+        return heap_summary(argv[2], argc > 3 ? strtoul(argv[3], nullptr, 10) : 20);
+    }
+
     if (argc > 1) {
         auto it = REPLS.find(argv[1]);
         if (it != REPLS.end()) {
@@ -44,7 +62,9 @@ int main(int argc, char* argv[]) {
 
         if (!line.empty()) {
             if (line == "q" || line == "quit") return 0;
-            repl(line);
+            if (!run_command(line)) {
+                repl(line);
+            }
             add_history(line.c_str());
         }
     }
@@ -85,6 +105,63 @@ void eval_repl(const std::string& line) {
     std::cout << obj->inspect() << std::endl;
 }
 
+int run_file(const std::string& path) {
+    auto obj = evaluator.eval_file(path);
+    if (obj == nullptr) {
+        return 0;
+    }
+
+    if (obj->type() == autumn::object::Type::ERROR_OBJECT) {
+        std::cerr << obj->inspect() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// AUTUMN_PRELUDE 指定的脚本先于其他输入执行，它定义的全局常量表随后被冻结
+bool load_prelude() {
+    const char* path = getenv("AUTUMN_PRELUDE");
+    if (path == nullptr || *path == '\0') {
+        return true;
+    }
+    auto obj = evaluator.eval_file(path);
+    if (obj != nullptr && obj->type() == autumn::object::Type::ERROR_OBJECT) {
+        std::cerr << obj->inspect() << std::endl;
+        return false;
+    }
+    evaluator.freeze_globals();
+    return true;
+}
+
+int heap_summary(const std::string& path, size_t top) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "failed to read: " << path << std::endl;
+        return 1;
+    }
+    if (!autumn::heap::summarize(in, std::cout, top)) {
+        std::cerr << "not a heap dump: " << path << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// 以 : 开头的 repl 命令，比如 :heap_dump heap.txt
+bool run_command(const std::string& line) {
+    const std::string heap_dump = ":heap_dump";
+    if (line.compare(0, heap_dump.size(), heap_dump) != 0) {
+        return false;
+    }
+    auto path = line.substr(heap_dump.size());
+    path.erase(0, path.find_first_not_of(' '));
+    if (path.empty()) {
+        path = "heap.txt";
+    }
+    auto obj = evaluator.heap_dump(path);
+    std::cout << obj->inspect() << std::endl;
+    return true;
+}
+
 void do_nothing(const std::string& line) {
     std::cout << "do_nothing:" << line << std::endl;
 }
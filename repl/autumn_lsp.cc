@@ -0,0 +1,54 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "lsp.h"
+
+// 通过标准输入输出提供诊断的语言服务器：./autumn_lsp
+// 每条消息前是 Content-Length 头，头和消息体之间是一个空行
+
+// 读取一条消息，输入结束时返回 false
+bool read_message(std::istream& in, std::string* body) {
+    size_t length = 0;
+    bool has_length = false;
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            if (!has_length) {
+                continue;
+            }
+            body->assign(length, '\0');
+            return static_cast<bool>(in.read(&(*body)[0], length));
+        }
+        const std::string header = "Content-Length:";
+        if (line.compare(0, header.size(), header) == 0) {
+            length = std::strtoul(line.c_str() + header.size(), nullptr, 10);
+            has_length = true;
+        }
+    }
+    return false;
+}
+
+void write_message(std::ostream& out, const std::string& body) {
+    out << "Content-Length: " << body.size() << "\r\n\r\n" << body;
+    out.flush();
+}
+
+int main() {
+    std::ios::sync_with_stdio(false);
+    autumn::lsp::Server server;
+    std::string body;
+    while (read_message(std::cin, &body)) {
+        for (auto& message : server.handle(body)) {
+            write_message(std::cout, message);
+        }
+        if (server.exited()) {
+            return server.exit_code();
+        }
+    }
+    // 客户端断开而没有发送 exit
+    return 1;
+}
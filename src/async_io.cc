@@ -0,0 +1,468 @@
+#include "async_io.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+#include "format.h"
+
+#ifdef __linux__
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#ifdef __NR_io_uring_setup
+#define AUTUMN_IO_URING 1
+#endif
+#endif
+#endif
+
+namespace autumn {
+namespace async_io {
+
+namespace {
+
+// st_size 为 0 的文件（/proc 等）大小未知，按块读到文件末尾
+constexpr size_t CHUNK_SIZE = 4096;
+// 每个线程的环上同时在途的请求数
+constexpr unsigned RING_ENTRIES = 256;
+constexpr size_t POOL_THREADS = 8;
+// 提交时攒够这么多个操作才调用 io_uring_enter，wait 时总会提交剩下的
+constexpr unsigned SUBMIT_BATCH = 32;
+
+} // namespace
+
+int read_file(const std::string& path, std::string* data) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno;
+    }
+    struct stat st;
+    bool sized = fstat(fd, &st) == 0 && st.st_size > 0;
+    data->resize(sized ? static_cast<size_t>(st.st_size) : CHUNK_SIZE);
+    size_t offset = 0;
+    int error = 0;
+    while (true) {
+        if (offset == data->size()) {
+            // 与 io_uring 的实现一致：读满 st_size 即结束
+            if (sized) {
+                break;
+            }
+            data->resize(data->size() * 2);
+        }
+        ssize_t n = ::read(fd, &(*data)[offset], data->size() - offset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            error = errno;
+            break;
+        }
+        if (n == 0) {
+            break;
+        }
+        offset += n;
+    }
+    data->resize(error == 0 ? offset : 0);
+    close(fd);
+    return error;
+}
+
+#ifdef AUTUMN_IO_URING
+
+// 单线程使用的 io_uring：提交和收割都在拥有它的线程上进行
+// 每个请求同一时刻只有一个操作在途（先 openat，再一次或多次 read），
+// 活动请求数不超过提交队列的长度，所以提交队列和完成队列都不会溢出
+class UringReader : public Reader {
+public:
+    ~UringReader() override {
+        // 内核可能还在写请求的缓冲区，先等在途和排队的请求完成
+        while (_error == 0 && !(_active.empty() && _queued.empty())) {
+            reap();
+            start_queued();
+            if (!_active.empty()) {
+                enter(1);
+            }
+        }
+        if (_sqes != nullptr) {
+            munmap(_sqes, _sqes_size);
+        }
+        if (_cq_ring != nullptr && _cq_ring != _sq_ring) {
+            munmap(_cq_ring, _cq_size);
+        }
+        if (_sq_ring != nullptr) {
+            munmap(_sq_ring, _sq_size);
+        }
+        if (_fd >= 0) {
+            close(_fd);
+        }
+    }
+
+    bool init(unsigned entries, std::string* error) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        _fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (_fd < 0) {
+            *error = format("io_uring_setup: {}", strerror(errno));
+            return false;
+        }
+
+        _sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) {
+            _sq_size = _cq_size = std::max(_sq_size, _cq_size);
+        }
+        _sq_ring = map(_sq_size, IORING_OFF_SQ_RING);
+        _cq_ring = single ? _sq_ring : map(_cq_size, IORING_OFF_CQ_RING);
+        _sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        _sqes = static_cast<io_uring_sqe*>(map(_sqes_size, IORING_OFF_SQES));
+        if (_sq_ring == nullptr || _cq_ring == nullptr || _sqes == nullptr) {
+            *error = format("io_uring mmap: {}", strerror(errno));
+            return false;
+        }
+
+        auto sq = static_cast<char*>(_sq_ring);
+        _sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        _sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        _sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto cq = static_cast<char*>(_cq_ring);
+        _cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        _cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        _cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        _entries = params.sq_entries;
+
+        // openat 和 read 需要 5.6 以上的内核
+        std::vector<char> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (syscall(__NR_io_uring_register, _fd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+            *error = format("io_uring probe: {}", strerror(errno));
+            return false;
+        }
+        for (int op : {IORING_OP_OPENAT, IORING_OP_READ}) {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) {
+                *error = format("io_uring does not support opcode {}", op);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::shared_ptr<Request> submit(const std::string& path) override {
+        auto request = std::make_shared<Request>(path);
+        if (_error != 0) {
+            request->finish(_error);
+            return request;
+        }
+        _queued.push_back(request);
+        // 顺便处理已经完成的操作；攒够一批再交给内核，一次系统调用提交多个操作
+        reap();
+        start_queued();
+        if (_pending >= SUBMIT_BATCH) {
+            flush();
+        }
+        return request;
+    }
+
+    void wait(const std::vector<std::shared_ptr<Request>>& requests) override {
+        auto done = [&]() {
+            return std::all_of(requests.begin(), requests.end(), [](const std::shared_ptr<Request>& r) {
+                return r->done();
+            });
+        };
+        while (true) {
+            reap();
+            start_queued();
+            // 没有在途的操作时剩下的请求不属于这个环，等待不会有结果
+            if (done() || _error != 0 || _active.empty()) {
+                return;
+            }
+            enter(1);
+        }
+    }
+
+    const char* backend() const override {
+        return "io_uring";
+    }
+private:
+    void* map(size_t size, off_t offset) {
+        void* ret = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd, offset);
+        return ret == MAP_FAILED ? nullptr : ret;
+    }
+
+    io_uring_sqe* next_sqe(Request* request) {
+        unsigned tail = *_sq_tail;
+        unsigned index = tail & _sq_mask;
+        auto sqe = &_sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->user_data = reinterpret_cast<uint64_t>(request);
+        _sq_array[index] = index;
+        return sqe;
+    }
+
+    void commit() {
+        __atomic_store_n(_sq_tail, *_sq_tail + 1, __ATOMIC_RELEASE);
+        ++_pending;
+    }
+
+    void open(Request* request) {
+        request->_stage = Request::OPENING;
+        auto sqe = next_sqe(request);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = AT_FDCWD;
+        sqe->addr = reinterpret_cast<uint64_t>(request->_path.c_str());
+        sqe->open_flags = O_RDONLY | O_CLOEXEC;
+        commit();
+    }
+
+    void read(Request* request) {
+        request->_stage = Request::READING;
+        auto sqe = next_sqe(request);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = request->_fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&request->_data[request->_offset]);
+        sqe->len = static_cast<uint32_t>(std::min<size_t>(request->_data.size() - request->_offset, 1u << 30));
+        sqe->off = request->_offset;
+        commit();
+    }
+
+    // 提交排队的请求，直到活动请求数达到环的大小
+    void start_queued() {
+        while (!_queued.empty() && _active.size() < _entries) {
+            auto request = std::move(_queued.front());
+            _queued.pop_front();
+            auto raw = request.get();
+            _active.emplace(raw, std::move(request));
+            open(raw);
+        }
+    }
+
+    void flush() {
+        while (_pending > 0 && _error == 0) {
+            enter(0);
+        }
+    }
+
+    // 提交未提交的操作，min_complete > 0 时等待至少这么多个完成事件
+    void enter(unsigned min_complete) {
+        int ret = static_cast<int>(syscall(__NR_io_uring_enter, _fd, _pending, min_complete,
+                min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+        if (ret >= 0) {
+            _pending -= std::min<unsigned>(ret, _pending);
+            return;
+        }
+        if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+            return;
+        }
+        // 环不可用，之后的请求都以这个错误结束
+        _error = errno;
+        for (auto& request : _queued) {
+            request->finish(_error);
+        }
+        _queued.clear();
+        for (auto& entry : _active) {
+            entry.second->finish(_error);
+        }
+    }
+
+    void reap() {
+        unsigned head = *_cq_head;
+        unsigned tail = __atomic_load_n(_cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            auto& cqe = _cqes[head & _cq_mask];
+            auto request = reinterpret_cast<Request*>(cqe.user_data);
+            int res = cqe.res;
+            ++head;
+            __atomic_store_n(_cq_head, head, __ATOMIC_RELEASE);
+            complete(request, res);
+        }
+    }
+
+    void complete(Request* request, int res) {
+        if (request->_stage == Request::OPENING) {
+            if (res < 0) {
+                finish(request, -res);
+                return;
+            }
+            request->_fd = res;
+            struct stat st;
+            request->_sized = fstat(res, &st) == 0 && st.st_size > 0;
+            request->_data.resize(request->_sized ? static_cast<size_t>(st.st_size) : CHUNK_SIZE);
+            read(request);
+            return;
+        }
+
+        if (res == -EINTR || res == -EAGAIN) {
+            read(request);
+            return;
+        }
+        if (res <= 0) {
+            finish(request, -res);
+            return;
+        }
+        request->_offset += res;
+        if (request->_offset == request->_data.size()) {
+            if (request->_sized) {
+                finish(request, 0);
+                return;
+            }
+            request->_data.resize(request->_data.size() * 2);
+        }
+        read(request);
+    }
+
+    void finish(Request* request, int error) {
+        if (request->_fd >= 0) {
+            close(request->_fd);
+            request->_fd = -1;
+        }
+        request->_data.resize(error == 0 ? request->_offset : 0);
+        request->finish(error);
+        // 最后释放，request 此后可能已经析构
+        _active.erase(request);
+    }
+private:
+    int _fd = -1;
+    void* _sq_ring = nullptr;
+    void* _cq_ring = nullptr;
+    size_t _sq_size = 0;
+    size_t _cq_size = 0;
+    io_uring_sqe* _sqes = nullptr;
+    size_t _sqes_size = 0;
+
+    unsigned* _sq_tail = nullptr;
+    unsigned _sq_mask = 0;
+    unsigned* _sq_array = nullptr;
+    unsigned* _cq_head = nullptr;
+    unsigned* _cq_tail = nullptr;
+    unsigned _cq_mask = 0;
+    io_uring_cqe* _cqes = nullptr;
+    unsigned _entries = 0;
+
+    // 已写入提交队列、尚未交给内核的操作数
+    unsigned _pending = 0;
+    // io_uring_enter 失败时的 errno
+    int _error = 0;
+    std::unordered_map<Request*, std::shared_ptr<Request>> _active;
+    std::deque<std::shared_ptr<Request>> _queued;
+};
+
+#endif
+
+// 固定数量的工作线程，每个请求由一个线程同步读取
+class ThreadPoolReader : public Reader {
+public:
+    explicit ThreadPoolReader(size_t threads) {
+        for (size_t i = 0; i < threads; ++i) {
+            _workers.emplace_back([this]() { run(); });
+        }
+    }
+
+    ~ThreadPoolReader() override {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _work.notify_all();
+        for (auto& worker : _workers) {
+            worker.join();
+        }
+    }
+
+    std::shared_ptr<Request> submit(const std::string& path) override {
+        auto request = std::make_shared<Request>(path);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _queue.push_back(request);
+        }
+        _work.notify_one();
+        return request;
+    }
+
+    void wait(const std::vector<std::shared_ptr<Request>>& requests) override {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [&]() {
+            return std::all_of(requests.begin(), requests.end(), [](const std::shared_ptr<Request>& r) {
+                return r->done();
+            });
+        });
+    }
+
+    const char* backend() const override {
+        return "threads";
+    }
+private:
+    // 队列空了并且要求停止时退出，析构前提交的请求都会完成
+    void run() {
+        while (true) {
+            std::shared_ptr<Request> request;
+            {
+                std::unique_lock<std::mutex> lock(_mutex);
+                _work.wait(lock, [this]() { return _stop || !_queue.empty(); });
+                if (_queue.empty()) {
+                    return;
+                }
+                request = std::move(_queue.front());
+                _queue.pop_front();
+            }
+            int error = read_file(request->_path, &request->_data);
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                request->finish(error);
+            }
+            _done.notify_all();
+        }
+    }
+private:
+    std::mutex _mutex;
+    std::condition_variable _work;
+    std::condition_variable _done;
+    std::deque<std::shared_ptr<Request>> _queue;
+    bool _stop = false;
+    std::vector<std::thread> _workers;
+};
+
+std::unique_ptr<Reader> create_uring(unsigned entries, std::string* error) {
+#ifdef AUTUMN_IO_URING
+    std::unique_ptr<UringReader> ret(new UringReader());
+    if (!ret->init(entries, error)) {
+        return nullptr;
+    }
+    return ret;
+#else
+    *error = "io_uring is not available on this platform";
+    return nullptr;
+#endif
+}
+
+std::unique_ptr<Reader> create_thread_pool(size_t threads) {
+    return std::unique_ptr<Reader>(new ThreadPoolReader(threads));
+}
+
+Reader& reader() {
+    thread_local std::unique_ptr<Reader> t_reader;
+    if (t_reader == nullptr) {
+        const char* mode = getenv("AUTUMN_ASYNC_IO");
+        std::string error;
+        if (mode == nullptr || strcmp(mode, "threads") != 0) {
+            t_reader = create_uring(RING_ENTRIES, &error);
+        }
+        if (t_reader == nullptr) {
+            t_reader = create_thread_pool(POOL_THREADS);
+        }
+    }
+    return *t_reader;
+}
+
+} // namespace async_io
+} // namespace autumn
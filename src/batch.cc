@@ -0,0 +1,367 @@
+#include "batch.h"
+
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
+
+#include "builtin.h"
+#include "evaluator.h"
+#include "parser.h"
+
+namespace autumn {
+
+// 一个节点的计算结果：整列或者广播的常量
+struct BatchExpression::Vector {
+    BatchResult::Kind kind = BatchResult::INTEGER;
+    bool scalar = false;
+    int64_t value = 0;
+    const int64_t* data = nullptr;
+    std::vector<int64_t> storage;
+};
+
+namespace {
+
+void collect_variables(
+        const ast::Node* node,
+        std::vector<std::string>* variables,
+        std::unordered_set<std::string>* seen) {
+    if (node == nullptr) {
+        return;
+    }
+
+    auto visit = [&](const ast::Node* child) {
+        collect_variables(child, variables, seen);
+    };
+
+    if (typeid(*node) == typeid(ast::Identifier)) {
+        auto& name = node->cast<ast::Identifier>()->value();
+        if (builtin::BUILTINS.count(name) == 0 && seen->insert(name).second) {
+            variables->push_back(name);
+        }
+    } else if (typeid(*node) == typeid(ast::PrefixExpression)) {
+        visit(node->cast<ast::PrefixExpression>()->right());
+    } else if (typeid(*node) == typeid(ast::InfixExpression)) {
+        auto n = node->cast<ast::InfixExpression>();
+        visit(n->left());
+        visit(n->right());
+    } else if (typeid(*node) == typeid(ast::ConcatExpression)) {
+        for (auto& operand : node->cast<ast::ConcatExpression>()->operands()) {
+            visit(operand.get());
+        }
+    } else if (typeid(*node) == typeid(ast::InterpolatedString)) {
+        for (auto& exp : node->cast<ast::InterpolatedString>()->expressions()) {
+            visit(exp.get());
+        }
+    } else if (typeid(*node) == typeid(ast::IfExpression)) {
+        auto n = node->cast<ast::IfExpression>();
+        visit(n->condition());
+        visit(n->consequence());
+        visit(n->alternative());
+    } else if (typeid(*node) == typeid(ast::BlockStatment)) {
+        for (auto& stmt : node->cast<ast::BlockStatment>()->statments()) {
+            visit(stmt.get());
+        }
+    } else if (typeid(*node) == typeid(ast::ExpressionStatment)) {
+        visit(node->cast<ast::ExpressionStatment>()->expression());
+    } else if (typeid(*node) == typeid(ast::CallExpression)) {
+        auto n = node->cast<ast::CallExpression>();
+        visit(n->function());
+        for (auto& arg : n->arguments()) {
+            visit(arg.get());
+        }
+    } else if (typeid(*node) == typeid(ast::IndexExpression)) {
+        auto n = node->cast<ast::IndexExpression>();
+        visit(n->left());
+        visit(n->index());
+    } else if (typeid(*node) == typeid(ast::ArrayLiteral)) {
+        for (auto& elem : node->cast<ast::ArrayLiteral>()->elements()) {
+            visit(elem.get());
+        }
+    }
+}
+
+}
+
+BatchExpression::BatchExpression(std::unique_ptr<ast::Program> program) :
+        _program(std::move(program)),
+        _evaluator(new Evaluator()) {
+}
+
+BatchExpression::~BatchExpression() {}
+
+std::unique_ptr<BatchExpression> BatchExpression::compile(
+        const std::string& source,
+        std::vector<std::string>* errors) {
+    Parser parser;
+    auto program = parser.parse(source);
+    if (program == nullptr || !parser.errors().empty()) {
+        *errors = parser.errors();
+        return nullptr;
+    }
+
+    auto& statments = program->statments();
+    if (statments.size() != 1
+            || statments[0] == nullptr
+            || typeid(*statments[0]) != typeid(ast::ExpressionStatment)) {
+        errors->push_back("expected a single expression");
+        return nullptr;
+    }
+
+    std::unique_ptr<BatchExpression> ret(new BatchExpression(std::move(program)));
+    ret->_expression = statments[0]->cast<ast::ExpressionStatment>()->expression();
+    std::unordered_set<std::string> seen;
+    collect_variables(ret->_expression, &ret->_variables, &seen);
+    ret->_vectorized = ret->typecheck(ret->_expression, &ret->_kind);
+    return ret;
+}
+
+int BatchExpression::variable_index(const std::string& name) const {
+    auto it = std::find(_variables.begin(), _variables.end(), name);
+    return it == _variables.end() ? -1 : static_cast<int>(it - _variables.begin());
+}
+
+bool BatchExpression::typecheck(const ast::Expression* exp, BatchResult::Kind* kind) const {
+    if (exp == nullptr) {
+        return false;
+    }
+
+    if (typeid(*exp) == typeid(ast::IntegerLiteral)) {
+        *kind = BatchResult::INTEGER;
+        return true;
+    } else if (typeid(*exp) == typeid(ast::BooleanLiteral)) {
+        *kind = BatchResult::BOOLEAN;
+        return true;
+    } else if (typeid(*exp) == typeid(ast::Identifier)) {
+        *kind = BatchResult::INTEGER;
+        return variable_index(exp->cast<ast::Identifier>()->value()) >= 0;
+    } else if (typeid(*exp) == typeid(ast::PrefixExpression)) {
+        auto n = exp->cast<ast::PrefixExpression>();
+        BatchResult::Kind right;
+        if (!typecheck(n->right(), &right)) {
+            return false;
+        }
+        if (n->op() == "!") {
+            *kind = BatchResult::BOOLEAN;
+            return true;
+        }
+        *kind = BatchResult::INTEGER;
+        return n->op() == "-" && right == BatchResult::INTEGER;
+    } else if (typeid(*exp) == typeid(ast::InfixExpression)) {
+        auto n = exp->cast<ast::InfixExpression>();
+        BatchResult::Kind left;
+        BatchResult::Kind right;
+        if (!typecheck(n->left(), &left) || !typecheck(n->right(), &right) || left != right) {
+            return false;
+        }
+        auto& op = n->op();
+        if (op == "==" || op == "!=") {
+            *kind = BatchResult::BOOLEAN;
+            return true;
+        }
+        if (left != BatchResult::INTEGER) {
+            return false;
+        }
+        if (op == "+" || op == "-" || op == "*" || op == "/") {
+            *kind = BatchResult::INTEGER;
+            return true;
+        }
+        *kind = BatchResult::BOOLEAN;
+        return op == "<" || op == "<=" || op == ">" || op == ">=";
+    } else if (typeid(*exp) == typeid(ast::ConcatExpression)) {
+        for (auto& operand : exp->cast<ast::ConcatExpression>()->operands()) {
+            BatchResult::Kind operand_kind;
+            if (!typecheck(operand.get(), &operand_kind) || operand_kind != BatchResult::INTEGER) {
+                return false;
+            }
+        }
+        *kind = BatchResult::INTEGER;
+        return true;
+    }
+    return false;
+}
+
+template <typename Op>
+void BatchExpression::apply(const Vector& a, const Vector& b, size_t rows, Op op, Vector* out) {
+    if (a.scalar && b.scalar) {
+        out->scalar = true;
+        out->value = op(a.value, b.value);
+        return;
+    }
+
+    // 每种组合一个循环，循环体没有分支，便于编译器向量化
+    out->storage.resize(rows);
+    int64_t* dst = out->storage.data();
+    if (a.scalar) {
+        int64_t x = a.value;
+        const int64_t* y = b.data;
+        for (size_t i = 0; i < rows; ++i) {
+            dst[i] = op(x, y[i]);
+        }
+    } else if (b.scalar) {
+        const int64_t* x = a.data;
+        int64_t y = b.value;
+        for (size_t i = 0; i < rows; ++i) {
+            dst[i] = op(x[i], y);
+        }
+    } else {
+        const int64_t* x = a.data;
+        const int64_t* y = b.data;
+        for (size_t i = 0; i < rows; ++i) {
+            dst[i] = op(x[i], y[i]);
+        }
+    }
+    out->data = dst;
+}
+
+bool BatchExpression::eval_vector(
+        const ast::Expression* exp,
+        const std::vector<Span<int64_t>>& columns,
+        size_t rows,
+        Vector* out) const {
+    if (typeid(*exp) == typeid(ast::IntegerLiteral)) {
+        out->kind = BatchResult::INTEGER;
+        out->scalar = true;
+        out->value = exp->cast<ast::IntegerLiteral>()->value();
+        return true;
+    } else if (typeid(*exp) == typeid(ast::BooleanLiteral)) {
+        out->kind = BatchResult::BOOLEAN;
+        out->scalar = true;
+        out->value = exp->cast<ast::BooleanLiteral>()->value();
+        return true;
+    } else if (typeid(*exp) == typeid(ast::Identifier)) {
+        // 直接引用输入列，不复制
+        out->kind = BatchResult::INTEGER;
+        out->data = columns[variable_index(exp->cast<ast::Identifier>()->value())].data();
+        return true;
+    } else if (typeid(*exp) == typeid(ast::PrefixExpression)) {
+        auto n = exp->cast<ast::PrefixExpression>();
+        Vector right;
+        if (!eval_vector(n->right(), columns, rows, &right)) {
+            return false;
+        }
+        Vector zero;
+        zero.scalar = true;
+        if (n->op() == "-") {
+            out->kind = BatchResult::INTEGER;
+            apply(zero, right, rows, [](int64_t x, int64_t y) { return x - y; }, out);
+        } else if (right.kind == BatchResult::BOOLEAN) {
+            out->kind = BatchResult::BOOLEAN;
+            apply(zero, right, rows, [](int64_t, int64_t y) { return static_cast<int64_t>(y == 0); }, out);
+        } else {
+            // 与 Evaluator 一致，整数取反总是 false
+            out->kind = BatchResult::BOOLEAN;
+            out->scalar = true;
+            out->value = 0;
+        }
+        return true;
+    } else if (typeid(*exp) == typeid(ast::ConcatExpression)) {
+        auto& operands = exp->cast<ast::ConcatExpression>()->operands();
+        if (!eval_vector(operands[0].get(), columns, rows, out)) {
+            return false;
+        }
+        for (size_t i = 1; i < operands.size(); ++i) {
+            Vector right;
+            if (!eval_vector(operands[i].get(), columns, rows, &right)) {
+                return false;
+            }
+            Vector sum;
+            apply(*out, right, rows, [](int64_t x, int64_t y) { return x + y; }, &sum);
+            *out = std::move(sum);
+        }
+        out->kind = BatchResult::INTEGER;
+        return true;
+    }
+
+    auto n = exp->cast<ast::InfixExpression>();
+    Vector left;
+    Vector right;
+    if (!eval_vector(n->left(), columns, rows, &left)
+            || !eval_vector(n->right(), columns, rows, &right)) {
+        return false;
+    }
+
+    auto& op = n->op();
+    out->kind = BatchResult::BOOLEAN;
+    if (op == "+") {
+        out->kind = BatchResult::INTEGER;
+        apply(left, right, rows, [](int64_t x, int64_t y) { return x + y; }, out);
+    } else if (op == "-") {
+        out->kind = BatchResult::INTEGER;
+        apply(left, right, rows, [](int64_t x, int64_t y) { return x - y; }, out);
+    } else if (op == "*") {
+        out->kind = BatchResult::INTEGER;
+        apply(left, right, rows, [](int64_t x, int64_t y) { return x * y; }, out);
+    } else if (op == "/") {
+        // 除数为 0 或者 INT64_MIN / -1 的行会出错，整体交给逐行求值，由它给这些行返回 Error
+        size_t count = left.scalar && right.scalar ? 1 : rows;
+        for (size_t i = 0; i < count; ++i) {
+            int64_t x = left.scalar ? left.value : left.data[i];
+            int64_t y = right.scalar ? right.value : right.data[i];
+            if (y == 0 || (y == -1 && x == std::numeric_limits<int64_t>::min())) {
+                return false;
+            }
+        }
+        out->kind = BatchResult::INTEGER;
+        apply(left, right, rows, [](int64_t x, int64_t y) { return x / y; }, out);
+    } else if (op == "<") {
+        apply(left, right, rows, [](int64_t x, int64_t y) { return static_cast<int64_t>(x < y); }, out);
+    } else if (op == "<=") {
+        apply(left, right, rows, [](int64_t x, int64_t y) { return static_cast<int64_t>(x <= y); }, out);
+    } else if (op == ">") {
+        apply(left, right, rows, [](int64_t x, int64_t y) { return static_cast<int64_t>(x > y); }, out);
+    } else if (op == ">=") {
+        apply(left, right, rows, [](int64_t x, int64_t y) { return static_cast<int64_t>(x >= y); }, out);
+    } else if (op == "==") {
+        apply(left, right, rows, [](int64_t x, int64_t y) { return static_cast<int64_t>(x == y); }, out);
+    } else {
+        apply(left, right, rows, [](int64_t x, int64_t y) { return static_cast<int64_t>(x != y); }, out);
+    }
+    return true;
+}
+
+BatchResult BatchExpression::eval(const std::vector<Span<int64_t>>& columns, size_t rows) const {
+    if (!_vectorized || columns.size() != _variables.size()) {
+        return eval_rows(columns, rows);
+    }
+
+    Vector vec;
+    if (!eval_vector(_expression, columns, rows, &vec)) {
+        return eval_rows(columns, rows);
+    }
+
+    BatchResult result;
+    result.kind = vec.kind;
+    if (vec.scalar) {
+        result.values.assign(rows, vec.value);
+    } else if (!vec.storage.empty()) {
+        result.values = std::move(vec.storage);
+    } else {
+        result.values.assign(vec.data, vec.data + rows);
+    }
+    return result;
+}
+
+BatchResult BatchExpression::eval_rows(const std::vector<Span<int64_t>>& columns, size_t rows) const {
+    BatchResult result;
+    result.objects.reserve(rows);
+    for (size_t row = 0; row < rows; ++row) {
+        auto env = object::make<object::Environment>(_evaluator->_env);
+        for (size_t i = 0; i < _variables.size() && i < columns.size(); ++i) {
+            std::shared_ptr<object::Object> val = object::make<object::Integer>(columns[i][row]);
+            env->set(_variables[i], val);
+        }
+        result.objects.emplace_back(_evaluator->eval(_expression, env));
+    }
+    return result;
+}
+
+std::shared_ptr<object::Object> BatchResult::at(size_t row) const {
+    if (kind == OBJECT) {
+        return objects[row];
+    } else if (kind == BOOLEAN) {
+        return values[row] ? object::constants::True : object::constants::False;
+    }
+    return object::make<object::Integer>(values[row]);
+}
+
+} // namespace autumn
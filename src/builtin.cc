@@ -1,5 +1,13 @@
 #include "builtin.h"
+
+#include <algorithm>
+
+#include "async_io.h"
 #include "format.h"
+#include "perf_counters.h"
+#include "regexp.h"
+#include "serialize.h"
+#include "timeline.h"
 
 namespace autumn {
 namespace builtin {
@@ -11,28 +19,200 @@ std::map<std::string, object::BuiltinFunction> BUILTINS = {
     {"push", push},
     {"rest", rest},
     {"puts", puts},
+    {"to_array", to_array},
+    {"to_str", to_str},
+    {"set", set},
+    {"add", add},
+    {"has", has},
+    {"remove", remove},
+    {"deque", deque},
+    {"push_back", push_back},
+    {"push_front", push_front},
+    {"pop_back", pop_back},
+    {"pop_front", pop_front},
+    {"priority_queue", priority_queue},
+    {"pq_push", pq_push},
+    {"pq_pop", pq_pop},
+    {"pq_top", pq_top},
+    {"clock_ns", clock_ns},
+    {"bench", bench},
+    {"bench_compare", bench_compare},
+    {"heap_dump", heap_dump},
+    {"freeze", freeze},
+    {"serialize", serialize},
+    {"deserialize", deserialize},
+    {"load_table", load_table},
+    {"save_table", save_table},
+    {"match", match},
+    {"find_all", find_all},
+    {"regex_replace", regex_replace},
+    {"regex_split", regex_split},
+    {"read_async", read_async},
+    {"wait_all", wait_all},
+};
+
+namespace {
+
+std::shared_ptr<object::Object> wrong_arguments(size_t expect, size_t got) {
+    return object::make<object::Error>(format("wrong number of arguments. expected {}, got {}", expect, got));
+}
+
+// 参数个数可选的函数，接受 [min, max] 个参数
+std::shared_ptr<object::Object> wrong_arguments(size_t min, size_t max, size_t got) {
+    return object::make<object::Error>(format("wrong number of arguments. expected {} to {}, got {}", min, max, got));
+}
+
+std::shared_ptr<object::Object> not_supported(const char* name, const object::Object* arg) {
+    return object::make<object::Error>(format("argument to `{}` not supported, got {}", name, arg->type()));
+}
+
+std::shared_ptr<object::Object> frozen(const char* name, const object::Object* arg) {
+    return object::make<object::Error>(format("argument to `{}` is frozen, got {}", name, arg->type()));
+}
+
+std::shared_ptr<object::Object> unusable_key(const object::Object* key) {
+    return object::make<object::Error>(format("unusable as set key: {}", key->type()));
+}
+
+std::shared_ptr<object::Object> native_bool(bool value) {
+    return value ? object::constants::True : object::constants::False;
+}
+
+bool is_callable(const object::Object* obj) {
+    return typeid(*obj) == typeid(object::Function) || typeid(*obj) == typeid(object::Builtin);
+}
+
+// bench 默认的迭代次数
+constexpr int64_t BENCH_ITERATIONS = 100;
+// 迭代次数的上限，样本按迭代次数预留空间
+constexpr int64_t MAX_BENCH_ITERATIONS = 10 * 1000 * 1000;
+
+std::shared_ptr<object::Object> too_many_iterations(const char* name, int64_t iterations) {
+    return object::make<object::Error>(format("{}: iterations must be at most {}, got {}",
+            name, MAX_BENCH_ITERATIONS, iterations));
+}
+
+// 一个函数的计时样本
+struct Samples {
+    std::vector<int64_t> ns;
+    uint64_t allocations = 0;
+    // 开启 AUTUMN_PERF_COUNTERS 且计数器可用时累计
+    perf_counters::Values counters;
+    bool counted = false;
 };
 
-std::shared_ptr<object::Object> len(const std::vector<std::shared_ptr<object::Object>>& args) {
+// 调用一次 fn 并记录耗时和创建的对象个数，出错时返回 Error
+std::shared_ptr<object::Object> run_once(
+        const object::Object* fn,
+        const object::Caller& caller,
+        Samples* samples) {
+    std::vector<std::shared_ptr<object::Object>> args;
+    perf_counters::Values counters_begin;
+    perf_counters::Values counters_end;
+    bool counted = samples != nullptr && perf_counters::enabled() && perf_counters::read(&counters_begin);
+    uint64_t allocations = object::t_allocations;
+    uint64_t begin = timeline::now_ns();
+    auto ret = caller.call(fn, args);
+    uint64_t end = timeline::now_ns();
+    counted = counted && perf_counters::read(&counters_end);
+    if (ret != nullptr && typeid(*ret) == typeid(object::Error)) {
+        return ret;
+    }
+    if (samples != nullptr) {
+        samples->ns.push_back(static_cast<int64_t>(end - begin));
+        samples->allocations += object::t_allocations - allocations;
+        if (counted) {
+            samples->counters += counters_end - counters_begin;
+            samples->counted = true;
+        }
+    }
+    return nullptr;
+}
+
+// ns 需已排序
+int64_t median_of(const std::vector<int64_t>& ns) {
+    size_t n = ns.size();
+    return n % 2 == 1 ? ns[n / 2] : (ns[n / 2 - 1] + ns[n / 2]) / 2;
+}
+
+void set_field(object::Hash* hash, const char* key, int64_t value) {
+    hash->append(object::make<object::String>(key), object::make<object::Integer>(value));
+}
+
+// 汇总为 {iterations, min, median, p99, mean, allocations}，时间单位是纳秒，
+// allocations 是每次调用平均创建的对象个数；有硬件计数时再加上每次调用的平均
+// cycles、instructions、branch_misses、cache_misses
+std::shared_ptr<object::Hash> summarize(Samples& samples) {
+    auto& ns = samples.ns;
+    std::sort(ns.begin(), ns.end());
+    size_t n = ns.size();
+    int64_t total = 0;
+    for (auto v : ns) {
+        total += v;
+    }
+
+    auto ret = object::make<object::Hash>();
+    set_field(ret.get(), "iterations", n);
+    set_field(ret.get(), "min", ns.front());
+    set_field(ret.get(), "median", median_of(ns));
+    set_field(ret.get(), "p99", ns[std::min(n - 1, (n * 99 + 99) / 100 - 1)]);
+    set_field(ret.get(), "mean", total / static_cast<int64_t>(n));
+    set_field(ret.get(), "allocations", samples.allocations / n);
+    if (samples.counted) {
+        for (int i = 0; i < perf_counters::EVENT_COUNT; ++i) {
+            if (perf_counters::supported(i)) {
+                std::string name = perf_counters::event_name(i);
+                std::replace(name.begin(), name.end(), '-', '_');
+                set_field(ret.get(), name.c_str(), samples.counters.value[i] / n);
+            }
+        }
+    }
+    return ret;
+}
+
+// 预热次数为迭代次数的 1/10，至少 1 次
+int64_t warmup_iterations(int64_t iterations) {
+    return std::max<int64_t>(1, iterations / 10);
+}
+
+// 集合类的参数，类型不符时返回 nullptr
+template <typename T>
+T* collection(const std::shared_ptr<object::Object>& arg) {
+    return typeid(*arg) == typeid(T) ? static_cast<T*>(arg.get()) : nullptr;
+}
+
+}
+
+std::shared_ptr<object::Object> len(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
     if (args.size() != 1) {
-        return std::make_shared<object::Error>(format("wrong number of arguments. expected 1, got {}", args.size()));
+        return object::make<object::Error>(format("wrong number of arguments. expected 1, got {}", args.size()));
     }
 
     auto& arg = args[0];
 
     if (typeid(*arg) == typeid(object::String)) {
         auto obj = arg->cast<object::String>();
-        return std::make_shared<object::Integer>(obj->value().length());
+        return object::make<object::Integer>(obj->length());
     } else if (typeid(*arg) == typeid(object::Array)) {
         auto obj = arg->cast<object::Array>();
-        return std::make_shared<object::Integer>(obj->elements().size());
+        return object::make<object::Integer>(obj->elements().size());
+    } else if (typeid(*arg) == typeid(object::Set)) {
+        return object::make<object::Integer>(arg->cast<object::Set>()->size());
+    } else if (typeid(*arg) == typeid(object::Deque)) {
+        return object::make<object::Integer>(arg->cast<object::Deque>()->size());
+    } else if (typeid(*arg) == typeid(object::PriorityQueue)) {
+        return object::make<object::Integer>(arg->cast<object::PriorityQueue>()->size());
+    } else if (typeid(*arg) == typeid(object::Table)) {
+        return object::make<object::Integer>(arg->cast<object::Table>()->size());
+    } else if (typeid(*arg) == typeid(object::Column)) {
+        return object::make<object::Integer>(arg->cast<object::Column>()->size());
     }
-    return std::make_shared<object::Error>(format("argument to `len` not supported, got {}", arg->type()));
+    return object::make<object::Error>(format("argument to `len` not supported, got {}", arg->type()));
 }
 
-std::shared_ptr<object::Object> first(const std::vector<std::shared_ptr<object::Object>>& args) {
+std::shared_ptr<object::Object> first(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
     if (args.size() != 1) {
-        return std::make_shared<object::Error>(format("wrong number of arguments. expected 1, got {}", args.size()));
+        return object::make<object::Error>(format("wrong number of arguments. expected 1, got {}", args.size()));
     }
 
     auto& arg = args[0];
@@ -43,13 +223,16 @@ std::shared_ptr<object::Object> first(const std::vector<std::shared_ptr<object::
             return object::constants::Null;
         }
         return obj->elements().front();
+    } else if (typeid(*arg) == typeid(object::Deque)) {
+        auto obj = arg->cast<object::Deque>();
+        return obj->size() == 0 ? object::constants::Null : obj->at(0);
     }
-    return std::make_shared<object::Error>(format("argument to `front` not supported, got {}", arg->type()));
+    return object::make<object::Error>(format("argument to `front` not supported, got {}", arg->type()));
 }
 
-std::shared_ptr<object::Object> last(const std::vector<std::shared_ptr<object::Object>>& args) {
+std::shared_ptr<object::Object> last(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
     if (args.size() != 1) {
-        return std::make_shared<object::Error>(format("wrong number of arguments. expected 1, got {}", args.size()));
+        return object::make<object::Error>(format("wrong number of arguments. expected 1, got {}", args.size()));
     }
 
     auto& arg = args[0];
@@ -60,13 +243,16 @@ std::shared_ptr<object::Object> last(const std::vector<std::shared_ptr<object::O
             return object::constants::Null;
         }
         return obj->elements().back();
+    } else if (typeid(*arg) == typeid(object::Deque)) {
+        auto obj = arg->cast<object::Deque>();
+        return obj->size() == 0 ? object::constants::Null : obj->at(obj->size() - 1);
     }
-    return std::make_shared<object::Error>(format("argument to `last` not supported, got {}", arg->type()));
+    return object::make<object::Error>(format("argument to `last` not supported, got {}", arg->type()));
 }
 
-std::shared_ptr<object::Object> push(const std::vector<std::shared_ptr<object::Object>>& args) {
+std::shared_ptr<object::Object> push(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
     if (args.size() != 2) {
-        return std::make_shared<object::Error>(format("wrong number of arguments. expected 2, got {}", args.size()));
+        return object::make<object::Error>(format("wrong number of arguments. expected 2, got {}", args.size()));
     }
 
     auto& arg0 = args[0];
@@ -74,16 +260,21 @@ std::shared_ptr<object::Object> push(const std::vector<std::shared_ptr<object::O
 
     if (typeid(*arg0) == typeid(object::Array)) {
         auto obj = arg0->cast<object::Array>();
-        auto new_obj = std::make_shared<object::Array>(obj->elements());
+        auto elems = obj->elements();
+        auto new_obj = object::make<object::Array>();
+        new_obj->reserve(elems.size() + 1);
+        for (auto& e : elems) {
+            new_obj->append(e);
+        }
         new_obj->append(arg1);
         return new_obj;
     }
-    return std::make_shared<object::Error>(format("argument to `push` not supported, got {}", arg0->type()));
+    return object::make<object::Error>(format("argument to `push` not supported, got {}", arg0->type()));
 }
 
-std::shared_ptr<object::Object> rest(const std::vector<std::shared_ptr<object::Object>>& args) {
+std::shared_ptr<object::Object> rest(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
     if (args.size() != 1) {
-        return std::make_shared<object::Error>(format("wrong number of arguments. expected 1, got {}", args.size()));
+        return object::make<object::Error>(format("wrong number of arguments. expected 1, got {}", args.size()));
     }
 
     auto& arg = args[0];
@@ -94,25 +285,712 @@ std::shared_ptr<object::Object> rest(const std::vector<std::shared_ptr<object::O
             return object::constants::Null;
         }
 
-        auto new_obj = std::make_shared<object::Array>();
-        bool first = true;
-        for (auto& e : obj->elements()) {
-            if (!first) {
-                new_obj->append(e);
-            }
-            first = false;
-        }
-        return new_obj;
+        // 切片与原数组共享元素，不需要拷贝
+        return object::Array::slice(
+                std::static_pointer_cast<const object::Array>(arg),
+                1,
+                obj->elements().size());
     }
-    return std::make_shared<object::Error>(format("argument to `push` not supported, got {}", arg->type()));
+    return object::make<object::Error>(format("argument to `push` not supported, got {}", arg->type()));
 }
 
-std::shared_ptr<object::Object> puts(const std::vector<std::shared_ptr<object::Object>>& args) {
+std::shared_ptr<object::Object> puts(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
     for (auto& e : args) {
         std::cout << e->inspect() << std::endl;
     }
     return object::constants::Null;
 }
 
+std::shared_ptr<object::Object> to_array(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+
+    auto& arg = args[0];
+    if (auto s = collection<object::Set>(arg)) {
+        return object::make<object::Array>(s->elements());
+    } else if (auto d = collection<object::Deque>(arg)) {
+        object::Array::Elements elems;
+        elems.reserve(d->size());
+        for (size_t i = 0; i < d->size(); ++i) {
+            elems.push_back(d->at(i));
+        }
+        return object::make<object::Array>(std::move(elems));
+    } else if (auto c = collection<object::Column>(arg)) {
+        object::Array::Elements elems;
+        elems.reserve(c->size());
+        for (size_t i = 0; i < c->size(); ++i) {
+            auto value = c->at(i);
+            if (typeid(*value) == typeid(object::Error)) {
+                return value;
+            }
+            elems.push_back(std::move(value));
+        }
+        return object::make<object::Array>(std::move(elems));
+    }
+    return not_supported("to_array", arg.get());
+}
+
+// 与字符串插值的转换规则相同，整数直接写入结果，不经过临时字符串
+std::shared_ptr<object::Object> to_str(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    if (typeid(*args[0]) == typeid(object::String)) {
+        return args[0];
+    }
+    object::StringBuilder builder;
+    builder.append(args[0].get());
+    return object::String::make(builder.build());
+}
+
+std::shared_ptr<object::Object> set(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() > 1) {
+        return wrong_arguments(1, args.size());
+    }
+
+    auto ret = object::make<object::Set>();
+    if (args.empty()) {
+        return ret;
+    }
+    auto array = collection<object::Array>(args[0]);
+    if (array == nullptr) {
+        return not_supported("set", args[0].get());
+    }
+    for (auto& e : array->elements()) {
+        if (!object::Set::is_hashable(e.get())) {
+            return unusable_key(e.get());
+        }
+        ret->insert(e);
+    }
+    return ret;
+}
+
+std::shared_ptr<object::Object> add(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 2) {
+        return wrong_arguments(2, args.size());
+    }
+    auto s = collection<object::Set>(args[0]);
+    if (s == nullptr) {
+        return not_supported("add", args[0].get());
+    }
+    if (s->frozen()) {
+        return frozen("add", args[0].get());
+    }
+    if (!object::Set::is_hashable(args[1].get())) {
+        return unusable_key(args[1].get());
+    }
+    return native_bool(s->insert(args[1]));
+}
+
+std::shared_ptr<object::Object> has(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 2) {
+        return wrong_arguments(2, args.size());
+    }
+    auto s = collection<object::Set>(args[0]);
+    if (s == nullptr) {
+        return not_supported("has", args[0].get());
+    }
+    return native_bool(s->contains(args[1].get()));
+}
+
+std::shared_ptr<object::Object> remove(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 2) {
+        return wrong_arguments(2, args.size());
+    }
+    auto s = collection<object::Set>(args[0]);
+    if (s == nullptr) {
+        return not_supported("remove", args[0].get());
+    }
+    if (s->frozen()) {
+        return frozen("remove", args[0].get());
+    }
+    return native_bool(s->erase(args[1].get()));
+}
+
+std::shared_ptr<object::Object> deque(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() > 1) {
+        return wrong_arguments(1, args.size());
+    }
+
+    auto ret = object::make<object::Deque>();
+    if (args.empty()) {
+        return ret;
+    }
+    auto array = collection<object::Array>(args[0]);
+    if (array == nullptr) {
+        return not_supported("deque", args[0].get());
+    }
+    for (auto& e : array->elements()) {
+        ret->push_back(e);
+    }
+    return ret;
+}
+
+std::shared_ptr<object::Object> push_back(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 2) {
+        return wrong_arguments(2, args.size());
+    }
+    auto d = collection<object::Deque>(args[0]);
+    if (d == nullptr) {
+        return not_supported("push_back", args[0].get());
+    }
+    if (d->frozen()) {
+        return frozen("push_back", args[0].get());
+    }
+    d->push_back(args[1]);
+    return args[0];
+}
+
+std::shared_ptr<object::Object> push_front(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 2) {
+        return wrong_arguments(2, args.size());
+    }
+    auto d = collection<object::Deque>(args[0]);
+    if (d == nullptr) {
+        return not_supported("push_front", args[0].get());
+    }
+    if (d->frozen()) {
+        return frozen("push_front", args[0].get());
+    }
+    d->push_front(args[1]);
+    return args[0];
+}
+
+std::shared_ptr<object::Object> pop_back(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    auto d = collection<object::Deque>(args[0]);
+    if (d == nullptr) {
+        return not_supported("pop_back", args[0].get());
+    }
+    if (d->frozen()) {
+        return frozen("pop_back", args[0].get());
+    }
+    return d->pop_back();
+}
+
+std::shared_ptr<object::Object> pop_front(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    auto d = collection<object::Deque>(args[0]);
+    if (d == nullptr) {
+        return not_supported("pop_front", args[0].get());
+    }
+    if (d->frozen()) {
+        return frozen("pop_front", args[0].get());
+    }
+    return d->pop_front();
+}
+
+std::shared_ptr<object::Object> priority_queue(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() > 1) {
+        return wrong_arguments(1, args.size());
+    }
+    if (args.empty()) {
+        return object::make<object::PriorityQueue>();
+    }
+
+    auto& comparator = args[0];
+    if (typeid(*comparator) != typeid(object::Function)
+            && typeid(*comparator) != typeid(object::Builtin)) {
+        return not_supported("priority_queue", comparator.get());
+    }
+    return object::make<object::PriorityQueue>(comparator);
+}
+
+std::shared_ptr<object::Object> pq_push(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 2) {
+        return wrong_arguments(2, args.size());
+    }
+    auto q = collection<object::PriorityQueue>(args[0]);
+    if (q == nullptr) {
+        return not_supported("pq_push", args[0].get());
+    }
+    if (q->frozen()) {
+        return frozen("pq_push", args[0].get());
+    }
+    auto error = q->push(args[1], caller);
+    return error != nullptr ? error : args[0];
+}
+
+std::shared_ptr<object::Object> pq_pop(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    auto q = collection<object::PriorityQueue>(args[0]);
+    if (q == nullptr) {
+        return not_supported("pq_pop", args[0].get());
+    }
+    if (q->frozen()) {
+        return frozen("pq_pop", args[0].get());
+    }
+    std::shared_ptr<object::Object> ret;
+    auto error = q->pop(caller, &ret);
+    return error != nullptr ? error : ret;
+}
+
+std::shared_ptr<object::Object> pq_top(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    auto q = collection<object::PriorityQueue>(args[0]);
+    if (q == nullptr) {
+        return not_supported("pq_top", args[0].get());
+    }
+    return q->top();
+}
+
+std::shared_ptr<object::Object> heap_dump(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    auto path = args[0]->cast<object::String>();
+    if (path == nullptr) {
+        return not_supported("heap_dump", args[0].get());
+    }
+    return caller.heap_dump(std::string(path->value()));
+}
+
+std::shared_ptr<object::Object> freeze(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    auto error = object::freeze(args[0]);
+    return error != nullptr ? error : args[0];
+}
+
+std::shared_ptr<object::Object> serialize(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    std::string bytes;
+    auto error = autumn::serialize::encode(args[0].get(), &bytes);
+    return error != nullptr ? error : object::make<object::String>(std::move(bytes));
+}
+
+// deserialize(bytes[, zero_copy])：zero_copy 为 true 时解码出的字符串引用 bytes，不拷贝
+std::shared_ptr<object::Object> deserialize(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.empty() || args.size() > 2) {
+        return wrong_arguments(1, 2, args.size());
+    }
+    if (typeid(*args[0]) != typeid(object::String)) {
+        return not_supported("deserialize", args[0].get());
+    }
+    bool zero_copy = false;
+    if (args.size() == 2) {
+        auto flag = args[1]->cast<object::Boolean>();
+        if (flag == nullptr) {
+            return not_supported("deserialize", args[1].get());
+        }
+        zero_copy = flag->value();
+    }
+    return autumn::serialize::decode(std::static_pointer_cast<const object::String>(args[0]), zero_copy);
+}
+
+std::shared_ptr<object::Object> load_table(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    if (typeid(*args[0]) != typeid(object::String)) {
+        return not_supported("load_table", args[0].get());
+    }
+    std::string error;
+    auto mapping = table::Mapping::open(std::string(args[0]->cast<object::String>()->value()), &error);
+    if (mapping == nullptr) {
+        return object::make<object::Error>(format("load_table: {}", error));
+    }
+    return object::make<object::Table>(mapping);
+}
+
+// save_table(path, {"列名": [...]})：每列是整数数组或字符串数组，写成 load_table 读取的格式
+std::shared_ptr<object::Object> save_table(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 2) {
+        return wrong_arguments(2, args.size());
+    }
+    if (typeid(*args[0]) != typeid(object::String)) {
+        return not_supported("save_table", args[0].get());
+    }
+    auto hash = collection<object::Hash>(args[1]);
+    if (hash == nullptr) {
+        return not_supported("save_table", args[1].get());
+    }
+
+    std::vector<table::ColumnData> columns;
+    std::shared_ptr<object::Object> error;
+    hash->for_each([&](const std::shared_ptr<object::Object>& key, const std::shared_ptr<object::Object>& value) {
+        if (error != nullptr) {
+            return;
+        }
+        auto array = collection<object::Array>(value);
+        if (typeid(*key) != typeid(object::String) || array == nullptr) {
+            error = not_supported("save_table", typeid(*key) != typeid(object::String) ? key.get() : value.get());
+            return;
+        }
+        table::ColumnData column;
+        column.name = std::string(key->cast<object::String>()->value());
+        auto elems = array->elements();
+        // 按第一个元素决定列的类型，空列按整数列保存
+        column.type = !elems.empty() && typeid(*elems[0]) == typeid(object::String)
+                ? table::STRING
+                : table::INT64;
+        for (auto& e : elems) {
+            if (column.type == table::INT64 && typeid(*e) == typeid(object::Integer)) {
+                column.integers.push_back(e->cast<object::Integer>()->value());
+            } else if (column.type == table::STRING && typeid(*e) == typeid(object::String)) {
+                column.strings.emplace_back(e->cast<object::String>()->value());
+            } else {
+                error = not_supported("save_table", e.get());
+                return;
+            }
+        }
+        columns.push_back(std::move(column));
+    });
+    if (error != nullptr) {
+        return error;
+    }
+
+    std::string message;
+    if (!table::write(std::string(args[0]->cast<object::String>()->value()), columns, &message)) {
+        return object::make<object::Error>(format("save_table: {}", message));
+    }
+    return object::constants::Null;
+}
+
+namespace {
+
+// 检查 (pattern, str, ...) 参数，从调用者的缓存中取出编译好的模式，出错时返回 Error
+std::shared_ptr<object::Object> compile_pattern(
+        const char* name,
+        const std::vector<std::shared_ptr<object::Object>>& args,
+        size_t count,
+        const object::Caller& caller,
+        std::shared_ptr<const regexp::Regex>* regex) {
+    if (args.size() != count) {
+        return wrong_arguments(count, args.size());
+    }
+    for (size_t i = 0; i < 2; ++i) {
+        if (typeid(*args[i]) != typeid(object::String)) {
+            return not_supported(name, args[i].get());
+        }
+    }
+    std::string error;
+    *regex = caller.regex_cache().get(args[0]->cast<object::String>()->value(), &error);
+    if (*regex == nullptr) {
+        return object::make<object::Error>(format("{}: {}", name, error));
+    }
+    return nullptr;
+}
+
+// 从左到右对每个不重叠的匹配调用 fn(captures)，fn 返回 false 时停止
+// 空匹配之后前进一个码点，避免停在同一个位置
+template <typename Fn>
+void for_each_match(const regexp::Regex& regex, std::string_view input, Fn fn) {
+    std::vector<size_t> captures;
+    size_t pos = 0;
+    while (regex.search(input, pos, &captures)) {
+        if (!fn(captures)) {
+            return;
+        }
+        if (captures[1] > captures[0]) {
+            pos = captures[1];
+        } else if (captures[1] < input.size()) {
+            pos = utf8::advance(input, captures[1], 1);
+        } else {
+            return;
+        }
+    }
+}
+
+// [整体, 第 1 组, ...]，都是 str 的切片，没有参与匹配的分组为 null
+std::shared_ptr<object::Object> match_groups(
+        const std::shared_ptr<const object::String>& str,
+        const std::vector<size_t>& captures) {
+    object::Array::Elements elems;
+    elems.reserve(captures.size() / 2);
+    for (size_t i = 0; i < captures.size(); i += 2) {
+        if (captures[i] == regexp::Regex::npos || captures[i + 1] == regexp::Regex::npos) {
+            elems.push_back(object::constants::Null);
+        } else {
+            elems.push_back(object::String::slice(str, captures[i], captures[i + 1]));
+        }
+    }
+    return object::make<object::Array>(std::move(elems));
+}
+
+} // namespace
+
+std::shared_ptr<object::Object> match(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    std::shared_ptr<const regexp::Regex> regex;
+    if (auto error = compile_pattern("match", args, 2, caller, &regex)) {
+        return error;
+    }
+    auto str = std::static_pointer_cast<const object::String>(args[1]);
+    std::vector<size_t> captures;
+    if (!regex->search(str->value(), 0, &captures)) {
+        return object::constants::Null;
+    }
+    return match_groups(str, captures);
+}
+
+std::shared_ptr<object::Object> find_all(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    std::shared_ptr<const regexp::Regex> regex;
+    if (auto error = compile_pattern("find_all", args, 2, caller, &regex)) {
+        return error;
+    }
+    auto str = std::static_pointer_cast<const object::String>(args[1]);
+    object::Array::Elements elems;
+    for_each_match(*regex, str->value(), [&](const std::vector<size_t>& captures) {
+        elems.push_back(object::String::slice(str, captures[0], captures[1]));
+        return true;
+    });
+    return object::make<object::Array>(std::move(elems));
+}
+
+// replacement 是字符串时 $0 到 $9 引用分组、$$ 表示 $；是函数时以 match 的结果调用，
+// 返回值按 to_str 的规则转换。结果在 StringBuilder 中拼接，只分配一次
+std::shared_ptr<object::Object> regex_replace(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    std::shared_ptr<const regexp::Regex> regex;
+    if (auto error = compile_pattern("regex_replace", args, 3, caller, &regex)) {
+        return error;
+    }
+    auto& replacement = args[2];
+    bool callable = is_callable(replacement.get());
+    if (!callable && typeid(*replacement) != typeid(object::String)) {
+        return not_supported("regex_replace", replacement.get());
+    }
+
+    auto str = std::static_pointer_cast<const object::String>(args[1]);
+    auto input = str->value();
+    object::StringBuilder builder;
+    // 函数返回的值要活到 build 之后
+    std::vector<std::shared_ptr<object::Object>> results;
+    std::shared_ptr<object::Object> error;
+    size_t last = 0;
+    bool matched = false;
+    for_each_match(*regex, input, [&](const std::vector<size_t>& captures) {
+        matched = true;
+        builder.append(input.substr(last, captures[0] - last));
+        last = captures[1];
+        if (callable) {
+            std::vector<std::shared_ptr<object::Object>> call_args = {match_groups(str, captures)};
+            auto ret = caller.call(replacement.get(), call_args);
+            if (ret != nullptr && typeid(*ret) == typeid(object::Error)) {
+                error = ret;
+                return false;
+            }
+            if (ret != nullptr) {
+                builder.append(ret.get());
+                results.push_back(std::move(ret));
+            }
+            return true;
+        }
+        auto text = replacement->cast<object::String>()->value();
+        size_t i = 0;
+        while (i < text.size()) {
+            size_t dollar = std::min(text.find('$', i), text.size());
+            builder.append(text.substr(i, dollar - i));
+            if (dollar + 1 >= text.size()) {
+                builder.append(text.substr(dollar));
+                break;
+            }
+            char c = text[dollar + 1];
+            if (c == '$') {
+                builder.append("$");
+            } else if ('0' <= c && c <= '9') {
+                size_t group = c - '0';
+                if (group > regex->groups()) {
+                    error = object::make<object::Error>(format("regex_replace: invalid group reference ${}", group));
+                    return false;
+                }
+                if (captures[2 * group] != regexp::Regex::npos) {
+                    builder.append(input.substr(captures[2 * group], captures[2 * group + 1] - captures[2 * group]));
+                }
+            } else {
+                builder.append(text.substr(dollar, 2));
+            }
+            i = dollar + 2;
+        }
+        return true;
+    });
+    if (error != nullptr) {
+        return error;
+    }
+    if (!matched) {
+        // 没有匹配时原样返回
+        return args[1];
+    }
+    builder.append(input.substr(last));
+    return object::String::make(builder.build());
+}
+
+std::shared_ptr<object::Object> regex_split(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    std::shared_ptr<const regexp::Regex> regex;
+    if (auto error = compile_pattern("regex_split", args, 2, caller, &regex)) {
+        return error;
+    }
+    auto str = std::static_pointer_cast<const object::String>(args[1]);
+    object::Array::Elements elems;
+    size_t last = 0;
+    for_each_match(*regex, str->value(), [&](const std::vector<size_t>& captures) {
+        elems.push_back(object::String::slice(str, last, captures[0]));
+        last = captures[1];
+        return true;
+    });
+    elems.push_back(object::String::slice(str, last, str->value().size()));
+    return object::make<object::Array>(std::move(elems));
+}
+
+std::shared_ptr<object::Object> read_async(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    if (typeid(*args[0]) != typeid(object::String)) {
+        return not_supported("read_async", args[0].get());
+    }
+    auto path = std::string(args[0]->cast<object::String>()->value());
+    return object::make<object::AsyncRead>(async_io::reader().submit(path));
+}
+
+// 等待数组中的全部句柄，按顺序返回文件内容；有读取失败时返回第一个失败的 Error
+std::shared_ptr<object::Object> wait_all(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.size() != 1) {
+        return wrong_arguments(1, args.size());
+    }
+    auto array = collection<object::Array>(args[0]);
+    if (array == nullptr) {
+        return not_supported("wait_all", args[0].get());
+    }
+    auto elems = array->elements();
+    std::vector<std::shared_ptr<async_io::Request>> requests;
+    requests.reserve(elems.size());
+    for (auto& e : elems) {
+        if (typeid(*e) != typeid(object::AsyncRead)) {
+            return not_supported("wait_all", e.get());
+        }
+        requests.push_back(e->cast<object::AsyncRead>()->request());
+    }
+    async_io::reader().wait(requests);
+
+    object::Array::Elements results;
+    results.reserve(elems.size());
+    for (auto& e : elems) {
+        auto result = e->cast<object::AsyncRead>()->result();
+        if (typeid(*result) == typeid(object::Error)) {
+            return object::make<object::Error>(format("wait_all: {}", result->cast<object::Error>()->message()));
+        }
+        results.push_back(std::move(result));
+    }
+    return object::make<object::Array>(std::move(results));
+}
+
+std::shared_ptr<object::Object> clock_ns(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (!args.empty()) {
+        return wrong_arguments(0, args.size());
+    }
+    return object::make<object::Integer>(static_cast<int64_t>(timeline::now_ns()));
+}
+
+std::shared_ptr<object::Object> bench(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    if (args.empty() || args.size() > 2) {
+        return wrong_arguments(1, 2, args.size());
+    }
+    if (!is_callable(args[0].get())) {
+        return not_supported("bench", args[0].get());
+    }
+
+    int64_t iterations = BENCH_ITERATIONS;
+    if (args.size() == 2) {
+        auto n = args[1]->cast<object::Integer>();
+        if (n == nullptr || n->value() <= 0) {
+            return not_supported("bench", args[1].get());
+        }
+        iterations = n->value();
+        if (iterations > MAX_BENCH_ITERATIONS) {
+            return too_many_iterations("bench", iterations);
+        }
+    }
+
+    for (int64_t i = 0; i < warmup_iterations(iterations); ++i) {
+        auto error = run_once(args[0].get(), caller, nullptr);
+        if (error != nullptr) {
+            return error;
+        }
+    }
+
+    Samples samples;
+    samples.ns.reserve(iterations);
+    for (int64_t i = 0; i < iterations; ++i) {
+        auto error = run_once(args[0].get(), caller, &samples);
+        if (error != nullptr) {
+            return error;
+        }
+    }
+    return summarize(samples);
+}
+
+std::shared_ptr<object::Object> bench_compare(const std::vector<std::shared_ptr<object::Object>>& args, const object::Caller& caller) {
+    // bench_compare(f, g, ...) 或 bench_compare(f, g, ..., iterations)
+    size_t count = args.size();
+    int64_t iterations = BENCH_ITERATIONS;
+    if (count > 1 && typeid(*args.back()) == typeid(object::Integer)) {
+        iterations = args.back()->cast<object::Integer>()->value();
+        if (iterations <= 0) {
+            return not_supported("bench_compare", args.back().get());
+        }
+        if (iterations > MAX_BENCH_ITERATIONS) {
+            return too_many_iterations("bench_compare", iterations);
+        }
+        --count;
+    }
+    if (count == 0) {
+        return wrong_arguments(1, args.size());
+    }
+    for (size_t i = 0; i < count; ++i) {
+        if (!is_callable(args[i].get())) {
+            return not_supported("bench_compare", args[i].get());
+        }
+    }
+
+    // 各函数轮流执行，减少频率和缓存状态变化带来的偏差
+    std::vector<Samples> samples(count);
+    for (auto& s : samples) {
+        s.ns.reserve(iterations);
+    }
+    for (int64_t i = 0; i < warmup_iterations(iterations) + iterations; ++i) {
+        bool warmup = i < warmup_iterations(iterations);
+        for (size_t j = 0; j < count; ++j) {
+            auto error = run_once(args[j].get(), caller, warmup ? nullptr : &samples[j]);
+            if (error != nullptr) {
+                return error;
+            }
+        }
+    }
+
+    std::vector<std::shared_ptr<object::Hash>> results;
+    int64_t fastest = 0;
+    for (size_t j = 0; j < count; ++j) {
+        results.push_back(summarize(samples[j]));
+        int64_t median = median_of(samples[j].ns);
+        fastest = j == 0 ? median : std::min(fastest, median);
+    }
+
+    object::Array::Elements elems;
+    for (size_t j = 0; j < count; ++j) {
+        auto& result = results[j];
+        auto fn = args[j]->cast<object::Function>();
+        std::string name = fn != nullptr ? fn->name() : args[j]->cast<object::Builtin>()->name();
+        result->append(object::make<object::String>("name"),
+                object::make<object::String>(name.empty() ? format("#{}", j) : name));
+        // 中位数相对最快者的百分比
+        int64_t median = median_of(samples[j].ns);
+        set_field(result.get(), "relative", fastest > 0 ? median * 100 / fastest : 100);
+        elems.push_back(result);
+    }
+    return object::make<object::Array>(std::move(elems));
+}
+
 } // namespace builtin
 } // namespace autumn
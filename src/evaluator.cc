@@ -1,5 +1,16 @@
 #include "evaluator.h"
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+
 #include "builtin.h"
+#include "defer.h"
+#include "heap.h"
+#include "line_profile.h"
+#include "optimizer.h"
+#include "perf_counters.h"
+#include "timeline.h"
 
 namespace autumn {
 
@@ -8,8 +19,162 @@ Evaluator::Evaluator() :
 }
  
 std::shared_ptr<const object::Object> Evaluator::eval(const std::string& input) {
+    timeline::Span span("eval", "Evaluator::eval");
+    object::Closures::Scope closures(&_closures);
     auto program = _parser.parse(input);
-    return eval(program.get(), _env);
+    // 行计数按源码统计，开启时不做编译期求值
+    if (program != nullptr && _parser.errors().empty() && !line_profile::enabled()) {
+        perf_counters::Scope counters("optimize");
+        Optimizer optimizer(_env.get());
+        optimizer.optimize(program.get());
+    }
+    perf_counters::Scope counters("eval");
+    if (!_region_mode) {
+        return eval(program.get(), _env);
+    }
+    std::shared_ptr<object::Object> result;
+    {
+        region::Scope scope(_region.get());
+        object::Closures::Scope request_closures(&_request_closures);
+        result = eval(program.get(), _env);
+    }
+    return finish_request(std::move(result));
+}
+
+std::shared_ptr<const object::Object> Evaluator::eval_file(const std::string& path) {
+    auto canonical_path = module::resolve(path, std::string());
+    if (canonical_path.empty()) {
+        return new_error("file not found: {}`{}`{}",
+                color::light::light,
+                path,
+                color::off);
+    }
+
+    // 脚本在全局环境中执行，编译期求值要避开其中重新绑定的内置函数
+    auto compiled = module::compile(canonical_path, _env.get());
+    if (compiled == nullptr) {
+        return new_error("failed to read: {}`{}`{}",
+                color::light::light,
+                path,
+                color::off);
+    }
+    if (line_profile::enabled()) {
+        line_profile::set_source(path, compiled->source, compiled->first_id, compiled->last_id);
+    }
+    perf_counters::Scope counters("eval");
+    object::Closures::Scope closures(&_closures);
+    if (!_region_mode) {
+        return eval_module(compiled.get(), _env);
+    }
+    std::shared_ptr<object::Object> result;
+    {
+        region::Scope scope(_region.get());
+        object::Closures::Scope request_closures(&_request_closures);
+        result = eval_module(compiled.get(), _env);
+    }
+    return finish_request(std::move(result));
+}
+
+std::shared_ptr<object::Object> Evaluator::finish_request(std::shared_ptr<object::Object> result) {
+    ++_region_stats.requests;
+    _region_stats.bytes += _region->used();
+
+    {
+        region::Promoter promoter(_region.get());
+        promoter.fix_remembered();
+        _env = promoter.promote(_env);
+        for (auto& pair : _modules) {
+            pair.second.exports = promoter.promote(pair.second.exports);
+        }
+        result = promoter.promote(result);
+        _region_stats.promoted += promoter.promoted();
+        _region_stats.fixed += promoter.fixed();
+    }
+
+    // 留在区域里的闭包和环境互相引用，不会自己释放。只需要看这次请求创建的闭包，
+    // 先在锁内取出环境，再在锁外清空：清空会析构闭包，析构时要再次获取同一把锁
+    std::vector<std::shared_ptr<object::Environment>> envs;
+    _request_closures.for_each([this, &envs](const object::Function* fn) {
+        if (_region->contains(fn)) {
+            envs.push_back(fn->env());
+        }
+    });
+    for (auto& env : envs) {
+        for (auto e = env; e != nullptr && _region->contains(e.get()); e = e->outer()) {
+            e->clear();
+        }
+    }
+    envs.clear();
+    // 仍然存活的（被外部持有或者分配在堆上的）闭包归入 Evaluator
+    _closures.splice(_request_closures);
+
+    if (_region->reset()) {
+        ++_region_stats.resets;
+    } else {
+        // 还有对象被外部持有，交给最后一个对象释放
+        _region = region::create();
+        ++_region_stats.retired;
+    }
+    return result;
+}
+
+std::shared_ptr<object::Object> Evaluator::heap_dump(const std::string& path) const {
+    std::ofstream out(path);
+    if (!out) {
+        return new_error("failed to write: {}`{}`{}",
+                color::light::light,
+                path,
+                color::off);
+    }
+
+    std::vector<heap::Root> roots;
+    roots.push_back(heap::Root{"globals", _env, nullptr});
+    for (auto& pair : _modules) {
+        roots.push_back(heap::Root{"module:" + pair.first, nullptr, pair.second.exports});
+    }
+    auto stats = heap::dump(roots, {&_closures, &_request_closures}, out);
+    if (!out) {
+        return new_error("failed to write: {}`{}`{}",
+                color::light::light,
+                path,
+                color::off);
+    }
+
+    auto ret = object::make<object::Hash>();
+    auto set = [&ret](const char* key, size_t value) {
+        ret->append(object::make<object::String>(key),
+                object::make<object::Integer>(static_cast<int64_t>(value)));
+    };
+    set("objects", stats.objects);
+    set("bytes", stats.bytes);
+    set("unreachable_objects", stats.unreachable_objects);
+    set("unreachable_bytes", stats.unreachable_bytes);
+    return ret;
+}
+
+size_t Evaluator::freeze_globals() {
+    std::vector<std::pair<std::string, std::shared_ptr<object::Object>>> shared;
+    for (auto& binding : _env->store()) {
+        if (binding.second->frozen() || object::freeze(binding.second) == nullptr) {
+            shared.emplace_back(binding.first, binding.second);
+        }
+    }
+    size_t ret = shared.size();
+    std::lock_guard<std::mutex> lock(_shared_mutex);
+    _shared_globals = std::move(shared);
+    return ret;
+}
+
+void Evaluator::share_globals(const Evaluator& other) {
+    // 冻结的值不可修改也不会释放，拷贝出绑定之后就不再需要 other 的锁
+    std::vector<std::pair<std::string, std::shared_ptr<object::Object>>> shared;
+    {
+        std::lock_guard<std::mutex> lock(other._shared_mutex);
+        shared = other._shared_globals;
+    }
+    for (auto& binding : shared) {
+        _env->set(binding.first, binding.second);
+    }
 }
 
 bool Evaluator::is_error(const object::Object* obj) const {
@@ -20,6 +185,14 @@ void Evaluator::reset_env() {
     _env.reset(new object::Environment());
 }
 
+std::shared_ptr<object::Object> Evaluator::call(
+        const object::Object* fn,
+        std::vector<std::shared_ptr<object::Object>>& args) const {
+    // 区域模式的请求中被内置函数回调时，新建的闭包仍然属于这次请求
+    object::Closures::Scope closures(region::current() == _region.get() ? &_request_closures : &_closures);
+    return apply_function(fn, args);
+}
+
 std::shared_ptr<object::Object> Evaluator::eval(
         const ast::Node* node,
         std::shared_ptr<object::Environment>& env) const {
@@ -35,6 +208,12 @@ std::shared_ptr<object::Object> Evaluator::eval(
         return new_error("abort: {}", message);
     }
 
+    if (_step_limit != 0 && ++_steps > _step_limit) {
+        return new_error("step limit exceeded: {}", _step_limit);
+    }
+
+    line_profile::Scope profile(node);
+
     if (typeid(*node) == typeid(ast::Program)) {
         auto n = node->cast<ast::Program>();
         return eval_program(n->statments(), env);
@@ -53,7 +232,7 @@ std::shared_ptr<object::Object> Evaluator::eval(
         if (is_error(return_val.get())) {
             return return_val;
         }
-        return std::make_shared<object::ReturnValue>(return_val);
+        return object::make<object::ReturnValue>(return_val);
 
     } else if (typeid(*node) == typeid(ast::LetStatment)) {
         auto n = node->cast<ast::LetStatment>();
@@ -66,8 +245,7 @@ std::shared_ptr<object::Object> Evaluator::eval(
 
     } else if (typeid(*node) == typeid(ast::IntegerLiteral)) {
         auto n = node->cast<ast::IntegerLiteral>();
-        return std::shared_ptr<object::Integer>(
-                new object::Integer(n->value()));
+        return object::make<object::Integer>(n->value());
 
     } else if (typeid(*node) == typeid(ast::BooleanLiteral)) {
         auto n = node->cast<ast::BooleanLiteral>();
@@ -75,15 +253,34 @@ std::shared_ptr<object::Object> Evaluator::eval(
 
     } else if (typeid(*node) == typeid(ast::StringLiteral)) {
         auto n = node->cast<ast::StringLiteral>();
-        return std::make_shared<object::String>(n->value());
+        auto cached = n->object();
+        if (cached != nullptr) {
+            return cached;
+        }
+        // 缓存的对象和语法树一样长寿，不能放在请求的区域里
+        region::Scope heap(nullptr);
+        auto str = object::String::make(n->value());
+        // 模块的语法树会被多个求值器共享，先建好码点索引，之后对象只读
+        str->length();
+        n->set_object(str);
+        return str;
+
+    } else if (typeid(*node) == typeid(ast::InterpolatedString)) {
+        return eval_interpolated_string(node->cast<ast::InterpolatedString>(), env);
 
     } else if (typeid(*node) == typeid(ast::ArrayLiteral)) {
         auto n = node->cast<ast::ArrayLiteral>();
-        auto elems = eval_expressions(n->elements(), env);
-        if (!elems.empty() && is_error(elems[0].get())) {
-            return elems[0];
+        // 直接写入数组，短数组不需要额外的缓冲区
+        auto ret = object::make<object::Array>();
+        ret->reserve(n->elements().size());
+        for (auto& elem : n->elements()) {
+            auto val = eval(elem.get(), env);
+            if (is_error(val.get())) {
+                return val;
+            }
+            ret->append(val);
         }
-        return std::make_shared<object::Array>(elems);
+        return ret;
 
     } else if (typeid(*node) == typeid(ast::HashLiteral)) {
         auto n = node->cast<ast::HashLiteral>();
@@ -111,6 +308,9 @@ std::shared_ptr<object::Object> Evaluator::eval(
 
         return eval_infix_expression(n->op(), left.get(), right.get(), env);
 
+    } else if (typeid(*node) == typeid(ast::ConcatExpression)) {
+        return eval_concat_expression(node->cast<ast::ConcatExpression>(), env);
+
     } else if (typeid(*node) == typeid(ast::IfExpression)) {
         return eval_if_expression(node->cast<ast::IfExpression>(), env);
 
@@ -119,8 +319,7 @@ std::shared_ptr<object::Object> Evaluator::eval(
 
     } else if (typeid(*node) == typeid(ast::FunctionLiteral)) {
         auto n = node->cast<ast::FunctionLiteral>();
-        return std::make_shared<object::Function>(
-                n->parameters(), n->body(), env);
+        return object::make<object::Function>(n->prototype(), env);
 
     } else if (typeid(*node) == typeid(ast::CallExpression)) {
         auto n = node->cast<ast::CallExpression>();
@@ -143,6 +342,11 @@ std::shared_ptr<object::Object> Evaluator::eval(
             return array;
         }
 
+        if (typeid(*n->index()) == typeid(ast::StringLiteral)
+                && typeid(*array) == typeid(object::Hash)) {
+            return eval_field_access(n, static_cast<const object::Hash*>(array.get()));
+        }
+
         auto index = eval(n->index(), env);
         if (is_error(index.get())) {
             return index;
@@ -150,6 +354,34 @@ std::shared_ptr<object::Object> Evaluator::eval(
 
         return eval_index_expression(array.get(), index.get());
 
+    } else if (typeid(*node) == typeid(ast::ImportExpression)) {
+        return eval_import_expression(node->cast<ast::ImportExpression>());
+
+    } else if (typeid(*node) == typeid(ast::SliceExpression)) {
+        auto n = node->cast<ast::SliceExpression>();
+        auto left = eval(n->left(), env);
+        if (is_error(left.get())) {
+            return left;
+        }
+
+        std::shared_ptr<object::Object> start;
+        if (n->start() != nullptr) {
+            start = eval(n->start(), env);
+            if (is_error(start.get())) {
+                return start;
+            }
+        }
+
+        std::shared_ptr<object::Object> end;
+        if (n->end() != nullptr) {
+            end = eval(n->end(), env);
+            if (is_error(end.get())) {
+                return end;
+            }
+        }
+
+        return eval_slice_expression(left, start.get(), end.get());
+
     }
 
     return nullptr;
@@ -163,7 +395,7 @@ std::shared_ptr<object::Object> Evaluator::eval_index_expression(
         auto a = obj->cast<object::Array>();
         auto i = index->cast<object::Integer>();
 
-        auto& elems = a->elements();
+        auto elems = a->elements();
         auto idx = i->value();
 
         if (idx < 0) {
@@ -174,10 +406,51 @@ std::shared_ptr<object::Object> Evaluator::eval_index_expression(
             return object::constants::Null;
         }
 
-        return elems[idx];
+        return object::share(elems[idx]);
+    } else if (typeid(*obj) == typeid(object::String)
+            && typeid(*index) == typeid(object::Integer)) {
+        auto str = obj->cast<object::String>();
+        long length = str->length();
+        long idx = index->cast<object::Integer>()->value();
+
+        if (idx < 0) {
+            idx += length;
+        }
+
+        if (idx < 0 || idx >= length) {
+            return object::constants::Null;
+        }
+
+        // 下标按码点计算，返回该码点对应的字符串
+        size_t begin = str->offset(idx);
+        size_t end = str->offset(idx + 1);
+        return object::String::make(str->value().substr(begin, end - begin));
     } else if (typeid(*obj) == typeid(object::Hash)) {
         auto h = obj->cast<object::Hash>();
-        return h->get(index);
+        return object::share(h->get(index));
+    } else if (typeid(*obj) == typeid(object::Table)
+            && typeid(*index) == typeid(object::String)) {
+        return obj->cast<object::Table>()->column(index->cast<object::String>()->value());
+    } else if ((typeid(*obj) == typeid(object::Table) || typeid(*obj) == typeid(object::Column))
+            && typeid(*index) == typeid(object::Integer)) {
+        long size = typeid(*obj) == typeid(object::Table)
+                ? obj->cast<object::Table>()->size()
+                : obj->cast<object::Column>()->size();
+        long idx = index->cast<object::Integer>()->value();
+
+        if (idx < 0) {
+            idx += size;
+        }
+
+        if (idx < 0 || idx >= size) {
+            return object::constants::Null;
+        }
+
+        // 按需解码，表的第 idx 行是以列名为键的 hash
+        if (typeid(*obj) == typeid(object::Table)) {
+            return obj->cast<object::Table>()->row(idx);
+        }
+        return obj->cast<object::Column>()->at(idx);
     }
 
     return new_error("index operator not supported: {}`{}`{}",
@@ -186,6 +459,102 @@ std::shared_ptr<object::Object> Evaluator::eval_index_expression(
             color::off);
 }
 
+std::shared_ptr<object::Object> Evaluator::eval_field_access(
+        const ast::IndexExpression* exp,
+        const object::Hash* hash) const {
+    auto& key = static_cast<const ast::StringLiteral*>(exp->index())->value();
+    auto shape = hash->shape();
+    if (shape == nullptr) {
+        return object::share(hash->get(key));
+    }
+
+    uint64_t cache = exp->inline_cache();
+    if ((cache >> 32) == shape->id()) {
+        return object::share(hash->slots()[cache & 0xffffffff]);
+    }
+
+    size_t slot = shape->find(key);
+    if (slot == object::Shape::npos) {
+        return object::constants::Null;
+    }
+    exp->set_inline_cache((static_cast<uint64_t>(shape->id()) << 32) | slot);
+    return object::share(hash->slots()[slot]);
+}
+
+std::shared_ptr<object::Object> Evaluator::eval_slice_expression(
+        const std::shared_ptr<object::Object>& obj,
+        const object::Object* start,
+        const object::Object* end) const {
+    size_t size = 0;
+    if (typeid(*obj) == typeid(object::String)) {
+        size = obj->cast<object::String>()->length();
+    } else if (typeid(*obj) == typeid(object::Array)) {
+        size = obj->cast<object::Array>()->elements().size();
+    } else if (typeid(*obj) == typeid(object::Column)) {
+        size = obj->cast<object::Column>()->size();
+    } else {
+        return new_error("slice operator not supported: {}`{}`{}",
+                color::light::light,
+                obj->type(),
+                color::off);
+    }
+
+    // 与 python 一致：负数从尾部开始计算，越界的下标截断到 [0, size]
+    auto normalize = [size](const object::Object* bound, long dflt, long* out) {
+        if (bound == nullptr) {
+            *out = dflt;
+            return true;
+        }
+        if (typeid(*bound) != typeid(object::Integer)) {
+            return false;
+        }
+        long idx = bound->cast<object::Integer>()->value();
+        if (idx < 0) {
+            idx += size;
+        }
+        *out = std::clamp(idx, 0L, static_cast<long>(size));
+        return true;
+    };
+
+    long begin_idx = 0;
+    long end_idx = 0;
+    if (!normalize(start, 0, &begin_idx)) {
+        return new_error("slice index must be INTEGER, got {}`{}`{}",
+                color::light::light,
+                start->type(),
+                color::off);
+    }
+    if (!normalize(end, size, &end_idx)) {
+        return new_error("slice index must be INTEGER, got {}`{}`{}",
+                color::light::light,
+                end->type(),
+                color::off);
+    }
+    end_idx = std::max(begin_idx, end_idx);
+
+    if (typeid(*obj) == typeid(object::String)) {
+        // 码点下标转换为字节偏移
+        auto str = std::static_pointer_cast<const object::String>(obj);
+        return object::String::slice(
+                str,
+                str->offset(begin_idx),
+                str->offset(end_idx));
+    }
+    if (typeid(*obj) == typeid(object::Column)) {
+        // 列的切片仍然是映射内存上的视图
+        auto column = obj->cast<object::Column>();
+        return object::make<object::Column>(
+                column->mapping(),
+                column->column(),
+                column->begin() + begin_idx,
+                end_idx - begin_idx);
+    }
+    return object::Array::slice(
+            std::static_pointer_cast<const object::Array>(obj),
+            begin_idx,
+            end_idx);
+}
+
 std::shared_ptr<object::Object> Evaluator::apply_function(
         const object::Object* fn,
         std::vector<std::shared_ptr<object::Object>>& args) const {
@@ -194,12 +563,23 @@ std::shared_ptr<object::Object> Evaluator::apply_function(
 
     if (typeid(*fn) == typeid(object::Function)) {
         auto function = fn->cast<object::Function>();
+        if (_call_limit != 0 && _calls >= _call_limit) {
+            return new_error("call depth exceeded: {}", _call_limit);
+        }
+        ++_calls;
+        Defer calls([this]() { --_calls; });
+        // 只记录耗时超过阈值的调用，避免短小的递归调用淹没时间线
+        timeline::Span span("call",
+                function->name().empty() ? std::string_view("fn") : function->name(),
+                timeline::threshold_ns());
         auto extended_env = extend_function_env(function, args);
         // 开始执行函数体内的语句
         val = eval(function->body(), extended_env);
     } else if (typeid(*fn) == typeid(object::Builtin)) {
         auto builtin_fn = fn->cast<object::Builtin>();
-        val = builtin_fn->run(args);
+        timeline::Span span("builtin", builtin_fn->name());
+        perf_counters::Scope counters("builtin", builtin_fn->name());
+        val = builtin_fn->run(args, *this);
     }
 
     if (val == nullptr) {
@@ -215,10 +595,11 @@ std::shared_ptr<object::Object> Evaluator::apply_function(
 std::shared_ptr<object::Environment> Evaluator::extend_function_env(
         const object::Function* fn,
         std::vector<std::shared_ptr<object::Object>>& args) const {
-    auto new_env = std::make_shared<object::Environment>(fn->env());
+    auto new_env = object::make<object::Environment>(fn->env());
     auto& params = fn->parameters();
+    size_t count = std::min(fn->prototype()->arity, args.size());
 
-    for (size_t i = 0; i < params.size() && i < args.size(); ++i) {
+    for (size_t i = 0; i < count; ++i) {
         new_env->set(params[i]->value(), args[i]);
     }
     return new_env;
@@ -244,6 +625,9 @@ std::shared_ptr<object::Object> Evaluator::eval_program(
     std::shared_ptr<object::Object> result;
 
     for (auto& stat : statments) {
+        // 顶层语句以源码作为事件名
+        timeline::Span span("statment",
+                timeline::enabled() ? stat->to_string() : std::string());
         result = eval(stat.get(), env);
         if (result == nullptr) {
             continue;
@@ -261,14 +645,14 @@ std::shared_ptr<object::Object> Evaluator::eval_program(
 std::shared_ptr<object::Object> Evaluator::eval_identifier(
         const ast::Identifier* identifier,
         std::shared_ptr<object::Environment>& env) const {
-    auto val = env->get(identifier->value());
+    auto& val = env->get(identifier->value());
     if (val != nullptr) {
-        return val;
+        return object::share(val);
     }
 
     auto builtin_fn = builtin::BUILTINS.find(identifier->value());
     if (builtin_fn != builtin::BUILTINS.end()) {
-        return std::make_shared<object::Builtin>(builtin_fn->second);
+        return object::make<object::Builtin>(builtin_fn->second, builtin_fn->first);
     }
 
     return new_error("identifier not found: {}`{}`{}",
@@ -333,7 +717,7 @@ std::shared_ptr<object::Object> Evaluator::eval_minus_prefix_operator_expression
     }
 
     auto result = right->cast<object::Integer>();
-    return std::make_shared<object::Integer>(-result->value());
+    return object::make<object::Integer>(-result->value());
 }
 
 
@@ -350,13 +734,25 @@ std::shared_ptr<object::Object> Evaluator::eval_integer_infix_expression(
     auto right_val = right->cast<object::Integer>();
 
     if (op == "+") {
-        return std::make_shared<object::Integer>(left_val->value() + right_val->value());
+        return object::make<object::Integer>(left_val->value() + right_val->value());
     } else if (op == "-") {
-        return std::make_shared<object::Integer>(left_val->value() - right_val->value());
+        return object::make<object::Integer>(left_val->value() - right_val->value());
     } else if (op == "*") {
-        return std::make_shared<object::Integer>(left_val->value() * right_val->value());
+        return object::make<object::Integer>(left_val->value() * right_val->value());
     } else if (op == "/") {
-        return std::make_shared<object::Integer>(left_val->value() / right_val->value());
+        if (right_val->value() == 0) {
+            return new_error("division by zero: {}`{} / {}`{}",
+                    color::light::light,
+                    left_val->value(), right_val->value(),
+                    color::off);
+        }
+        if (right_val->value() == -1 && left_val->value() == std::numeric_limits<int64_t>::min()) {
+            return new_error("integer overflow: {}`{} / {}`{}",
+                    color::light::light,
+                    left_val->value(), right_val->value(),
+                    color::off);
+        }
+        return object::make<object::Integer>(left_val->value() / right_val->value());
     } else if (op == "<") {
         return native_bool_to_boolean_object(left_val->value() < right_val->value());
     } else if (op == "<=") {
@@ -386,7 +782,11 @@ std::shared_ptr<object::Object> Evaluator::eval_string_infix_expression(
     auto right_val = right->cast<object::String>();
 
     if (op == "+") {
-        return std::make_shared<object::String>(left_val->value() + right_val->value());
+        std::string ret;
+        ret.reserve(left_val->value().size() + right_val->value().size());
+        ret.append(left_val->value());
+        ret.append(right_val->value());
+        return object::String::make(std::move(ret));
     }
 
     return new_error("unknown operator: {}`{} {} {}`{}",
@@ -404,7 +804,11 @@ std::shared_ptr<object::Object> Evaluator::eval_array_infix_expression(
     auto right_val = right->cast<object::Array>();
 
     if (op == "+") {
-        auto ret = std::make_shared<object::Array>(left_val->elements());
+        auto ret = object::make<object::Array>();
+        ret->reserve(left_val->elements().size() + right_val->elements().size());
+        for (auto& e : left_val->elements()) {
+            ret->append(e);
+        }
         for (auto& e : right_val->elements()) {
             ret->append(e);
         }
@@ -417,6 +821,106 @@ std::shared_ptr<object::Object> Evaluator::eval_array_infix_expression(
             color::off);
 }
 
+std::shared_ptr<object::Object> Evaluator::eval_concat_expression(
+        const ast::ConcatExpression* exp,
+        std::shared_ptr<object::Environment>& env) const {
+    auto& operands = exp->operands();
+    auto acc = eval(operands[0].get(), env);
+    if (is_error(acc.get())) {
+        return acc;
+    }
+
+    size_t i = 1;
+    auto& type = typeid(*acc);
+    if (type == typeid(object::String) || type == typeid(object::Array)) {
+        // 连续的同类操作数先求值，算出总长度后一次分配完成拼接
+        std::vector<std::shared_ptr<object::Object>> values = { acc };
+        std::shared_ptr<object::Object> mismatch;
+        for (; i < operands.size(); ++i) {
+            auto val = eval(operands[i].get(), env);
+            if (is_error(val.get())) {
+                return val;
+            }
+            if (typeid(*val) != type) {
+                mismatch = val;
+                ++i;
+                break;
+            }
+            values.emplace_back(val);
+        }
+
+        if (values.size() > 1 && type == typeid(object::String)) {
+            size_t size = 0;
+            for (auto& val : values) {
+                size += val->cast<object::String>()->value().size();
+            }
+            std::string ret;
+            ret.reserve(size);
+            for (auto& val : values) {
+                ret.append(val->cast<object::String>()->value());
+            }
+            acc = object::String::make(std::move(ret));
+        } else if (values.size() > 1) {
+            size_t size = 0;
+            for (auto& val : values) {
+                size += val->cast<object::Array>()->elements().size();
+            }
+            auto ret = object::make<object::Array>();
+            ret->reserve(size);
+            for (auto& val : values) {
+                for (auto& e : val->cast<object::Array>()->elements()) {
+                    ret->append(e);
+                }
+            }
+            acc = ret;
+        }
+
+        // 类型不一致时退回逐个相加，报错信息与嵌套形式相同
+        if (mismatch != nullptr) {
+            acc = eval_infix_expression("+", acc.get(), mismatch.get(), env);
+            if (is_error(acc.get())) {
+                return acc;
+            }
+        }
+    }
+
+    for (; i < operands.size(); ++i) {
+        auto val = eval(operands[i].get(), env);
+        if (is_error(val.get())) {
+            return val;
+        }
+        acc = eval_infix_expression("+", acc.get(), val.get(), env);
+        if (is_error(acc.get())) {
+            return acc;
+        }
+    }
+    return acc;
+}
+
+std::shared_ptr<object::Object> Evaluator::eval_interpolated_string(
+        const ast::InterpolatedString* exp,
+        std::shared_ptr<object::Environment>& env) const {
+    auto& literals = exp->literals();
+    auto& expressions = exp->expressions();
+    // 先求出所有的值，builder 只记录各段，最后一次分配
+    std::vector<std::shared_ptr<object::Object>> values;
+    values.reserve(expressions.size());
+    object::StringBuilder builder;
+    for (size_t i = 0; i < expressions.size(); ++i) {
+        auto val = eval(expressions[i].get(), env);
+        if (val == nullptr) {
+            val = object::constants::Null;
+        } else if (is_error(val.get())) {
+            return val;
+        }
+        builder.append(literals[i]);
+        builder.append(val.get());
+        values.emplace_back(std::move(val));
+    }
+    builder.append(literals.back());
+    return object::String::make(builder.build());
+}
+
 std::shared_ptr<object::Object> Evaluator::eval_infix_expression(
         const std::string& op,
         const object::Object* left,
@@ -484,12 +988,57 @@ std::shared_ptr<object::Object> Evaluator::eval_if_expression(
     return object::constants::Null;
 }
 
+const object::Shape* Evaluator::hash_literal_shape(const ast::HashLiteral* exp) const {
+    auto layout = exp->layout();
+    if (layout != ast::HashLiteral::UNKNOWN) {
+        return exp->shape();
+    }
+
+    std::vector<std::string> keys;
+    for (auto& pair : exp->pairs()) {
+        if (typeid(*pair.first) != typeid(ast::StringLiteral)) {
+            exp->set_layout(ast::HashLiteral::GENERIC, nullptr);
+            return nullptr;
+        }
+        keys.push_back(pair.first->cast<ast::StringLiteral>()->value());
+    }
+
+    // 空字面量和重复的键走字典方式
+    auto sorted = keys;
+    std::sort(sorted.begin(), sorted.end());
+    if (keys.empty() || std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+        exp->set_layout(ast::HashLiteral::GENERIC, nullptr);
+        return nullptr;
+    }
+
+    auto shape = object::Shape::intern(keys);
+    exp->set_layout(ast::HashLiteral::SHAPED, shape);
+    return shape;
+}
+
 std::shared_ptr<object::Object> Evaluator::eval_hash_literal(
             const ast::HashLiteral* exp,
             std::shared_ptr<object::Environment>& env) const {
-    auto ret = std::make_shared<object::Hash>();
-
     auto& pairs = exp->pairs();
+    auto shape = hash_literal_shape(exp);
+    if (shape != nullptr) {
+        // 键是常量，只需要求值
+        std::vector<std::shared_ptr<object::Object>> slots;
+        slots.reserve(pairs.size());
+        for (auto& pair : pairs) {
+            auto val = eval(pair.second.get(), env);
+
+            if (val == nullptr) {
+                return nullptr;
+            }
+
+            slots.push_back(std::move(val));
+        }
+        return object::make<object::Hash>(shape, std::move(slots));
+    }
+
+    auto ret = object::make<object::Hash>();
+
     // std::pair<std::unique_ptr<ast::Expression>, std::unique_ptr<ast::Expression>>
     for (auto& pair : pairs) {
         auto key = eval(pair.first.get(), env);
@@ -510,4 +1059,80 @@ std::shared_ptr<object::Object> Evaluator::eval_hash_literal(
     return ret;
 }
 
+std::shared_ptr<object::Object> Evaluator::eval_import_expression(
+        const ast::ImportExpression* exp) const {
+    std::string base = _module_dirs.empty() ? std::string() : _module_dirs.back();
+    auto path = module::resolve(exp->path(), base);
+    if (path.empty()) {
+        return new_error("module not found: {}`{}`{}",
+                color::light::light,
+                exp->path(),
+                color::off);
+    }
+
+    if (_loading.count(path) != 0) {
+        return new_error("circular import: {}`{}`{}",
+                color::light::light,
+                exp->path(),
+                color::off);
+    }
+
+    auto compiled = module::compile(path);
+    if (compiled == nullptr) {
+        return new_error("failed to read module: {}`{}`{}",
+                color::light::light,
+                exp->path(),
+                color::off);
+    }
+
+    auto it = _modules.find(path);
+    if (it != _modules.end() && it->second.mtime == compiled->mtime) {
+        return it->second.exports;
+    }
+
+    // 模块在独立的环境中执行，顶层 let 绑定中不以 _ 开头的作为导出
+    auto env = object::make<object::Environment>();
+    _loading.insert(path);
+    auto result = eval_module(compiled.get(), env);
+    _loading.erase(path);
+
+    if (result != nullptr && is_error(result.get())) {
+        return new_error("in module {}`{}`{}: {}",
+                color::light::light,
+                exp->path(),
+                color::off,
+                result->cast<object::Error>()->message());
+    }
+
+    auto exports = object::make<object::Hash>();
+    for (auto& binding : env->store()) {
+        if (binding.first.empty() || binding.first[0] == '_') {
+            continue;
+        }
+        exports->append(object::String::make(binding.first), binding.second);
+    }
+
+    _modules[path] = Module{compiled->mtime, exports};
+    return exports;
+}
+
+std::shared_ptr<object::Object> Evaluator::eval_module(
+        const module::Compiled* compiled,
+        std::shared_ptr<object::Environment>& env) const {
+    if (!compiled->errors.empty()) {
+        std::string message;
+        for (size_t i = 0; i < compiled->errors.size(); ++i) {
+            if (i != 0) {
+                message.append(1, '\n');
+            }
+            message.append(compiled->errors[i]);
+        }
+        return new_error("abort: {}", message);
+    }
+
+    _module_dirs.push_back(std::filesystem::path(compiled->path).parent_path().string());
+    Defer defer([this]() { _module_dirs.pop_back(); });
+    return eval(compiled->program.get(), env);
+}
+
 } // namespace autumn
@@ -0,0 +1,546 @@
+#include "heap.h"
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+#include "async_io.h"
+
+namespace autumn {
+namespace heap {
+
+namespace {
+
+constexpr const char* ENVIRONMENT = "ENVIRONMENT";
+constexpr const char* OUTER = "<outer>";
+
+// std::map 和 std::unordered_map 节点的额外开销，按两到三个指针估算
+constexpr size_t NODE_OVERHEAD = 4 * sizeof(void*);
+
+struct Node {
+    std::string kind;
+    size_t self = 0;
+    // 最短保留路径上的前一个节点和这一步的写法，根的 parent 是 0，step 是根的名字
+    size_t parent = 0;
+    std::string step;
+    bool reachable = true;
+    std::vector<std::pair<size_t, std::string>> edges;
+};
+
+bool is_constant(const object::Object* obj) {
+    return obj == object::constants::Null.get()
+        || obj == object::constants::True.get()
+        || obj == object::constants::False.get();
+}
+
+// 超出 SSO 的字符串才计入堆上的字节
+size_t string_bytes(size_t length) {
+    return length > object::SLICE_INLINE_SIZE ? length + 1 : 0;
+}
+
+size_t self_size(const object::Environment* env) {
+    size_t size = sizeof(object::Environment);
+    for (auto& pair : env->store()) {
+        size += sizeof(pair) + NODE_OVERHEAD + string_bytes(pair.first.size());
+    }
+    return size;
+}
+
+size_t self_size(const object::Object* obj) {
+    const size_t elem = sizeof(std::shared_ptr<object::Object>);
+    if (typeid(*obj) == typeid(object::String)) {
+        // 切片视图的内存属于父字符串，经过 <owner> 边计入；引用表的映射等其它内存时按自身长度估算
+        auto str = obj->cast<object::String>();
+        if (str->parent() != nullptr) {
+            return sizeof(object::String);
+        }
+        return sizeof(object::String) + string_bytes(str->value().size());
+    } else if (typeid(*obj) == typeid(object::Array)) {
+        auto array = obj->cast<object::Array>();
+        // 内联的元素已经算在对象大小里，切片的元素属于根数组
+        if (array->is_inline() || array->parent() != nullptr) {
+            return sizeof(object::Array);
+        }
+        return sizeof(object::Array) + array->elements().size() * elem;
+    } else if (typeid(*obj) == typeid(object::Hash)) {
+        auto hash = obj->cast<object::Hash>();
+        switch (hash->storage()) {
+        case object::Hash::SMALL:
+        case object::Hash::DENSE:
+            return sizeof(object::Hash) + hash->entries().capacity() * sizeof(object::Hash::Entry);
+        case object::Hash::SHAPED:
+            // 只有值数组，键布局是共享的
+            return sizeof(object::Hash) + hash->size() * elem;
+        default:
+            return sizeof(object::Hash) + hash->size()
+                * (sizeof(object::Hash::Pairs::value_type) + NODE_OVERHEAD);
+        }
+    } else if (typeid(*obj) == typeid(object::Set)) {
+        return sizeof(object::Set) + obj->cast<object::Set>()->size() * (elem + 2 * sizeof(size_t));
+    } else if (typeid(*obj) == typeid(object::Deque)) {
+        return sizeof(object::Deque) + obj->cast<object::Deque>()->size() * elem;
+    } else if (typeid(*obj) == typeid(object::PriorityQueue)) {
+        return sizeof(object::PriorityQueue) + obj->cast<object::PriorityQueue>()->size() * elem;
+    } else if (typeid(*obj) == typeid(object::Table) || typeid(*obj) == typeid(object::Column)) {
+        // 数据在映射的文件里，不占堆内存
+        return typeid(*obj) == typeid(object::Table) ? sizeof(object::Table) : sizeof(object::Column);
+    } else if (typeid(*obj) == typeid(object::AsyncRead)) {
+        auto request = obj->cast<object::AsyncRead>()->request();
+        return sizeof(object::AsyncRead) + sizeof(async_io::Request)
+            + string_bytes(request->path().size()) + string_bytes(request->data().capacity());
+    } else if (typeid(*obj) == typeid(object::Function)) {
+        // 原型和语法树由同一字面量的所有闭包共享，不计入
+        return sizeof(object::Function);
+    } else if (typeid(*obj) == typeid(object::Builtin)) {
+        return sizeof(object::Builtin) + string_bytes(obj->cast<object::Builtin>()->name().size());
+    } else if (typeid(*obj) == typeid(object::Error)) {
+        return sizeof(object::Error) + string_bytes(obj->cast<object::Error>()->message().size());
+    } else if (typeid(*obj) == typeid(object::Integer)) {
+        return sizeof(object::Integer);
+    } else if (typeid(*obj) == typeid(object::Boolean)) {
+        return sizeof(object::Boolean);
+    } else if (typeid(*obj) == typeid(object::ReturnValue)) {
+        return sizeof(object::ReturnValue);
+    }
+    return sizeof(object::Object);
+}
+
+// 哈希键在路径中的写法
+std::string key_name(const object::Object* key) {
+    if (typeid(*key) == typeid(object::String)) {
+        return '"' + std::string(key->cast<object::String>()->value()) + '"';
+    } else if (typeid(*key) == typeid(object::Integer)) {
+        return std::to_string(key->cast<object::Integer>()->value());
+    } else if (typeid(*key) == typeid(object::Boolean)) {
+        return key->cast<object::Boolean>()->value() ? "true" : "false";
+    }
+    std::stringstream ss;
+    ss << key->type();
+    return ss.str();
+}
+
+// 名字和路径写在行尾，换行需要转义
+std::string escape(const std::string& str) {
+    std::string ret;
+    for (char c : str) {
+        if (c == '\n') {
+            ret.append("\\n");
+        } else if (c == '\r') {
+            ret.append("\\r");
+        } else {
+            ret.append(1, c);
+        }
+    }
+    return ret;
+}
+
+class Graph {
+public:
+    Graph() : _nodes(1) {
+        // 0 号是虚拟根，连接所有的根
+        _nodes[0].kind = "ROOT";
+        _nodes[0].self = 0;
+    }
+
+    void add_root(const std::string& name, const void* ptr, bool env, bool reachable) {
+        if (ptr == nullptr || (!env && is_constant(static_cast<const object::Object*>(ptr)))) {
+            return;
+        }
+        size_t id = visit(ptr, env, 0, name, reachable);
+        _nodes[0].edges.emplace_back(id, name);
+        _roots.emplace_back(id, name);
+        expand();
+    }
+
+    bool visited(const void* ptr) const {
+        return _ids.count(ptr) != 0;
+    }
+
+    Stats write(std::ostream& out) {
+        compute_retained();
+
+        Stats stats;
+        out << "# autumn heap dump" << std::endl;
+        for (size_t id = 1; id < _nodes.size(); ++id) {
+            auto& node = _nodes[id];
+            out << "node " << id
+                << ' ' << node.kind
+                << ' ' << node.self
+                << ' ' << _retained[id]
+                << ' ' << (_idom[id] < 0 ? 0 : _idom[id])
+                << ' ' << (node.reachable ? 1 : 0)
+                << ' ' << node.parent
+                << ' ' << escape(node.step) << '\n';
+            ++stats.objects;
+            stats.bytes += node.self;
+            if (!node.reachable) {
+                ++stats.unreachable_objects;
+                stats.unreachable_bytes += node.self;
+            }
+        }
+        for (size_t id = 1; id < _nodes.size(); ++id) {
+            for (auto& edge : _nodes[id].edges) {
+                out << "edge " << id << ' ' << edge.first << ' ' << escape(edge.second) << '\n';
+            }
+        }
+        for (auto& root : _roots) {
+            out << "root " << root.first << ' ' << escape(root.second) << '\n';
+        }
+        out.flush();
+        return stats;
+    }
+private:
+    // 第一次见到的对象按广度优先的顺序展开，因此沿 parent 得到的是最短的保留路径
+    size_t visit(const void* ptr, bool env, size_t parent, const std::string& step, bool reachable) {
+        auto it = _ids.find(ptr);
+        if (it != _ids.end()) {
+            return it->second;
+        }
+        size_t id = _nodes.size();
+        _ids.emplace(ptr, id);
+        _nodes.emplace_back();
+        auto& node = _nodes.back();
+        if (env) {
+            auto e = static_cast<const object::Environment*>(ptr);
+            node.kind = ENVIRONMENT;
+            node.self = self_size(e);
+        } else {
+            auto obj = static_cast<const object::Object*>(ptr);
+            std::stringstream ss;
+            ss << obj->type();
+            node.kind = ss.str();
+            node.self = self_size(obj);
+        }
+        node.parent = parent;
+        node.step = step;
+        node.reachable = reachable;
+        _pending.emplace_back(ptr, env);
+        return id;
+    }
+
+    void add_edge(size_t from, const object::Object* obj, const std::string& name, const std::string& step) {
+        if (obj == nullptr || is_constant(obj)) {
+            return;
+        }
+        size_t to = visit(obj, false, from, step, _nodes[from].reachable);
+        _nodes[from].edges.emplace_back(to, name);
+    }
+
+    void add_edge(size_t from, const object::Environment* env, const std::string& name) {
+        if (env == nullptr) {
+            return;
+        }
+        size_t to = visit(env, true, from, "." + name, _nodes[from].reachable);
+        _nodes[from].edges.emplace_back(to, name);
+    }
+
+    void expand() {
+        while (!_pending.empty()) {
+            auto [ptr, env] = _pending.front();
+            _pending.pop_front();
+            size_t id = _ids[ptr];
+            if (env) {
+                expand(static_cast<const object::Environment*>(ptr), id);
+            } else {
+                expand(static_cast<const object::Object*>(ptr), id);
+            }
+        }
+    }
+
+    void expand(const object::Environment* env, size_t id) {
+        for (auto& pair : env->store()) {
+            add_edge(id, pair.second.get(), pair.first, "." + pair.first);
+        }
+        add_edge(id, env->outer().get(), OUTER);
+    }
+
+    void expand(const object::Object* obj, size_t id) {
+        if (typeid(*obj) == typeid(object::Function)) {
+            add_edge(id, obj->cast<object::Function>()->env().get(), "<env>");
+        } else if (typeid(*obj) == typeid(object::String)) {
+            // 切片视图让父字符串保持存活
+            add_edge(id, obj->cast<object::String>()->parent(), "<owner>", ".<owner>");
+        } else if (typeid(*obj) == typeid(object::Array)) {
+            auto array = obj->cast<object::Array>();
+            add_edge(id, array->parent(), "<owner>", ".<owner>");
+            auto elems = array->elements();
+            for (size_t i = 0; i < elems.size(); ++i) {
+                auto step = "[" + std::to_string(i) + "]";
+                add_edge(id, elems[i].get(), step, step);
+            }
+        } else if (typeid(*obj) == typeid(object::Hash)) {
+            obj->cast<object::Hash>()->for_each([&](
+                    const std::shared_ptr<object::Object>& key,
+                    const std::shared_ptr<object::Object>& value) {
+                auto step = "[" + key_name(key.get()) + "]";
+                add_edge(id, key.get(), "<key>", step + ".<key>");
+                add_edge(id, value.get(), step, step);
+            });
+        } else if (typeid(*obj) == typeid(object::Set)) {
+            for (auto& elem : obj->cast<object::Set>()->elements()) {
+                add_edge(id, elem.get(), "<element>", ".<element>");
+            }
+        } else if (typeid(*obj) == typeid(object::Deque)) {
+            auto deque = obj->cast<object::Deque>();
+            for (size_t i = 0; i < deque->size(); ++i) {
+                auto step = "[" + std::to_string(i) + "]";
+                add_edge(id, deque->at(i).get(), step, step);
+            }
+        } else if (typeid(*obj) == typeid(object::PriorityQueue)) {
+            auto pq = obj->cast<object::PriorityQueue>();
+            add_edge(id, pq->comparator().get(), "<comparator>", ".<comparator>");
+            for (auto& elem : pq->elements()) {
+                add_edge(id, elem.get(), "<element>", ".<element>");
+            }
+        } else if (typeid(*obj) == typeid(object::ReturnValue)) {
+            auto ret = const_cast<object::ReturnValue*>(obj->cast<object::ReturnValue>());
+            add_edge(id, ret->value().get(), "<value>", ".<value>");
+        }
+    }
+
+    // 支配树使用 Cooper、Harvey、Kennedy 的迭代算法，
+    // 按逆后序反复求前驱的公共支配者直到不再变化
+    void compute_retained() {
+        size_t n = _nodes.size();
+        std::vector<std::vector<size_t>> preds(n);
+        for (size_t id = 0; id < n; ++id) {
+            for (auto& edge : _nodes[id].edges) {
+                preds[edge.first].push_back(id);
+            }
+        }
+
+        // 非递归的深度优先遍历求后序
+        std::vector<long> postorder(n, -1);
+        std::vector<size_t> order;
+        std::vector<bool> seen(n, false);
+        std::vector<std::pair<size_t, size_t>> stack{{0, 0}};
+        seen[0] = true;
+        while (!stack.empty()) {
+            auto& [id, next] = stack.back();
+            if (next < _nodes[id].edges.size()) {
+                size_t to = _nodes[id].edges[next++].first;
+                if (!seen[to]) {
+                    seen[to] = true;
+                    stack.emplace_back(to, 0);
+                }
+                continue;
+            }
+            postorder[id] = order.size();
+            order.push_back(id);
+            stack.pop_back();
+        }
+
+        _idom.assign(n, -1);
+        _idom[0] = 0;
+        auto intersect = [&](long a, long b) {
+            while (a != b) {
+                while (postorder[a] < postorder[b]) {
+                    a = _idom[a];
+                }
+                while (postorder[b] < postorder[a]) {
+                    b = _idom[b];
+                }
+            }
+            return a;
+        };
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto it = order.rbegin(); it != order.rend(); ++it) {
+                size_t id = *it;
+                if (id == 0) {
+                    continue;
+                }
+                long idom = -1;
+                for (size_t pred : preds[id]) {
+                    if (_idom[pred] < 0) {
+                        continue;
+                    }
+                    idom = idom < 0 ? static_cast<long>(pred) : intersect(pred, idom);
+                }
+                if (idom != _idom[id]) {
+                    _idom[id] = idom;
+                    changed = true;
+                }
+            }
+        }
+
+        // 后序中子节点总在支配者之前
+        _retained.assign(n, 0);
+        for (size_t id : order) {
+            _retained[id] += _nodes[id].self;
+            if (id != 0) {
+                _retained[_idom[id]] += _retained[id];
+            }
+        }
+    }
+private:
+    std::vector<Node> _nodes;
+    std::unordered_map<const void*, size_t> _ids;
+    std::deque<std::pair<const void*, bool>> _pending;
+    std::vector<std::pair<size_t, std::string>> _roots;
+    std::vector<long> _idom;
+    std::vector<size_t> _retained;
+};
+
+struct Binding {
+    std::string name;
+    size_t retained = 0;
+    size_t unreachable = 0;
+    size_t count = 0;
+    std::string example;
+};
+
+}
+
+Stats dump(const std::vector<Root>& roots, const std::vector<const object::Closures*>& closures,
+        std::ostream& out) {
+    Graph graph;
+    for (auto& root : roots) {
+        if (root.env != nullptr) {
+            graph.add_root(root.name, root.env.get(), true, true);
+        } else {
+            graph.add_root(root.name, root.object.get(), false, true);
+        }
+    }
+
+    // 从根不可达但仍然存活的闭包。在锁内展开，闭包不会在展开期间被释放；
+    // 展开只读取对象，不会释放对象，也就不会再去获取这把锁
+    for (auto group : closures) {
+        group->for_each([&graph](const object::Function* fn) {
+            if (graph.visited(fn)) {
+                return;
+            }
+            auto name = fn->name().empty() ? std::string("fn") : fn->name();
+            graph.add_root("<unreachable " + name + ">", fn, false, false);
+        });
+    }
+    return graph.write(out);
+}
+
+bool summarize(std::istream& in, std::ostream& out, size_t top) {
+    struct Record {
+        std::string kind;
+        size_t retained = 0;
+        size_t idom = 0;
+        bool reachable = true;
+        size_t parent = 0;
+        std::string step;
+    };
+    std::unordered_map<size_t, Record> nodes;
+    std::map<std::string, Binding> bindings;
+    Stats stats;
+
+    // 沿 parent 拼出路径，前一个节点的编号总是更小
+    auto path = [&nodes](size_t id) {
+        std::vector<const std::string*> steps;
+        for (auto it = nodes.find(id); it != nodes.end(); ) {
+            steps.push_back(&it->second.step);
+            size_t parent = it->second.parent;
+            if (parent == 0 || parent >= it->first) {
+                break;
+            }
+            it = nodes.find(parent);
+        }
+        std::string ret;
+        for (auto step = steps.rbegin(); step != steps.rend(); ++step) {
+            ret.append(**step);
+        }
+        return ret;
+    };
+
+    std::string line;
+    if (!std::getline(in, line) || line != "# autumn heap dump") {
+        return false;
+    }
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        std::string tag;
+        ss >> tag;
+        if (tag == "node") {
+            size_t id = 0;
+            size_t self = 0;
+            int reachable = 1;
+            Record record;
+            ss >> id >> record.kind >> self >> record.retained >> record.idom >> reachable
+                >> record.parent;
+            if (!ss) {
+                return false;
+            }
+            ss.get();
+            std::getline(ss, record.step);
+            record.reachable = reachable != 0;
+            ++stats.objects;
+            stats.bytes += self;
+            if (!record.reachable) {
+                ++stats.unreachable_objects;
+                stats.unreachable_bytes += self;
+            }
+            nodes.emplace(id, std::move(record));
+        } else if (tag == "edge") {
+            size_t from = 0;
+            size_t to = 0;
+            std::string name;
+            ss >> from >> to;
+            if (!ss) {
+                return false;
+            }
+            ss.get();
+            std::getline(ss, name);
+            // 只统计环境中的绑定，并且只计入被该绑定独占的部分
+            auto f = nodes.find(from);
+            auto t = nodes.find(to);
+            if (f == nodes.end() || t == nodes.end()
+                    || f->second.kind != ENVIRONMENT || name == OUTER) {
+                continue;
+            }
+            auto& binding = bindings[name];
+            binding.name = name;
+            ++binding.count;
+            if (t->second.idom != from) {
+                continue;
+            }
+            binding.retained += t->second.retained;
+            if (!t->second.reachable) {
+                binding.unreachable += t->second.retained;
+            }
+            if (binding.example.empty()) {
+                binding.example = path(to);
+            }
+        } else if (tag == "root") {
+            continue;
+        } else {
+            return false;
+        }
+    }
+
+    std::vector<Binding> sorted;
+    for (auto& pair : bindings) {
+        sorted.push_back(pair.second);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](const Binding& a, const Binding& b) {
+        return a.retained > b.retained;
+    });
+
+    out << format("objects: {}, bytes: {}, unreachable objects: {}, unreachable bytes: {}\n",
+            stats.objects, stats.bytes, stats.unreachable_objects, stats.unreachable_bytes);
+    out << std::setw(12) << "retained" << std::setw(12) << "unreachable" << std::setw(8) << "count"
+        << "  binding\n";
+    for (size_t i = 0; i < sorted.size() && i < top; ++i) {
+        auto& binding = sorted[i];
+        out << std::setw(12) << binding.retained << std::setw(12) << binding.unreachable
+            << std::setw(8) << binding.count << "  " << binding.name;
+        if (!binding.example.empty()) {
+            out << "  (" << binding.example << ")";
+        }
+        out << '\n';
+    }
+    return true;
+}
+
+} // namespace heap
+} // namespace autumn
@@ -0,0 +1,160 @@
+#include "incremental_parser.h"
+
+#include <algorithm>
+
+namespace autumn {
+
+namespace {
+
+constexpr uint64_t FNV_OFFSET = 14695981039346656037ull;
+constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    auto bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+// 去掉形如 \x1b[1m 的终端颜色
+std::string strip_color(const std::string& message) {
+    std::string ret;
+    for (size_t i = 0; i < message.size(); ++i) {
+        if (message[i] == '\x1b' && i + 1 < message.size() && message[i + 1] == '[') {
+            size_t end = message.find('m', i);
+            if (end != std::string::npos) {
+                i = end;
+                continue;
+            }
+        }
+        ret.append(1, message[i]);
+    }
+    return ret;
+}
+
+bool is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+}
+
+uint64_t IncrementalParser::token_hash(const std::string& source, size_t begin, size_t end) {
+    Lexer lexer(source.substr(begin, end - begin));
+    uint64_t hash = FNV_OFFSET;
+    for (auto token = lexer.next_token();
+            token.type != Token::END;
+            token = lexer.next_token()) {
+        hash = fnv1a(hash, &token.type, sizeof(token.type));
+        hash = fnv1a(hash, token.literal.data(), token.literal.size());
+        // 分隔相邻的 literal，避免 "ab" "c" 和 "a" "bc" 相同
+        hash = fnv1a(hash, "", 1);
+    }
+    return hash;
+}
+
+void IncrementalParser::update(const std::string& source) {
+    size_t prefix = 0;
+    size_t limit = std::min(source.size(), _source.size());
+    while (prefix < limit && source[prefix] == _source[prefix]) {
+        ++prefix;
+    }
+    size_t suffix = 0;
+    limit -= prefix;
+    while (suffix < limit
+            && source[source.size() - 1 - suffix] == _source[_source.size() - 1 - suffix]) {
+        ++suffix;
+    }
+    if (prefix == source.size() && prefix == _source.size() && !_statments.empty()) {
+        _reparsed = 0;
+        _reused = _statments.size();
+        return;
+    }
+    edit(prefix, _source.size() - suffix, source.substr(prefix, source.size() - prefix - suffix));
+}
+
+void IncrementalParser::edit(size_t begin, size_t end, const std::string& text) {
+    begin = std::min(begin, _source.size());
+    end = std::max(begin, std::min(end, _source.size()));
+    _source.replace(begin, end - begin, text);
+    long delta = static_cast<long>(text.size()) - static_cast<long>(end - begin);
+    // 编辑后的内容在新源码中的结束位置
+    size_t edited_end = begin + text.size();
+
+    // 编辑点所在的语句，以及它前面的一条语句需要重新解析
+    size_t damaged = 0;
+    while (damaged < _statments.size() && _statments[damaged].begin <= begin) {
+        ++damaged;
+    }
+    damaged = damaged >= 2 ? damaged - 2 : 0;
+    size_t offset = damaged == 0 ? 0 : _statments[damaged].begin;
+
+    // 编辑区之后的语句是复用的候选
+    std::vector<Statment> old(std::make_move_iterator(_statments.begin() + damaged),
+            std::make_move_iterator(_statments.end()));
+    _statments.resize(damaged);
+    size_t candidate = 0;
+    while (candidate < old.size() && old[candidate].begin < end) {
+        ++candidate;
+    }
+
+    _reparsed = 0;
+    _reused = 0;
+    bool resynced = false;
+    _parser.parse_statments(_source, offset, [&](
+            std::unique_ptr<ast::Statment> stmt,
+            size_t stmt_begin,
+            size_t stmt_end,
+            std::vector<std::string> errors) {
+        _statments.push_back(Statment{
+            stmt_begin,
+            stmt_end,
+            token_hash(_source, stmt_begin, stmt_end),
+            std::move(stmt),
+            std::move(errors)});
+        ++_reparsed;
+
+        if (stmt_end < edited_end) {
+            return true;
+        }
+        while (candidate < old.size() && old[candidate].begin + delta < stmt_end) {
+            ++candidate;
+        }
+        if (candidate == old.size() || old[candidate].begin + delta != stmt_end) {
+            return true;
+        }
+        auto& next = old[candidate];
+        if (token_hash(_source, next.begin + delta, next.end + delta) != next.hash) {
+            return true;
+        }
+        resynced = true;
+        return false;
+    });
+
+    if (resynced) {
+        for (size_t i = candidate; i < old.size(); ++i) {
+            old[i].begin += delta;
+            old[i].end += delta;
+            _statments.push_back(std::move(old[i]));
+            ++_reused;
+        }
+    }
+    _reused += damaged;
+}
+
+std::vector<IncrementalParser::Diagnostic> IncrementalParser::diagnostics() const {
+    std::vector<Diagnostic> ret;
+    for (auto& stmt : _statments) {
+        size_t end = stmt.end;
+        while (end > stmt.begin && is_space(_source[end - 1])) {
+            --end;
+        }
+        for (auto& error : stmt.errors) {
+            ret.push_back(Diagnostic{stmt.begin, end, strip_color(error)});
+        }
+    }
+    return ret;
+}
+
+} // namespace autumn
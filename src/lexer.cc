@@ -1,5 +1,6 @@
 #include "lexer.h"
 #include <algorithm>
+#include <vector>
 namespace autumn {
 
 Lexer::Lexer(const std::string& input) :
@@ -7,15 +8,51 @@ Lexer::Lexer(const std::string& input) :
     read_char();
 }
 
+Lexer::Lexer(const std::string& input, size_t offset) :
+    _input(input) {
+    offset = std::min(offset, _input.size());
+    _line = 1 + std::count(_input.begin(), _input.begin() + offset, '\n');
+    _read_pos = offset;
+    read_char();
+}
+
+Lexer::~Lexer() {
+    if (_perf_sampled) {
+        perf_counters::record("lex", _perf);
+    }
+}
+
 Token Lexer::next_token() {
+    if (!perf_counters::enabled()) {
+        return scan_token();
+    }
+    perf_counters::Values begin;
+    perf_counters::Values end;
+    bool sampled = perf_counters::read(&begin);
+    Token token = scan_token();
+    if (sampled && perf_counters::read(&end)) {
+        _perf += end - begin;
+        _perf_sampled = true;
+    }
+    return token;
+}
+
+Token Lexer::scan_token() {
     skip_whitespace();
     Token token;
+    int line = _line;
+    int offset = _pos;
 
     switch (_ch) {
     case '"':
         {
             std::string s = read_string();
-            token = Token{Token::STRING, s};
+            // 没有结尾的引号时保留开头的引号，解析器据此报告没有结束的字符串
+            if (_ch == '"') {
+                token = Token{Token::STRING, s};
+            } else {
+                token = Token{Token::ILLEGAL, "\"" + s};
+            }
         }
         break;
     case '=':
@@ -95,20 +132,28 @@ Token Lexer::next_token() {
     default:
         if (is_letter(_ch)) {
             auto ident = read_identifier();
-            return Token{Token::lookup(ident), ident};
+            return Token{Token::lookup(ident), ident, line, offset};
         } else if (is_digital(_ch)) {
             auto num = read_number();
-            return Token{Token::INT, num};
+            return Token{Token::INT, num, line, offset};
         } else {
-            return Token{Token::ILLEGAL, ""};
+            // 跳过非法字符，否则解析器会反复拿到同一个 token
+            std::string literal(1, _ch);
+            read_char();
+            return Token{Token::ILLEGAL, literal, line, offset};
         }
     }
 
     read_char();
+    token.line = line;
+    token.offset = offset;
     return token;
 }
 
 void Lexer::read_char() {
+    if (_ch == '\n') {
+        ++_line;
+    }
     if (_read_pos >= _input.length()) {
         _ch = 0;
     } else {
@@ -161,11 +206,85 @@ std::string Lexer::read_number() {
 
 std::string Lexer::read_string() {
     int pos = _pos + 1;
+    // 没有结尾的引号时读到输入末尾为止
+    size_t end = string_end(_input, pos);
+    if (end == std::string::npos) {
+        end = _input.size();
+    }
     do {
         read_char();
-    } while (_ch != '"');
+    } while (static_cast<size_t>(_pos) < end);
     return _input.substr(pos, _pos - pos);
 }
 
+size_t Lexer::string_end(std::string_view input, size_t pos) {
+    return closing(input, pos, true);
+}
+
+size_t Lexer::interpolation_end(std::string_view input, size_t pos) {
+    return closing(input, pos, false);
+}
+
+size_t Lexer::interpolation_begin(std::string_view input, size_t pos) {
+    for (size_t i = pos; i + 1 < input.size(); ++i) {
+        if (input[i] == '\\' && input[i + 1] == '$') {
+            ++i;
+        } else if (input[i] == '$' && input[i + 1] == '{') {
+            return i;
+        }
+    }
+    return std::string::npos;
+}
+
+std::string Lexer::unescape(std::string_view text) {
+    std::string ret;
+    ret.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\\' && i + 1 < text.size() && text[i + 1] == '$') {
+            ++i;
+        }
+        ret.push_back(text[i]);
+    }
+    return ret;
+}
+
+bool Lexer::in_interpolation(std::string_view input) {
+    bool open = false;
+    closing(input, 0, true, &open);
+    return open;
+}
+
+size_t Lexer::closing(std::string_view input, size_t pos, bool string, bool* open) {
+    // 用显式的栈代替递归，嵌套再深也不会栈溢出：0 表示字符串，
+    // 大于 0 表示插值中还没有匹配的 { 的个数（包括 ${ 本身）
+    std::vector<size_t> frames(1, string ? 0 : 1);
+    for (size_t i = pos; i < input.size(); ++i) {
+        auto& top = frames.back();
+        if (top == 0) {
+            if (input[i] == '"') {
+                frames.pop_back();
+            } else if (input[i] == '\\' && i + 1 < input.size() && input[i + 1] == '$') {
+                ++i;
+            } else if (input[i] == '$' && i + 1 < input.size() && input[i + 1] == '{') {
+                frames.push_back(1);
+                ++i;
+            }
+        } else if (input[i] == '"') {
+            frames.push_back(0);
+        } else if (input[i] == '{') {
+            ++top;
+        } else if (input[i] == '}' && --top == 0) {
+            frames.pop_back();
+        }
+        if (frames.empty()) {
+            return i;
+        }
+    }
+    if (open != nullptr) {
+        *open = std::any_of(frames.begin(), frames.end(), [](size_t frame) { return frame > 0; });
+    }
+    return std::string::npos;
+}
+
 } // namespace autumn
 
@@ -0,0 +1,210 @@
+#include "line_profile.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace autumn {
+namespace line_profile {
+
+namespace internal {
+std::atomic<int> g_mode{0};
+}
+
+namespace {
+
+struct Counter {
+    uint64_t count = 0;
+    uint64_t ns = 0;
+    int line = 0;
+};
+
+// 以下状态和各线程计数表的登记都由 s_mutex 保护
+std::mutex s_mutex;
+std::string s_name;
+std::string s_source;
+uint32_t s_first_id = 0;
+uint32_t s_last_id = 0;
+bool s_has_source = false;
+// 已经退出的线程留下的计数，下标是 节点编号 - s_first_id
+std::vector<Counter> s_retired;
+
+void merge(std::vector<Counter>* to, const std::vector<Counter>& from) {
+    if (to->size() < from.size()) {
+        to->resize(from.size());
+    }
+    for (size_t i = 0; i < from.size(); ++i) {
+        auto& counter = (*to)[i];
+        counter.count += from[i].count;
+        counter.ns += from[i].ns;
+        if (from[i].count != 0) {
+            counter.line = from[i].line;
+        }
+    }
+}
+
+// 每个线程各自计数，hit 只锁本线程的表，不和其它线程争抢；report 和 reset 逐个加锁读写
+// 只统计 set_source 给出的节点区间，表的大小不超过区间的长度
+struct ThreadCounters;
+std::vector<ThreadCounters*> s_threads;
+
+struct ThreadCounters {
+    std::mutex mutex;
+    std::vector<Counter> counters;
+    uint32_t first_id = 0;
+    uint32_t last_id = 0;
+
+    ThreadCounters() {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        first_id = s_first_id;
+        last_id = s_last_id;
+        s_threads.push_back(this);
+    }
+
+    ~ThreadCounters() {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        merge(&s_retired, counters);
+        s_threads.erase(std::find(s_threads.begin(), s_threads.end(), this));
+    }
+};
+
+thread_local ThreadCounters t_counters;
+
+// 调用方持有 s_mutex
+void clear_locked() {
+    s_retired.clear();
+    for (auto thread : s_threads) {
+        std::lock_guard<std::mutex> lock(thread->mutex);
+        thread->counters.clear();
+        thread->first_id = s_first_id;
+        thread->last_id = s_last_id;
+    }
+}
+
+void report_at_exit() {
+    if (s_has_source) {
+        report(std::cerr);
+    }
+}
+
+struct EnvInitializer {
+    EnvInitializer() {
+        const char* mode = getenv("AUTUMN_LINE_PROFILE");
+        if (mode == nullptr) {
+            return;
+        }
+        if (strcmp(mode, "time") == 0) {
+            enable(true);
+        } else if (strcmp(mode, "1") == 0) {
+            enable(false);
+        }
+    }
+} s_env_initializer;
+
+}
+
+void enable(bool timing) {
+    if (internal::g_mode.load(std::memory_order_relaxed) == 0) {
+        atexit(report_at_exit);
+    }
+    internal::g_mode.store(timing ? 2 : 1, std::memory_order_relaxed);
+}
+
+void set_source(
+        const std::string& name,
+        const std::string& source,
+        uint32_t first_id,
+        uint32_t last_id) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_name = name;
+    s_source = source;
+    s_has_source = true;
+    if (first_id == s_first_id && last_id == s_last_id) {
+        return;
+    }
+    // 换了源码之后节点区间不同，之前的计数不会再输出
+    s_first_id = first_id;
+    s_last_id = last_id;
+    clear_locked();
+}
+
+void hit(const ast::Node* node, uint64_t ns) {
+    auto& local = t_counters;
+    std::lock_guard<std::mutex> lock(local.mutex);
+    uint32_t id = node->id();
+    // 模块等其他源码中的语句不在清单里，不计数
+    if (id < local.first_id || id >= local.last_id) {
+        return;
+    }
+    size_t index = id - local.first_id;
+    if (index >= local.counters.size()) {
+        local.counters.resize(std::min<size_t>(std::max<size_t>(index + 1, local.counters.size() * 2),
+                local.last_id - local.first_id));
+    }
+    auto& counter = local.counters[index];
+    ++counter.count;
+    counter.ns += ns;
+    counter.line = static_cast<const ast::Statment*>(node)->line();
+}
+
+void report(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    std::vector<Counter> counters = s_retired;
+    for (auto thread : s_threads) {
+        std::lock_guard<std::mutex> thread_lock(thread->mutex);
+        merge(&counters, thread->counters);
+    }
+
+    std::vector<std::string> lines;
+    std::stringstream ss(s_source);
+    for (std::string line; std::getline(ss, line); ) {
+        lines.push_back(line);
+    }
+
+    // 同一行上的多条语句合并计数
+    std::vector<Counter> per_line(lines.size() + 1);
+    for (auto& counter : counters) {
+        if (counter.count == 0 || counter.line <= 0
+                || counter.line >= static_cast<int>(per_line.size())) {
+            continue;
+        }
+        per_line[counter.line].count += counter.count;
+        per_line[counter.line].ns += counter.ns;
+    }
+
+    char buf[64];
+    out << "        -:    0:Source:" << s_name << '\n';
+    for (size_t i = 0; i < lines.size(); ++i) {
+        auto& counter = per_line[i + 1];
+        if (counter.count == 0) {
+            snprintf(buf, sizeof(buf), "%9s:", "-");
+        } else {
+            snprintf(buf, sizeof(buf), "%9llu:", static_cast<unsigned long long>(counter.count));
+        }
+        out << buf;
+        // 耗时是包含嵌套调用在内的累计值
+        if (timing()) {
+            if (counter.count == 0) {
+                snprintf(buf, sizeof(buf), "%12s:", "-");
+            } else {
+                snprintf(buf, sizeof(buf), "%9.3fms:", counter.ns / 1e6);
+            }
+            out << buf;
+        }
+        snprintf(buf, sizeof(buf), "%5zu:", i + 1);
+        out << buf << lines[i] << '\n';
+    }
+}
+
+void reset() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    clear_locked();
+}
+
+} // namespace line_profile
+} // namespace autumn
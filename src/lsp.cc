@@ -0,0 +1,516 @@
+#include "lsp.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "utf8.h"
+
+namespace autumn {
+namespace lsp {
+
+namespace {
+
+// JSON-RPC 的错误码
+constexpr int PARSE_ERROR = -32700;
+constexpr int METHOD_NOT_FOUND = -32601;
+
+// 递归下降的 JSON 解析器
+class Reader {
+public:
+    Reader(std::string_view text) : _text(text) {}
+
+    bool read(Json* out) {
+        if (!value(out, 0)) {
+            return false;
+        }
+        skip_space();
+        return _pos == _text.size();
+    }
+private:
+    // 嵌套层数上限，避免恶意输入耗尽栈
+    static constexpr int MAX_DEPTH = 256;
+
+    void skip_space() {
+        while (_pos < _text.size()
+                && (_text[_pos] == ' ' || _text[_pos] == '\n' || _text[_pos] == '\r' || _text[_pos] == '\t')) {
+            ++_pos;
+        }
+    }
+
+    bool consume(std::string_view word) {
+        if (_text.substr(_pos, word.size()) != word) {
+            return false;
+        }
+        _pos += word.size();
+        return true;
+    }
+
+    bool value(Json* out, int depth) {
+        if (depth > MAX_DEPTH) {
+            return false;
+        }
+        skip_space();
+        if (_pos >= _text.size()) {
+            return false;
+        }
+        char c = _text[_pos];
+        if (c == '{') {
+            return object(out, depth);
+        } else if (c == '[') {
+            return array(out, depth);
+        } else if (c == '"') {
+            std::string str;
+            if (!string(&str)) {
+                return false;
+            }
+            *out = Json(str);
+            return true;
+        } else if (consume("true")) {
+            *out = Json(true);
+            return true;
+        } else if (consume("false")) {
+            *out = Json(false);
+            return true;
+        } else if (consume("null")) {
+            *out = Json();
+            return true;
+        }
+        return number(out);
+    }
+
+    bool object(Json* out, int depth) {
+        ++_pos;
+        Json::Object members;
+        skip_space();
+        if (consume("}")) {
+            *out = Json(std::move(members));
+            return true;
+        }
+        while (true) {
+            skip_space();
+            std::string key;
+            if (_pos >= _text.size() || _text[_pos] != '"' || !string(&key)) {
+                return false;
+            }
+            skip_space();
+            if (!consume(":")) {
+                return false;
+            }
+            Json member;
+            if (!value(&member, depth + 1)) {
+                return false;
+            }
+            members.emplace_back(std::move(key), std::move(member));
+            skip_space();
+            if (consume(",")) {
+                continue;
+            }
+            if (consume("}")) {
+                break;
+            }
+            return false;
+        }
+        *out = Json(std::move(members));
+        return true;
+    }
+
+    bool array(Json* out, int depth) {
+        ++_pos;
+        Json::Array elements;
+        skip_space();
+        if (consume("]")) {
+            *out = Json(std::move(elements));
+            return true;
+        }
+        while (true) {
+            Json element;
+            if (!value(&element, depth + 1)) {
+                return false;
+            }
+            elements.push_back(std::move(element));
+            skip_space();
+            if (consume(",")) {
+                continue;
+            }
+            if (consume("]")) {
+                break;
+            }
+            return false;
+        }
+        *out = Json(std::move(elements));
+        return true;
+    }
+
+    bool hex4(uint32_t* out) {
+        if (_pos + 4 > _text.size()) {
+            return false;
+        }
+        uint32_t value = 0;
+        for (int i = 0; i < 4; ++i) {
+            char c = _text[_pos++];
+            value <<= 4;
+            if ('0' <= c && c <= '9') {
+                value |= c - '0';
+            } else if ('a' <= c && c <= 'f') {
+                value |= c - 'a' + 10;
+            } else if ('A' <= c && c <= 'F') {
+                value |= c - 'A' + 10;
+            } else {
+                return false;
+            }
+        }
+        *out = value;
+        return true;
+    }
+
+    static void append_utf8(std::string* out, uint32_t cp) {
+        if (cp < 0x80) {
+            out->append(1, static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            out->append(1, static_cast<char>(0xC0 | (cp >> 6)));
+            out->append(1, static_cast<char>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            out->append(1, static_cast<char>(0xE0 | (cp >> 12)));
+            out->append(1, static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out->append(1, static_cast<char>(0x80 | (cp & 0x3F)));
+        } else {
+            out->append(1, static_cast<char>(0xF0 | (cp >> 18)));
+            out->append(1, static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            out->append(1, static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out->append(1, static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    bool string(std::string* out) {
+        ++_pos;
+        while (_pos < _text.size()) {
+            char c = _text[_pos++];
+            if (c == '"') {
+                return true;
+            }
+            if (c != '\\') {
+                out->append(1, c);
+                continue;
+            }
+            if (_pos >= _text.size()) {
+                return false;
+            }
+            char e = _text[_pos++];
+            switch (e) {
+            case '"': out->append(1, '"'); break;
+            case '\\': out->append(1, '\\'); break;
+            case '/': out->append(1, '/'); break;
+            case 'b': out->append(1, '\b'); break;
+            case 'f': out->append(1, '\f'); break;
+            case 'n': out->append(1, '\n'); break;
+            case 'r': out->append(1, '\r'); break;
+            case 't': out->append(1, '\t'); break;
+            case 'u':
+                {
+                    uint32_t cp = 0;
+                    if (!hex4(&cp)) {
+                        return false;
+                    }
+                    // UTF-16 代理对
+                    if (cp >= 0xD800 && cp < 0xDC00 && consume("\\u")) {
+                        uint32_t low = 0;
+                        if (!hex4(&low) || low < 0xDC00 || low >= 0xE000) {
+                            return false;
+                        }
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    append_utf8(out, cp);
+                }
+                break;
+            default:
+                return false;
+            }
+        }
+        return false;
+    }
+
+    bool number(Json* out) {
+        size_t begin = _pos;
+        while (_pos < _text.size()
+                && (isdigit(static_cast<unsigned char>(_text[_pos]))
+                    || _text[_pos] == '-' || _text[_pos] == '+'
+                    || _text[_pos] == '.' || _text[_pos] == 'e' || _text[_pos] == 'E')) {
+            ++_pos;
+        }
+        if (_pos == begin) {
+            return false;
+        }
+        std::string str(_text.substr(begin, _pos - begin));
+        char* end = nullptr;
+        double value = strtod(str.c_str(), &end);
+        if (end != str.c_str() + str.size()) {
+            return false;
+        }
+        *out = Json(value);
+        return true;
+    }
+private:
+    std::string_view _text;
+    size_t _pos = 0;
+};
+
+void dump_string(const std::string& str, std::string* out) {
+    out->append(1, '"');
+    for (char c : str) {
+        switch (c) {
+        case '"': out->append("\\\""); break;
+        case '\\': out->append("\\\\"); break;
+        case '\n': out->append("\\n"); break;
+        case '\r': out->append("\\r"); break;
+        case '\t': out->append("\\t"); break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out->append(buf);
+            } else {
+                out->append(1, c);
+            }
+        }
+    }
+    out->append(1, '"');
+}
+
+// UTF-8 首字节对应的码点占用的 UTF-16 码元数
+size_t utf16_units(unsigned char lead) {
+    return lead >= 0xF0 ? 2 : 1;
+}
+
+std::string response(const Json& id, Json result) {
+    return Json(Json::Object{
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"result", std::move(result)},
+    }).dump();
+}
+
+std::string error_response(const Json& id, int code, const std::string& message) {
+    return Json(Json::Object{
+        {"jsonrpc", "2.0"},
+        {"id", id},
+        {"error", Json(Json::Object{{"code", code}, {"message", message}})},
+    }).dump();
+}
+
+Json position_json(const Position& position) {
+    return Json(Json::Object{
+        {"line", position.line},
+        {"character", position.character},
+    });
+}
+
+Position position_from(const Json& json) {
+    Position position;
+    position.line = static_cast<size_t>(std::max(0.0, json["line"].number()));
+    position.character = static_cast<size_t>(std::max(0.0, json["character"].number()));
+    return position;
+}
+
+}
+
+const Json& Json::operator[](std::string_view key) const {
+    static const Json null;
+    for (auto& member : _object) {
+        if (member.first == key) {
+            return member.second;
+        }
+    }
+    return null;
+}
+
+bool Json::parse(std::string_view text, Json* out) {
+    Reader reader(text);
+    return reader.read(out);
+}
+
+std::string Json::dump() const {
+    std::string out;
+    dump(&out);
+    return out;
+}
+
+void Json::dump(std::string* out) const {
+    switch (_type) {
+    case NUL:
+        out->append("null");
+        break;
+    case BOOLEAN:
+        out->append(_boolean ? "true" : "false");
+        break;
+    case NUMBER:
+        if (std::floor(_number) == _number && std::fabs(_number) < 1e15) {
+            out->append(std::to_string(static_cast<int64_t>(_number)));
+        } else {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%.17g", _number);
+            out->append(buf);
+        }
+        break;
+    case STRING:
+        dump_string(_string, out);
+        break;
+    case ARRAY:
+        out->append(1, '[');
+        for (size_t i = 0; i < _array.size(); ++i) {
+            if (i != 0) {
+                out->append(1, ',');
+            }
+            _array[i].dump(out);
+        }
+        out->append(1, ']');
+        break;
+    case OBJECT:
+        out->append(1, '{');
+        for (size_t i = 0; i < _object.size(); ++i) {
+            if (i != 0) {
+                out->append(1, ',');
+            }
+            dump_string(_object[i].first, out);
+            out->append(1, ':');
+            _object[i].second.dump(out);
+        }
+        out->append(1, '}');
+        break;
+    }
+}
+
+size_t offset_of(const std::string& text, const Position& position) {
+    size_t offset = 0;
+    for (size_t line = 0; line < position.line; ++line) {
+        size_t newline = text.find('\n', offset);
+        if (newline == std::string::npos) {
+            return text.size();
+        }
+        offset = newline + 1;
+    }
+    size_t units = 0;
+    while (offset < text.size() && text[offset] != '\n' && units < position.character) {
+        units += utf16_units(static_cast<unsigned char>(text[offset]));
+        ++offset;
+        while (offset < text.size() && utf8::is_continuation(text[offset])) {
+            ++offset;
+        }
+    }
+    return offset;
+}
+
+Position position_of(const std::string& text, size_t offset) {
+    offset = std::min(offset, text.size());
+    Position position;
+    size_t line_begin = 0;
+    for (size_t i = 0; i < offset; ++i) {
+        if (text[i] == '\n') {
+            ++position.line;
+            line_begin = i + 1;
+        }
+    }
+    for (size_t i = line_begin; i < offset; ++i) {
+        if (!utf8::is_continuation(text[i])) {
+            position.character += utf16_units(static_cast<unsigned char>(text[i]));
+        }
+    }
+    return position;
+}
+
+const IncrementalParser* Server::document(const std::string& uri) const {
+    auto it = _documents.find(uri);
+    return it == _documents.end() ? nullptr : &it->second;
+}
+
+std::vector<std::string> Server::handle(const std::string& message) {
+    Json request;
+    if (!Json::parse(message, &request) || request.type() != Json::OBJECT) {
+        return {error_response(Json(), PARSE_ERROR, "parse error")};
+    }
+
+    auto& id = request["id"];
+    auto& method = request["method"].string();
+    auto& params = request["params"];
+    // 没有 id 的是通知，不需要响应
+    bool is_request = !id.is_null();
+
+    if (method == "initialize") {
+        return {response(id, Json(Json::Object{
+            {"capabilities", Json(Json::Object{
+                {"textDocumentSync", Json(Json::Object{
+                    {"openClose", true},
+                    // 2: 增量同步
+                    {"change", 2},
+                })},
+            })},
+            {"serverInfo", Json(Json::Object{{"name", "autumn-lsp"}})},
+        }))};
+    } else if (method == "shutdown") {
+        _shutdown = true;
+        return {response(id, Json())};
+    } else if (method == "exit") {
+        _exited = true;
+        return {};
+    } else if (method == "textDocument/didOpen") {
+        auto& document = params["textDocument"];
+        auto& uri = document["uri"].string();
+        _documents[uri].update(document["text"].string());
+        return {publish_diagnostics(uri)};
+    } else if (method == "textDocument/didChange") {
+        auto& uri = params["textDocument"]["uri"].string();
+        auto& parser = _documents[uri];
+        for (auto& change : params["contentChanges"].array()) {
+            auto& range = change["range"];
+            if (range.is_null()) {
+                parser.update(change["text"].string());
+                continue;
+            }
+            size_t begin = offset_of(parser.source(), position_from(range["start"]));
+            size_t end = offset_of(parser.source(), position_from(range["end"]));
+            parser.edit(begin, std::max(begin, end), change["text"].string());
+        }
+        return {publish_diagnostics(uri)};
+    } else if (method == "textDocument/didClose") {
+        auto& uri = params["textDocument"]["uri"].string();
+        _documents.erase(uri);
+        return {publish_diagnostics(uri)};
+    }
+
+    if (is_request) {
+        return {error_response(id, METHOD_NOT_FOUND, "method not found: " + method)};
+    }
+    return {};
+}
+
+std::string Server::publish_diagnostics(const std::string& uri) const {
+    Json::Array diagnostics;
+    auto parser = document(uri);
+    if (parser != nullptr) {
+        for (auto& diagnostic : parser->diagnostics()) {
+            diagnostics.push_back(Json(Json::Object{
+                {"range", Json(Json::Object{
+                    {"start", position_json(position_of(parser->source(), diagnostic.begin))},
+                    {"end", position_json(position_of(parser->source(), diagnostic.end))},
+                })},
+                // 1: Error
+                {"severity", 1},
+                {"source", "autumn"},
+                {"message", diagnostic.message},
+            }));
+        }
+    }
+    return Json(Json::Object{
+        {"jsonrpc", "2.0"},
+        {"method", "textDocument/publishDiagnostics"},
+        {"params", Json(Json::Object{
+            {"uri", uri},
+            {"diagnostics", Json(std::move(diagnostics))},
+        })},
+    }).dump();
+}
+
+} // namespace lsp
+} // namespace autumn
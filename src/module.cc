@@ -0,0 +1,98 @@
+#include "module.h"
+
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+#include "environment.h"
+#include "line_profile.h"
+#include "optimizer.h"
+#include "perf_counters.h"
+#include "parser.h"
+
+namespace autumn {
+namespace module {
+
+namespace {
+
+std::mutex s_mutex;
+std::unordered_map<std::string, std::shared_ptr<const Compiled>> s_compiled;
+
+}
+
+std::string resolve(const std::string& path, const std::string& base) {
+    std::filesystem::path p(path);
+    if (p.is_relative() && !base.empty()) {
+        p = std::filesystem::path(base) / p;
+    }
+
+    std::error_code ec;
+    auto canonical = std::filesystem::canonical(p, ec);
+    if (ec || !std::filesystem::is_regular_file(canonical, ec)) {
+        return std::string();
+    }
+    return canonical.string();
+}
+
+std::shared_ptr<const Compiled> compile(
+        const std::string& canonical_path,
+        const object::Environment* globals) {
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(canonical_path, ec);
+    if (ec) {
+        return nullptr;
+    }
+
+    bool rebound = false;
+    {
+        std::lock_guard<std::mutex> lock(s_mutex);
+        auto it = s_compiled.find(canonical_path);
+        if (it != s_compiled.end() && it->second->mtime == mtime) {
+            for (auto& name : it->second->builtins) {
+                if (globals != nullptr && globals->get(name) != nullptr) {
+                    rebound = true;
+                    break;
+                }
+            }
+            if (!rebound) {
+                return it->second;
+            }
+        }
+    }
+
+    std::ifstream in(canonical_path);
+    if (!in) {
+        return nullptr;
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+
+    // 解析放在锁外，多个线程同时编译同一个模块时以后写入的为准
+    auto compiled = std::make_shared<Compiled>();
+    Parser parser;
+    compiled->path = canonical_path;
+    compiled->mtime = mtime;
+    compiled->source = ss.str();
+    compiled->first_id = ast::Node::peek_next_id();
+    auto program = parser.parse(compiled->source);
+    if (program != nullptr && parser.errors().empty() && !line_profile::enabled()) {
+        perf_counters::Scope counters("optimize");
+        Optimizer optimizer(globals);
+        optimizer.optimize(program.get());
+        compiled->builtins = optimizer.builtins();
+    }
+    compiled->program = std::move(program);
+    compiled->last_id = ast::Node::peek_next_id();
+    compiled->errors = parser.errors();
+
+    if (rebound) {
+        return compiled;
+    }
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_compiled[canonical_path] = compiled;
+    return compiled;
+}
+
+} // namespace module
+} // namespace autumn
@@ -1,5 +1,15 @@
 #include "object.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <unordered_set>
+
+#include "async_io.h"
+#include "defer.h"
 
 namespace autumn {
 namespace object {
@@ -23,8 +33,1010 @@ std::unordered_map<int, std::string> Type::_type_to_name = {
     {BUILTIN_OBJECT, "BUILTIN"},
     {ARRAY_OBJECT, "ARRAY"},
     {HASH_OBJECT, "HASH"},
+    {SET_OBJECT, "SET"},
+    {DEQUE_OBJECT, "DEQUE"},
+    {PRIORITY_QUEUE_OBJECT, "PRIORITY_QUEUE"},
+    {TABLE_OBJECT, "TABLE"},
+    {COLUMN_OBJECT, "COLUMN"},
+    {ASYNC_READ_OBJECT, "ASYNC_READ"},
+};
+
+namespace {
+
+thread_local Closures* t_closures = nullptr;
+
+bool should_compact(size_t length, size_t pinned) {
+    return pinned >= SLICE_COMPACT_MIN_SIZE
+        && length * SLICE_COMPACT_RATIO < pinned;
+}
+
+// 冻结对象图的根，只增不减，保证冻结的对象永远不会释放
+std::mutex s_immortals_mutex;
+auto s_immortals = new std::vector<std::shared_ptr<Object>>();
+
+// 依次访问 obj 直接引用的对象
+void for_each_child(const Object* obj, const std::function<void(const std::shared_ptr<Object>&)>& fn) {
+    auto& type = typeid(*obj);
+    if (type == typeid(Array)) {
+        for (auto& elem : obj->cast<Array>()->elements()) {
+            fn(elem);
+        }
+    } else if (type == typeid(Hash)) {
+        obj->cast<Hash>()->for_each([&fn](const std::shared_ptr<Object>& key,
+                const std::shared_ptr<Object>& value) {
+            fn(key);
+            fn(value);
+        });
+    } else if (type == typeid(Set)) {
+        for (auto& elem : obj->cast<Set>()->elements()) {
+            fn(elem);
+        }
+    } else if (type == typeid(Deque)) {
+        auto deque = obj->cast<Deque>();
+        for (size_t i = 0; i < deque->size(); ++i) {
+            fn(deque->at(i));
+        }
+    } else if (type == typeid(PriorityQueue)) {
+        auto queue = obj->cast<PriorityQueue>();
+        fn(queue->comparator());
+        for (auto& elem : queue->elements()) {
+            fn(elem);
+        }
+    } else if (type == typeid(ReturnValue)) {
+        fn(const_cast<ReturnValue*>(obj->cast<ReturnValue>())->value());
+    }
+}
+
+}
+
+std::shared_ptr<Object> freeze(const std::shared_ptr<Object>& obj) {
+    // 先检查整张图，有闭包时不留下冻结了一半的图
+    std::vector<Object*> objects;
+    std::unordered_set<const Object*> visited;
+    std::vector<Object*> pending{obj.get()};
+    while (!pending.empty()) {
+        auto current = pending.back();
+        pending.pop_back();
+        if (current == nullptr || current->frozen() || !visited.insert(current).second) {
+            continue;
+        }
+        // 异步读取的句柄只能由提交它的线程等待
+        if (typeid(*current) == typeid(Function) || typeid(*current) == typeid(AsyncRead)) {
+            return make<Error>(format("argument to `freeze` not supported, got {}", current->type()));
+        }
+        objects.push_back(current);
+        for_each_child(current, [&pending](const std::shared_ptr<Object>& child) {
+            pending.push_back(child.get());
+        });
+    }
+
+    for (auto current : objects) {
+        // 非 ASCII 字符串的码点索引是按需构建的，冻结前建好，之后多个线程只读
+        if (typeid(*current) == typeid(String)) {
+            current->cast<String>()->length();
+        }
+        current->_frozen = true;
+    }
+    if (!objects.empty()) {
+        std::lock_guard<std::mutex> lock(s_immortals_mutex);
+        s_immortals->push_back(obj);
+    }
+    return nullptr;
+}
+
+Closures::~Closures() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto fn = _head; fn != nullptr; fn = fn->_next) {
+        fn->_closures = nullptr;
+    }
+}
+
+void Closures::for_each(const std::function<void(const Function*)>& fn) const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto f = _tail; f != nullptr; f = f->_prev) {
+        fn(f);
+    }
+}
+
+void Closures::splice(Closures& other) {
+    std::scoped_lock lock(_mutex, other._mutex);
+    if (other._head == nullptr) {
+        return;
+    }
+    for (auto fn = other._head; fn != nullptr; fn = fn->_next) {
+        fn->_closures = this;
+    }
+    // other 中的闭包登记得更晚，放在链表头
+    other._tail->_next = _head;
+    if (_head != nullptr) {
+        _head->_prev = other._tail;
+    } else {
+        _tail = other._tail;
+    }
+    _head = other._head;
+    other._head = nullptr;
+    other._tail = nullptr;
+}
+
+Closures* Closures::current() {
+    return t_closures;
+}
+
+Closures::Scope::Scope(Closures* closures) : _previous(t_closures) {
+    t_closures = closures;
+}
+
+Closures::Scope::~Scope() {
+    t_closures = _previous;
+}
+
+void Closures::add(Function* fn) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    fn->_next = _head;
+    if (_head != nullptr) {
+        _head->_prev = fn;
+    } else {
+        _tail = fn;
+    }
+    _head = fn;
+}
+
+void Closures::remove(Function* fn) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (fn->_prev != nullptr) {
+        fn->_prev->_next = fn->_next;
+    } else {
+        _head = fn->_next;
+    }
+    if (fn->_next != nullptr) {
+        fn->_next->_prev = fn->_prev;
+    } else {
+        _tail = fn->_prev;
+    }
+}
+
+std::shared_ptr<String> String::make(std::string_view value) {
+    // 下标 0 是空串，1..128 是对应的 ASCII 字符
+    static const auto cache = [] {
+        auto table = new std::vector<std::shared_ptr<String>>();
+        table->push_back(std::make_shared<String>(std::string()));
+        for (int c = 0; c < 128; ++c) {
+            table->push_back(std::make_shared<String>(std::string(1, static_cast<char>(c))));
+        }
+        return table;
+    }();
+
+    if (value.empty()) {
+        return (*cache)[0];
+    }
+    if (value.size() == 1 && static_cast<unsigned char>(value[0]) < 128) {
+        return (*cache)[static_cast<unsigned char>(value[0]) + 1];
+    }
+    if (value.size() > SMALL_STRING_SIZE) {
+        return object::make<String>(std::string(value));
+    }
+
+    // 缓存中的对象总是分配在普通的堆上，不会钉住区域；只在本线程使用，不需要加锁
+    // 冻结后交给其他线程的也只是借用的引用
+    thread_local std::vector<std::shared_ptr<String>> t_small(SMALL_STRING_CACHE_SIZE);
+    size_t hashcode = std::hash<std::string_view>{}(value);
+    auto& slot = t_small[hashcode & (SMALL_STRING_CACHE_SIZE - 1)];
+    if (slot == nullptr || slot->_hash != hashcode || slot->_value != value) {
+        slot = std::make_shared<String>(std::string(value));
+    }
+    return slot;
+}
+
+std::shared_ptr<String> String::make(std::string&& value) {
+    if (value.size() <= SMALL_STRING_SIZE) {
+        return make(std::string_view(value));
+    }
+    return object::make<String>(std::move(value));
+}
+
+std::shared_ptr<String> String::slice(
+        const std::shared_ptr<const String>& str,
+        size_t begin,
+        size_t end) {
+    auto view = str->value().substr(begin, end - begin);
+
+    std::shared_ptr<const void> owner = str->_owner;
+    size_t pinned = str->_pinned;
+    bool string_owner = str->_string_owner;
+    if (owner == nullptr) {
+        owner = str;
+        pinned = str->_value.size();
+        string_owner = true;
+    }
+
+    if (view.size() <= SLICE_INLINE_SIZE || should_compact(view.size(), pinned)) {
+        return make(view);
+    }
+    auto ret = object::make<String>(owner, view.data(), view.size(), pinned, str->_ascii);
+    ret->_string_owner = string_owner;
+    return ret;
+}
+
+size_t String::length() const {
+    if (_ascii) {
+        return value().size();
+    }
+    build_index();
+    return _codepoints;
+}
+
+size_t String::offset(size_t codepoint) const {
+    if (_ascii) {
+        return codepoint;
+    }
+    build_index();
+
+    // 先通过索引定位到所在的块，再在块内向后扫描，最多扫描 INDEX_STRIDE 个码点
+    auto str = value();
+    size_t block = codepoint / utf8::INDEX_STRIDE;
+    if (block >= _index->size()) {
+        return str.size();
+    }
+    return utf8::advance(str, (*_index)[block], codepoint % utf8::INDEX_STRIDE);
+}
+
+void String::build_index() const {
+    if (_index != nullptr) {
+        return;
+    }
+    auto index = std::make_unique<std::vector<uint32_t>>();
+    _codepoints = utf8::build_index(value(), index.get());
+    _index = std::move(index);
+}
+
+void Array::assign(const std::shared_ptr<Object>* data, size_t size) {
+    if (size <= ARRAY_INLINE_SIZE) {
+        std::copy(data, data + size, _inline);
+        _inline_size = static_cast<uint8_t>(size);
+        return;
+    }
+    _elements.assign(data, data + size);
+    _spilled = true;
+}
+
+void Array::reserve(size_t size) {
+    if (_owner != nullptr) {
+        // 视图被写入时才拷贝出独立的元素
+        auto elems = elements();
+        Elements copy;
+        copy.reserve(std::max(size, elems.size()));
+        copy.assign(elems.begin(), elems.end());
+        _elements = std::move(copy);
+        _spilled = true;
+        _owner.reset();
+        _offset = 0;
+        _length = 0;
+        return;
+    }
+    if (!_spilled) {
+        if (size <= ARRAY_INLINE_SIZE) {
+            return;
+        }
+        _elements.reserve(std::max(size, 2 * ARRAY_INLINE_SIZE));
+        for (size_t i = 0; i < _inline_size; ++i) {
+            _elements.push_back(std::move(_inline[i]));
+        }
+        _inline_size = 0;
+        _spilled = true;
+        return;
+    }
+    _elements.reserve(size);
+}
+
+std::shared_ptr<Array> Array::slice(
+        const std::shared_ptr<const Array>& array,
+        size_t begin,
+        size_t end) {
+    auto root = array->_owner != nullptr ? array->_owner : array;
+    size_t offset = array->_offset + begin;
+    if (array->_owner == nullptr) {
+        offset = begin;
+    }
+
+    size_t length = end - begin;
+    // 短切片直接拷贝到对象内部，比视图更省
+    if (length <= ARRAY_INLINE_SIZE
+            || should_compact(length, root->elements().size())) {
+        auto elems = array->elements();
+        return object::make<Array>(Span<std::shared_ptr<Object>>(
+                elems.data() + begin, length));
+    }
+
+    auto ret = object::make<Array>();
+    ret->_owner = root;
+    ret->_offset = offset;
+    ret->_length = length;
+    return ret;
+}
+
+namespace {
+
+struct ShapeRegistry {
+    std::mutex mutex;
+    std::map<std::vector<std::string>, std::unique_ptr<Shape>> shapes;
 };
 
+// 函数内的静态变量，避免和其他全局对象的初始化顺序问题
+ShapeRegistry& shape_registry() {
+    static ShapeRegistry* registry = new ShapeRegistry;
+    return *registry;
+}
+
+}
+
+Shape::Shape(uint32_t id, const std::vector<std::string>& keys) : _id(id) {
+    _keys.reserve(keys.size());
+    _hashes.reserve(keys.size());
+    for (auto& key : keys) {
+        _keys.push_back(std::make_shared<String>(key));
+        _hashes.push_back(std::hash<std::string_view>{}(key));
+    }
+}
+
+const Shape* Shape::intern(const std::vector<std::string>& keys) {
+    auto& registry = shape_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto& shape = registry.shapes[keys];
+    if (shape == nullptr) {
+        shape.reset(new Shape(static_cast<uint32_t>(registry.shapes.size()), keys));
+    }
+    return shape.get();
+}
+
+const Shape* Shape::lookup(const std::vector<std::string>& keys) {
+    auto& registry = shape_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    auto it = registry.shapes.find(keys);
+    return it != registry.shapes.end() ? it->second.get() : nullptr;
+}
+
+size_t Shape::find(std::string_view key) const {
+    size_t hashcode = std::hash<std::string_view>{}(key);
+    for (size_t i = 0; i < _hashes.size(); ++i) {
+        if (_hashes[i] == hashcode && _keys[i]->cast<String>()->value() == key) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+size_t Shape::find_hash(size_t hashcode) const {
+    for (size_t i = 0; i < _hashes.size(); ++i) {
+        if (_hashes[i] == hashcode) {
+            return i;
+        }
+    }
+    return npos;
+}
+
+namespace {
+
+// 哈希值按有符号整数比较，整数键的哈希值就是它本身
+bool is_dense(int64_t lo, int64_t hi, size_t count) {
+    uint64_t span = static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo) + 1;
+    return span != 0 && span <= 2 * count;
+}
+
+}
+
+const std::shared_ptr<Object>* Hash::find(size_t hashcode) const {
+    switch (_storage) {
+    case SMALL:
+        for (auto& entry : _entries) {
+            if (entry.hash == hashcode) {
+                return &entry.pair.second;
+            }
+        }
+        break;
+    case DENSE:
+        {
+            size_t i = hashcode - _dense_base;
+            if (i < _entries.size() && _entries[i].pair.first != nullptr) {
+                return &_entries[i].pair.second;
+            }
+        }
+        break;
+    case SHAPED:
+        {
+            size_t slot = _shape->find_hash(hashcode);
+            if (slot != Shape::npos) {
+                return &_slots[slot];
+            }
+        }
+        break;
+    case MAP:
+        {
+            auto it = _pairs.find(hashcode);
+            if (it != _pairs.end()) {
+                return &it->second.second;
+            }
+        }
+        break;
+    }
+    return nullptr;
+}
+
+bool Hash::append(const std::shared_ptr<Object>& key, const std::shared_ptr<Object>& value) {
+    auto hasher = key->cast<Hasher>();
+    if (hasher == nullptr) {
+        return false;
+    }
+
+    size_t hashcode = hasher->hash();
+    if (find(hashcode) != nullptr) {
+        return true;
+    }
+
+    region::barrier(this, key.get());
+    region::barrier(this, value.get());
+    Pair pair(key, value);
+    if (_storage == SHAPED) {
+        // 键布局和 shape 不再一致
+        if (_slots.size() < SMALL_HASH_SIZE) {
+            to_small();
+        } else {
+            to_map();
+        }
+    }
+    if (_storage == SMALL) {
+        if (_entries.size() < SMALL_HASH_SIZE) {
+            _entries.push_back(Entry{hashcode, std::move(pair)});
+            return true;
+        }
+        if (!to_dense(hashcode, key.get())) {
+            to_map();
+        }
+    }
+    if (_storage == DENSE) {
+        if (insert_dense(hashcode, key.get(), std::move(pair))) {
+            return true;
+        }
+        to_map();
+    }
+    _pairs.emplace(hashcode, std::move(pair));
+    return true;
+}
+
+void Hash::to_small() {
+    _entries.reserve(_slots.size() + 1);
+    for (size_t i = 0; i < _slots.size(); ++i) {
+        _entries.push_back(Entry{_shape->hash(i), Pair(_shape->key(i), std::move(_slots[i]))});
+    }
+    _slots.clear();
+    _shape = nullptr;
+    _storage = SMALL;
+}
+
+bool Hash::to_dense(size_t hashcode, const Object* key) {
+    if (typeid(*key) != typeid(Integer)) {
+        return false;
+    }
+    int64_t lo = static_cast<int64_t>(hashcode);
+    int64_t hi = lo;
+    for (auto& entry : _entries) {
+        if (typeid(*entry.pair.first) != typeid(Integer)) {
+            return false;
+        }
+        lo = std::min(lo, static_cast<int64_t>(entry.hash));
+        hi = std::max(hi, static_cast<int64_t>(entry.hash));
+    }
+    if (!is_dense(lo, hi, _entries.size() + 1)) {
+        return false;
+    }
+
+    std::vector<Entry> dense(static_cast<uint64_t>(hi) - static_cast<uint64_t>(lo) + 1);
+    for (auto& entry : _entries) {
+        dense[entry.hash - static_cast<size_t>(lo)] = std::move(entry);
+    }
+    _dense_size = _entries.size();
+    _entries = std::move(dense);
+    _dense_base = static_cast<size_t>(lo);
+    _dense_lo = lo;
+    _dense_hi = hi;
+    _storage = DENSE;
+    return true;
+}
+
+bool Hash::insert_dense(size_t hashcode, const Object* key, Pair&& pair) {
+    if (typeid(*key) != typeid(Integer)) {
+        return false;
+    }
+    int64_t key_value = static_cast<int64_t>(hashcode);
+    int64_t lo = std::min(_dense_lo, key_value);
+    int64_t hi = std::max(_dense_hi, key_value);
+    if (!is_dense(lo, hi, _dense_size + 1)) {
+        return false;
+    }
+
+    if (key_value < static_cast<int64_t>(_dense_base)) {
+        // 和尾部的 resize 一样按倍数增长：头部多留出与现有长度相当的空位，
+        // 键递减地插入时均摊 O(1)
+        uint64_t need = static_cast<uint64_t>(_dense_base) - hashcode;
+        uint64_t room = hashcode - static_cast<uint64_t>(std::numeric_limits<int64_t>::min());
+        uint64_t slack = std::min<uint64_t>(std::max<uint64_t>(need, _entries.size()) - need, room);
+        std::vector<Entry> entries(need + slack + _entries.size());
+        std::move(_entries.begin(), _entries.end(), entries.begin() + need + slack);
+        _entries = std::move(entries);
+        _dense_base = hashcode - slack;
+    }
+    _dense_lo = lo;
+    _dense_hi = hi;
+    size_t i = hashcode - _dense_base;
+    if (i >= _entries.size()) {
+        _entries.resize(i + 1);
+    }
+    _entries[i] = Entry{hashcode, std::move(pair)};
+    ++_dense_size;
+    return true;
+}
+
+void Hash::to_map() {
+    if (_storage == SHAPED) {
+        for (size_t i = 0; i < _slots.size(); ++i) {
+            _pairs.emplace(_shape->hash(i), Pair(_shape->key(i), std::move(_slots[i])));
+        }
+        _slots.clear();
+        _shape = nullptr;
+    } else {
+        for (auto& entry : _entries) {
+            if (entry.pair.first != nullptr) {
+                _pairs.emplace(entry.hash, std::move(entry.pair));
+            }
+        }
+        _entries.clear();
+        _entries.shrink_to_fit();
+    }
+    _storage = MAP;
+}
+
+namespace {
+
+// 哈希值再混合一次，整数的 std::hash 是恒等映射，直接取低位容易聚集
+size_t mix(size_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+bool keys_equal(const Object* a, const Object* b) {
+    if (typeid(*a) != typeid(*b)) {
+        return false;
+    }
+    if (typeid(*a) == typeid(Integer)) {
+        return a->cast<Integer>()->value() == b->cast<Integer>()->value();
+    } else if (typeid(*a) == typeid(Boolean)) {
+        return a->cast<Boolean>()->value() == b->cast<Boolean>()->value();
+    } else if (typeid(*a) == typeid(String)) {
+        return a->cast<String>()->equals(*b->cast<String>());
+    }
+    return a == b;
+}
+
+std::string inspect_elements(const std::string& name, const std::vector<std::shared_ptr<Object>>& elems) {
+    std::string ret = name;
+    ret.append("([");
+    for (size_t i = 0; i < elems.size(); ++i) {
+        if (i != 0) {
+            ret.append(", ");
+        }
+        ret.append(elems[i]->inspect());
+    }
+    ret.append("])");
+    return ret;
+}
+
+}
+
+std::string Set::inspect() const {
+    return inspect_elements("set", elements());
+}
+
+long Set::find(const Object* key, size_t hash) const {
+    if (_slots.empty()) {
+        return -1;
+    }
+
+    size_t mask = _slots.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        auto& slot = _slots[i];
+        if (slot.key == nullptr && !slot.deleted) {
+            return -1;
+        }
+        if (slot.key != nullptr && slot.hash == hash && keys_equal(slot.key.get(), key)) {
+            return static_cast<long>(i);
+        }
+    }
+}
+
+bool Set::contains(const Object* key) const {
+    auto hasher = key->cast<Hasher>();
+    return hasher != nullptr && find(key, mix(hasher->hash())) >= 0;
+}
+
+bool Set::insert(const std::shared_ptr<Object>& key) {
+    auto hasher = key->cast<Hasher>();
+    if (hasher == nullptr) {
+        return false;
+    }
+
+    size_t hash = mix(hasher->hash());
+    if (find(key.get(), hash) >= 0) {
+        return false;
+    }
+    region::barrier(this, key.get());
+
+    // 包括墓碑在内的负载超过 3/4 时扩容，保证探测总能遇到空槽位
+    if ((_used + 1) * 4 > _slots.size() * 3) {
+        size_t capacity = 8;
+        while (capacity < (_size + 1) * 2) {
+            capacity *= 2;
+        }
+        rehash(capacity);
+    }
+
+    size_t mask = _slots.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        auto& slot = _slots[i];
+        if (slot.key == nullptr) {
+            if (!slot.deleted) {
+                ++_used;
+            }
+            slot.hash = hash;
+            slot.key = key;
+            slot.deleted = false;
+            ++_size;
+            return true;
+        }
+    }
+}
+
+bool Set::erase(const Object* key) {
+    auto hasher = key->cast<Hasher>();
+    if (hasher == nullptr) {
+        return false;
+    }
+
+    long i = find(key, mix(hasher->hash()));
+    if (i < 0) {
+        return false;
+    }
+    _slots[i].key.reset();
+    _slots[i].deleted = true;
+    --_size;
+    return true;
+}
+
+void Set::rehash(size_t capacity) {
+    std::vector<Slot> slots(capacity);
+    size_t mask = capacity - 1;
+    for (auto& slot : _slots) {
+        if (slot.key == nullptr) {
+            continue;
+        }
+        size_t i = slot.hash & mask;
+        while (slots[i].key != nullptr) {
+            i = (i + 1) & mask;
+        }
+        slots[i] = std::move(slot);
+    }
+    _slots.swap(slots);
+    _used = _size;
+}
+
+std::vector<std::shared_ptr<Object>> Set::elements() const {
+    std::vector<std::shared_ptr<Object>> ret;
+    ret.reserve(_size);
+    for (auto& slot : _slots) {
+        if (slot.key != nullptr) {
+            ret.push_back(slot.key);
+        }
+    }
+    return ret;
+}
+
+std::string Deque::inspect() const {
+    std::vector<std::shared_ptr<Object>> elems;
+    elems.reserve(_size);
+    for (size_t i = 0; i < _size; ++i) {
+        elems.push_back(at(i));
+    }
+    return inspect_elements("deque", elems);
+}
+
+void Deque::grow() {
+    std::vector<std::shared_ptr<Object>> buffer(std::max<size_t>(8, _buffer.size() * 2));
+    for (size_t i = 0; i < _size; ++i) {
+        buffer[i] = std::move(_buffer[(_head + i) & (_buffer.size() - 1)]);
+    }
+    _buffer.swap(buffer);
+    _head = 0;
+}
+
+void Deque::push_back(const std::shared_ptr<Object>& value) {
+    region::barrier(this, value.get());
+    if (_size == _buffer.size()) {
+        grow();
+    }
+    _buffer[(_head + _size) & (_buffer.size() - 1)] = value;
+    ++_size;
+}
+
+void Deque::push_front(const std::shared_ptr<Object>& value) {
+    region::barrier(this, value.get());
+    if (_size == _buffer.size()) {
+        grow();
+    }
+    _head = (_head - 1) & (_buffer.size() - 1);
+    _buffer[_head] = value;
+    ++_size;
+}
+
+std::shared_ptr<Object> Deque::pop_front() {
+    if (_size == 0) {
+        return constants::Null;
+    }
+    auto ret = std::move(_buffer[_head]);
+    _head = (_head + 1) & (_buffer.size() - 1);
+    --_size;
+    return ret;
+}
+
+std::shared_ptr<Object> Deque::pop_back() {
+    if (_size == 0) {
+        return constants::Null;
+    }
+    --_size;
+    return std::move(_buffer[(_head + _size) & (_buffer.size() - 1)]);
+}
+
+namespace {
+
+// 十进制位数，含负号
+size_t decimal_size(int64_t value) {
+    uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : value;
+    size_t n = value < 0 ? 2 : 1;
+    while (magnitude >= 10) {
+        magnitude /= 10;
+        ++n;
+    }
+    return n;
+}
+
+} // namespace
+
+void StringBuilder::append(std::string_view text) {
+    if (text.empty()) {
+        return;
+    }
+    _pieces.push_back({text});
+    _size += text.size();
+}
+
+void StringBuilder::append(const Object* value) {
+    auto& type = typeid(*value);
+    if (type == typeid(String)) {
+        append(value->cast<String>()->value());
+    } else if (type == typeid(Integer)) {
+        int64_t integer = value->cast<Integer>()->value();
+        _pieces.push_back({std::string_view(), integer, true});
+        _size += decimal_size(integer);
+    } else if (type == typeid(Boolean)) {
+        append(value->cast<Boolean>()->value() ? "true" : "false");
+    } else if (type == typeid(Null)) {
+        append("null");
+    } else {
+        _owned.emplace_back(new std::string(value->inspect()));
+        append(*_owned.back());
+    }
+}
+
+std::string StringBuilder::build() const {
+    std::string ret(_size, '\0');
+    char* p = ret.data();
+    char* end = p + _size;
+    for (auto& piece : _pieces) {
+        if (piece.is_integer) {
+            p = std::to_chars(p, end, piece.integer).ptr;
+        } else {
+            memcpy(p, piece.text.data(), piece.text.size());
+            p += piece.text.size();
+        }
+    }
+    return ret;
+}
+
+std::string PriorityQueue::inspect() const {
+    return format("priority_queue(size: {})", _heap.size());
+}
+
+bool PriorityQueue::before(
+        const std::shared_ptr<Object>& a,
+        const std::shared_ptr<Object>& b,
+        const Caller& caller,
+        std::shared_ptr<Object>* error) const {
+    if (_comparator != nullptr) {
+        std::vector<std::shared_ptr<Object>> args = { a, b };
+        auto ret = caller.call(_comparator.get(), args);
+        if (ret != nullptr && typeid(*ret) == typeid(Error)) {
+            *error = ret;
+            return false;
+        }
+        return ret != nullptr && ret != constants::Null && ret != constants::False;
+    }
+
+    if (typeid(*a) == typeid(Integer) && typeid(*b) == typeid(Integer)) {
+        return a->cast<Integer>()->value() < b->cast<Integer>()->value();
+    } else if (typeid(*a) == typeid(String) && typeid(*b) == typeid(String)) {
+        return a->cast<String>()->value() < b->cast<String>()->value();
+    }
+    *error = object::make<Error>(format("priority_queue: cannot compare {} and {}",
+            a->type(), b->type()));
+    return false;
+}
+
+std::shared_ptr<Object> PriorityQueue::reentered() const {
+    return object::make<Error>("priority_queue: modified by its own comparator");
+}
+
+// 比较出错时立即返回，元素留在队列中，但堆序可能被破坏
+std::shared_ptr<Object> PriorityQueue::push(const std::shared_ptr<Object>& value, const Caller& caller) {
+    if (_busy) {
+        return reentered();
+    }
+    _busy = true;
+    Defer done([this]() { _busy = false; });
+    std::shared_ptr<Object> error;
+    region::barrier(this, value.get());
+    _heap.push_back(value);
+    size_t i = _heap.size() - 1;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        bool up = before(_heap[i], _heap[parent], caller, &error);
+        if (error != nullptr) {
+            return error;
+        }
+        if (!up) {
+            break;
+        }
+        std::swap(_heap[i], _heap[parent]);
+        i = parent;
+    }
+    return nullptr;
+}
+
+std::shared_ptr<Object> PriorityQueue::pop(const Caller& caller, std::shared_ptr<Object>* out) {
+    if (_busy) {
+        return reentered();
+    }
+    if (_heap.empty()) {
+        *out = constants::Null;
+        return nullptr;
+    }
+
+    _busy = true;
+    Defer done([this]() { _busy = false; });
+    *out = std::move(_heap.front());
+    _heap.front() = std::move(_heap.back());
+    _heap.pop_back();
+
+    std::shared_ptr<Object> error;
+    size_t n = _heap.size();
+    size_t i = 0;
+    while (true) {
+        size_t best = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < n && before(_heap[left], _heap[best], caller, &error)) {
+            best = left;
+        }
+        if (right < n && error == nullptr && before(_heap[right], _heap[best], caller, &error)) {
+            best = right;
+        }
+        if (error != nullptr) {
+            return error;
+        }
+        if (best == i) {
+            break;
+        }
+        std::swap(_heap[i], _heap[best]);
+        i = best;
+    }
+    return nullptr;
+}
+
+namespace {
+
+// 第 row 行的值，短字符串拷贝，长字符串引用映射的内存
+std::shared_ptr<Object> decode_cell(
+        const std::shared_ptr<const table::Mapping>& mapping,
+        size_t column,
+        size_t row) {
+    auto& c = mapping->columns()[column];
+    if (c.type == table::INT64) {
+        return object::make<Integer>(mapping->integers(column)[row]);
+    }
+    std::string_view str;
+    if (!mapping->string(column, row, &str)) {
+        return object::make<Error>(format("table: corrupt string in column `{}` at row {}", c.name, row));
+    }
+    if (str.size() <= SLICE_INLINE_SIZE) {
+        return String::make(str);
+    }
+    return object::make<String>(mapping, str.data(), str.size(), str.size(), utf8::is_ascii(str));
+}
+
+} // namespace
+
+std::string Table::inspect() const {
+    std::string names;
+    for (auto& c : _mapping->columns()) {
+        if (!names.empty()) {
+            names += ", ";
+        }
+        names += c.name;
+    }
+    return format("table(rows: {}, columns: [{}])", _mapping->rows(), names);
+}
+
+std::shared_ptr<Object> Table::column(std::string_view name) const {
+    int i = _mapping->find(name);
+    if (i < 0) {
+        return constants::Null;
+    }
+    return object::make<Column>(_mapping, i, 0, _mapping->rows());
+}
+
+std::shared_ptr<Object> Table::row(size_t row) const {
+    auto& columns = _mapping->columns();
+    std::vector<std::shared_ptr<Object>> values;
+    values.reserve(columns.size());
+    for (size_t i = 0; i < columns.size(); ++i) {
+        auto value = decode_cell(_mapping, i, row);
+        if (typeid(*value) == typeid(Error)) {
+            return value;
+        }
+        values.push_back(std::move(value));
+    }
+    if (_mapping->shape() != nullptr) {
+        return object::make<Hash>(_mapping->shape(), std::move(values));
+    }
+    // 有重复列名时与 table["列名"] 一致，取前面的列
+    auto hash = object::make<Hash>();
+    for (size_t i = 0; i < columns.size(); ++i) {
+        hash->append(String::make(columns[i].name), values[i]);
+    }
+    return hash;
+}
+
+std::string Column::inspect() const {
+    return format("column({}, size: {})", _mapping->columns()[_column].name, _size);
+}
+
+std::shared_ptr<Object> Column::at(size_t i) const {
+    return decode_cell(_mapping, _column, _begin + i);
+}
+
+std::string AsyncRead::inspect() const {
+    return format("read_async({}, {})", _request->path(), _request->done() ? "done" : "pending");
+}
+
+std::shared_ptr<Object> AsyncRead::result() const {
+    if (_request->error() != 0) {
+        return make<Error>(format("cannot read {}: {}", _request->path(), strerror(_request->error())));
+    }
+    auto& data = _request->data();
+    if (data.size() <= SLICE_INLINE_SIZE) {
+        return String::make(data);
+    }
+    return make<String>(_request, data.data(), data.size(), data.size(), utf8::is_ascii(data));
+}
+
 std::ostream& operator<<(std::ostream& out, const Type& type) {
     auto it = type._type_to_name.find(type._type);
     if (it != type._type_to_name.end()) {
@@ -0,0 +1,335 @@
+#include "optimizer.h"
+
+#include "evaluator.h"
+
+namespace autumn {
+
+namespace {
+
+// 没有副作用的内置函数
+const std::unordered_set<std::string> PURE_BUILTINS = {
+    "len", "first", "last", "push", "rest",
+};
+
+bool is_constant(const ast::Expression* exp) {
+    if (typeid(*exp) == typeid(ast::IntegerLiteral)
+            || typeid(*exp) == typeid(ast::StringLiteral)
+            || typeid(*exp) == typeid(ast::BooleanLiteral)) {
+        return true;
+    }
+    if (typeid(*exp) == typeid(ast::PrefixExpression)) {
+        auto n = exp->cast<ast::PrefixExpression>();
+        return n->op() == "-"
+            && n->right() != nullptr
+            && typeid(*n->right()) == typeid(ast::IntegerLiteral);
+    }
+    return false;
+}
+
+}
+
+Optimizer::Optimizer(const object::Environment* globals) :
+    _globals(globals) {
+}
+
+Optimizer::~Optimizer() {
+    if (_evaluator != nullptr) {
+        // 纯函数的闭包捕获了全局环境，清空后才能释放
+        _evaluator->_env->clear();
+    }
+}
+
+void Optimizer::walk(
+        ast::Node* node,
+        const StatmentVisitor& on_statment,
+        const ExpressionVisitor& on_expression) {
+    if (node == nullptr) {
+        return;
+    }
+
+    auto visit = [&](std::unique_ptr<ast::Expression>& slot) {
+        if (slot != nullptr) {
+            on_expression(slot);
+        }
+    };
+    auto visit_statments = [&](std::vector<std::unique_ptr<ast::Statment>>& statments) {
+        for (auto& stmt : statments) {
+            if (stmt == nullptr) {
+                continue;
+            }
+            on_statment(stmt.get());
+            walk(stmt.get(), on_statment, on_expression);
+        }
+    };
+
+    if (typeid(*node) == typeid(ast::Program)) {
+        visit_statments(static_cast<ast::Program*>(node)->_statments);
+    } else if (typeid(*node) == typeid(ast::BlockStatment)) {
+        visit_statments(static_cast<ast::BlockStatment*>(node)->_statments);
+    } else if (typeid(*node) == typeid(ast::LetStatment)) {
+        visit(static_cast<ast::LetStatment*>(node)->_expression);
+    } else if (typeid(*node) == typeid(ast::ReturnStatment)) {
+        visit(static_cast<ast::ReturnStatment*>(node)->_expression);
+    } else if (typeid(*node) == typeid(ast::ExpressionStatment)) {
+        visit(static_cast<ast::ExpressionStatment*>(node)->_expression);
+    } else if (typeid(*node) == typeid(ast::PrefixExpression)) {
+        visit(static_cast<ast::PrefixExpression*>(node)->_right);
+    } else if (typeid(*node) == typeid(ast::InfixExpression)) {
+        auto n = static_cast<ast::InfixExpression*>(node);
+        visit(n->_left);
+        visit(n->_right);
+    } else if (typeid(*node) == typeid(ast::ConcatExpression)) {
+        for (auto& operand : static_cast<ast::ConcatExpression*>(node)->_operands) {
+            visit(operand);
+        }
+    } else if (typeid(*node) == typeid(ast::InterpolatedString)) {
+        for (auto& exp : static_cast<ast::InterpolatedString*>(node)->_expressions) {
+            visit(exp);
+        }
+    } else if (typeid(*node) == typeid(ast::IfExpression)) {
+        auto n = static_cast<ast::IfExpression*>(node);
+        visit(n->_condition);
+        walk(n->_consequence.get(), on_statment, on_expression);
+        walk(n->_alternative.get(), on_statment, on_expression);
+    } else if (typeid(*node) == typeid(ast::FunctionLiteral)) {
+        walk(static_cast<ast::FunctionLiteral*>(node)->_prototype->body.get(),
+                on_statment, on_expression);
+    } else if (typeid(*node) == typeid(ast::CallExpression)) {
+        auto n = static_cast<ast::CallExpression*>(node);
+        visit(n->_function);
+        for (auto& arg : n->_arguments) {
+            visit(arg);
+        }
+    } else if (typeid(*node) == typeid(ast::IndexExpression)) {
+        auto n = static_cast<ast::IndexExpression*>(node);
+        visit(n->_left);
+        visit(n->_index);
+    } else if (typeid(*node) == typeid(ast::SliceExpression)) {
+        auto n = static_cast<ast::SliceExpression*>(node);
+        visit(n->_left);
+        visit(n->_start);
+        visit(n->_end);
+    } else if (typeid(*node) == typeid(ast::ArrayLiteral)) {
+        for (auto& elem : static_cast<ast::ArrayLiteral*>(node)->_elements) {
+            visit(elem);
+        }
+    } else if (typeid(*node) == typeid(ast::HashLiteral)) {
+        for (auto& pair : static_cast<ast::HashLiteral*>(node)->_pairs) {
+            visit(pair.first);
+            visit(pair.second);
+        }
+    }
+}
+
+void Optimizer::optimize(ast::Program* program) {
+    if (program == nullptr) {
+        return;
+    }
+
+    analyze(program);
+    infer_purity();
+    if (_pure.empty()) {
+        return;
+    }
+
+    std::unordered_set<std::string> visiting;
+    for (auto& item : _pure) {
+        item.second.last_definition = last_definition(item.first, visiting);
+    }
+
+    walk(program,
+            [](ast::Statment*) {},
+            [this](std::unique_ptr<ast::Expression>& slot) { fold(slot); });
+}
+
+void Optimizer::analyze(ast::Program* program) {
+    // 统计所有 let 绑定和参数名，被重复绑定或遮蔽的名字不作为纯函数
+    std::vector<const ast::FunctionLiteral*> enclosing;
+    std::unordered_set<const ast::FunctionLiteral*> imports;
+
+    StatmentVisitor on_statment = [this](ast::Statment* stmt) {
+        if (typeid(*stmt) == typeid(ast::LetStatment)) {
+            ++_let_counts[stmt->cast<ast::LetStatment>()->identifier()->value()];
+        }
+    };
+    ExpressionVisitor on_expression = [&](std::unique_ptr<ast::Expression>& slot) {
+        auto exp = slot.get();
+        if (typeid(*exp) == typeid(ast::FunctionLiteral)) {
+            auto literal = exp->cast<ast::FunctionLiteral>();
+            for (auto& param : literal->parameters()) {
+                _parameters.insert(param->value());
+            }
+            enclosing.push_back(literal);
+            walk(exp, on_statment, on_expression);
+            enclosing.pop_back();
+            return;
+        }
+        if (typeid(*exp) == typeid(ast::ImportExpression)) {
+            // 包含 import 的函数以及包围它的函数都不是纯函数
+            imports.insert(enclosing.begin(), enclosing.end());
+        }
+        walk(exp, on_statment, on_expression);
+    };
+    walk(program, on_statment, on_expression);
+
+    for (auto& stmt : program->statments()) {
+        if (stmt == nullptr || typeid(*stmt) != typeid(ast::LetStatment)) {
+            continue;
+        }
+        auto let = stmt->cast<ast::LetStatment>();
+        auto exp = let->expression();
+        if (exp == nullptr || typeid(*exp) != typeid(ast::FunctionLiteral)) {
+            continue;
+        }
+        auto literal = exp->cast<ast::FunctionLiteral>();
+        auto& name = let->identifier()->value();
+        if (_let_counts[name] != 1
+                || _parameters.count(name) != 0
+                || imports.count(literal) != 0) {
+            continue;
+        }
+        _pure[name] = Candidate{ let, literal };
+    }
+}
+
+void Optimizer::infer_purity() {
+    // 先假设所有候选都是纯函数，反复剔除引用了非纯名字的函数直到不再变化
+    // 这样相互递归的纯函数也能被识别
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto it = _pure.begin(); it != _pure.end(); ) {
+            bool pure = true;
+            for (auto& name : it->second.literal->prototype()->free_variables) {
+                if (_pure.count(name) != 0) {
+                    continue;
+                }
+                if (is_builtin(name)) {
+                    continue;
+                }
+                pure = false;
+                break;
+            }
+            if (pure) {
+                ++it;
+            } else {
+                it = _pure.erase(it);
+                changed = true;
+            }
+        }
+    }
+}
+
+bool Optimizer::is_builtin(const std::string& name) const {
+    return PURE_BUILTINS.count(name) != 0
+        && _let_counts.count(name) == 0
+        && _parameters.count(name) == 0
+        && (_globals == nullptr || _globals->get(name) == nullptr);
+}
+
+std::vector<std::string> Optimizer::builtins() const {
+    std::unordered_set<std::string> names;
+    for (auto& item : _pure) {
+        for (auto& name : item.second.literal->prototype()->free_variables) {
+            if (_pure.count(name) == 0) {
+                names.insert(name);
+            }
+        }
+    }
+    return std::vector<std::string>(names.begin(), names.end());
+}
+
+uint32_t Optimizer::last_definition(
+        const std::string& name,
+        std::unordered_set<std::string>& visiting) {
+    auto& candidate = _pure[name];
+    if (candidate.last_definition != 0 || !visiting.insert(name).second) {
+        return candidate.last_definition;
+    }
+
+    // 语句节点先于其子节点创建，编号顺序就是源码顺序
+    uint32_t last = candidate.let->id();
+    for (auto& free : candidate.literal->prototype()->free_variables) {
+        if (_pure.count(free) != 0) {
+            last = std::max(last, last_definition(free, visiting));
+        }
+    }
+    visiting.erase(name);
+    candidate.last_definition = last;
+    return last;
+}
+
+void Optimizer::fold(std::unique_ptr<ast::Expression>& slot) {
+    // 先处理子表达式，参数中的调用可以先被替换为常量
+    walk(slot.get(),
+            [](ast::Statment*) {},
+            [this](std::unique_ptr<ast::Expression>& child) { fold(child); });
+
+    if (typeid(*slot) != typeid(ast::CallExpression)) {
+        return;
+    }
+    auto call = slot->cast<ast::CallExpression>();
+    auto function = call->function();
+    if (function == nullptr || typeid(*function) != typeid(ast::Identifier)) {
+        return;
+    }
+    auto it = _pure.find(function->cast<ast::Identifier>()->value());
+    if (it == _pure.end()) {
+        return;
+    }
+    // 调用点在定义之前时，运行时会报错，保持原样
+    if (call->id() <= it->second.last_definition) {
+        return;
+    }
+    for (auto& arg : call->arguments()) {
+        if (arg == nullptr || !is_constant(arg.get())) {
+            return;
+        }
+    }
+
+    auto literal = evaluate(call);
+    if (literal != nullptr) {
+        slot = std::move(literal);
+        ++_folded;
+    }
+}
+
+std::unique_ptr<ast::Expression> Optimizer::evaluate(const ast::CallExpression* call) {
+    if (_evaluator == nullptr) {
+        _evaluator.reset(new Evaluator());
+        _evaluator->_step_limit = STEP_BUDGET;
+        _evaluator->_call_limit = CALL_DEPTH;
+        for (auto& item : _pure) {
+            std::shared_ptr<object::Object> fn = std::make_shared<object::Function>(
+                    item.second.literal->prototype(), _evaluator->_env);
+            _evaluator->_env->set(item.first, fn);
+        }
+    }
+
+    _evaluator->_steps = 0;
+    _evaluator->_calls = 0;
+    auto result = _evaluator->eval(call, _evaluator->_env);
+    if (result == nullptr) {
+        return nullptr;
+    }
+
+    Token token;
+    token.line = call->line();
+    if (typeid(*result) == typeid(object::Integer)) {
+        token.type = Token::INT;
+        token.literal = std::to_string(result->cast<object::Integer>()->value());
+        return std::unique_ptr<ast::Expression>(new ast::IntegerLiteral(token));
+    } else if (typeid(*result) == typeid(object::String)) {
+        token.type = Token::STRING;
+        token.literal = std::string(result->cast<object::String>()->value());
+        return std::unique_ptr<ast::Expression>(new ast::StringLiteral(token));
+    } else if (typeid(*result) == typeid(object::Boolean)) {
+        bool value = result == object::constants::True;
+        token.type = value ? Token::TRUE : Token::FALSE;
+        token.literal = value ? "true" : "false";
+        return std::unique_ptr<ast::Expression>(new ast::BooleanLiteral(token));
+    }
+    return nullptr;
+}
+
+} // namespace autumn
@@ -1,7 +1,10 @@
 #include "parser.h"
 
 #include <unordered_map>
+#include <unordered_set>
 #include "defer.h"
+#include "perf_counters.h"
+#include "timeline.h"
 
 namespace autumn {
 
@@ -23,9 +26,134 @@ const std::unordered_map<Token::Type, Parser::Precedence> PRECEDENCES = {
     {Token::LBRACKET, Parser::Precedence::INDEX},
 };
 
+// 函数作用域分析，收集函数内绑定的名字和引用的名字
+// 嵌套函数在外层之前解析完成，直接使用它的自由变量，不再进入它的函数体
+class ScopeCollector {
+public:
+    void bind(const std::string& name) {
+        _bound.insert(name);
+    }
+
+    void collect(const ast::Node* node) {
+        if (node == nullptr) {
+            return;
+        }
+
+        if (typeid(*node) == typeid(ast::Identifier)) {
+            reference(node->cast<ast::Identifier>()->value());
+        } else if (typeid(*node) == typeid(ast::PrefixExpression)) {
+            collect(node->cast<ast::PrefixExpression>()->right());
+        } else if (typeid(*node) == typeid(ast::InfixExpression)) {
+            auto n = node->cast<ast::InfixExpression>();
+            collect(n->left());
+            collect(n->right());
+        } else if (typeid(*node) == typeid(ast::ConcatExpression)) {
+            for (auto& operand : node->cast<ast::ConcatExpression>()->operands()) {
+                collect(operand.get());
+            }
+        } else if (typeid(*node) == typeid(ast::InterpolatedString)) {
+            for (auto& exp : node->cast<ast::InterpolatedString>()->expressions()) {
+                collect(exp.get());
+            }
+        } else if (typeid(*node) == typeid(ast::IfExpression)) {
+            auto n = node->cast<ast::IfExpression>();
+            collect(n->condition());
+            collect(n->consequence());
+            collect(n->alternative());
+        } else if (typeid(*node) == typeid(ast::BlockStatment)) {
+            for (auto& stmt : node->cast<ast::BlockStatment>()->statments()) {
+                collect(stmt.get());
+            }
+        } else if (typeid(*node) == typeid(ast::LetStatment)) {
+            auto n = node->cast<ast::LetStatment>();
+            bind(n->identifier()->value());
+            collect(n->expression());
+        } else if (typeid(*node) == typeid(ast::ReturnStatment)) {
+            collect(node->cast<ast::ReturnStatment>()->expression());
+        } else if (typeid(*node) == typeid(ast::ExpressionStatment)) {
+            collect(node->cast<ast::ExpressionStatment>()->expression());
+        } else if (typeid(*node) == typeid(ast::CallExpression)) {
+            auto n = node->cast<ast::CallExpression>();
+            collect(n->function());
+            for (auto& arg : n->arguments()) {
+                collect(arg.get());
+            }
+        } else if (typeid(*node) == typeid(ast::IndexExpression)) {
+            auto n = node->cast<ast::IndexExpression>();
+            collect(n->left());
+            collect(n->index());
+        } else if (typeid(*node) == typeid(ast::SliceExpression)) {
+            auto n = node->cast<ast::SliceExpression>();
+            collect(n->left());
+            collect(n->start());
+            collect(n->end());
+        } else if (typeid(*node) == typeid(ast::ArrayLiteral)) {
+            for (auto& elem : node->cast<ast::ArrayLiteral>()->elements()) {
+                collect(elem.get());
+            }
+        } else if (typeid(*node) == typeid(ast::HashLiteral)) {
+            for (auto& pair : node->cast<ast::HashLiteral>()->pairs()) {
+                collect(pair.first.get());
+                collect(pair.second.get());
+            }
+        } else if (typeid(*node) == typeid(ast::FunctionLiteral)) {
+            for (auto& name : node->cast<ast::FunctionLiteral>()->prototype()->free_variables) {
+                reference(name);
+            }
+        }
+    }
+
+    size_t local_count() const {
+        return _bound.size();
+    }
+
+    std::vector<std::string> free_variables() const {
+        std::vector<std::string> ret;
+        for (auto& name : _referenced) {
+            if (_bound.find(name) == _bound.end()) {
+                ret.push_back(name);
+            }
+        }
+        return ret;
+    }
+private:
+    void reference(const std::string& name) {
+        if (_seen.insert(name).second) {
+            _referenced.push_back(name);
+        }
+    }
+private:
+    std::unordered_set<std::string> _bound;
+    std::unordered_set<std::string> _seen;
+    std::vector<std::string> _referenced;
+};
+
 }
 
+// 进入一层表达式或代码块，离开时恢复
+class Parser::Nesting {
+public:
+    Nesting(Parser* parser) : _parser(parser) {
+        ++_parser->_depth;
+    }
+
+    ~Nesting() {
+        --_parser->_depth;
+    }
+
+    bool too_deep() const {
+        return _parser->_depth > _parser->_max_depth;
+    }
+private:
+    Parser* _parser;
+};
+
 Parser::Parser() {
+    const char* max_depth = getenv("AUTUMN_MAX_DEPTH");
+    if (max_depth != nullptr && atoll(max_depth) > 0) {
+        _max_depth = atoll(max_depth);
+    }
+
     using namespace std::placeholders;
     // 注册前缀解析函数
     _prefix_parse_funcs[Token::IDENT] = std::bind(&Parser::parse_identifier, this);
@@ -40,6 +168,7 @@ Parser::Parser() {
     _prefix_parse_funcs[Token::IF] = std::bind(&Parser::parse_if_expression, this);
     _prefix_parse_funcs[Token::LBRACKET] = std::bind(&Parser::parse_array_literal, this);
     _prefix_parse_funcs[Token::LBRACE] = std::bind(&Parser::parse_hash_literal, this);
+    _prefix_parse_funcs[Token::IMPORT] = std::bind(&Parser::parse_import_expression, this);
 
     // 注册中缀解析函数
     _infix_parse_funcs[Token::PLUS] = std::bind(&Parser::parse_infix_expression, this, _1);
@@ -62,15 +191,50 @@ const std::vector<std::string>& Parser::errors() const {
 }
 
 std::unique_ptr<ast::Program> Parser::parse(const std::string& input) {
+    timeline::Span span("parse", "Parser::parse");
+    perf_counters::Scope counters("parse");
     Lexer lexer(input);
-    _lexer = &lexer;
+    reset(&lexer);
+
+    auto program = parse();
+    // 嵌套过深时只剩残缺的语法树，不再返回
+    if (_aborted) {
+        return nullptr;
+    }
+    return program;
+}
+
+void Parser::parse_statments(const std::string& input, size_t offset, const StatmentCallback& callback) {
+    perf_counters::Scope counters("parse");
+    Lexer lexer(input, offset);
+    reset(&lexer);
+
+    while (!current_token_is(Token::END)) {
+        size_t begin = _current_token.offset;
+        size_t error_count = _errors.size();
+        auto stmt = parse_statment();
+        next_token();
+        size_t end = current_token_is(Token::END) ? input.size() : _current_token.offset;
+        std::vector<std::string> errors(_errors.begin() + error_count, _errors.end());
+        if (_aborted) {
+            stmt.reset();
+        }
+        if (!callback(std::move(stmt), begin, end, std::move(errors))) {
+            break;
+        }
+    }
+    _lexer = nullptr;
+}
+
+void Parser::reset(Lexer* lexer) {
+    _lexer = lexer;
     _errors.clear();
     _tracer.reset();
+    _depth = 0;
+    _aborted = false;
 
     next_token();
     next_token();
-
-    return parse();
 }
 
 std::unique_ptr<ast::Program> Parser::parse() {
@@ -92,6 +256,25 @@ void Parser::next_token() {
     _peek_token = _lexer->next_token();
 }
 
+void Parser::add_error(std::string error) {
+    if (!_aborted) {
+        _errors.push_back(std::move(error));
+    }
+}
+
+void Parser::abort_too_deep() {
+    if (_aborted) {
+        return;
+    }
+    add_error(format("nesting too deep: more than {} levels at line {}",
+                _max_depth,
+                _current_token.line));
+    _aborted = true;
+    while (!current_token_is(Token::END)) {
+        next_token();
+    }
+}
+
 void Parser::peek_error(Token::Type type) {
     std::string error = "expected next token to be \x1b[1m`"
         + Token::to_string(type) 
@@ -100,7 +283,7 @@ void Parser::peek_error(Token::Type type) {
         + "\x1b[0m` instead at literal \x1b[1m`"
         + _peek_token.literal
         + "`\x1b[0m";
-    _errors.push_back(std::move(error));
+    add_error(std::move(error));
 }
 
 bool Parser::expect_peek(Token::Type type) {
@@ -172,6 +355,9 @@ std::unique_ptr<ast::Statment> Parser::parse_let_statment() {
     next_token();
     // 表达式解析部分
     auto exp = parse_expression(Precedence::LOWEST);
+    if (exp != nullptr && typeid(*exp) == typeid(ast::FunctionLiteral)) {
+        exp->cast<ast::FunctionLiteral>()->set_name(stmt->identifier()->value());
+    }
     stmt->set_expression(exp.release());
 
     if (peek_token_is(Token::SEMICOLON)) {
@@ -212,13 +398,30 @@ std::unique_ptr<ast::Statment> Parser::parse_expression_statment() {
 
 std::unique_ptr<ast::Expression> Parser::parse_expression(Precedence precedence) {
     Defer defer(_tracer.trace(__FUNCTION__, _current_token.literal));
+    Nesting nesting(this);
+    if (nesting.too_deep()) {
+        abort_too_deep();
+        return nullptr;
+    }
     auto prefix = _prefix_parse_funcs.find(_current_token.type);
     if (prefix == _prefix_parse_funcs.end()) {
-        _errors.push_back("no prefix parse function found for `" + _current_token.literal + "`");
+        auto& literal = _current_token.literal;
+        // 词法分析把没有结尾引号的字符串连同开头的引号作为非法 token
+        if (_current_token.type == Token::ILLEGAL && !literal.empty() && literal[0] == '"') {
+            add_error(format("unterminated {} at line {}",
+                    Lexer::in_interpolation(std::string_view(literal).substr(1))
+                        ? "string interpolation" : "string literal",
+                    _current_token.line));
+            return nullptr;
+        }
+        add_error("no prefix parse function found for `" + literal + "`");
         return nullptr;
     }
 
     auto left = prefix->second();
+    // 左结合的运算符链每多一个节点树就深一层，同样计入嵌套层数，+ 链展平后不会变深
+    size_t chain = 0;
+    Defer unwind([this, &chain]() { _depth -= chain; });
 
     // precedence 描述的是向右结合的能力。如果 precedence 是当前最高的，到目前所
     // 收集到的 left_exp 就不会被传递给 infix_parse_func
@@ -234,6 +437,13 @@ std::unique_ptr<ast::Expression> Parser::parse_expression(Precedence precedence)
         // infix_parse_func 内部会递进 token
         auto exp = infix->second(left.release());
         left.swap(exp);
+        if (left != nullptr && typeid(*left) != typeid(ast::ConcatExpression)) {
+            ++chain;
+            if (++_depth > _max_depth) {
+                abort_too_deep();
+                return nullptr;
+            }
+        }
     }
 
     return left;
@@ -303,9 +513,69 @@ std::unique_ptr<ast::Expression> Parser::parse_hash_literal() {
 
 std::unique_ptr<ast::Expression> Parser::parse_string_literal() {
     Defer defer(_tracer.trace(__FUNCTION__, _current_token.literal));
+    auto& literal = _current_token.literal;
+    if (Lexer::interpolation_begin(literal, 0) != std::string::npos) {
+        return parse_interpolated_string();
+    }
+    if (literal.find("\\$") != std::string::npos) {
+        return std::unique_ptr<ast::Expression>(new ast::StringLiteral(_current_token, Lexer::unescape(literal)));
+    }
     return std::unique_ptr<ast::Expression>(new ast::StringLiteral(_current_token));
 }
 
+std::unique_ptr<ast::Expression> Parser::parse_interpolated_string() {
+    Token token = _current_token;
+    auto& text = token.literal;
+    std::unique_ptr<ast::InterpolatedString> interpolated(new ast::InterpolatedString(token));
+
+    size_t pos = 0;
+    while (true) {
+        size_t begin = Lexer::interpolation_begin(text, pos);
+        if (begin == std::string::npos) {
+            interpolated->append_literal(Lexer::unescape(std::string_view(text).substr(pos)));
+            break;
+        }
+        interpolated->append_literal(Lexer::unescape(std::string_view(text).substr(pos, begin - pos)));
+        // 词法分析已经保证每个 ${ 都有匹配的 }
+        size_t end = Lexer::interpolation_end(text, begin + 2);
+        auto exp = parse_interpolation(text.substr(begin + 2, end - begin - 2), token.line);
+        if (exp == nullptr) {
+            return nullptr;
+        }
+        interpolated->append_expression(exp.release());
+        pos = end + 1;
+    }
+    return interpolated;
+}
+
+std::unique_ptr<ast::Expression> Parser::parse_interpolation(const std::string& source, int line) {
+    if (source.find_first_not_of(" \t\r\n") == std::string::npos) {
+        add_error(format("empty interpolation in string literal at line {}", line));
+        return nullptr;
+    }
+
+    // 临时切换到子串的词法分析器，解析完成后恢复
+    Lexer lexer(source);
+    lexer.set_line(line);
+    auto saved_lexer = _lexer;
+    auto saved_current = _current_token;
+    auto saved_peek = _peek_token;
+    _lexer = &lexer;
+    next_token();
+    next_token();
+
+    auto exp = parse_expression(Precedence::LOWEST);
+    if (exp != nullptr && !peek_token_is(Token::END)) {
+        add_error(format("unexpected `{}` in string interpolation at line {}", _peek_token.literal, line));
+        exp.reset();
+    }
+
+    _lexer = saved_lexer;
+    _current_token = saved_current;
+    _peek_token = saved_peek;
+    return exp;
+}
+
 std::unique_ptr<ast::Expression> Parser::parse_boolean_literal() {
     Defer defer(_tracer.trace(__FUNCTION__, _current_token.literal));
     return std::unique_ptr<ast::Expression>(new ast::BooleanLiteral(_current_token));
@@ -356,6 +626,14 @@ std::unique_ptr<ast::Expression> Parser::parse_function_literal() {
     }
 
     function_literal->set_body(body.release());
+
+    ScopeCollector scope;
+    for (auto& param : function_literal->parameters()) {
+        scope.bind(param->value());
+    }
+    scope.collect(function_literal->body());
+    auto free_variables = scope.free_variables();
+    function_literal->set_scope(scope.local_count(), free_variables);
     return function_literal;
 }
 
@@ -417,8 +695,27 @@ std::unique_ptr<ast::Expression> Parser::parse_if_expression() {
     return if_expression;
 }
 
+std::unique_ptr<ast::Expression> Parser::parse_import_expression() {
+    Defer defer(_tracer.trace(__FUNCTION__, _current_token.literal));
+    std::unique_ptr<ast::ImportExpression> import_expression(
+            new ast::ImportExpression(_current_token));
+
+    // 模块路径只能是字符串字面量，保证在求值前就能确定
+    if (!expect_peek(Token::STRING)) {
+        return nullptr;
+    }
+
+    import_expression->set_path(_current_token.literal);
+    return import_expression;
+}
+
 std::unique_ptr<ast::BlockStatment> Parser::parse_block_statment() {
     Defer defer(_tracer.trace(__FUNCTION__, _current_token.literal));
+    Nesting nesting(this);
+    if (nesting.too_deep()) {
+        abort_too_deep();
+        return nullptr;
+    }
     std::unique_ptr<ast::BlockStatment> block_statment(
             new ast::BlockStatment(_current_token));
 
@@ -434,7 +731,7 @@ std::unique_ptr<ast::BlockStatment> Parser::parse_block_statment() {
     }
 
     if (current_token_is(Token::END)) {
-        _errors.push_back("expect token `}`, got `EOF` instead.");
+        add_error("expect token `}`, got `EOF` instead.");
         return nullptr;
     }
     return block_statment;
@@ -444,11 +741,31 @@ std::unique_ptr<ast::Expression> Parser::parse_infix_expression(ast::Expression*
     Defer defer(_tracer.trace(__FUNCTION__, _current_token.literal));
     std::unique_ptr<ast::InfixExpression> infix_expression(
             new ast::InfixExpression(_current_token));
+    Token token = _current_token;
 
     auto precedence = current_precedence();
     next_token();
     auto right = parse_expression(precedence);
 
+    // 展平 + 链：a + b + c 解析为一个 ConcatExpression
+    if (infix_expression->op() == "+" && left != nullptr && right != nullptr) {
+        if (typeid(*left) == typeid(ast::ConcatExpression)) {
+            auto concat = static_cast<ast::ConcatExpression*>(left);
+            concat->append_operand(right.release());
+            return std::unique_ptr<ast::Expression>(concat);
+        }
+        if (typeid(*left) == typeid(ast::InfixExpression)
+                && left->cast<ast::InfixExpression>()->op() == "+") {
+            std::unique_ptr<ast::InfixExpression> inner(static_cast<ast::InfixExpression*>(left));
+            std::unique_ptr<ast::ConcatExpression> concat(
+                    new ast::ConcatExpression(token));
+            concat->append_operand(inner->release_left());
+            concat->append_operand(inner->release_right());
+            concat->append_operand(right.release());
+            return concat;
+        }
+    }
+
     infix_expression->set_left(left);
     infix_expression->set_right(right.release());
 
@@ -469,12 +786,28 @@ std::unique_ptr<ast::Expression> Parser::parse_call_expression(ast::Expression*
 
 std::unique_ptr<ast::Expression> Parser::parse_index_expression(ast::Expression* left) {
     Defer defer(_tracer.trace(__FUNCTION__, _current_token.literal));
-    std::unique_ptr<ast::IndexExpression> index_expression(
-            new ast::IndexExpression(_current_token));
+    // 先接管 left，保证出错提前返回时不会泄漏
+    std::unique_ptr<ast::Expression> left_exp(left);
+    Token token = _current_token;
+
+    // 形如 a[:end] 或 a[:]
+    if (peek_token_is(Token::COLON)) {
+        next_token();
+        return parse_slice_expression(token, left_exp.release(), nullptr);
+    }
 
     next_token();
     auto exp = parse_expression(Precedence::LOWEST);
-    index_expression->set_left(left);
+
+    // 形如 a[start:end] 或 a[start:]
+    if (peek_token_is(Token::COLON)) {
+        next_token();
+        return parse_slice_expression(token, left_exp.release(), exp.release());
+    }
+
+    std::unique_ptr<ast::IndexExpression> index_expression(
+            new ast::IndexExpression(token));
+    index_expression->set_left(left_exp.release());
     index_expression->set_index(exp.release());
 
     if (!expect_peek(Token::RBRACKET)) {
@@ -484,6 +817,30 @@ std::unique_ptr<ast::Expression> Parser::parse_index_expression(ast::Expression*
     return index_expression;
 }
 
+std::unique_ptr<ast::Expression> Parser::parse_slice_expression(
+        const Token& token,
+        ast::Expression* left,
+        ast::Expression* start) {
+    Defer defer(_tracer.trace(__FUNCTION__, _current_token.literal));
+    std::unique_ptr<ast::SliceExpression> slice_expression(
+            new ast::SliceExpression(token));
+    slice_expression->set_left(left);
+    slice_expression->set_start(start);
+
+    // 当前 token 是 `:`
+    if (!peek_token_is(Token::RBRACKET)) {
+        next_token();
+        auto end = parse_expression(Precedence::LOWEST);
+        slice_expression->set_end(end.release());
+    }
+
+    if (!expect_peek(Token::RBRACKET)) {
+        return nullptr;
+    }
+
+    return slice_expression;
+}
+
 std::vector<std::unique_ptr<ast::Expression>> Parser::parse_expression_list(Token::Type end) {
     Defer defer(_tracer.trace(__FUNCTION__, _current_token.literal));
     std::vector<std::unique_ptr<ast::Expression>> args;
@@ -0,0 +1,255 @@
+#include "perf_counters.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace autumn {
+namespace perf_counters {
+
+namespace internal {
+std::atomic<bool> g_enabled{false};
+}
+
+namespace {
+
+struct Entry {
+    std::string name;
+    uint64_t calls = 0;
+    Values total;
+};
+
+std::mutex s_mutex;
+// 按第一次出现的顺序输出
+std::vector<Entry> s_entries;
+std::unordered_map<std::string, size_t> s_index;
+
+// 第一组计数器的打开结果，报告在进程退出时输出，此时线程的计数器可能已经析构
+bool s_probed = false;
+bool s_available = false;
+bool s_supported[EVENT_COUNT] = {};
+std::string s_reason;
+
+// 当前线程的一组计数器，第一个成功打开的事件作为组长
+class Group {
+public:
+    Group() {
+#ifdef __linux__
+        static const uint64_t configs[EVENT_COUNT] = {
+            PERF_COUNT_HW_CPU_CYCLES,
+            PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_BRANCH_MISSES,
+            PERF_COUNT_HW_CACHE_MISSES,
+        };
+        for (int i = 0; i < EVENT_COUNT; ++i) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[i];
+            attr.read_format = PERF_FORMAT_GROUP;
+            attr.disabled = _leader < 0 ? 1 : 0;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            int fd = syscall(SYS_perf_event_open, &attr, 0, -1, _leader, 0);
+            if (fd < 0) {
+                if (_reason.empty()) {
+                    _reason = format_reason(event_name(i), errno);
+                }
+                continue;
+            }
+            if (_leader < 0) {
+                _leader = fd;
+            }
+            _fds.push_back(fd);
+            _slots.push_back(i);
+        }
+        if (_leader >= 0) {
+            ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+#else
+        _reason = "perf_event_open is only available on Linux";
+#endif
+        std::lock_guard<std::mutex> lock(s_mutex);
+        if (!s_probed) {
+            s_probed = true;
+            s_available = available();
+            for (int i = 0; i < EVENT_COUNT; ++i) {
+                s_supported[i] = supported(i);
+            }
+            s_reason = _reason;
+        }
+    }
+
+    ~Group() {
+#ifdef __linux__
+        for (int fd : _fds) {
+            close(fd);
+        }
+#endif
+    }
+
+    bool available() const {
+        return _leader >= 0;
+    }
+
+    bool supported(int event) const {
+        for (int slot : _slots) {
+            if (slot == event) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::string& reason() const {
+        return _reason;
+    }
+
+    bool read(Values* values) const {
+#ifdef __linux__
+        if (_leader < 0) {
+            return false;
+        }
+        // PERF_FORMAT_GROUP 的布局: nr, value[nr]
+        uint64_t buf[EVENT_COUNT + 1];
+        ssize_t n = ::read(_leader, buf, sizeof(buf));
+        if (n < static_cast<ssize_t>(sizeof(uint64_t)) || buf[0] != _slots.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < _slots.size(); ++i) {
+            values->value[_slots[i]] = buf[i + 1];
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+private:
+    static std::string format_reason(const char* event, int err) {
+        return std::string("perf_event_open(") + event + "): " + strerror(err);
+    }
+
+private:
+    int _leader = -1;
+    std::vector<int> _fds;
+    // _fds[i] 对应的事件
+    std::vector<int> _slots;
+    std::string _reason;
+};
+
+Group& group() {
+    thread_local Group s_group;
+    return s_group;
+}
+
+void report_at_exit() {
+    report(std::cerr);
+}
+
+struct EnvInitializer {
+    EnvInitializer() {
+        const char* mode = getenv("AUTUMN_PERF_COUNTERS");
+        if (mode != nullptr && strcmp(mode, "1") == 0) {
+            enable();
+        }
+    }
+} s_env_initializer;
+
+}
+
+const char* event_name(int event) {
+    static const char* names[EVENT_COUNT] = {
+        "cycles",
+        "instructions",
+        "branch-misses",
+        "cache-misses",
+    };
+    return event >= 0 && event < EVENT_COUNT ? names[event] : "unknown";
+}
+
+void enable() {
+    if (!internal::g_enabled.load(std::memory_order_relaxed)) {
+        // 先打开计数器，报告只使用打开时的结果
+        available();
+        atexit(report_at_exit);
+    }
+    internal::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+bool available() {
+    return group().available();
+}
+
+bool supported(int event) {
+    return group().supported(event);
+}
+
+std::string unavailable_reason() {
+    return group().reason();
+}
+
+bool read(Values* values) {
+    return group().read(values);
+}
+
+void record(std::string_view name, const Values& values) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    auto it = s_index.find(std::string(name));
+    if (it == s_index.end()) {
+        it = s_index.emplace(std::string(name), s_entries.size()).first;
+        s_entries.push_back(Entry{it->first});
+    }
+    auto& entry = s_entries[it->second];
+    ++entry.calls;
+    entry.total += values;
+}
+
+void report(std::ostream& out) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (!s_available) {
+        out << "perf counters unavailable: " << s_reason << std::endl;
+        return;
+    }
+
+    out << "perf counters (user space, nested phases are included in their parents):" << std::endl;
+    out << std::left << std::setw(24) << "phase" << std::right << std::setw(10) << "calls";
+    for (int i = 0; i < EVENT_COUNT; ++i) {
+        out << std::setw(16) << event_name(i);
+    }
+    out << std::endl;
+    for (auto& entry : s_entries) {
+        out << std::left << std::setw(24) << entry.name << std::right << std::setw(10) << entry.calls;
+        for (int i = 0; i < EVENT_COUNT; ++i) {
+            if (s_supported[i]) {
+                out << std::setw(16) << entry.total.value[i];
+            } else {
+                out << std::setw(16) << "-";
+            }
+        }
+        out << std::endl;
+    }
+}
+
+void reset() {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    s_entries.clear();
+    s_index.clear();
+}
+
+} // namespace perf_counters
+} // namespace autumn
@@ -0,0 +1,728 @@
+#include "regexp.h"
+
+#include <algorithm>
+
+#include "format.h"
+#include "utf8.h"
+
+namespace autumn {
+namespace regexp {
+
+namespace {
+
+constexpr uint32_t MAX_CODEPOINT = 0x10FFFF;
+
+// 解码 pos 处的码点，len 是它占用的字节数；非法的后续字节与 utf8::advance 一样归入前一个码点
+uint32_t decode(std::string_view input, size_t pos, size_t* len) {
+    auto b = static_cast<unsigned char>(input[pos]);
+    size_t n = 1;
+    while (pos + n < input.size() && utf8::is_continuation(input[pos + n])) {
+        ++n;
+    }
+    *len = n;
+    if (b < 0x80) {
+        return b;
+    }
+    size_t extra = b >= 0xF0 ? 3 : b >= 0xE0 ? 2 : b >= 0xC0 ? 1 : 0;
+    uint32_t c = b & (0x3F >> extra);
+    for (size_t k = 1; k <= extra && k < n; ++k) {
+        c = (c << 6) | (static_cast<unsigned char>(input[pos + k]) & 0x3F);
+    }
+    return c;
+}
+
+bool is_word(char c) {
+    return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || c == '_';
+}
+
+using Ranges = std::vector<std::pair<uint32_t, uint32_t>>;
+
+const Ranges DIGIT = {{'0', '9'}};
+const Ranges WORD = {{'0', '9'}, {'A', 'Z'}, {'_', '_'}, {'a', 'z'}};
+const Ranges SPACE = {{'\t', '\r'}, {' ', ' '}};
+
+// 排序并合并相交或相邻的区间
+void normalize(Ranges* ranges) {
+    std::sort(ranges->begin(), ranges->end());
+    Ranges merged;
+    for (auto& r : *ranges) {
+        if (!merged.empty() && r.first <= merged.back().second + 1) {
+            merged.back().second = std::max(merged.back().second, r.second);
+        } else {
+            merged.push_back(r);
+        }
+    }
+    ranges->swap(merged);
+}
+
+// ranges 需已排序且不重叠
+Ranges complement(const Ranges& ranges) {
+    Ranges ret;
+    uint32_t next = 0;
+    for (auto& r : ranges) {
+        if (r.first > next) {
+            ret.push_back({next, r.first - 1});
+        }
+        next = r.second + 1;
+    }
+    if (next <= MAX_CODEPOINT) {
+        ret.push_back({next, MAX_CODEPOINT});
+    }
+    return ret;
+}
+
+// 模式的语法树
+struct Node {
+    enum Kind {
+        EMPTY,
+        LITERAL,
+        ANY,
+        CLASS,
+        ASSERT,
+        GROUP,
+        CONCAT,
+        ALTERNATE,
+        REPEAT,
+    };
+
+    Kind kind;
+    // LITERAL 的码点，CLASS 的下标，ASSERT 的类型，GROUP 的编号
+    uint32_t value = 0;
+    // REPEAT 的次数，max 为 -1 表示不限
+    int min = 0;
+    int max = 0;
+    bool greedy = true;
+    std::vector<std::unique_ptr<Node>> children;
+
+    explicit Node(Kind k, uint32_t v = 0) : kind(k), value(v) {}
+};
+
+} // namespace
+
+// 递归下降地解析模式，再把语法树翻译成指令
+class Compiler {
+public:
+    Compiler(std::string_view pattern, Regex* regex) :
+        _pattern(pattern),
+        _regex(regex) {
+    }
+
+    bool compile(std::string* error) {
+        auto root = parse_alternation(0);
+        if (root != nullptr && _pos < _pattern.size()) {
+            fail("unmatched `)`");
+        }
+        if (_error.empty()) {
+            _regex->_anchored = anchored(root.get());
+            emit({Regex::SAVE, 0});
+            generate(root.get());
+            emit({Regex::SAVE, 1});
+            emit({Regex::MATCH});
+        }
+        if (!_error.empty()) {
+            *error = _error;
+            return false;
+        }
+        return true;
+    }
+private:
+    bool done() const {
+        return _pos >= _pattern.size();
+    }
+
+    char peek() const {
+        return done() ? 0 : _pattern[_pos];
+    }
+
+    uint32_t next() {
+        size_t len = 0;
+        uint32_t c = decode(_pattern, _pos, &len);
+        _pos += len;
+        return c;
+    }
+
+    std::nullptr_t fail(const std::string& what) {
+        if (_error.empty()) {
+            _error = format("{} at offset {}", what, _pos);
+        }
+        return nullptr;
+    }
+
+    std::unique_ptr<Node> parse_alternation(int depth) {
+        if (depth > Regex::MAX_DEPTH) {
+            return fail("nesting too deep");
+        }
+        auto first = parse_concat(depth);
+        if (first == nullptr || peek() != '|') {
+            return first;
+        }
+        auto ret = std::make_unique<Node>(Node::ALTERNATE);
+        ret->children.push_back(std::move(first));
+        while (peek() == '|') {
+            ++_pos;
+            auto branch = parse_concat(depth);
+            if (branch == nullptr) {
+                return nullptr;
+            }
+            ret->children.push_back(std::move(branch));
+        }
+        return ret;
+    }
+
+    std::unique_ptr<Node> parse_concat(int depth) {
+        auto ret = std::make_unique<Node>(Node::CONCAT);
+        while (!done() && peek() != '|' && peek() != ')') {
+            auto item = parse_repeat(depth);
+            if (item == nullptr) {
+                return nullptr;
+            }
+            ret->children.push_back(std::move(item));
+        }
+        if (ret->children.empty()) {
+            return std::make_unique<Node>(Node::EMPTY);
+        }
+        if (ret->children.size() == 1) {
+            return std::move(ret->children[0]);
+        }
+        return ret;
+    }
+
+    // {n}、{n,}、{n,m}，不是这些形式时返回 false，不消耗输入
+    bool parse_count(int* min, int* max) {
+        size_t pos = _pos + 1;
+        auto number = [&](int* out) {
+            size_t begin = pos;
+            long value = 0;
+            while (pos < _pattern.size() && '0' <= _pattern[pos] && _pattern[pos] <= '9') {
+                value = std::min<long>(value * 10 + (_pattern[pos] - '0'), Regex::MAX_REPEAT + 1);
+                ++pos;
+            }
+            *out = static_cast<int>(value);
+            return pos > begin;
+        };
+        if (!number(min)) {
+            return false;
+        }
+        *max = *min;
+        if (pos < _pattern.size() && _pattern[pos] == ',') {
+            ++pos;
+            if (!number(max)) {
+                *max = -1;
+            }
+        }
+        if (pos >= _pattern.size() || _pattern[pos] != '}') {
+            return false;
+        }
+        _pos = pos + 1;
+        return true;
+    }
+
+    std::unique_ptr<Node> parse_repeat(int depth) {
+        auto atom = parse_atom(depth);
+        while (atom != nullptr && !done()) {
+            int min = 0;
+            int max = 0;
+            char c = peek();
+            if (c == '*') {
+                ++_pos;
+                max = -1;
+            } else if (c == '+') {
+                ++_pos;
+                min = 1;
+                max = -1;
+            } else if (c == '?') {
+                ++_pos;
+                max = 1;
+            } else if (c != '{' || !parse_count(&min, &max)) {
+                break;
+            }
+            if (min > Regex::MAX_REPEAT || max > Regex::MAX_REPEAT) {
+                return fail(format("repeat count exceeds {}", Regex::MAX_REPEAT));
+            }
+            if (max != -1 && min > max) {
+                return fail("invalid repeat count");
+            }
+            auto repeat = std::make_unique<Node>(Node::REPEAT);
+            repeat->min = min;
+            repeat->max = max;
+            if (peek() == '?') {
+                ++_pos;
+                repeat->greedy = false;
+            }
+            repeat->children.push_back(std::move(atom));
+            atom = std::move(repeat);
+        }
+        return atom;
+    }
+
+    std::unique_ptr<Node> parse_atom(int depth) {
+        char c = peek();
+        if (c == '(') {
+            ++_pos;
+            int group = -1;
+            if (_pattern.substr(_pos, 2) == "?:") {
+                _pos += 2;
+            } else {
+                group = ++_regex->_groups;
+            }
+            auto child = parse_alternation(depth + 1);
+            if (child == nullptr) {
+                return nullptr;
+            }
+            if (peek() != ')') {
+                return fail("missing `)`");
+            }
+            ++_pos;
+            if (group < 0) {
+                return child;
+            }
+            auto ret = std::make_unique<Node>(Node::GROUP, group);
+            ret->children.push_back(std::move(child));
+            return ret;
+        } else if (c == '[') {
+            ++_pos;
+            return parse_class();
+        } else if (c == '*' || c == '+' || c == '?') {
+            return fail(format("nothing to repeat before `{}`", c));
+        } else if (c == '.') {
+            ++_pos;
+            return std::make_unique<Node>(Node::ANY);
+        } else if (c == '^') {
+            ++_pos;
+            return std::make_unique<Node>(Node::ASSERT, Regex::BEGIN_TEXT);
+        } else if (c == '$') {
+            ++_pos;
+            return std::make_unique<Node>(Node::ASSERT, Regex::END_TEXT);
+        } else if (c == '\\') {
+            ++_pos;
+            if (peek() == 'b' || peek() == 'B') {
+                auto assertion = peek() == 'b' ? Regex::WORD_BOUNDARY : Regex::NOT_WORD_BOUNDARY;
+                ++_pos;
+                return std::make_unique<Node>(Node::ASSERT, assertion);
+            }
+            Ranges ranges;
+            bool negated = false;
+            uint32_t literal = 0;
+            if (!parse_escape(&ranges, &negated, &literal)) {
+                return nullptr;
+            }
+            if (ranges.empty()) {
+                return std::make_unique<Node>(Node::LITERAL, literal);
+            }
+            return add_class(std::move(ranges), negated);
+        }
+        return std::make_unique<Node>(Node::LITERAL, next());
+    }
+
+    // 反斜杠之后的部分：\d 这类写入 ranges，其它转义写入 literal
+    bool parse_escape(Ranges* ranges, bool* negated, uint32_t* literal) {
+        if (done()) {
+            fail("trailing `\\`");
+            return false;
+        }
+        char c = peek();
+        ++_pos;
+        switch (c) {
+        case 'd': *ranges = DIGIT; return true;
+        case 'w': *ranges = WORD; return true;
+        case 's': *ranges = SPACE; return true;
+        case 'D': *ranges = DIGIT; *negated = true; return true;
+        case 'W': *ranges = WORD; *negated = true; return true;
+        case 'S': *ranges = SPACE; *negated = true; return true;
+        case 'n': *literal = '\n'; return true;
+        case 't': *literal = '\t'; return true;
+        case 'r': *literal = '\r'; return true;
+        default:
+            break;
+        }
+        // 字母和数字的转义保留给以后使用
+        if (is_word(c) || static_cast<unsigned char>(c) >= 0x80) {
+            --_pos;
+            fail(format("unknown escape `\\{}`", c));
+            return false;
+        }
+        *literal = static_cast<unsigned char>(c);
+        return true;
+    }
+
+    // [ 之后的部分
+    std::unique_ptr<Node> parse_class() {
+        bool negated = false;
+        if (peek() == '^') {
+            ++_pos;
+            negated = true;
+        }
+        Ranges ranges;
+        bool first = true;
+        while (true) {
+            if (done()) {
+                return fail("missing `]`");
+            }
+            if (peek() == ']' && !first) {
+                ++_pos;
+                break;
+            }
+            first = false;
+
+            uint32_t lo = 0;
+            if (peek() == '\\') {
+                ++_pos;
+                Ranges named;
+                bool named_negated = false;
+                if (!parse_escape(&named, &named_negated, &lo)) {
+                    return nullptr;
+                }
+                if (!named.empty()) {
+                    auto add = named_negated ? complement(named) : named;
+                    ranges.insert(ranges.end(), add.begin(), add.end());
+                    continue;
+                }
+            } else {
+                lo = next();
+            }
+
+            uint32_t hi = lo;
+            if (peek() == '-' && _pos + 1 < _pattern.size() && _pattern[_pos + 1] != ']') {
+                ++_pos;
+                if (peek() == '\\') {
+                    ++_pos;
+                    Ranges named;
+                    bool named_negated = false;
+                    if (!parse_escape(&named, &named_negated, &hi)) {
+                        return nullptr;
+                    }
+                    if (!named.empty()) {
+                        return fail("invalid class range");
+                    }
+                } else {
+                    hi = next();
+                }
+                if (hi < lo) {
+                    return fail("invalid class range");
+                }
+            }
+            ranges.push_back({lo, hi});
+        }
+        return add_class(std::move(ranges), negated);
+    }
+
+    std::unique_ptr<Node> add_class(Ranges ranges, bool negated) {
+        normalize(&ranges);
+        Regex::Class cls;
+        cls.ranges = std::move(ranges);
+        cls.negated = negated;
+        _regex->_classes.push_back(std::move(cls));
+        return std::make_unique<Node>(Node::CLASS, _regex->_classes.size() - 1);
+    }
+
+    static bool anchored(const Node* node) {
+        while (node->kind == Node::CONCAT || node->kind == Node::GROUP) {
+            node = node->children[0].get();
+        }
+        return node->kind == Node::ASSERT && node->value == Regex::BEGIN_TEXT;
+    }
+
+    // 追加一条指令，返回它的位置；超出上限时记录错误
+    uint32_t emit(Regex::Inst inst) {
+        auto& program = _regex->_program;
+        if (program.size() >= Regex::MAX_PROGRAM_SIZE) {
+            fail("pattern too large");
+            return 0;
+        }
+        program.push_back(inst);
+        return program.size() - 1;
+    }
+
+    uint32_t here() const {
+        return _regex->_program.size();
+    }
+
+    void patch_split(uint32_t split, uint32_t body, uint32_t out, bool greedy) {
+        if (!_error.empty()) {
+            return;
+        }
+        auto& inst = _regex->_program[split];
+        inst.x = greedy ? body : out;
+        inst.y = greedy ? out : body;
+    }
+
+    void generate(const Node* node) {
+        if (!_error.empty()) {
+            return;
+        }
+        switch (node->kind) {
+        case Node::EMPTY:
+            break;
+        case Node::LITERAL:
+            emit({Regex::CHAR, node->value});
+            break;
+        case Node::ANY:
+            emit({Regex::ANY});
+            break;
+        case Node::CLASS:
+            emit({Regex::CLASS, node->value});
+            break;
+        case Node::ASSERT:
+            emit({Regex::ASSERT, node->value});
+            break;
+        case Node::GROUP:
+            emit({Regex::SAVE, 2 * node->value});
+            generate(node->children[0].get());
+            emit({Regex::SAVE, 2 * node->value + 1});
+            break;
+        case Node::CONCAT:
+            for (auto& child : node->children) {
+                generate(child.get());
+            }
+            break;
+        case Node::ALTERNATE: {
+            // split L1, next; L1: 分支; jmp end; next: ...
+            std::vector<uint32_t> jumps;
+            for (size_t i = 0; i + 1 < node->children.size(); ++i) {
+                uint32_t split = emit({Regex::SPLIT});
+                generate(node->children[i].get());
+                jumps.push_back(emit({Regex::JMP}));
+                patch_split(split, split + 1, here(), true);
+            }
+            generate(node->children.back().get());
+            if (_error.empty()) {
+                for (auto jump : jumps) {
+                    _regex->_program[jump].x = here();
+                }
+            }
+            break;
+        }
+        case Node::REPEAT: {
+            auto child = node->children[0].get();
+            for (int i = 0; i < node->min; ++i) {
+                generate(child);
+            }
+            if (node->max == -1) {
+                // L: split body, out; body; jmp L; out:
+                uint32_t split = emit({Regex::SPLIT});
+                generate(child);
+                emit({Regex::JMP, 0, split});
+                patch_split(split, split + 1, here(), node->greedy);
+                break;
+            }
+            // 可选的部分：每一份都可以直接跳到结尾，即 (x(x(x)?)?)?
+            std::vector<uint32_t> splits;
+            for (int i = node->min; i < node->max && _error.empty(); ++i) {
+                splits.push_back(emit({Regex::SPLIT}));
+                generate(child);
+            }
+            for (auto split : splits) {
+                patch_split(split, split + 1, here(), node->greedy);
+            }
+            break;
+        }
+        }
+    }
+private:
+    std::string_view _pattern;
+    size_t _pos = 0;
+    Regex* _regex;
+    std::string _error;
+};
+
+bool Regex::Class::contains(uint32_t c) const {
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), std::make_pair(c, MAX_CODEPOINT + 1));
+    bool found = it != ranges.begin() && c <= std::prev(it)->second;
+    return found != negated;
+}
+
+std::shared_ptr<const Regex> Regex::compile(std::string_view pattern, std::string* error) {
+    std::shared_ptr<Regex> ret(new Regex());
+    Compiler compiler(pattern, ret.get());
+    if (!compiler.compile(error)) {
+        return nullptr;
+    }
+    return ret;
+}
+
+namespace {
+
+// 一个输入位置上的线程集合，按优先级排列；稀疏集合使得插入、查询、清空都是 O(1)
+class ThreadList {
+public:
+    ThreadList(size_t program_size, size_t slots) :
+        _sparse(program_size),
+        _dense(program_size),
+        _captures(program_size * slots),
+        _slots(slots) {
+    }
+
+    bool contains(uint32_t pc) const {
+        uint32_t i = _sparse[pc];
+        return i < _size && _dense[i] == pc;
+    }
+
+    uint32_t insert(uint32_t pc) {
+        _sparse[pc] = _size;
+        _dense[_size] = pc;
+        return _size++;
+    }
+
+    size_t size() const {
+        return _size;
+    }
+
+    uint32_t pc(size_t i) const {
+        return _dense[i];
+    }
+
+    size_t* captures(size_t i) {
+        return &_captures[i * _slots];
+    }
+
+    void clear() {
+        _size = 0;
+    }
+private:
+    std::vector<uint32_t> _sparse;
+    std::vector<uint32_t> _dense;
+    std::vector<size_t> _captures;
+    size_t _slots;
+    uint32_t _size = 0;
+};
+
+// 添加线程时的待办：沿 pc 继续展开，或者恢复一个捕获位置
+struct Job {
+    uint32_t pc;
+    bool restore;
+    uint32_t slot;
+    size_t value;
+};
+
+} // namespace
+
+bool Regex::search(std::string_view input, size_t begin, std::vector<size_t>* captures) const {
+    size_t slots = 2 * (_groups + 1);
+    ThreadList current(_program.size(), slots);
+    ThreadList next(_program.size(), slots);
+    std::vector<size_t> scratch(slots);
+    std::vector<Job> stack;
+
+    auto holds = [&](uint32_t assertion, size_t pos) {
+        switch (assertion) {
+        case BEGIN_TEXT:
+            return pos == 0;
+        case END_TEXT:
+            return pos == input.size();
+        default: {
+            bool before = pos > 0 && is_word(input[pos - 1]);
+            bool after = pos < input.size() && is_word(input[pos]);
+            return (before != after) == (assertion == WORD_BOUNDARY);
+        }
+        }
+    };
+
+    // 沿不消耗输入的指令展开，把到达的消耗输入的指令和 MATCH 加入 list
+    // 捕获位置在 scratch 上原地修改，回溯到分支时恢复
+    auto add = [&](ThreadList& list, uint32_t start, size_t pos) {
+        stack.push_back({start, false, 0, 0});
+        while (!stack.empty()) {
+            Job job = stack.back();
+            stack.pop_back();
+            if (job.restore) {
+                scratch[job.slot] = job.value;
+                continue;
+            }
+            uint32_t pc = job.pc;
+            while (!list.contains(pc)) {
+                uint32_t id = list.insert(pc);
+                auto& inst = _program[pc];
+                if (inst.op == JMP) {
+                    pc = inst.x;
+                } else if (inst.op == SPLIT) {
+                    stack.push_back({inst.y, false, 0, 0});
+                    pc = inst.x;
+                } else if (inst.op == SAVE) {
+                    stack.push_back({0, true, inst.arg, scratch[inst.arg]});
+                    scratch[inst.arg] = pos;
+                    ++pc;
+                } else if (inst.op == ASSERT) {
+                    if (!holds(inst.arg, pos)) {
+                        break;
+                    }
+                    ++pc;
+                } else {
+                    std::copy(scratch.begin(), scratch.end(), list.captures(id));
+                    break;
+                }
+            }
+        }
+    };
+
+    bool matched = false;
+    size_t pos = begin;
+    while (true) {
+        // 尚未匹配时，每个位置都从头开始一个优先级最低的线程，相当于模式前面有 .*?
+        if (!matched && (!_anchored || pos == begin)) {
+            std::fill(scratch.begin(), scratch.end(), npos);
+            add(current, 0, pos);
+        }
+        if (current.size() == 0) {
+            break;
+        }
+
+        uint32_t c = 0;
+        size_t len = 0;
+        if (pos < input.size()) {
+            c = decode(input, pos, &len);
+        }
+        for (size_t i = 0; i < current.size(); ++i) {
+            auto& inst = _program[current.pc(i)];
+            bool step = false;
+            if (inst.op == MATCH) {
+                // 优先级更低的线程不再需要
+                captures->assign(current.captures(i), current.captures(i) + slots);
+                matched = true;
+                break;
+            } else if (inst.op == CHAR) {
+                step = len > 0 && c == inst.arg;
+            } else if (inst.op == ANY) {
+                step = len > 0 && c != '\n';
+            } else if (inst.op == CLASS) {
+                step = len > 0 && _classes[inst.arg].contains(c);
+            }
+            if (step) {
+                auto caps = current.captures(i);
+                std::copy(caps, caps + slots, scratch.begin());
+                add(next, current.pc(i) + 1, pos + len);
+            }
+        }
+        std::swap(current, next);
+        next.clear();
+        if (pos >= input.size()) {
+            break;
+        }
+        pos += len;
+    }
+    return matched;
+}
+
+std::shared_ptr<const Regex> Cache::get(std::string_view pattern, std::string* error) {
+    auto it = _index.find(pattern);
+    if (it != _index.end()) {
+        ++_hits;
+        _entries.splice(_entries.begin(), _entries, it->second);
+        return it->second->second;
+    }
+
+    ++_misses;
+    auto regex = Regex::compile(pattern, error);
+    if (regex == nullptr) {
+        return nullptr;
+    }
+    _entries.emplace_front(std::string(pattern), regex);
+    _index[_entries.front().first] = _entries.begin();
+    if (_entries.size() > _capacity) {
+        _index.erase(_entries.back().first);
+        _entries.pop_back();
+    }
+    return regex;
+}
+
+} // namespace regexp
+} // namespace autumn
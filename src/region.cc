@@ -0,0 +1,383 @@
+#include "region.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "environment.h"
+#include "object.h"
+
+namespace autumn {
+namespace region {
+
+namespace {
+
+// 写屏障的记录：在请求中写入了区域对象的堆上容器和环境，以及对应的区域
+thread_local std::unordered_map<object::Object*, const Region*> t_remembered_objects;
+thread_local std::unordered_map<object::Environment*, const Region*> t_remembered_envs;
+
+}
+
+void* Region::allocate(size_t size, size_t align) {
+    while (true) {
+        if (_cursor != nullptr) {
+            auto addr = reinterpret_cast<uintptr_t>(_cursor);
+            auto aligned = reinterpret_cast<char*>((addr + align - 1) & ~(uintptr_t)(align - 1));
+            if (aligned + size <= _end) {
+                _cursor = aligned + size;
+                _live.fetch_add(1, std::memory_order_relaxed);
+                return aligned;
+            }
+            ++_block;
+        }
+
+        // 复用 reset 之前申请的块，不够时申请新块，超大的对象单独占一个块
+        if (_block >= _blocks.size() || _blocks[_block].size < size + align) {
+            Block block;
+            block.size = std::max(BLOCK_SIZE, size + align);
+            block.data.reset(new char[block.size]);
+            _capacity += block.size;
+            const char* begin = block.data.get();
+            auto range = std::make_pair(begin, begin + block.size);
+            _ranges.insert(std::upper_bound(_ranges.begin(), _ranges.end(), range), range);
+            _blocks.insert(_blocks.begin() + std::min(_block, _blocks.size()), std::move(block));
+        }
+        _cursor = _blocks[_block].data.get();
+        _end = _cursor + _blocks[_block].size;
+    }
+}
+
+bool Region::reset() {
+    if (live() != 0) {
+        return false;
+    }
+    _block = 0;
+    _cursor = nullptr;
+    _end = nullptr;
+    return true;
+}
+
+void Region::abandon() {
+    _abandoned.store(true, std::memory_order_release);
+    if (live() == 0) {
+        delete this;
+    }
+}
+
+bool Region::contains(const void* p) const {
+    auto addr = static_cast<const char*>(p);
+    auto it = std::upper_bound(_ranges.begin(), _ranges.end(), addr,
+            [](const char* a, const std::pair<const char*, const char*>& range) {
+                return a < range.first;
+            });
+    if (it == _ranges.begin()) {
+        return false;
+    }
+    --it;
+    return addr < it->second;
+}
+
+size_t Region::used() const {
+    if (_cursor == nullptr) {
+        size_t ret = 0;
+        for (size_t i = 0; i < _block && i < _blocks.size(); ++i) {
+            ret += _blocks[i].size;
+        }
+        return ret;
+    }
+    size_t ret = _cursor - _blocks[_block].data.get();
+    for (size_t i = 0; i < _block; ++i) {
+        ret += _blocks[i].size;
+    }
+    return ret;
+}
+
+Scope::Scope(Region* region) : _previous(t_current) {
+    t_current = region;
+}
+
+Scope::~Scope() {
+    t_current = _previous;
+}
+
+bool enabled() {
+    // 第一次调用时读取，全局的 Evaluator 可能在本文件的静态对象初始化之前构造
+    static const bool s_enabled = []() {
+        const char* mode = getenv("AUTUMN_REGION");
+        return mode != nullptr && strcmp(mode, "1") == 0;
+    }();
+    return s_enabled;
+}
+
+void remember(object::Object* container, const object::Object* value) {
+    if (container->_remembered || t_current->contains(container) || !t_current->contains(value)) {
+        return;
+    }
+    container->_remembered = true;
+    t_remembered_objects.emplace(container, t_current);
+}
+
+void remember(object::Environment* env, const object::Object* value) {
+    if (env->_remembered || t_current->contains(env) || !t_current->contains(value)) {
+        return;
+    }
+    env->_remembered = true;
+    t_remembered_envs.emplace(env, t_current);
+}
+
+void forget(const object::Object* container) {
+    t_remembered_objects.erase(const_cast<object::Object*>(container));
+}
+
+void forget(const object::Environment* env) {
+    t_remembered_envs.erase(const_cast<object::Environment*>(env));
+}
+
+std::shared_ptr<object::Object> Promoter::promote(const std::shared_ptr<object::Object>& obj) {
+    if (obj == nullptr) {
+        return obj;
+    }
+    // 冻结的对象永不释放，即使在区域里也原样保留
+    // 堆上的对象引用的区域对象已经由 fix_remembered 处理过
+    if (obj->frozen() || !_region->contains(obj.get())) {
+        return obj;
+    }
+    auto it = _objects.find(obj.get());
+    if (it != _objects.end()) {
+        return it->second;
+    }
+
+    auto& type = typeid(*obj);
+    std::shared_ptr<object::Object> ret;
+    if (type == typeid(object::Integer)) {
+        ret = std::make_shared<object::Integer>(obj->cast<object::Integer>()->value());
+    } else if (type == typeid(object::Boolean)) {
+        ret = std::make_shared<object::Boolean>(obj->cast<object::Boolean>()->value());
+    } else if (type == typeid(object::String)) {
+        auto str = obj->cast<object::String>();
+        if (str->_owner == nullptr) {
+            ret = std::make_shared<object::String>(std::string(str->value()));
+        } else {
+            // 视图继续共享父缓冲区；父对象在区域里时一定是字符串，先提升父对象
+            // 不在区域里的父对象（表的映射等）原样共享
+            std::shared_ptr<const void> owner = str->_owner;
+            const char* data = str->value().data();
+            if (str->_string_owner && _region->contains(owner.get())) {
+                auto parent = std::static_pointer_cast<const object::String>(owner);
+                auto offset = data - parent->value().data();
+                auto promoted = std::static_pointer_cast<const object::String>(
+                        promote(std::const_pointer_cast<object::String>(parent)));
+                data = promoted->value().data() + offset;
+                owner = promoted;
+            }
+            auto view = std::make_shared<object::String>(owner, data,
+                    str->value().size(), str->_pinned, str->_ascii);
+            view->_string_owner = str->_string_owner;
+            ret = view;
+        }
+    } else if (type == typeid(object::Table)) {
+        ret = std::make_shared<object::Table>(obj->cast<object::Table>()->mapping());
+    } else if (type == typeid(object::Column)) {
+        auto column = obj->cast<object::Column>();
+        ret = std::make_shared<object::Column>(column->mapping(), column->column(),
+                column->begin(), column->size());
+    } else if (type == typeid(object::AsyncRead)) {
+        ret = std::make_shared<object::AsyncRead>(obj->cast<object::AsyncRead>()->request());
+    } else if (type == typeid(object::Error)) {
+        ret = std::make_shared<object::Error>(obj->cast<object::Error>()->message());
+    } else if (type == typeid(object::Builtin)) {
+        auto builtin = obj->cast<object::Builtin>();
+        ret = std::make_shared<object::Builtin>(builtin->_fn, builtin->name());
+    } else if (type == typeid(object::ReturnValue)) {
+        auto value = promote(obj->cast<object::ReturnValue>()->value());
+        ret = std::make_shared<object::ReturnValue>(value);
+    } else if (type == typeid(object::Array)) {
+        auto array = std::make_shared<object::Array>();
+        _objects[obj.get()] = array;
+        auto elems = obj->cast<object::Array>()->elements();
+        array->reserve(elems.size());
+        for (auto& elem : elems) {
+            array->append(promote(elem));
+        }
+        ret = array;
+    } else if (type == typeid(object::Hash)) {
+        auto hash = obj->cast<object::Hash>();
+        // 和数组一样先登记再拷贝元素，经过可变容器回到自身的环只拷贝一次
+        if (hash->storage() == object::Hash::SHAPED) {
+            auto copy = std::make_shared<object::Hash>(hash->shape(),
+                    std::vector<std::shared_ptr<object::Object>>(hash->size()));
+            _objects[obj.get()] = copy;
+            for (size_t i = 0; i < hash->size(); ++i) {
+                copy->_slots[i] = promote(hash->slots()[i]);
+            }
+            ret = copy;
+        } else {
+            auto copy = std::make_shared<object::Hash>();
+            _objects[obj.get()] = copy;
+            hash->for_each([&](const std::shared_ptr<object::Object>& key,
+                    const std::shared_ptr<object::Object>& value) {
+                copy->append(promote(key), promote(value));
+            });
+            ret = copy;
+        }
+    } else if (type == typeid(object::Set)) {
+        auto set = std::make_shared<object::Set>();
+        _objects[obj.get()] = set;
+        for (auto& elem : obj->cast<object::Set>()->elements()) {
+            set->insert(promote(elem));
+        }
+        ret = set;
+    } else if (type == typeid(object::Deque)) {
+        auto deque = std::make_shared<object::Deque>();
+        _objects[obj.get()] = deque;
+        auto src = obj->cast<object::Deque>();
+        for (size_t i = 0; i < src->size(); ++i) {
+            deque->push_back(promote(src->at(i)));
+        }
+        ret = deque;
+    } else if (type == typeid(object::PriorityQueue)) {
+        auto src = obj->cast<object::PriorityQueue>();
+        auto queue = std::make_shared<object::PriorityQueue>();
+        _objects[obj.get()] = queue;
+        queue->_comparator = promote(src->comparator());
+        // 元素已经满足堆序，直接拷贝，不需要调用比较函数
+        for (auto& elem : src->elements()) {
+            queue->_heap.push_back(promote(elem));
+        }
+        ret = queue;
+    } else if (type == typeid(object::Function)) {
+        auto fn = obj->cast<object::Function>();
+        auto env = promote(fn->env());
+        // 环境中可能已经通过环回到了这个函数
+        it = _objects.find(obj.get());
+        if (it != _objects.end()) {
+            return it->second;
+        }
+        ret = std::make_shared<object::Function>(fn->_prototype, env);
+    } else {
+        // 没有状态的对象（null 等）总是共享的全局常量
+        return obj;
+    }
+
+    _objects[obj.get()] = ret;
+    ++_promoted;
+    return ret;
+}
+
+std::shared_ptr<object::Environment> Promoter::promote(const std::shared_ptr<object::Environment>& env) {
+    if (env == nullptr) {
+        return env;
+    }
+    if (!_region->contains(env.get())) {
+        return env;
+    }
+    auto it = _envs.find(env.get());
+    if (it != _envs.end()) {
+        return it->second;
+    }
+
+    auto outer = promote(env->outer());
+    auto ret = outer != nullptr
+        ? std::make_shared<object::Environment>(outer)
+        : std::make_shared<object::Environment>();
+    // 先登记再拷贝绑定，绑定中的闭包可能引用这个环境
+    _envs[env.get()] = ret;
+    ++_promoted;
+    for (auto& binding : env->store()) {
+        auto value = promote(binding.second);
+        ret->set(binding.first, value);
+    }
+    return ret;
+}
+
+void Promoter::fix_remembered() {
+    // 先取出属于这个区域的记录，再逐个修正：替换掉的区域对象可能持有某个记下的容器的
+    // 最后一个引用，容器析构时会从记录中删除自己，处理前要确认它还在
+    std::vector<object::Object*> objects;
+    for (auto& entry : t_remembered_objects) {
+        if (entry.second == _region) {
+            objects.push_back(entry.first);
+        }
+    }
+    std::vector<object::Environment*> envs;
+    for (auto& entry : t_remembered_envs) {
+        if (entry.second == _region) {
+            envs.push_back(entry.first);
+        }
+    }
+    for (auto obj : objects) {
+        if (t_remembered_objects.erase(obj) != 0) {
+            obj->_remembered = false;
+            fix(obj);
+            ++_fixed;
+        }
+    }
+    for (auto env : envs) {
+        if (t_remembered_envs.erase(env) != 0) {
+            env->_remembered = false;
+            fix(env);
+            ++_fixed;
+        }
+    }
+}
+
+void Promoter::fix(object::Object* obj) {
+    // 只替换直接引用的区域对象，经过它们到达的其他堆上容器如果写入过，同样在记录中
+    auto& type = typeid(*obj);
+    if (type == typeid(object::Array)) {
+        // 写入过的数组一定有自己的元素，不是切片
+        auto array = obj->cast<object::Array>();
+        for (size_t i = 0; i < array->_inline_size; ++i) {
+            array->_inline[i] = promote(array->_inline[i]);
+        }
+        for (auto& elem : array->_elements) {
+            elem = promote(elem);
+        }
+    } else if (type == typeid(object::Hash)) {
+        // 拷贝出来的键和原来的键哈希值相同，原位替换不影响索引
+        auto hash = obj->cast<object::Hash>();
+        for (auto& slot : hash->_slots) {
+            slot = promote(slot);
+        }
+        for (auto& entry : hash->_entries) {
+            if (entry.pair.first != nullptr) {
+                entry.pair.first = promote(entry.pair.first);
+                entry.pair.second = promote(entry.pair.second);
+            }
+        }
+        for (auto& pair : hash->_pairs) {
+            pair.second.first = promote(pair.second.first);
+            pair.second.second = promote(pair.second.second);
+        }
+    } else if (type == typeid(object::Set)) {
+        auto set = obj->cast<object::Set>();
+        for (auto& elem : set->elements()) {
+            auto promoted = promote(elem);
+            if (promoted != elem) {
+                set->erase(elem.get());
+                set->insert(promoted);
+            }
+        }
+    } else if (type == typeid(object::Deque)) {
+        auto deque = obj->cast<object::Deque>();
+        for (size_t i = 0; i < deque->size(); ++i) {
+            auto& slot = deque->_buffer[(deque->_head + i) & (deque->_buffer.size() - 1)];
+            slot = promote(slot);
+        }
+    } else if (type == typeid(object::PriorityQueue)) {
+        auto queue = obj->cast<object::PriorityQueue>();
+        for (auto& elem : queue->_heap) {
+            elem = promote(elem);
+        }
+    }
+}
+
+void Promoter::fix(object::Environment* env) {
+    for (auto& binding : env->_store) {
+        binding.second = promote(binding.second);
+    }
+}
+
+} // namespace region
+} // namespace autumn
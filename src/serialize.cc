@@ -0,0 +1,492 @@
+#include "serialize.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace autumn {
+namespace serialize {
+
+namespace {
+
+enum Tag : uint8_t {
+    NUL = 0,
+    FALSE,
+    TRUE,
+    INTEGER,
+    STRING,
+    ARRAY,
+    HASH,
+    RECORD,
+    SET,
+    DEQUE,
+    REF,
+};
+
+constexpr char MAGIC[] = {'A', 'U'};
+
+// 解码时的最大嵌套层数，防止构造的输入耗尽栈
+constexpr size_t MAX_DEPTH = 1000;
+
+// 超过该键数的 RECORD 按普通 hash 解码
+constexpr size_t MAX_RECORD_SIZE = 64;
+
+void put_varint(uint64_t value, std::string* out) {
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+void put_bytes(std::string_view bytes, std::string* out) {
+    put_varint(bytes.size(), out);
+    out->append(bytes);
+}
+
+class Writer {
+public:
+    explicit Writer(std::string* out) : _out(out) {}
+
+    // 成功时返回 nullptr
+    std::shared_ptr<object::Object> write(const object::Object* value) {
+        auto& type = typeid(*value);
+        if (type == typeid(object::Null)) {
+            _out->push_back(NUL);
+            return nullptr;
+        }
+        if (type == typeid(object::Boolean)) {
+            _out->push_back(value->cast<object::Boolean>()->value() ? TRUE : FALSE);
+            return nullptr;
+        }
+        if (type == typeid(object::Integer)) {
+            int64_t n = value->cast<object::Integer>()->value();
+            _out->push_back(INTEGER);
+            put_varint((static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63), _out);
+            return nullptr;
+        }
+        if (type != typeid(object::String)
+                && type != typeid(object::Array)
+                && type != typeid(object::Hash)
+                && type != typeid(object::Set)
+                && type != typeid(object::Deque)) {
+            return object::make<object::Error>(format("argument to `serialize` not supported, got {}", value->type()));
+        }
+
+        // 字符串和容器第二次出现时只写下标
+        auto it = _ids.find(value);
+        if (it != _ids.end()) {
+            _out->push_back(REF);
+            put_varint(it->second, _out);
+            return nullptr;
+        }
+        _ids.emplace(value, _ids.size());
+
+        if (type == typeid(object::String)) {
+            _out->push_back(STRING);
+            put_bytes(value->cast<object::String>()->value(), _out);
+            return nullptr;
+        }
+        if (type == typeid(object::Array)) {
+            auto elems = value->cast<object::Array>()->elements();
+            _out->push_back(ARRAY);
+            put_varint(elems.size(), _out);
+            return write_all(elems.begin(), elems.end());
+        }
+        if (type == typeid(object::Set)) {
+            auto elems = value->cast<object::Set>()->elements();
+            _out->push_back(SET);
+            put_varint(elems.size(), _out);
+            return write_all(elems.begin(), elems.end());
+        }
+        if (type == typeid(object::Deque)) {
+            auto deque = value->cast<object::Deque>();
+            _out->push_back(DEQUE);
+            put_varint(deque->size(), _out);
+            for (size_t i = 0; i < deque->size(); ++i) {
+                auto error = write(deque->at(i).get());
+                if (error != nullptr) {
+                    return error;
+                }
+            }
+            return nullptr;
+        }
+
+        auto hash = value->cast<object::Hash>();
+        std::shared_ptr<object::Object> error;
+        if (hash->storage() == object::Hash::SHAPED) {
+            auto shape = hash->shape();
+            _out->push_back(RECORD);
+            put_varint(shape->size(), _out);
+            for (size_t i = 0; i < shape->size(); ++i) {
+                put_bytes(shape->key(i)->cast<object::String>()->value(), _out);
+            }
+            return write_all(hash->slots().begin(), hash->slots().end());
+        }
+        _out->push_back(HASH);
+        put_varint(hash->size(), _out);
+        hash->for_each([this, &error](const std::shared_ptr<object::Object>& key,
+                const std::shared_ptr<object::Object>& value) {
+            if (error == nullptr) {
+                error = write(key.get());
+            }
+            if (error == nullptr) {
+                error = write(value.get());
+            }
+        });
+        return error;
+    }
+private:
+    template <typename It>
+    std::shared_ptr<object::Object> write_all(It begin, It end) {
+        for (auto it = begin; it != end; ++it) {
+            auto error = write(it->get());
+            if (error != nullptr) {
+                return error;
+            }
+        }
+        return nullptr;
+    }
+private:
+    std::string* _out;
+    std::unordered_map<const object::Object*, size_t> _ids;
+};
+
+} // namespace
+
+// 作为 String 和 Hash 的友元，直接构造字符串视图和 shape 方式的 hash
+class Reader {
+public:
+    Reader(std::string_view bytes, const std::shared_ptr<const object::String>& owner) :
+        _bytes(bytes) {
+        // 视图总是引用最底层的缓冲区，与 String::slice 一致
+        if (owner != nullptr) {
+            _owner = owner->_owner;
+            _pinned = owner->_pinned;
+            _string_owner = owner->_string_owner;
+            if (_owner == nullptr) {
+                _owner = owner;
+                _pinned = owner->_value.size();
+                _string_owner = true;
+            }
+        }
+    }
+
+    std::shared_ptr<object::Object> read() {
+        if (_bytes.size() < sizeof(MAGIC) + 1
+                || _bytes[0] != MAGIC[0]
+                || _bytes[1] != MAGIC[1]) {
+            fail("not serialized data");
+        } else if (static_cast<uint8_t>(_bytes[2]) != VERSION) {
+            fail("unsupported version");
+        } else {
+            _pos = sizeof(MAGIC) + 1;
+            auto ret = value(0);
+            if (_error == nullptr && _pos != _bytes.size()) {
+                fail("trailing bytes");
+            }
+            if (_error == nullptr) {
+                return ret;
+            }
+        }
+        return _error;
+    }
+private:
+    std::shared_ptr<object::Object> fail(const char* what) {
+        if (_error == nullptr) {
+            _error = object::make<object::Error>(format("deserialize: {} at offset {}", what, _pos));
+        }
+        return nullptr;
+    }
+
+    bool varint(uint64_t* out) {
+        uint64_t ret = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (_pos >= _bytes.size()) {
+                fail("truncated input");
+                return false;
+            }
+            auto byte = static_cast<uint8_t>(_bytes[_pos++]);
+            ret |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                *out = ret;
+                return true;
+            }
+        }
+        fail("varint too long");
+        return false;
+    }
+
+    // 读取元素个数，每个元素至少占 1 个字节，超过剩余字节数的个数一定不合法
+    bool count(uint64_t* out) {
+        if (!varint(out)) {
+            return false;
+        }
+        if (*out > _bytes.size() - _pos) {
+            fail("truncated input");
+            return false;
+        }
+        return true;
+    }
+
+    bool bytes(std::string_view* out) {
+        uint64_t length = 0;
+        if (!varint(&length)) {
+            return false;
+        }
+        if (length > _bytes.size() - _pos) {
+            fail("truncated input");
+            return false;
+        }
+        *out = _bytes.substr(_pos, length);
+        _pos += length;
+        return true;
+    }
+
+    std::shared_ptr<object::Object> string(std::string_view view) {
+        if (_owner == nullptr || view.size() <= object::SLICE_INLINE_SIZE) {
+            return object::String::make(view);
+        }
+        auto ret = object::make<object::String>(_owner, view.data(), view.size(), _pinned, utf8::is_ascii(view));
+        ret->_string_owner = _string_owner;
+        return ret;
+    }
+
+    std::shared_ptr<object::Object> value(size_t depth) {
+        if (depth > MAX_DEPTH) {
+            return fail("nesting too deep");
+        }
+        if (_pos >= _bytes.size()) {
+            return fail("truncated input");
+        }
+        auto tag = static_cast<uint8_t>(_bytes[_pos++]);
+        uint64_t n = 0;
+        switch (tag) {
+        case NUL:
+            return object::constants::Null;
+        case FALSE:
+            return object::constants::False;
+        case TRUE:
+            return object::constants::True;
+        case INTEGER:
+            if (!varint(&n)) {
+                return nullptr;
+            }
+            return object::make<object::Integer>(static_cast<int64_t>((n >> 1) ^ (~(n & 1) + 1)));
+        case REF:
+            if (!varint(&n)) {
+                return nullptr;
+            }
+            if (n >= _refs.size()) {
+                return fail("bad reference");
+            }
+            if (!referable(_refs[n].get())) {
+                return fail("cyclic reference without a deque");
+            }
+            return _refs[n];
+        case STRING: {
+            std::string_view view;
+            if (!bytes(&view)) {
+                return nullptr;
+            }
+            auto ret = string(view);
+            _refs.push_back(ret);
+            return ret;
+        }
+        case ARRAY: {
+            if (!count(&n)) {
+                return nullptr;
+            }
+            // 先登记再读元素，元素可以经由集合或双端队列引用回这个数组
+            auto ret = object::make<object::Array>();
+            open(ret);
+            ret->reserve(n);
+            for (uint64_t i = 0; i < n; ++i) {
+                auto elem = value(depth + 1);
+                if (elem == nullptr) {
+                    return nullptr;
+                }
+                ret->append(elem);
+            }
+            close();
+            return ret;
+        }
+        case HASH: {
+            if (!count(&n)) {
+                return nullptr;
+            }
+            auto ret = object::make<object::Hash>();
+            open(ret);
+            for (uint64_t i = 0; i < n; ++i) {
+                auto key = value(depth + 1);
+                if (key == nullptr) {
+                    return nullptr;
+                }
+                if (!object::Set::is_hashable(key.get())) {
+                    return fail("unusable as hash key");
+                }
+                auto val = value(depth + 1);
+                if (val == nullptr) {
+                    return nullptr;
+                }
+                ret->append(key, val);
+            }
+            close();
+            return ret;
+        }
+        case RECORD:
+            return record(depth);
+        case SET: {
+            if (!count(&n)) {
+                return nullptr;
+            }
+            auto ret = object::make<object::Set>();
+            open(ret);
+            for (uint64_t i = 0; i < n; ++i) {
+                auto elem = value(depth + 1);
+                if (elem == nullptr) {
+                    return nullptr;
+                }
+                if (!object::Set::is_hashable(elem.get())) {
+                    return fail("unusable as set key");
+                }
+                ret->insert(elem);
+            }
+            close();
+            return ret;
+        }
+        case DEQUE: {
+            if (!count(&n)) {
+                return nullptr;
+            }
+            auto ret = object::make<object::Deque>();
+            open(ret);
+            for (uint64_t i = 0; i < n; ++i) {
+                auto elem = value(depth + 1);
+                if (elem == nullptr) {
+                    return nullptr;
+                }
+                ret->push_back(elem);
+            }
+            close();
+            return ret;
+        }
+        default:
+            --_pos;
+            return fail("unknown tag");
+        }
+    }
+
+    // 登记正在构造的容器，元素中的 REF 可以指向它
+    void open(const std::shared_ptr<object::Object>& obj) {
+        _open.emplace(obj.get(), _frames.size());
+        _frames.push_back(obj.get());
+        if (typeid(*obj) == typeid(object::Deque)) {
+            _deques.push_back(_frames.size() - 1);
+        }
+        _refs.push_back(obj);
+    }
+
+    void close() {
+        if (!_deques.empty() && _deques.back() == _frames.size() - 1) {
+            _deques.pop_back();
+        }
+        _open.erase(_frames.back());
+        _frames.pop_back();
+    }
+
+    // 语言中不可变的数组和 hash 只能经由双端队列形成环，
+    // 引用一个还没构造完的数组或 hash 时，两者之间必须隔着一个双端队列
+    bool referable(const object::Object* obj) const {
+        auto it = _open.find(obj);
+        if (it == _open.end() || typeid(*obj) == typeid(object::Deque) || typeid(*obj) == typeid(object::Set)) {
+            return true;
+        }
+        return !_deques.empty() && _deques.back() > it->second;
+    }
+
+    std::shared_ptr<object::Object> record(size_t depth) {
+        uint64_t n = 0;
+        if (!count(&n)) {
+            return nullptr;
+        }
+        std::vector<std::string> keys;
+        keys.reserve(n);
+        for (uint64_t i = 0; i < n; ++i) {
+            std::string_view key;
+            if (!bytes(&key)) {
+                return nullptr;
+            }
+            keys.emplace_back(key);
+        }
+
+        // 与 hash 字面量相同：空的、有重复键的按普通 hash 处理
+        // shape 一旦创建就不会释放，解码只复用已经存在的 shape，不从不可信的输入新建，
+        // 没见过的键布局按普通 hash 解码
+        auto sorted = keys;
+        std::sort(sorted.begin(), sorted.end());
+        bool shaped = !keys.empty()
+            && keys.size() <= MAX_RECORD_SIZE
+            && std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end();
+
+        const object::Shape* shape = nullptr;
+        if (shaped) {
+            shape = object::Shape::lookup(keys);
+            shaped = shape != nullptr;
+        }
+
+        std::shared_ptr<object::Hash> ret;
+        if (shaped) {
+            ret = object::make<object::Hash>(shape,
+                    std::vector<std::shared_ptr<object::Object>>(n, object::constants::Null));
+        } else {
+            ret = object::make<object::Hash>();
+        }
+        open(ret);
+        for (uint64_t i = 0; i < n; ++i) {
+            auto val = value(depth + 1);
+            if (val == nullptr) {
+                return nullptr;
+            }
+            if (shaped) {
+                ret->_slots[i] = val;
+            } else {
+                ret->append(object::String::make(keys[i]), val);
+            }
+        }
+        close();
+        return ret;
+    }
+private:
+    std::string_view _bytes;
+    size_t _pos = 0;
+    std::shared_ptr<const void> _owner;
+    size_t _pinned = 0;
+    bool _string_owner = false;
+    std::vector<std::shared_ptr<object::Object>> _refs;
+    // 正在构造的容器（从外到内）、它们在 _frames 中的位置、其中双端队列的位置
+    std::vector<const object::Object*> _frames;
+    std::unordered_map<const object::Object*, size_t> _open;
+    std::vector<size_t> _deques;
+    std::shared_ptr<object::Object> _error;
+};
+
+std::shared_ptr<object::Object> encode(const object::Object* value, std::string* out) {
+    out->append(MAGIC, sizeof(MAGIC));
+    out->push_back(static_cast<char>(VERSION));
+    Writer writer(out);
+    return writer.write(value);
+}
+
+std::shared_ptr<object::Object> decode(std::string_view bytes) {
+    Reader reader(bytes, nullptr);
+    return reader.read();
+}
+
+std::shared_ptr<object::Object> decode(const std::shared_ptr<const object::String>& bytes, bool zero_copy) {
+    Reader reader(bytes->value(), zero_copy ? bytes : nullptr);
+    return reader.read();
+}
+
+} // namespace serialize
+} // namespace autumn
@@ -0,0 +1,254 @@
+#include "table.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "format.h"
+#include "object.h"
+
+namespace autumn {
+namespace table {
+
+namespace {
+
+constexpr char MAGIC[] = {'A', 'U', 'T', 'B'};
+
+struct Header {
+    char magic[4];
+    uint32_t version;
+    uint64_t rows;
+    uint64_t columns;
+};
+
+struct Entry {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t name_offset;
+    uint64_t name_size;
+    uint64_t data_offset;
+    uint64_t offsets_offset;
+};
+
+static_assert(sizeof(Header) == 24, "unexpected header layout");
+static_assert(sizeof(Entry) == 40, "unexpected column entry layout");
+
+// [offset, offset + size) 是否在文件内，不会溢出
+bool in_range(uint64_t offset, uint64_t size, size_t file_size) {
+    return offset <= file_size && size <= file_size - offset;
+}
+
+size_t align8(size_t n) {
+    return (n + 7) & ~static_cast<size_t>(7);
+}
+
+} // namespace
+
+Mapping::~Mapping() {
+    if (_base != nullptr) {
+        munmap(_base, _size);
+    }
+}
+
+std::shared_ptr<const Mapping> Mapping::open(const std::string& path, std::string* error) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        *error = format("cannot open {}: {}", path, strerror(errno));
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        *error = format("cannot stat {}: {}", path, strerror(errno));
+        close(fd);
+        return nullptr;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(Header)) {
+        *error = format("not a table file: {}", path);
+        close(fd);
+        return nullptr;
+    }
+    // 只读的共享映射，多个进程打开同一个文件时共用页缓存
+    void* base = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        *error = format("cannot map {}: {}", path, strerror(errno));
+        return nullptr;
+    }
+
+    std::shared_ptr<Mapping> ret(new Mapping());
+    ret->_base = base;
+    ret->_size = size;
+    auto bytes = static_cast<const char*>(base);
+
+    Header header;
+    memcpy(&header, bytes, sizeof(header));
+    if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        *error = format("not a table file: {}", path);
+        return nullptr;
+    }
+    if (header.version != VERSION) {
+        *error = format("unsupported table version {}: {}", header.version, path);
+        return nullptr;
+    }
+    if (header.columns > (size - sizeof(Header)) / sizeof(Entry)) {
+        *error = format("corrupt table {}: column directory out of range", path);
+        return nullptr;
+    }
+    ret->_rows = header.rows;
+
+    std::vector<std::string> names;
+    for (uint64_t i = 0; i < header.columns; ++i) {
+        Entry entry;
+        memcpy(&entry, bytes + sizeof(Header) + i * sizeof(Entry), sizeof(entry));
+        if (!in_range(entry.name_offset, entry.name_size, size)) {
+            *error = format("corrupt table {}: column {} name out of range", path, i);
+            return nullptr;
+        }
+
+        Column column;
+        column.name.assign(bytes + entry.name_offset, entry.name_size);
+        column.type = static_cast<ColumnType>(entry.type);
+        if (column.type == INT64) {
+            if (entry.data_offset % 8 != 0
+                    || header.rows > size / 8
+                    || !in_range(entry.data_offset, header.rows * 8, size)) {
+                *error = format("corrupt table {}: column `{}` out of range", path, column.name);
+                return nullptr;
+            }
+            column.data = bytes + entry.data_offset;
+            column.data_size = header.rows * 8;
+        } else if (column.type == STRING) {
+            if (entry.offsets_offset % 8 != 0
+                    || header.rows >= size / 8
+                    || !in_range(entry.offsets_offset, (header.rows + 1) * 8, size)) {
+                *error = format("corrupt table {}: column `{}` out of range", path, column.name);
+                return nullptr;
+            }
+            column.offsets = reinterpret_cast<const uint64_t*>(bytes + entry.offsets_offset);
+            // 最后一个偏移就是字节区的长度
+            uint64_t data_size = column.offsets[header.rows];
+            if (!in_range(entry.data_offset, data_size, size)) {
+                *error = format("corrupt table {}: column `{}` out of range", path, column.name);
+                return nullptr;
+            }
+            column.data = bytes + entry.data_offset;
+            column.data_size = data_size;
+        } else {
+            *error = format("corrupt table {}: column `{}` has unknown type {}", path, column.name, entry.type);
+            return nullptr;
+        }
+        names.push_back(column.name);
+        ret->_columns.push_back(std::move(column));
+    }
+
+    // 与 hash 字面量相同：空的、有重复键的不使用 shape
+    // 列名来自文件，和 deserialize 一样只复用已有的 shape（程序中同样键序列的 hash 字面量），
+    // 不让文件内容在全局的 shape 表里留下永不释放的条目；找不到时行对象使用普通的 hash
+    auto sorted = names;
+    std::sort(sorted.begin(), sorted.end());
+    if (!names.empty() && std::adjacent_find(sorted.begin(), sorted.end()) == sorted.end()) {
+        ret->_shape = object::Shape::lookup(names);
+    }
+    return ret;
+}
+
+int Mapping::find(std::string_view name) const {
+    for (size_t i = 0; i < _columns.size(); ++i) {
+        if (_columns[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+Span<int64_t> Mapping::integers(size_t column) const {
+    auto& c = _columns[column];
+    if (c.type != INT64) {
+        return {};
+    }
+    return {reinterpret_cast<const int64_t*>(c.data), _rows};
+}
+
+bool Mapping::string(size_t column, size_t row, std::string_view* out) const {
+    auto& c = _columns[column];
+    uint64_t begin = c.offsets[row];
+    uint64_t end = c.offsets[row + 1];
+    if (begin > end || end > c.data_size) {
+        return false;
+    }
+    *out = std::string_view(c.data + begin, end - begin);
+    return true;
+}
+
+bool write(const std::string& path, const std::vector<ColumnData>& columns, std::string* error) {
+    uint64_t rows = 0;
+    for (size_t i = 0; i < columns.size(); ++i) {
+        auto& c = columns[i];
+        uint64_t n = c.type == INT64 ? c.integers.size() : c.strings.size();
+        if (i == 0) {
+            rows = n;
+        } else if (n != rows) {
+            *error = format("column `{}` has {} rows, expected {}", c.name, n, rows);
+            return false;
+        }
+    }
+
+    // 先排好每一段的位置：文件头、列目录、列名，然后每列的数据
+    std::string out(sizeof(Header) + columns.size() * sizeof(Entry), '\0');
+    std::vector<Entry> entries(columns.size());
+    for (size_t i = 0; i < columns.size(); ++i) {
+        entries[i].type = columns[i].type;
+        entries[i].reserved = 0;
+        entries[i].name_offset = out.size();
+        entries[i].name_size = columns[i].name.size();
+        out.append(columns[i].name);
+    }
+    for (size_t i = 0; i < columns.size(); ++i) {
+        auto& c = columns[i];
+        out.resize(align8(out.size()), '\0');
+        if (c.type == INT64) {
+            entries[i].data_offset = out.size();
+            entries[i].offsets_offset = 0;
+            out.append(reinterpret_cast<const char*>(c.integers.data()), c.integers.size() * sizeof(int64_t));
+            continue;
+        }
+        std::vector<uint64_t> offsets;
+        offsets.reserve(c.strings.size() + 1);
+        uint64_t offset = 0;
+        offsets.push_back(offset);
+        for (auto& s : c.strings) {
+            offset += s.size();
+            offsets.push_back(offset);
+        }
+        entries[i].offsets_offset = out.size();
+        out.append(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        entries[i].data_offset = out.size();
+        for (auto& s : c.strings) {
+            out.append(s);
+        }
+    }
+
+    Header header;
+    memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.rows = rows;
+    header.columns = columns.size();
+    memcpy(&out[0], &header, sizeof(header));
+    memcpy(&out[sizeof(Header)], entries.data(), entries.size() * sizeof(Entry));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(out.data(), out.size());
+    if (!file) {
+        *error = format("failed to write: {}", path);
+        return false;
+    }
+    return true;
+}
+
+} // namespace table
+} // namespace autumn
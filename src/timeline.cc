@@ -0,0 +1,177 @@
+#include "timeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "utf8.h"
+
+namespace autumn {
+namespace timeline {
+
+namespace internal {
+std::atomic<bool> g_enabled{false};
+}
+
+namespace {
+
+struct Event {
+    const char* category;
+    uint64_t begin_ns;
+    uint64_t dur_ns;
+    uint8_t name_length;
+    char name[64];
+};
+
+// 固定大小的事件块，写满后分配新的块
+struct Chunk {
+    static constexpr size_t CAPACITY = 4096;
+    Event events[CAPACITY];
+    std::atomic<size_t> size{0};
+    std::atomic<Chunk*> next{nullptr};
+};
+
+// 每个线程一个缓冲区，只有所属线程写入
+// 线程退出后缓冲区仍然保留，直到进程结束
+struct ThreadBuffer {
+    int tid = 0;
+    Chunk head;
+    Chunk* tail = &head;
+};
+
+std::mutex s_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> s_buffers;
+std::string s_path;
+uint64_t s_threshold_ns = 100 * 1000;
+uint64_t s_origin_ns = now_ns();
+
+ThreadBuffer* thread_buffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        // 每个线程只在第一次记录时加锁注册
+        std::lock_guard<std::mutex> lock(s_mutex);
+        s_buffers.emplace_back(new ThreadBuffer);
+        buffer = s_buffers.back().get();
+        buffer->tid = static_cast<int>(s_buffers.size());
+    }
+    return buffer;
+}
+
+void write_escaped(std::ostream& out, const char* str, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        char c = str[i];
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out << ' ';
+        } else {
+            out << c;
+        }
+    }
+}
+
+void flush_at_exit() {
+    flush(s_path);
+}
+
+// 通过环境变量开启
+struct EnvInitializer {
+    EnvInitializer() {
+        const char* threshold = getenv("AUTUMN_TIMELINE_THRESHOLD_US");
+        if (threshold != nullptr) {
+            s_threshold_ns = strtoull(threshold, nullptr, 10) * 1000;
+        }
+
+        const char* path = getenv("AUTUMN_TIMELINE");
+        if (path != nullptr && path[0] != '\0') {
+            enable(path);
+        }
+    }
+} s_env_initializer;
+
+}
+
+void enable(const std::string& path) {
+    std::lock_guard<std::mutex> lock(s_mutex);
+    if (s_path.empty()) {
+        atexit(flush_at_exit);
+    }
+    s_path = path;
+    internal::g_enabled.store(true, std::memory_order_relaxed);
+}
+
+uint64_t threshold_ns() {
+    return s_threshold_ns;
+}
+
+void record(const char* category, std::string_view name, uint64_t begin_ns, uint64_t end_ns) {
+    auto buffer = thread_buffer();
+    auto chunk = buffer->tail;
+    size_t size = chunk->size.load(std::memory_order_relaxed);
+    if (size == Chunk::CAPACITY) {
+        auto next = new Chunk;
+        chunk->next.store(next, std::memory_order_release);
+        buffer->tail = next;
+        chunk = next;
+        size = 0;
+    }
+
+    auto& event = chunk->events[size];
+    event.category = category;
+    event.begin_ns = begin_ns;
+    event.dur_ns = end_ns - begin_ns;
+    size_t length = std::min(name.size(), sizeof(event.name));
+    // 截断时不拆开 UTF-8 字符
+    while (length < name.size() && length > 0 && utf8::is_continuation(name[length])) {
+        --length;
+    }
+    event.name_length = static_cast<uint8_t>(length);
+    std::memcpy(event.name, name.data(), event.name_length);
+    // 先写事件再发布 size，flush 只读取已发布的事件
+    chunk->size.store(size + 1, std::memory_order_release);
+}
+
+bool flush(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(s_mutex);
+    out << std::fixed << std::setprecision(3);
+    out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+    bool first = true;
+    for (auto& buffer : s_buffers) {
+        for (const Chunk* chunk = &buffer->head;
+                chunk != nullptr;
+                chunk = chunk->next.load(std::memory_order_acquire)) {
+            size_t size = chunk->size.load(std::memory_order_acquire);
+            for (size_t i = 0; i < size; ++i) {
+                auto& event = chunk->events[i];
+                if (!first) {
+                    out << ",\n";
+                }
+                first = false;
+                // ts 和 dur 的单位是微秒
+                out << R"({"name":")";
+                write_escaped(out, event.name, event.name_length);
+                out << R"(","cat":")" << event.category
+                    << R"(","ph":"X","pid":1,"tid":)" << buffer->tid
+                    << R"(,"ts":)" << (event.begin_ns - s_origin_ns) / 1000.0
+                    << R"(,"dur":)" << event.dur_ns / 1000.0
+                    << '}';
+            }
+        }
+    }
+    out << "]}\n";
+    return static_cast<bool>(out);
+}
+
+} // namespace timeline
+} // namespace autumn
@@ -9,6 +9,7 @@ std::map<std::string, Token::Type> Token::keywords = {
     {"if", Token::IF},
     {"else", Token::ELSE},
     {"return", Token::RETURN},
+    {"import", Token::IMPORT},
 };
 
 static std::map<Token::Type, std::string> s_token_type = {
@@ -43,6 +44,7 @@ static std::map<Token::Type, std::string> s_token_type = {
     {Token::IF, "IF"},
     {Token::ELSE, "ELSE"},
     {Token::RETURN, "RETURN"},
+    {Token::IMPORT, "IMPORT"},
     {Token::STRING, "STRING"},
     {Token::END, "END"},
 };
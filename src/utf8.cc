@@ -0,0 +1,77 @@
+#include "utf8.h"
+
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace autumn {
+namespace utf8 {
+
+bool is_ascii(std::string_view str) {
+    const char* p = str.data();
+    size_t n = str.size();
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    // 最高位为 1 的字节不是 ASCII，movemask 一次收集 16 个字节的最高位
+    __m128i acc = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        acc = _mm_or_si128(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i)));
+    }
+    if (_mm_movemask_epi8(acc) != 0) {
+        return false;
+    }
+#endif
+
+    uint64_t word_acc = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, p + i, sizeof(word));
+        word_acc |= word;
+    }
+    for (; i < n; ++i) {
+        word_acc |= static_cast<unsigned char>(p[i]);
+    }
+    return (word_acc & 0x8080808080808080ULL) == 0;
+}
+
+size_t length(std::string_view str) {
+    size_t count = 0;
+    for (char c : str) {
+        count += !is_continuation(c);
+    }
+    return count;
+}
+
+size_t advance(std::string_view str, size_t offset, size_t n) {
+    while (n > 0 && offset < str.size()) {
+        ++offset;
+        while (offset < str.size() && is_continuation(str[offset])) {
+            ++offset;
+        }
+        --n;
+    }
+    return offset;
+}
+
+size_t build_index(std::string_view str, std::vector<uint32_t>* index) {
+    index->clear();
+    index->reserve(str.size() / INDEX_STRIDE + 1);
+
+    size_t count = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+        if (is_continuation(str[i])) {
+            continue;
+        }
+        if (count % INDEX_STRIDE == 0) {
+            index->push_back(static_cast<uint32_t>(i));
+        }
+        ++count;
+    }
+    return count;
+}
+
+} // namespace utf8
+} // namespace autumn
@@ -0,0 +1,169 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "async_io.h"
+#include "evaluator.h"
+
+using namespace autumn;
+using namespace autumn::object;
+
+namespace {
+
+std::string run(Evaluator& evaluator, const std::string& input) {
+    auto obj = evaluator.eval(input);
+    if (obj == nullptr) {
+        return std::string();
+    }
+    auto error = obj->cast<Error>();
+    return error != nullptr ? error->message() : obj->inspect();
+}
+
+// 测试用的一组临时文件，结束时删除
+class TempFiles {
+public:
+    TempFiles(const std::string& name, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            auto path = format("/tmp/autumn_async_io_test_{}_{}_{}", getpid(), name, i);
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out << "file " << i;
+            _paths.push_back(path);
+        }
+    }
+
+    ~TempFiles() {
+        for (auto& path : _paths) {
+            std::remove(path.c_str());
+        }
+    }
+
+    const std::string& operator[](size_t i) const {
+        return _paths[i];
+    }
+
+    size_t size() const {
+        return _paths.size();
+    }
+private:
+    std::vector<std::string> _paths;
+};
+
+// 两种实现的行为相同；请求数超过环的大小时排队
+void check_reader(async_io::Reader& reader) {
+    TempFiles files(reader.backend(), 600);
+    std::string large(1 << 20, 'x');
+    {
+        std::ofstream out(files[0], std::ios::binary | std::ios::trunc);
+        out << large;
+    }
+
+    std::vector<std::shared_ptr<async_io::Request>> requests;
+    for (size_t i = 0; i < files.size(); ++i) {
+        requests.push_back(reader.submit(files[i]));
+    }
+    // /proc 下的文件 st_size 为 0，按块读到末尾
+    requests.push_back(reader.submit("/proc/self/status"));
+    requests.push_back(reader.submit(files[0] + ".missing"));
+    reader.wait(requests);
+
+    EXPECT_EQ(large, requests[0]->data());
+    for (size_t i = 1; i < files.size(); ++i) {
+        ASSERT_TRUE(requests[i]->done());
+        EXPECT_EQ(0, requests[i]->error());
+        EXPECT_EQ(format("file {}", i), requests[i]->data());
+    }
+    auto& status = requests[files.size()];
+    EXPECT_EQ(0, status->error());
+    EXPECT_EQ(0u, status->data().find("Name:"));
+    EXPECT_EQ(ENOENT, requests.back()->error());
+    EXPECT_TRUE(requests.back()->data().empty());
+}
+
+TEST(AsyncIO, TestUring) {
+    std::string error;
+    auto reader = async_io::create_uring(8, &error);
+    if (reader == nullptr) {
+        GTEST_SKIP() << error;
+    }
+    EXPECT_STREQ("io_uring", reader->backend());
+    check_reader(*reader);
+}
+
+TEST(AsyncIO, TestThreadPool) {
+    auto reader = async_io::create_thread_pool(4);
+    EXPECT_STREQ("threads", reader->backend());
+    check_reader(*reader);
+}
+
+// 析构时等待在途的请求，句柄仍然有效
+TEST(AsyncIO, TestDestroyWhilePending) {
+    TempFiles files("destroy", 20);
+    std::vector<std::shared_ptr<async_io::Request>> requests;
+    {
+        std::string error;
+        auto reader = async_io::create_uring(4, &error);
+        if (reader == nullptr) {
+            reader = async_io::create_thread_pool(2);
+        }
+        for (size_t i = 0; i < files.size(); ++i) {
+            requests.push_back(reader->submit(files[i]));
+        }
+    }
+    for (size_t i = 0; i < files.size(); ++i) {
+        ASSERT_TRUE(requests[i]->done());
+        EXPECT_EQ(format("file {}", i), requests[i]->data());
+    }
+}
+
+TEST(AsyncIO, TestBuiltins) {
+    TempFiles files("builtins", 3);
+    std::string long_text = "a file longer than the inline string size";
+    {
+        std::ofstream out(files[2], std::ios::binary | std::ios::trunc);
+        out << long_text;
+    }
+
+    Evaluator evaluator;
+    evaluator.eval(format(R"(let dir = "{}";)", files[0].substr(0, files[0].size() - 1)));
+    evaluator.eval(R"(let hs = [read_async(dir + "0"), read_async(dir + "1"), read_async(dir + "2")];)");
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {"wait_all(hs)", format(R"(["file 0", "file 1", "{}"])", long_text)},
+        // 可以重复等待
+        {"wait_all([hs[1]])[0]", R"("file 1")"},
+        {"wait_all([])", "[]"},
+        {"hs[0]", format("read_async({}, done)", files[0])},
+        {R"(wait_all([hs[0], read_async(dir + "missing")]))",
+            format("wait_all: cannot read {}missing: No such file or directory", files[0].substr(0, files[0].size() - 1))},
+        {"read_async(1)", "argument to `read_async` not supported, got INTEGER"},
+        {"read_async()", "wrong number of arguments. expected 1, got 0"},
+        {"wait_all(hs[0])", "argument to `wait_all` not supported, got ASYNC_READ"},
+        {"wait_all([1])", "argument to `wait_all` not supported, got INTEGER"},
+        {"freeze(hs)", "argument to `freeze` not supported, got ASYNC_READ"},
+    };
+    for (auto& test : tests) {
+        EXPECT_EQ(std::get<1>(test), run(evaluator, std::get<0>(test))) << std::get<0>(test);
+    }
+
+    // 长内容是请求缓冲区的视图
+    auto contents = evaluator.eval("wait_all(hs)");
+    auto handle = evaluator.eval("hs[2]");
+    auto str = contents->cast<Array>()->elements()[2]->cast<String>();
+    EXPECT_EQ(handle->cast<AsyncRead>()->request()->data().data(), str->value().data());
+}
+
+// 区域模式下逃逸的句柄被提升到堆上，仍然引用同一个请求
+TEST(AsyncIO, TestRegion) {
+    TempFiles files("region", 1);
+    Evaluator evaluator;
+    evaluator.set_region_mode(true);
+    evaluator.eval(format(R"(let h = read_async("{}");)", files[0]));
+    auto h = evaluator._env->get("h");
+    ASSERT_FALSE(evaluator._region->contains(h.get()));
+    evaluator.eval("[1, 2, 3]");
+    EXPECT_EQ(R"(["file 0"])", run(evaluator, "wait_all([h])"));
+}
+
+}
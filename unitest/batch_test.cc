@@ -0,0 +1,149 @@
+#include <limits>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "batch.h"
+
+using namespace autumn;
+
+namespace {
+
+std::vector<std::string> row_results(const BatchResult& result) {
+    std::vector<std::string> ret;
+    for (size_t i = 0; i < result.size(); ++i) {
+        auto obj = result.at(i);
+        auto error = obj->cast<object::Error>();
+        ret.push_back(error != nullptr ? error->message() : obj->inspect());
+    }
+    return ret;
+}
+
+TEST(Batch, TestVectorized) {
+    std::vector<int64_t> price = {10, 20, 30, 40};
+    std::vector<int64_t> qty = {1, 2, 3, 4};
+    std::vector<int64_t> limit = {15, 15, 100, 100};
+
+    std::vector<std::tuple<std::string, BatchResult::Kind, std::vector<int64_t>>> tests = {
+        {"price * qty > limit", BatchResult::BOOLEAN, {0, 1, 0, 1}},
+        {"price + qty + limit", BatchResult::INTEGER, {26, 37, 133, 144}},
+        {"-price / 3 + 1", BatchResult::INTEGER, {-2, -5, -9, -12}},
+        {"(qty >= 2) == (price != 30)", BatchResult::BOOLEAN, {0, 1, 0, 1}},
+        {"!(qty < 3)", BatchResult::BOOLEAN, {0, 0, 1, 1}},
+        {"2 * 3", BatchResult::INTEGER, {6, 6, 6, 6}},
+        {"qty", BatchResult::INTEGER, {1, 2, 3, 4}},
+    };
+
+    for (auto& test : tests) {
+        std::vector<std::string> errors;
+        auto exp = BatchExpression::compile(std::get<0>(test), &errors);
+        ASSERT_TRUE(exp != nullptr);
+        EXPECT_TRUE(exp->vectorized()) << std::get<0>(test);
+
+        std::vector<Span<int64_t>> columns;
+        for (auto& name : exp->variables()) {
+            auto& column = name == "price" ? price : (name == "qty" ? qty : limit);
+            columns.emplace_back(column.data(), column.size());
+        }
+        auto result = exp->eval(columns, 4);
+        EXPECT_EQ(std::get<1>(test), result.kind);
+        EXPECT_EQ(std::get<2>(test), result.values);
+        // 与逐行求值的结果一致
+        EXPECT_EQ(row_results(exp->eval_rows(columns, 4)), row_results(result));
+    }
+}
+
+// 列和结果都是 64 位整数
+TEST(Batch, TestInt64Columns) {
+    std::vector<int64_t> a = {5000000000LL, -3000000000LL};
+    std::vector<int64_t> b = {3, 2};
+    std::vector<Span<int64_t>> columns = {
+        Span<int64_t>(a.data(), a.size()),
+        Span<int64_t>(b.data(), b.size()),
+    };
+
+    std::vector<std::string> errors;
+    auto exp = BatchExpression::compile("a * b + 1", &errors);
+    ASSERT_TRUE(exp != nullptr);
+    EXPECT_TRUE(exp->vectorized());
+    auto result = exp->eval(columns, 2);
+    EXPECT_EQ(BatchResult::INTEGER, result.kind);
+    std::vector<int64_t> expect = {15000000001LL, -5999999999LL};
+    EXPECT_EQ(expect, result.values);
+    EXPECT_EQ(row_results(exp->eval_rows(columns, 2)), row_results(result));
+}
+
+TEST(Batch, TestFallback) {
+    std::vector<int64_t> a = {1, 0, 3};
+    std::vector<int64_t> b = {2, 2, 0};
+    std::vector<Span<int64_t>> columns = {
+        Span<int64_t>(a.data(), a.size()),
+        Span<int64_t>(b.data(), b.size()),
+    };
+
+    std::vector<std::tuple<std::string, std::vector<std::string>>> tests = {
+        {"if (a > b) { a } else { b }", {"2", "2", "3"}},
+        {"a + b + true", {
+            "type mismatch: `INTEGER + BOOLEAN`",
+            "type mismatch: `INTEGER + BOOLEAN`",
+            "type mismatch: `INTEGER + BOOLEAN`",
+        }},
+        {"len([a, b, 1])", {"3", "3", "3"}},
+    };
+
+    for (auto& test : tests) {
+        std::vector<std::string> errors;
+        auto exp = BatchExpression::compile(std::get<0>(test), &errors);
+        ASSERT_TRUE(exp != nullptr);
+        EXPECT_FALSE(exp->vectorized());
+        std::vector<std::string> expect_variables = {"a", "b"};
+        EXPECT_EQ(expect_variables, exp->variables());
+
+        auto result = exp->eval(columns, 3);
+        EXPECT_EQ(BatchResult::OBJECT, result.kind);
+        EXPECT_EQ(std::get<1>(test), row_results(result));
+    }
+
+    // 除数为 0 时退回逐行求值
+    std::vector<std::string> errors;
+    auto exp = BatchExpression::compile("b / a", &errors);
+    ASSERT_TRUE(exp != nullptr);
+    EXPECT_TRUE(exp->vectorized());
+    std::vector<Span<int64_t>> divisor = { Span<int64_t>(b.data(), b.size()), Span<int64_t>(a.data(), a.size()) };
+    auto result = exp->eval(divisor, 1);
+    EXPECT_EQ(BatchResult::INTEGER, result.kind);
+}
+
+TEST(Batch, TestDivisionError) {
+    std::vector<int64_t> a = {6, 6, std::numeric_limits<int64_t>::min()};
+    std::vector<int64_t> b = {3, 0, -1};
+    std::vector<Span<int64_t>> columns = {
+        Span<int64_t>(a.data(), a.size()),
+        Span<int64_t>(b.data(), b.size()),
+    };
+
+    std::vector<std::string> errors;
+    auto exp = BatchExpression::compile("a / b", &errors);
+    ASSERT_TRUE(exp != nullptr);
+    EXPECT_TRUE(exp->vectorized());
+
+    auto result = exp->eval(columns, 2);
+    EXPECT_EQ(BatchResult::OBJECT, result.kind);
+    std::vector<std::string> expect = {"2", "division by zero: `6 / 0`"};
+    EXPECT_EQ(expect, row_results(result));
+
+    result = exp->eval(columns, 3);
+    expect.push_back("integer overflow: `-9223372036854775808 / -1`");
+    EXPECT_EQ(expect, row_results(result));
+}
+
+TEST(Batch, TestCompileError) {
+    std::vector<std::string> errors;
+    EXPECT_TRUE(BatchExpression::compile("let x = 1;", &errors) == nullptr);
+    EXPECT_EQ(1u, errors.size());
+
+    errors.clear();
+    EXPECT_TRUE(BatchExpression::compile("a +", &errors) == nullptr);
+    EXPECT_FALSE(errors.empty());
+}
+
+}
@@ -1,5 +1,6 @@
 #include <any>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <gtest/gtest.h>
 #include "evaluator.h"
@@ -42,6 +43,8 @@ TEST(Builtin, TestLen) {
     std::vector<std::tuple<std::string, std::any>> tests = {
         {R"(len(""))", 0},
         {R"(len("hello world"))", 11},
+        {R"(len("秋天"))", 2},
+        {R"(len("autumn 秋天 🍂"))", 11},
         {R"(len(1))", "argument to `len` not supported, got INTEGER"},
         {R"(len("one", "two"))", "wrong number of arguments. expected 1, got 2"},
         {R"(len([1, 2, 3]))", 3},
@@ -156,8 +159,260 @@ TEST(Builtin, TestPush) {
     }
 }
 
+void test_inspect(const std::vector<std::tuple<std::string, std::string>>& tests) {
+    Evaluator evaluator;
+
+    for (auto& test : tests) {
+        auto& input = std::get<0>(test);
+        auto& expect = std::get<1>(test);
+
+        evaluator.reset_env();
+        auto object = evaluator.eval(input);
+        auto error = object->cast<Error>();
+        EXPECT_EQ(expect, error != nullptr ? error->message() : object->inspect()) << input;
+    }
+}
+
+TEST(Builtin, TestSet) {
+    test_inspect({
+        {"let s = set([1, 2, 2, 3]); len(s)", "3"},
+        {"let s = set(); add(s, 1)", "true"},
+        {"let s = set([1]); add(s, 1)", "false"},
+        {R"(let s = set(["a", 1, true]); [has(s, "a"), has(s, 1), has(s, true), has(s, "1"), has(s, false)])",
+            "[true, true, true, false, false]"},
+        {"let s = set([1, 2]); [remove(s, 1), remove(s, 1), has(s, 1), has(s, 2), len(s)]",
+            "[true, false, false, true, 1]"},
+        {"let s = set([5]); remove(s, 5); add(s, 5); to_array(s)", "[5]"},
+        {"set([fn(x) { x }])", "unusable as set key: FUNCTION"},
+        {"add([], 1)", "argument to `add` not supported, got ARRAY"},
+    });
+
+    // 扩容和墓碑复用
+    Evaluator evaluator;
+    auto object = evaluator.eval(R"(
+        let s = set();
+        let fill = fn(i, n) { if (i < n) { add(s, i * 1024); fill(i + 1, n) } };
+        fill(0, 300);
+        let drop = fn(i, n) { if (i < n) { remove(s, i * 1024); drop(i + 2, n) } };
+        drop(0, 300);
+        fill(0, 300);
+        [len(s), has(s, 299 * 1024), has(s, 1)]
+    )");
+    EXPECT_EQ("[300, true, false]", object->inspect());
+}
+
+TEST(Builtin, TestDeque) {
+    test_inspect({
+        {"let d = deque([1, 2]); push_front(d, 0); push_back(d, 3)", "deque([0, 1, 2, 3])"},
+        {"let d = deque([1, 2, 3]); [pop_front(d), pop_back(d), len(d)]", "[1, 3, 1]"},
+        {"let d = deque(); [pop_front(d), pop_back(d), first(d), last(d)]", "[null, null, null, null]"},
+        {"let d = deque([1, 2, 3]); [first(d), last(d)]", "[1, 3]"},
+        {"pop_front([1])", "argument to `pop_front` not supported, got ARRAY"},
+    });
+
+    // 环形缓冲区在回绕后扩容
+    Evaluator evaluator;
+    auto object = evaluator.eval(R"(
+        let d = deque();
+        let step = fn(i, n) {
+            if (i < n) {
+                push_back(d, i);
+                push_front(d, -i);
+                if (i - (i / 3) * 3 == 0) { pop_back(d); }
+                step(i + 1, n)
+            }
+        };
+        step(1, 20);
+        [len(d), first(d), last(d)]
+    )");
+    EXPECT_EQ("[32, -19, 19]", object->inspect());
+}
+
+TEST(Builtin, TestPriorityQueue) {
+    test_inspect({
+        {"let q = priority_queue(); pq_push(q, 5); pq_push(q, 1); pq_push(q, 3); [pq_pop(q), pq_pop(q), pq_top(q), len(q)]",
+            "[1, 3, 5, 1]"},
+        {R"(let q = priority_queue(); pq_push(q, "b"); pq_push(q, "a"); pq_pop(q))", R"("a")"},
+        {"let q = priority_queue(fn(a, b) { a > b }); pq_push(q, 1); pq_push(q, 7); pq_push(q, 4); [pq_pop(q), pq_pop(q), pq_pop(q), pq_pop(q)]",
+            "[7, 4, 1, null]"},
+        // 按数组第一个元素排序
+        {"let q = priority_queue(fn(a, b) { a[0] < b[0] }); pq_push(q, [3, \"c\"]); pq_push(q, [1, \"a\"]); pq_pop(q)[1]",
+            R"("a")"},
+        {"let q = priority_queue(); pq_push(q, 1); pq_push(q, true)", "priority_queue: cannot compare BOOLEAN and INTEGER"},
+        {"let q = priority_queue(fn(a, b) { a + true }); pq_push(q, 1); pq_push(q, 2)", "type mismatch: `INTEGER + BOOLEAN`"},
+        {"priority_queue(1)", "argument to `priority_queue` not supported, got INTEGER"},
+        // 比较函数修改同一个队列时报错，而不是在调整到一半的堆上操作
+        {"let q = priority_queue(fn(a, b) { pq_push(q, 0); a < b }); pq_push(q, 3); pq_push(q, 1)",
+            "priority_queue: modified by its own comparator"},
+        {R"(let f = deque();
+            let q = priority_queue(fn(a, b) { if (len(f) > 0) { pq_pop(q) } else { a < b } });
+            pq_push(q, 3); pq_push(q, 1); pq_push(q, 2); push_back(f, 1); pq_pop(q))",
+            "priority_queue: modified by its own comparator"},
+    });
+}
+
+TEST(Builtin, TestFreeze) {
+    test_inspect({
+        {R"(let t = freeze([1, {"a": [2, 3]}, "x"]); t[1]["a"][1])", "3"},
+        {"let s = freeze(set([1, 2])); [has(s, 2), len(s)]", "[true, 2]"},
+        {"let s = freeze(set([1])); add(s, 2)", "argument to `add` is frozen, got SET"},
+        {"let s = freeze(set([1])); remove(s, 1)", "argument to `remove` is frozen, got SET"},
+        {"let d = freeze(deque([1])); push_back(d, 2)", "argument to `push_back` is frozen, got DEQUE"},
+        {"let d = freeze(deque([1])); pop_front(d)", "argument to `pop_front` is frozen, got DEQUE"},
+        {"let q = priority_queue(); pq_push(q, 1); freeze(q); pq_pop(q)", "argument to `pq_pop` is frozen, got PRIORITY_QUEUE"},
+        // 冻结是深度的：嵌套的容器也不能修改
+        {"let a = freeze([set([1])]); add(a[0], 2)", "argument to `add` is frozen, got SET"},
+        // 闭包捕获的环境可变，不能冻结
+        {"freeze([1, fn(x) { x }])", "argument to `freeze` not supported, got FUNCTION"},
+        {"freeze()", "wrong number of arguments. expected 1, got 0"},
+    });
+
+    // 失败时图保持原样
+    Evaluator evaluator;
+    evaluator.eval("let s = set([1]);");
+    evaluator.eval("freeze([s, fn(x) { x }])");
+    EXPECT_EQ("true", evaluator.eval("add(s, 2)")->inspect());
+}
+
+// prelude 中冻结的常量表被多个线程的求值器共享
+TEST(Builtin, TestFreezeShareAcrossThreads) {
+    Evaluator prelude;
+    prelude.eval(R"(
+        let table = [10, 20, 30, {"name": "秋天的风", "code": 7}];
+        let limits = {"max": 100, "min": 1};
+        let inc = fn(x) { x + 1 };
+    )");
+    ASSERT_EQ(2u, prelude.freeze_globals());
+    ASSERT_TRUE(prelude._env->get("table")->frozen());
+    ASSERT_FALSE(prelude._env->get("inc")->frozen());
+
+    std::vector<std::string> results(4);
+    std::vector<std::thread> threads;
+    // prelude 所在的线程继续定义新的全局变量，share_globals 只读取发布的快照
+    threads.emplace_back([&prelude]() {
+        for (int round = 0; round < 200; ++round) {
+            prelude.eval("let v" + std::to_string(round) + " = " + std::to_string(round) + ";");
+        }
+    });
+    for (size_t i = 0; i < results.size(); ++i) {
+        threads.emplace_back([&prelude, &results, i]() {
+            Evaluator evaluator;
+            std::string last;
+            for (int round = 0; round < 200; ++round) {
+                evaluator.share_globals(prelude);
+                auto obj = evaluator.eval(R"([table[1], table[3]["name"][1], limits["max"], len(table)])");
+                last = obj->inspect();
+            }
+            results[i] = last;
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    for (auto& result : results) {
+        EXPECT_EQ(R"([20, "天", 100, 4])", result);
+    }
+
+    // 读到的冻结值借用本线程的锚点，不触碰对象自身的引用计数
+    Evaluator evaluator;
+    evaluator.share_globals(prelude);
+    auto table = prelude._env->get("table");
+    auto count = table.use_count();
+    auto obj = evaluator.eval("table");
+    EXPECT_EQ(table.get(), obj.get());
+    EXPECT_EQ(count, table.use_count());
+    EXPECT_TRUE(evaluator._env->get("inc") == nullptr);
+    EXPECT_TRUE(evaluator._env->get("v0") == nullptr);
+}
+
+TEST(Builtin, TestBreadthFirstSearch) {
+    std::string input = R"(
+        let bfs = fn(graph, start) {
+            let seen = set([start]);
+            let queue = deque([start]);
+            let expand = fn(nodes) {
+                if (len(nodes) > 0) {
+                    let node = first(nodes);
+                    if (add(seen, node)) { push_back(queue, node); }
+                    expand(rest(nodes));
+                }
+            };
+            let visit = fn(order) {
+                if (len(queue) == 0) { return order; }
+                let node = pop_front(queue);
+                expand(graph[node]);
+                visit(push(order, node));
+            };
+            visit([]);
+        };
+        bfs({1: [2, 3], 2: [4], 3: [4, 1], 4: [5], 5: []}, 1);
+    )";
+    Evaluator evaluator;
+    auto object = evaluator.eval(input);
+    EXPECT_EQ("[1, 2, 3, 4, 5]", object->inspect());
+}
+
+TEST(Builtin, TestClockNs) {
+    test_inspect({
+        {"let a = clock_ns(); let b = clock_ns(); [a > 0, b >= a]", "[true, true]"},
+        {"clock_ns(1)", "wrong number of arguments. expected 0, got 1"},
+    });
+}
+
+TEST(Builtin, TestBench) {
+    // 耗时不固定，只检查统计量之间的关系
+    test_inspect({
+        {R"(let r = bench(fn() { [1, 2] }, 20); [r["iterations"], r["min"] <= r["median"], r["median"] <= r["p99"], r["allocations"] > 0])",
+            "[20, true, true, true]"},
+        {R"(bench(clock_ns)["iterations"])", "100"},
+        {"bench(fn() { 1 + true }, 5)", "type mismatch: `INTEGER + BOOLEAN`"},
+        {"bench(1)", "argument to `bench` not supported, got INTEGER"},
+        {"bench(fn() { 1 }, 0)", "argument to `bench` not supported, got INTEGER"},
+        {"bench(fn() { 1 }, 100000000000)", "bench: iterations must be at most 10000000, got 100000000000"},
+        {"bench()", "wrong number of arguments. expected 1 to 2, got 0"},
+        {"bench(fn() { 1 }, 1, 2)", "wrong number of arguments. expected 1 to 2, got 3"},
+    });
+}
+
+TEST(Builtin, TestBenchCompare) {
+    test_inspect({
+        {R"(let fast = fn() { 1 }; let slow = fn() { [1, 2, 3] + [4] }; let r = bench_compare(fast, slow, 20); [len(r), r[0]["name"], r[1]["name"], r[0]["iterations"]])",
+            R"([2, "fast", "slow", 20])"},
+        {R"(let r = bench_compare(fn() { 1 }); [r[0]["name"], r[0]["relative"]])", R"(["#0", 100])"},
+        {"bench_compare(10)", "argument to `bench_compare` not supported, got INTEGER"},
+        {"bench_compare()", "wrong number of arguments. expected 1, got 0"},
+        {"bench_compare(fn() { 1 }, 100000000000)", "bench_compare: iterations must be at most 10000000, got 100000000000"},
+        {"bench_compare(fn() { 1 }, true)", "argument to `bench_compare` not supported, got BOOLEAN"},
+    });
+}
+
 // puts 的返回值是 null
 // 这个单元测试只是增加覆盖率
+TEST(Builtin, TestToStr) {
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {"to_str(42)", R"("42")"},
+        {"to_str(-7)", R"("-7")"},
+        {"to_str(-9223372036854775807 - 1)", R"("-9223372036854775808")"},
+        {"to_str(true)", R"("true")"},
+        {"to_str(first([]))", R"("null")"},
+        {R"(to_str("s"))", R"("s")"},
+        {"to_str([1, 2])", R"("[1, 2]")"},
+        {R"("n=" + to_str(1 + 2))", R"("n=3")"},
+        {"to_str()", "wrong number of arguments. expected 1, got 0"},
+    };
+
+    Evaluator evaluator;
+    for (auto& test : tests) {
+        auto obj = evaluator.eval(std::get<0>(test));
+        auto error = obj->cast<Error>();
+        EXPECT_EQ(std::get<1>(test), error != nullptr ? error->message() : obj->inspect()) << std::get<0>(test);
+    }
+
+    // 字符串原样返回，不拷贝
+    auto str = evaluator.eval(R"(let s = "a long string value"; s)");
+    EXPECT_EQ(str, evaluator.eval("to_str(s)"));
+}
+
 TEST(Builtin, TestPuts) {
     std::string input = R"(let a = [1, 2, "hello autumn"]; puts(a))";
     Evaluator evaluator;
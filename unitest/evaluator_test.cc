@@ -1,5 +1,8 @@
 #include <any>
+#include <filesystem>
+#include <fstream>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <gtest/gtest.h>
 #include "evaluator.h"
@@ -37,6 +40,16 @@ void test_error_object(const Object* object, const std::string& expect) {
     EXPECT_EQ(expect, result->message());
 }
 
+// 在临时目录下创建脚本文件，返回绝对路径
+std::string write_script(const std::string& name, const std::string& content) {
+    auto dir = std::filesystem::temp_directory_path() / "autumn_test";
+    std::filesystem::create_directories(dir);
+    auto path = dir / name;
+    std::ofstream out(path);
+    out << content;
+    return path.string();
+}
+
 TEST(Evaluator, TestEvalIntegerExpression) {
     std::vector<std::tuple<std::string, int>> tests = {
         {"5", 5},
@@ -68,6 +81,43 @@ TEST(Evaluator, TestEvalIntegerExpression) {
     }
 }
 
+// 整数是 64 位的，运算结果超出 32 位时不会截断
+TEST(Evaluator, TestEvalInt64Expression) {
+    std::vector<std::tuple<std::string, int64_t>> tests = {
+        {"100000 * 100000", 10000000000LL},
+        {"let big = 65536 * 65536; big / 2 + big", 6442450944LL},
+        {"-(2147483647 + 1)", -2147483648LL},
+    };
+
+    Evaluator evaluator;
+    for (auto& test : tests) {
+        auto object = evaluator.eval(std::get<0>(test));
+        auto result = object->cast<Integer>();
+        ASSERT_TRUE(result != nullptr) << std::get<0>(test);
+        EXPECT_EQ(std::get<1>(test), result->value());
+    }
+}
+
+// 每创建一个对象计数加一，只统计当前线程
+TEST(Evaluator, TestAllocationCount) {
+    Evaluator evaluator;
+    evaluator.eval("let a = 1;");
+    auto before = t_allocations;
+    evaluator.eval("[a]; [a]; [a, a]");
+    EXPECT_GE(t_allocations - before, 3u);
+
+    // 其它线程创建的对象不计入
+    before = t_allocations;
+    uint64_t other = 0;
+    std::thread([&other]() {
+        Evaluator evaluator;
+        evaluator.eval("[1, 2]");
+        other = t_allocations;
+    }).join();
+    EXPECT_GE(other, 3u);
+    EXPECT_EQ(before, t_allocations);
+}
+
 TEST(Evaluator, TestEvalBooleanExpression) {
     std::vector<std::tuple<std::string, bool>> tests = {
         {"true", true},
@@ -183,6 +233,8 @@ TEST(Evaluator, TestErrorHandling) {
                     return 1;
                 }
             )", "unknown operator: `BOOLEAN + BOOLEAN`"},
+        {"10 / 0", "division by zero: `10 / 0`"},
+        {"(-9223372036854775807 - 1) / -1", "integer overflow: `-9223372036854775808 / -1`"},
     };
 
     Evaluator evaluator;
@@ -232,6 +284,24 @@ TEST(Evaluator, TestFunctionObject) {
     EXPECT_STREQ("(x + 2)", fn_obj->body()->to_string().c_str());
 }
 
+TEST(Evaluator, TestFunctionPrototypeShared) {
+    std::string input = R"(
+        let make = fn(x) { fn(y) { x + y } };
+        [make(1), make(2)];
+    )";
+    Evaluator evaluator;
+    auto object = evaluator.eval(input);
+    auto array = object->cast<Array>();
+    ASSERT_TRUE(array != nullptr);
+    auto first = array->elements()[0]->cast<Function>();
+    auto second = array->elements()[1]->cast<Function>();
+    ASSERT_TRUE(first != nullptr);
+    ASSERT_TRUE(second != nullptr);
+    // 同一个字面量创建的闭包共享原型，只有环境不同
+    EXPECT_EQ(first->prototype(), second->prototype());
+    EXPECT_NE(first->env(), second->env());
+}
+
 TEST(Evaluator, TestFunctionApplication) {
     std::vector<std::tuple<std::string, int>> tests = {
         {"let identity = fn(x) { x; }; identity(5);", 5},
@@ -316,6 +386,68 @@ TEST(Evaluator, TestArrayConcatenation) {
     EXPECT_STREQ(object->inspect().c_str(), "[1, 2, 3, 4, 3, 4, 5]");
 }
 
+TEST(Evaluator, TestConcatExpression) {
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {R"("a" + "b" + "c" + "d")", R"("abcd")"},
+        {"[1] + [2, 3] + [] + [4]", "[1, 2, 3, 4]"},
+        {"let a = [1, 2, 3]; a[1:] + [9] + a[:1]", "[2, 3, 9, 1]"},
+        {"1 + 2 + 3 + 4", "10"},
+        {R"(let s = "x"; s + s + s)", R"("xxx")"},
+        // 类型不一致时逐个相加
+        {R"("a" + "b" + 1)", "type mismatch: `STRING + INTEGER`"},
+        {R"([1] + [2] + "c" + [3])", "type mismatch: `ARRAY + STRING`"},
+        {R"(1 + 2 + "c")", "type mismatch: `INTEGER + STRING`"},
+    };
+
+    Evaluator evaluator;
+    for (auto& test : tests) {
+        auto& input = std::get<0>(test);
+        auto& expect = std::get<1>(test);
+
+        auto object = evaluator.eval(input);
+        ASSERT_TRUE(object != nullptr);
+        auto error_object = object->cast<Error>();
+        if (error_object != nullptr) {
+            EXPECT_EQ(expect, error_object->message());
+        } else {
+            EXPECT_EQ(expect, object->inspect());
+        }
+    }
+}
+
+TEST(Evaluator, TestInterpolatedString) {
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {R"(let x = 1; let y = -20; "x=${x}, y=${y}")", R"("x=1, y=-20")"},
+        {R"("${9223372036854775807} ${-9223372036854775807 - 1}")",
+                R"("9223372036854775807 -9223372036854775808")"},
+        {R"(let name = "秋天"; "hello, ${name}!")", R"("hello, 秋天!")"},
+        {R"("${true}/${false}/${first([])}/${if (false) { 1 }}")", R"("true/false/null/null")"},
+        {R"("${[1, "a"]} ${ {"k": 2}["k"] }")", R"("[1, "a"] 2")"},
+        {R"(let f = fn(n) { "<${n}>" }; "${f(1)}${f(2)}")", R"("<1><2>")"},
+        {R"("${ "in ${1 + 1}" }")", R"("in 2")"},
+        {R"("${0}")", R"("0")"},
+        // \${ 是字面的 ${
+        {R"(let x = 1; "\${x} = ${x}")", R"("${x} = 1")"},
+        {R"("price: \${5}")", R"("price: ${5}")"},
+        {R"("a${1 + true}b")", "type mismatch: `INTEGER + BOOLEAN`"},
+        {R"("${missing}")", "identifier not found: `missing`"},
+    };
+
+    Evaluator evaluator;
+    for (auto& test : tests) {
+        auto& input = std::get<0>(test);
+        auto& expect = std::get<1>(test);
+
+        auto object = evaluator.eval(input);
+        ASSERT_TRUE(object != nullptr) << input;
+        auto error_object = object->cast<Error>();
+        if (error_object != nullptr) {
+            EXPECT_EQ(expect, error_object->message()) << input;
+        } else {
+            EXPECT_EQ(expect, object->inspect()) << input;
+        }
+    }
+}
 
 TEST(Evaluator, TestArrayLiteral) {
     std::string input = "[1, 2 + 2, 3 * 3]";
@@ -388,4 +520,430 @@ TEST(Evaluator, TestHashLiteral) {
     test_integer_object(hash_obj->get(std::make_unique<object::Boolean>(false).get()).get(), 6);
 }
 
+
+TEST(Evaluator, TestHashShapes) {
+    Evaluator evaluator;
+    evaluator.eval(R"(
+        let a = {"name": "x", "age": 1};
+        let b = {"name": "y", "age": 2};
+        let c = {"age": 3, "name": "z"};
+        let d = {"name": "w", "name": "v"};
+        let e = {"name": 1, 2: 2};
+    )");
+    auto a = evaluator.eval("a");
+    auto b = evaluator.eval("b");
+    auto c = evaluator.eval("c");
+    auto d = evaluator.eval("d");
+    auto e = evaluator.eval("e");
+
+    // 相同键序列的字面量共享 shape，键的顺序不同则 shape 不同
+    auto shape = a->cast<Hash>()->shape();
+    ASSERT_TRUE(shape != nullptr);
+    EXPECT_EQ(shape, b->cast<Hash>()->shape());
+    EXPECT_NE(nullptr, c->cast<Hash>()->shape());
+    EXPECT_NE(shape, c->cast<Hash>()->shape());
+    // 重复的键和非字符串常量的键使用字典，重复时保留第一个值
+    EXPECT_EQ(nullptr, d->cast<Hash>()->shape());
+    test_string_object(d->cast<Hash>()->get("name").get(), "w");
+    EXPECT_EQ(nullptr, e->cast<Hash>()->shape());
+    // shape 方式按字面量中的顺序输出
+    EXPECT_EQ(R"({"name":"x", "age":1})", a->inspect());
+
+    std::vector<std::tuple<std::string, std::any>> tests = {
+        {R"(a["name"])", "x"},
+        {R"(c["name"])", "z"},
+        {R"(a["missing"])", nullptr},
+        {R"(let k = "age"; a[k])", 1},
+        {R"(e["name"])", 1},
+        {R"(e[2])", 2},
+        // 同一个访问点依次遇到不同 shape 和字典方式的 hash
+        {R"(let get = fn(h) { h["name"] }; [get(a), get(c), get(b), get(e), get({"other": 1}), get(a)])",
+                std::vector<std::any>{std::string("x"), std::string("z"), std::string("y"), 1, nullptr, std::string("x")}},
+    };
+    for (auto& test : tests) {
+        auto object = evaluator.eval(std::get<0>(test));
+        ASSERT_TRUE(object != nullptr) << std::get<0>(test);
+        auto& expected = std::get<1>(test);
+        if (expected.type() == typeid(const char*)) {
+            test_string_object(object.get(), std::any_cast<const char*>(expected));
+        } else if (expected.type() == typeid(int)) {
+            test_integer_object(object.get(), std::any_cast<int>(expected));
+        } else if (expected.type() == typeid(nullptr)) {
+            test_null_object(object.get());
+        } else {
+            auto elems = object->cast<Array>()->elements();
+            auto& expected_elems = std::any_cast<const std::vector<std::any>&>(expected);
+            ASSERT_EQ(elems.size(), expected_elems.size());
+            for (size_t i = 0; i < elems.size(); ++i) {
+                if (expected_elems[i].type() == typeid(std::string)) {
+                    test_string_object(elems[i].get(), std::any_cast<std::string>(expected_elems[i]));
+                } else if (expected_elems[i].type() == typeid(int)) {
+                    test_integer_object(elems[i].get(), std::any_cast<int>(expected_elems[i]));
+                } else {
+                    test_null_object(elems[i].get());
+                }
+            }
+        }
+    }
+
+    // 常量键的访问不创建键对象
+    uint64_t before = t_allocations;
+    auto name = evaluator.eval(R"(a["name"])");
+    EXPECT_EQ(0, t_allocations - before);
+    test_string_object(name.get(), "x");
+
+    // 已有的键保持 shape；追加新键后转为字典，原有的键值不变
+    // 同样的键序列得到同一个 shape
+    EXPECT_EQ(shape, Shape::intern({"name", "age"}));
+    auto hash = std::make_shared<Hash>(shape, std::vector<std::shared_ptr<Object>>{
+            std::make_shared<String>("y"), std::make_shared<Integer>(2)});
+    EXPECT_TRUE(hash->append(std::make_shared<String>("age"), std::make_shared<Integer>(5)));
+    EXPECT_EQ(shape, hash->shape());
+    test_integer_object(hash->get("age").get(), 2);
+    EXPECT_TRUE(hash->append(std::make_shared<String>("city"), std::make_shared<Integer>(6)));
+    EXPECT_EQ(nullptr, hash->shape());
+    EXPECT_EQ(3, hash->size());
+    test_string_object(hash->get("name").get(), "y");
+    test_integer_object(hash->get(std::make_unique<String>("city").get()).get(), 6);
+    // 其他同 shape 的 hash 不受影响
+    EXPECT_EQ(shape, a->cast<Hash>()->shape());
+    test_string_object(evaluator.eval(R"(get(a))").get(), "x");
+}
+
+TEST(Evaluator, TestSmallContainers) {
+    Evaluator evaluator;
+
+    // 短数组的元素放在对象内部，超过后转到独立的缓冲区
+    auto small = evaluator.eval("[1, 2, 3, 4]");
+    EXPECT_TRUE(small->cast<Array>()->is_inline());
+    auto large = evaluator.eval("[1, 2, 3, 4, 5]");
+    EXPECT_FALSE(large->cast<Array>()->is_inline());
+    auto pushed = evaluator.eval("let a = [1, 2, 3, 4]; push(a, 5)");
+    EXPECT_FALSE(pushed->cast<Array>()->is_inline());
+    EXPECT_EQ("[1, 2, 3, 4, 5]", pushed->inspect());
+    auto concat = evaluator.eval("[1] + [2] + [3]");
+    EXPECT_TRUE(concat->cast<Array>()->is_inline());
+    EXPECT_EQ("[1, 2, 3]", concat->inspect());
+
+    Array array;
+    for (int i = 0; i < 10; ++i) {
+        array.append(std::make_shared<Integer>(i));
+        EXPECT_EQ(i < static_cast<int>(ARRAY_INLINE_SIZE), array.is_inline());
+    }
+    EXPECT_EQ("[0, 1, 2, 3, 4, 5, 6, 7, 8, 9]", array.inspect());
+
+    // 短切片拷贝，长切片共享根数组的元素
+    auto root = evaluator.eval("let r = [0, 1, 2, 3, 4, 5, 6, 7, 8, 9]; r");
+    EXPECT_EQ("[7, 8, 9]", evaluator.eval("r[7:]")->inspect());
+    EXPECT_TRUE(evaluator.eval("r[7:]")->cast<Array>()->is_inline());
+    EXPECT_EQ("[1, 2, 3, 4, 5, 6, 7, 8, 9]", evaluator.eval("rest(r)")->inspect());
+    EXPECT_EQ("[2, 3, 4, 5, 6, 7, 8, 9, 10]", evaluator.eval("push(rest(rest(r)), 10)")->inspect());
+
+    // 不超过 SMALL_HASH_SIZE 个键值对时线性扫描，保持插入顺序
+    auto hash = evaluator.eval(R"({1: "a", "b": 2, false: 3})");
+    EXPECT_EQ(Hash::SMALL, hash->cast<Hash>()->storage());
+    EXPECT_EQ(R"({1:"a", "b":2, false:3})", hash->inspect());
+    test_integer_object(evaluator.eval(R"({1: "a", "b": 2, false: 3}["b"])").get(), 2);
+    test_null_object(evaluator.eval(R"({1: "a"}[2])").get());
+
+    // 稠密的整数键按下标访问
+    auto dense = evaluator.eval(R"({9: 9, 8: 8, 7: 7, 6: 6, 5: 5, 4: 4, 3: 3, 2: 2, 1: 1, 0: 0, -1: -1})");
+    EXPECT_EQ(Hash::DENSE, dense->cast<Hash>()->storage());
+    EXPECT_EQ(11, dense->cast<Hash>()->size());
+    EXPECT_EQ("{-1:-1, 0:0, 1:1, 2:2, 3:3, 4:4, 5:5, 6:6, 7:7, 8:8, 9:9}", dense->inspect());
+    for (int i = -1; i < 10; ++i) {
+        test_integer_object(dense->cast<Hash>()->get(std::make_unique<Integer>(i).get()).get(), i);
+    }
+    test_null_object(dense->cast<Hash>()->get(std::make_unique<Integer>(10).get()).get());
+    test_null_object(dense->cast<Hash>()->get(std::make_unique<Integer>(-2).get()).get());
+    test_null_object(dense->cast<Hash>()->get("1").get());
+
+    // 有空位但仍然稠密
+    auto holes = evaluator.eval(R"({0: 0, 2: 2, 4: 4, 6: 6, 8: 8, 10: 10, 12: 12, 14: 14, 16: 16})");
+    EXPECT_EQ(Hash::DENSE, holes->cast<Hash>()->storage());
+    test_null_object(holes->cast<Hash>()->get(std::make_unique<Integer>(3).get()).get());
+    test_integer_object(holes->cast<Hash>()->get(std::make_unique<Integer>(16).get()).get(), 16);
+
+    // 稀疏的整数键和混合类型的键转为一般的字典
+    auto sparse = evaluator.eval(R"({0: 0, 1: 1, 2: 2, 3: 3, 4: 4, 5: 5, 6: 6, 7: 7, 1000: 1000})");
+    EXPECT_EQ(Hash::MAP, sparse->cast<Hash>()->storage());
+    test_integer_object(sparse->cast<Hash>()->get(std::make_unique<Integer>(1000).get()).get(), 1000);
+    test_integer_object(sparse->cast<Hash>()->get(std::make_unique<Integer>(7).get()).get(), 7);
+    auto mixed = evaluator.eval(R"({0: 0, 1: 1, 2: 2, 3: 3, 4: 4, 5: 5, 6: 6, 7: 7, "x": 8})");
+    EXPECT_EQ(Hash::MAP, mixed->cast<Hash>()->storage());
+    test_integer_object(mixed->cast<Hash>()->get("x").get(), 8);
+    test_integer_object(mixed->cast<Hash>()->get(std::make_unique<Integer>(0).get()).get(), 0);
+
+    // 稠密的 hash 追加字符串键后转为字典，原有的键值不变
+    Hash grow;
+    for (int i = 0; i < 20; ++i) {
+        grow.append(std::make_shared<Integer>(i), std::make_shared<Integer>(i * 10));
+    }
+    EXPECT_EQ(Hash::DENSE, grow.storage());
+    grow.append(std::make_shared<Integer>(-3), std::make_shared<Integer>(-30));
+    EXPECT_EQ(Hash::DENSE, grow.storage());
+    // 重复的键保留第一个值
+    grow.append(std::make_shared<Integer>(5), std::make_shared<Integer>(0));
+    test_integer_object(grow.get(std::make_unique<Integer>(5).get()).get(), 50);
+    grow.append(std::make_shared<String>("s"), std::make_shared<Integer>(1));
+    EXPECT_EQ(Hash::MAP, grow.storage());
+    EXPECT_EQ(22, grow.size());
+    test_integer_object(grow.get(std::make_unique<Integer>(-3).get()).get(), -30);
+    test_integer_object(grow.get(std::make_unique<Integer>(19).get()).get(), 190);
+    test_integer_object(grow.get("s").get(), 1);
+
+    // 键递减地追加时头部按倍数增长，不必每次都移动全部元素
+    Hash descending;
+    for (int i = 100000; i > 0; --i) {
+        descending.append(std::make_shared<Integer>(i), std::make_shared<Integer>(i));
+    }
+    EXPECT_EQ(Hash::DENSE, descending.storage());
+    EXPECT_EQ(100000, descending.size());
+    EXPECT_LE(descending.entries().size(), 2 * 100000u);
+    test_integer_object(descending.get(std::make_unique<Integer>(1).get()).get(), 1);
+    test_integer_object(descending.get(std::make_unique<Integer>(100000).get()).get(), 100000);
+    test_null_object(descending.get(std::make_unique<Integer>(0).get()).get());
+    descending.append(std::make_shared<Integer>(0), std::make_shared<Integer>(0));
+    test_integer_object(descending.get(std::make_unique<Integer>(0).get()).get(), 0);
+    size_t count = 0;
+    int64_t previous = -1;
+    descending.for_each([&](const std::shared_ptr<Object>& key, const std::shared_ptr<Object>&) {
+        EXPECT_LT(previous, key->cast<Integer>()->value());
+        previous = key->cast<Integer>()->value();
+        ++count;
+    });
+    EXPECT_EQ(100001u, count);
+
+    // 值为 null 的键也算存在
+    Hash nulls;
+    nulls.append(std::make_shared<Integer>(1), constants::Null);
+    nulls.append(std::make_shared<Integer>(1), std::make_shared<Integer>(1));
+    test_null_object(nulls.get(std::make_unique<Integer>(1).get()).get());
+    EXPECT_EQ(1, nulls.size());
+}
+
+TEST(Evaluator, TestStringIndexExpression) {
+    std::vector<std::tuple<std::string, std::any>> tests = {
+        {R"("autumn"[0])", "a"},
+        {R"("autumn"[5])", "n"},
+        {R"("autumn"[-1])", "n"},
+        {R"(let s = "autumn"; s[len(s) - 2])", "m"},
+        {R"("autumn"[6])", nullptr},
+        {R"(""[0])", nullptr},
+    };
+
+    Evaluator evaluator;
+
+    for (auto& test : tests) {
+        auto& input = std::get<0>(test);
+        auto& expect = std::get<1>(test);
+
+        auto object = evaluator.eval(input);
+
+        if (expect.type() == typeid(const char*)) {
+            test_string_object(object.get(), std::any_cast<const char*>(expect));
+        } else {
+            test_null_object(object.get());
+        }
+    }
+}
+
+TEST(Evaluator, TestSmallStrings) {
+    Evaluator evaluator;
+
+    // 单个 ASCII 字符和空串共享对象，取下标不分配
+    auto a = evaluator.eval(R"(let s = "banana"; s[1])");
+    auto b = evaluator.eval("s[3]");
+    EXPECT_EQ(a.get(), b.get());
+    EXPECT_EQ(String::make("a").get(), a.get());
+    EXPECT_EQ(String::make("").get(), evaluator.eval("s[2:2]").get());
+    evaluator.eval("let i = 5;");
+    uint64_t before = t_allocations;
+    evaluator.eval("s[i]");
+    EXPECT_EQ(0, t_allocations - before);
+
+    // 同一个字面量每次求值返回同一个对象
+    auto literals = evaluator.eval(R"(let f = fn(x) { "status" }; [f(i), f(i)])");
+    auto elems = literals->cast<Array>()->elements();
+    EXPECT_EQ(elems[0].get(), elems[1].get());
+
+    // 拼接、切片、插值得到的短字符串经过缓存，相同内容再次出现时复用同一个对象
+    before = t_allocations;
+    auto cached = String::make(std::string("short key"));
+    EXPECT_EQ(cached.get(), String::make("short key").get());
+    EXPECT_EQ(1, t_allocations - before);
+    evaluator.eval(R"(let k = "ban" + "ana"; let n = 7;)");
+    auto k1 = evaluator.eval(R"(s[0:3] + "ana")");
+    auto k2 = evaluator.eval(R"("${s[0:3]}ana")");
+    auto k3 = evaluator.eval("to_str(n)");
+    EXPECT_EQ(evaluator._env->get("k").get(), k1.get());
+    EXPECT_EQ(k1.get(), k2.get());
+    EXPECT_EQ("\"7\"", k3->inspect());
+    // 长字符串不进入缓存
+    auto long1 = evaluator.eval(R"(s + " is longer")");
+    auto long2 = evaluator.eval(R"(s + " is longer")");
+    EXPECT_NE(long1.get(), long2.get());
+
+    // 短字符串的哈希值在构造时算好，与长字符串一致
+    String small("key");
+    String view_source("a string longer than fifteen");
+    EXPECT_EQ(std::hash<std::string_view>{}("key"), small.hash());
+    EXPECT_EQ(std::hash<std::string_view>{}("a string longer than fifteen"), view_source.hash());
+    EXPECT_TRUE(small.equals(String(std::string("key"))));
+    EXPECT_FALSE(small.equals(String(std::string("kex"))));
+}
+
+TEST(Evaluator, TestSliceExpression) {
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {R"("hello autumn"[6:])", R"("autumn")"},
+        {R"("hello autumn"[:5])", R"("hello")"},
+        {R"("hello autumn"[-6:-3])", R"("aut")"},
+        {R"("hello autumn"[3:1])", R"("")"},
+        {R"("hello autumn"[:100])", R"("hello autumn")"},
+        {"[1, 2, 3, 4][1:3]", "[2, 3]"},
+        {"[1, 2, 3, 4][:]", "[1, 2, 3, 4]"},
+        {"[1, 2, 3, 4][-2:]", "[3, 4]"},
+        {"[1, 2, 3, 4][2:][1]", "4"},
+        {"[1, 2, 3, 4][1:][1:][0]", "3"},
+        {"push([1, 2, 3][:2], 5)", "[1, 2, 5]"},
+        {"let a = [1, 2, 3]; let b = a[1:]; push(a, 4); b", "[2, 3]"},
+        {"[1, 2][true:]", "error: slice index must be INTEGER, got `BOOLEAN`"},
+        {"5[1:2]", "error: slice operator not supported: `INTEGER`"},
+    };
+
+    Evaluator evaluator;
+
+    for (auto& test : tests) {
+        auto& input = std::get<0>(test);
+        auto& expect = std::get<1>(test);
+
+        evaluator.reset_env();
+        auto object = evaluator.eval(input);
+
+        EXPECT_EQ(expect, object->inspect());
+    }
+}
+
+TEST(Evaluator, TestSliceCompaction) {
+    Evaluator evaluator;
+
+    // 大字符串中的长切片共享父缓冲区
+    auto object = evaluator.eval(R"(
+        let s = "0123456789012345678901234567890123456789012345678901234567890123456789";
+        s[1:60]
+    )");
+    auto str = object->cast<String>();
+    ASSERT_TRUE(str != nullptr);
+    EXPECT_EQ(59u, str->value().size());
+    EXPECT_TRUE(str->_owner != nullptr);
+
+    // 小切片拷贝出独立的缓冲区，不再钉住父对象
+    object = evaluator.eval("s[1:17]");
+    str = object->cast<String>();
+    ASSERT_TRUE(str != nullptr);
+    EXPECT_EQ("1234567890123456", str->value());
+    EXPECT_TRUE(str->_owner == nullptr);
+}
+
+
+TEST(Evaluator, TestUtf8String) {
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {R"("秋天的风"[1])", R"("天")"},
+        {R"("秋天的风"[-1])", R"("风")"},
+        {R"("a秋b"[1:])", R"("秋b")"},
+        {R"("秋天的风"[1:3])", R"("天的")"},
+        {R"("🍂autumn"[0])", R"("🍂")"},
+        {R"("🍂autumn"[1:3])", R"("au")"},
+    };
+
+    Evaluator evaluator;
+
+    for (auto& test : tests) {
+        auto& input = std::get<0>(test);
+        auto& expect = std::get<1>(test);
+
+        auto object = evaluator.eval(input);
+
+        EXPECT_EQ(expect, object->inspect());
+    }
+}
+
+TEST(Evaluator, TestUtf8StringIndex) {
+    // 跨越多个索引块的随机访问
+    std::string input = "let s = \"";
+    for (int i = 0; i < 300; ++i) {
+        input += (i % 3 == 0) ? "秋" : "a";
+    }
+    input += "\"; [len(s), s[0], s[1], s[63], s[64], s[129], s[299], s[200:203]]";
+
+    Evaluator evaluator;
+    auto object = evaluator.eval(input);
+    EXPECT_EQ(R"([300, "秋", "a", "秋", "a", "秋", "a", "a秋a"])", object->inspect());
+}
+
+
+TEST(Evaluator, TestImportExpression) {
+    auto math = write_script("math.au", R"(
+        let _factor = 2;
+        let square = fn(x) { x * x };
+        let double = fn(x) { x * _factor };
+    )");
+    write_script("main.au", R"(
+        let m = import "math.au";
+        let result = m["square"](3) + m["double"](4);
+    )");
+
+    Evaluator evaluator;
+    auto object = evaluator.eval(format(R"(let m = import "{}"; m["square"](5))", math));
+    test_integer_object(object.get(), 25);
+
+    // 私有绑定不导出
+    object = evaluator.eval("m[\"_factor\"]");
+    test_null_object(object.get());
+
+    // 同一个 Evaluator 中重复导入得到同一份导出
+    object = evaluator.eval(format(R"(import "{}")", math));
+    auto first = object;
+    object = evaluator.eval(format(R"(import "{}")", math));
+    EXPECT_EQ(first.get(), object.get());
+
+    // 脚本中的相对路径以脚本所在目录为起点
+    auto main = (std::filesystem::path(math).parent_path() / "main.au").string();
+    object = evaluator.eval_file(main);
+    object = evaluator.eval("result");
+    test_integer_object(object.get(), 17);
+}
+
+TEST(Evaluator, TestImportReload) {
+    auto path = write_script("reload.au", "let value = 1;");
+
+    Evaluator evaluator;
+    auto object = evaluator.eval(format(R"(import "{}"["value"])", path));
+    test_integer_object(object.get(), 1);
+
+    // 修改时间变化后重新编译执行
+    write_script("reload.au", "let value = 2;");
+    auto mtime = std::filesystem::last_write_time(path);
+    std::filesystem::last_write_time(path, mtime + std::chrono::seconds(1));
+    object = evaluator.eval(format(R"(import "{}"["value"])", path));
+    test_integer_object(object.get(), 2);
+}
+
+TEST(Evaluator, TestImportError) {
+    auto a = write_script("cycle_a.au", R"(let b = import "cycle_b.au";)");
+    write_script("cycle_b.au", R"(let a = import "cycle_a.au";)");
+    auto bad = write_script("bad.au", "let x = 1 + undefined_name;");
+
+    Evaluator evaluator;
+    auto object = evaluator.eval(R"(import "no_such_module.au")");
+    test_error_object(object.get(), "module not found: `no_such_module.au`");
+
+    object = evaluator.eval(format(R"(import "{}")", bad));
+    test_error_object(object.get(), format("in module `{}`: identifier not found: `undefined_name`", bad));
+
+    object = evaluator.eval(format(R"(import "{}")", a));
+    test_error_object(object.get(), format(
+            "in module `{}`: in module `cycle_b.au`: circular import: `cycle_a.au`", a));
+}
+
 }
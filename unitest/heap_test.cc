@@ -0,0 +1,220 @@
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+#include "evaluator.h"
+#include "heap.h"
+
+using namespace autumn;
+
+namespace {
+
+struct Record {
+    std::string kind;
+    size_t self = 0;
+    size_t retained = 0;
+    size_t idom = 0;
+    bool reachable = true;
+};
+
+// 按路径索引 dump 文件中的 node 行，路径沿 parent 拼接 step
+std::map<std::string, Record> load(const std::string& path) {
+    std::map<std::string, Record> records;
+    std::map<size_t, std::string> paths;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        std::string tag;
+        ss >> tag;
+        if (tag != "node") {
+            continue;
+        }
+        size_t id = 0;
+        int reachable = 0;
+        Record record;
+        size_t parent = 0;
+        ss >> id >> record.kind >> record.self >> record.retained >> record.idom >> reachable >> parent;
+        record.reachable = reachable != 0;
+        ss.get();
+        std::string step;
+        std::getline(ss, step);
+        auto node_path = parent == 0 ? step : paths[parent] + step;
+        paths[id] = node_path;
+        records.emplace(node_path, record);
+    }
+    return records;
+}
+
+std::string dump_path() {
+    return (std::filesystem::temp_directory_path() / "autumn_heap_test.txt").string();
+}
+
+TEST(Heap, TestDump) {
+    Evaluator evaluator;
+    auto obj = evaluator.eval(R"(
+        let inner = [1, 2];
+        let a = [inner, "a string longer than the inline size"];
+        let h = {"k": inner};
+        let f = fn(x) { x + a[0][0] };
+    )");
+    obj = evaluator.eval(R"(heap_dump(")" + dump_path() + R"("))");
+    auto stats = obj->cast<object::Hash>();
+    ASSERT_NE(nullptr, stats) << obj->inspect();
+
+    auto records = load(dump_path());
+    ASSERT_EQ("ENVIRONMENT", records["globals"].kind);
+    EXPECT_EQ("ARRAY", records["globals.a"].kind);
+    EXPECT_EQ("HASH", records["globals.h"].kind);
+    EXPECT_EQ("FUNCTION", records["globals.f"].kind);
+    EXPECT_EQ("STRING", records["globals.a[1]"].kind);
+    EXPECT_EQ("STRING", records["globals.h[\"k\"].<key>"].kind);
+    EXPECT_TRUE(records["globals.a"].reachable);
+
+    // inner 被 a、h 和全局环境共同引用，不计入 a 的保留大小
+    auto& a = records["globals.a"];
+    auto& inner = records["globals.inner"];
+    EXPECT_EQ(a.self + records["globals.a[1]"].retained, a.retained);
+    EXPECT_EQ(inner.self + 2 * records["globals.inner[0]"].self, inner.retained);
+    EXPECT_GT(records["globals"].retained, a.retained + inner.retained);
+
+    EXPECT_EQ("failed to write: `/nonexistent/heap.txt`",
+            evaluator.eval(R"(heap_dump("/nonexistent/heap.txt"))")->cast<object::Error>()->message());
+    EXPECT_EQ("argument to `heap_dump` not supported, got INTEGER",
+            evaluator.eval("heap_dump(1)")->cast<object::Error>()->message());
+}
+
+TEST(Heap, TestUnreachableClosure) {
+    Evaluator evaluator;
+    // g 的环境绑定了 g 自己，调用结束后两者互相引用，不会被释放
+    evaluator.eval(R"(
+        let leak = fn() {
+            let payload = [1, 2, 3];
+            let cyclic_closure = fn() { cyclic_closure };
+            0
+        };
+        leak();
+        leak();
+    )");
+    auto obj = evaluator.eval(R"(heap_dump(")" + dump_path() + R"("))");
+    auto stats = obj->cast<object::Hash>();
+    ASSERT_NE(nullptr, stats) << obj->inspect();
+    auto unreachable = stats->get(object::String("unreachable_objects").cast<object::Object>());
+    EXPECT_GE(unreachable->cast<object::Integer>()->value(), 2 * 3);
+
+    auto records = load(dump_path());
+    auto& fn = records["<unreachable cyclic_closure>"];
+    EXPECT_EQ("FUNCTION", fn.kind);
+    EXPECT_FALSE(fn.reachable);
+    EXPECT_EQ(0, fn.idom);
+    EXPECT_EQ("ARRAY", records["<unreachable cyclic_closure>.<env>.payload"].kind);
+
+    std::ifstream in(dump_path());
+    std::stringstream summary;
+    ASSERT_TRUE(heap::summarize(in, summary, 3));
+    EXPECT_NE(std::string::npos, summary.str().find("payload")) << summary.str();
+}
+
+// 只列出当前 Evaluator 创建的闭包
+TEST(Heap, TestClosuresPerEvaluator) {
+    Evaluator other;
+    other.eval("let leak = fn() { let other_closure = fn() { other_closure }; 0 }; leak();");
+
+    Evaluator evaluator;
+    auto obj = evaluator.eval(R"(heap_dump(")" + dump_path() + R"("))");
+    auto stats = obj->cast<object::Hash>();
+    ASSERT_NE(nullptr, stats) << obj->inspect();
+    auto unreachable = stats->get(object::String("unreachable_objects").cast<object::Object>());
+    EXPECT_EQ(0, unreachable->cast<object::Integer>()->value());
+    EXPECT_EQ(0u, load(dump_path()).count("<unreachable other_closure>"));
+
+    size_t count = 0;
+    other._closures.for_each([&count](const object::Function*) {
+        ++count;
+    });
+    EXPECT_EQ(2u, count);
+}
+
+// 每个节点只写出前一个节点和一步路径，深的链不会让文件按深度的平方增长
+TEST(Heap, TestDeepChain) {
+    Evaluator evaluator;
+    evaluator.eval(R"(
+        let build = fn(n, acc) { if (n == 0) { acc } else { build(n - 1, [acc]) } };
+        let chain = build(800, [1]);
+    )");
+    auto obj = evaluator.eval(R"(heap_dump(")" + dump_path() + R"("))");
+    ASSERT_NE(nullptr, obj->cast<object::Hash>()) << obj->inspect();
+    EXPECT_LT(std::filesystem::file_size(dump_path()), 100u * 1024);
+
+    std::string deepest = "globals.chain";
+    for (size_t i = 0; i < 800; ++i) {
+        deepest += "[0]";
+    }
+    auto records = load(dump_path());
+    EXPECT_EQ("ARRAY", records[deepest].kind);
+    EXPECT_EQ("INTEGER", records[deepest + "[0]"].kind);
+}
+
+// 切片视图通过 <owner> 边保持父对象存活，父对象计入切片的保留大小
+TEST(Heap, TestSliceOwner) {
+    Evaluator evaluator;
+    evaluator.eval(R"(
+        let s = fn() { let p = "0123456789012345678901234567890123456789012345678901234567890123456789"; p[1:69] }();
+        let t = fn() { let p = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16]; p[1:15] }();
+    )");
+    auto obj = evaluator.eval(R"(heap_dump(")" + dump_path() + R"("))");
+    ASSERT_NE(nullptr, obj->cast<object::Hash>()) << obj->inspect();
+
+    auto records = load(dump_path());
+    auto& s = records["globals.s"];
+    auto& s_owner = records["globals.s.<owner>"];
+    ASSERT_EQ("STRING", s_owner.kind);
+    EXPECT_LT(70u, s_owner.self);
+    EXPECT_EQ(s.self + s_owner.retained, s.retained);
+
+    auto& t = records["globals.t"];
+    auto& t_owner = records["globals.t.<owner>"];
+    ASSERT_EQ("ARRAY", t_owner.kind);
+    EXPECT_LE(t.self + t_owner.self, t.retained);
+    EXPECT_LT(t.self, t_owner.self);
+}
+
+TEST(Heap, TestSummarize) {
+    std::string dump =
+        "# autumn heap dump\n"
+        "node 1 ENVIRONMENT 100 1000 0 1 0 globals\n"
+        "node 2 ARRAY 500 600 1 1 1 .big\n"
+        "node 3 INTEGER 100 100 2 1 2 [0]\n"
+        "node 4 ENVIRONMENT 50 200 0 0 0 <unreachable f>.<env>\n"
+        "node 5 ARRAY 150 150 4 0 4 .big\n"
+        "node 6 INTEGER 100 100 1 1 1 .small\n"
+        "edge 1 2 big\n"
+        "edge 1 6 small\n"
+        "edge 2 3 [0]\n"
+        "edge 4 5 big\n"
+        "edge 4 1 <outer>\n"
+        "edge 4 6 shared\n"
+        "root 1 globals\n";
+    std::stringstream in(dump);
+    std::stringstream out;
+    ASSERT_TRUE(heap::summarize(in, out, 10));
+    EXPECT_EQ(
+        "objects: 6, bytes: 1000, unreachable objects: 2, unreachable bytes: 200\n"
+        "    retained unreachable   count  binding\n"
+        "         750         150       2  big  (globals.big)\n"
+        "         100           0       1  small  (globals.small)\n"
+        "           0           0       1  shared\n",
+        out.str());
+
+    std::stringstream top(dump);
+    std::stringstream one;
+    ASSERT_TRUE(heap::summarize(top, one, 1));
+    EXPECT_EQ(std::string::npos, one.str().find("small"));
+
+    std::stringstream bad("not a dump\n");
+    EXPECT_FALSE(heap::summarize(bad, out, 10));
+}
+
+}
@@ -0,0 +1,154 @@
+#include <random>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "incremental_parser.h"
+
+using namespace autumn;
+
+namespace {
+
+struct Expected {
+    size_t begin;
+    size_t end;
+    std::string text;
+    size_t errors;
+};
+
+// 从头完整解析一遍，作为增量解析的对照
+std::vector<Expected> parse_all(const std::string& source) {
+    std::vector<Expected> ret;
+    Parser parser;
+    parser.parse_statments(source, 0, [&](
+            std::unique_ptr<ast::Statment> stmt,
+            size_t begin,
+            size_t end,
+            std::vector<std::string> errors) {
+        ret.push_back(Expected{begin, end, stmt ? stmt->to_string() : "", errors.size()});
+        return true;
+    });
+    return ret;
+}
+
+void check_consistent(const IncrementalParser& parser) {
+    auto expected = parse_all(parser.source());
+    auto& actual = parser.statments();
+    ASSERT_EQ(actual.size(), expected.size()) << parser.source();
+    for (size_t i = 0; i < expected.size(); ++i) {
+        EXPECT_EQ(actual[i].begin, expected[i].begin) << parser.source();
+        EXPECT_EQ(actual[i].end, expected[i].end) << parser.source();
+        EXPECT_EQ(actual[i].node ? actual[i].node->to_string() : "", expected[i].text) << parser.source();
+        EXPECT_EQ(actual[i].errors.size(), expected[i].errors) << parser.source();
+    }
+}
+
+TEST(IncrementalParser, TestStatments) {
+    IncrementalParser parser;
+    parser.update("let a = 1;\nlet b = a + 2;\nputs(b);\n");
+    auto& stmts = parser.statments();
+    ASSERT_EQ(stmts.size(), 3);
+    EXPECT_EQ(stmts[0].begin, 0);
+    EXPECT_EQ(stmts[0].end, 11);
+    EXPECT_EQ(stmts[1].begin, 11);
+    EXPECT_EQ(stmts[1].end, 26);
+    EXPECT_EQ(stmts[2].begin, 26);
+    EXPECT_EQ(stmts[2].end, parser.source().size());
+    EXPECT_EQ(stmts[1].node->to_string(), "let b = (a + 2);");
+    EXPECT_EQ(parser.reparsed(), 3);
+    EXPECT_EQ(parser.reused(), 0);
+    EXPECT_TRUE(parser.diagnostics().empty());
+}
+
+TEST(IncrementalParser, TestReuse) {
+    std::string source;
+    for (int i = 0; i < 100; ++i) {
+        source += "let value = " + std::to_string(i) + ";\n";
+    }
+    IncrementalParser parser;
+    parser.update(source);
+    ASSERT_EQ(parser.statments().size(), 100);
+
+    // 修改中间一条语句，只重新解析附近的语句
+    size_t pos = source.find("= 50;") + 2;
+    parser.edit(pos, pos + 2, "5000");
+    EXPECT_LE(parser.reparsed(), 3);
+    EXPECT_EQ(parser.reparsed() + parser.reused(), 100);
+    EXPECT_EQ(parser.statments()[50].node->to_string(), "let value = 5000;");
+    check_consistent(parser);
+
+    // 内容不变的更新全部复用
+    parser.update(parser.source());
+    EXPECT_EQ(parser.reparsed(), 0);
+    EXPECT_EQ(parser.reused(), 100);
+
+    // 在开头插入语句，后面的语句平移后复用
+    parser.edit(0, 0, "let first = 0;\n");
+    EXPECT_LE(parser.reparsed(), 2);
+    EXPECT_EQ(parser.statments().size(), 101);
+    check_consistent(parser);
+}
+
+TEST(IncrementalParser, TestDiagnostics) {
+    IncrementalParser parser;
+    parser.update("let a = 1;\nlet b = ;\nlet c = 3;\n");
+    auto diagnostics = parser.diagnostics();
+    ASSERT_EQ(diagnostics.size(), 1);
+    EXPECT_EQ(diagnostics[0].begin, 11);
+    // 不包含语句末尾的换行
+    EXPECT_EQ(diagnostics[0].end, 20);
+    EXPECT_EQ(diagnostics[0].message, "no prefix parse function found for `;`");
+
+    parser.update("let a = 1;\nlet b = 2;\nlet c = 3;\n");
+    EXPECT_TRUE(parser.diagnostics().empty());
+    check_consistent(parser);
+}
+
+TEST(IncrementalParser, TestStructuralEdits) {
+    IncrementalParser parser;
+    parser.update("let f = fn(x) {\n  x + 1;\n};\nlet y = f(2);\n");
+    check_consistent(parser);
+
+    // 打开一个未闭合的块，吞掉后面的语句
+    parser.edit(0, 0, "if (true) {\n");
+    check_consistent(parser);
+    EXPECT_FALSE(parser.diagnostics().empty());
+
+    // 闭合后恢复
+    parser.update(parser.source() + "}\n");
+    check_consistent(parser);
+    EXPECT_TRUE(parser.diagnostics().empty());
+
+    // 未闭合的字符串
+    parser.edit(0, 0, "let s = \"abc;\n");
+    check_consistent(parser);
+    parser.edit(0, 14, "");
+    check_consistent(parser);
+}
+
+TEST(IncrementalParser, TestRandomEdits) {
+    const std::vector<std::string> pieces = {
+        "let a = 1;\n", "a + b;", "fn(x) { x }", "{", "}", "(", ")", ";", "\n",
+        "if (a < b) { a } else { b }\n", "\"str\"", "[1, 2, 3]", "return a;\n", " ",
+    };
+    std::mt19937 rng(20261018);
+    IncrementalParser parser;
+    std::string source;
+    for (int i = 0; i < 20; ++i) {
+        source += pieces[rng() % pieces.size()];
+    }
+    parser.update(source);
+    check_consistent(parser);
+    for (int i = 0; i < 300; ++i) {
+        auto& current = parser.source();
+        size_t begin = current.empty() ? 0 : rng() % (current.size() + 1);
+        size_t end = std::min(current.size(), begin + rng() % 8);
+        std::string text = rng() % 3 == 0 ? "" : pieces[rng() % pieces.size()];
+        parser.edit(begin, end, text);
+        check_consistent(parser);
+        if (HasFailure()) {
+            break;
+        }
+    }
+}
+
+}
@@ -216,3 +216,67 @@ TEST(Lexer, TestNontrivial) {
         EXPECT_EQ(expect_token.type, token.type);
     }
 }
+
+TEST(Lexer, TestIllegal) {
+    std::string input = R"(a @ "unterminated)";
+    Token expect_tokens[] = {
+        {Token::IDENT, "a"},
+        {Token::ILLEGAL, "@"},
+        {Token::ILLEGAL, "\"unterminated"},
+        {Token::END, ""},
+        {Token::END, ""},
+    };
+
+    Lexer lexer(input);
+
+    for (auto& expect_token: expect_tokens) {
+        auto token = lexer.next_token();
+        EXPECT_EQ(expect_token.literal, token.literal);
+        EXPECT_EQ(expect_token.type, token.type);
+    }
+}
+
+// 插值中的花括号和字符串属于同一个字符串 token
+TEST(Lexer, TestInterpolation) {
+    std::string input = R"("a${x}b" "${h["k"]}" "${ {"a": 1}["a"] }" "\${" "${x" y)";
+    Token expect_tokens[] = {
+        {Token::STRING, "a${x}b"},
+        {Token::STRING, R"(${h["k"]})"},
+        {Token::STRING, R"(${ {"a": 1}["a"] })"},
+        // 转义的 \${ 不开始插值
+        {Token::STRING, R"(\${)"},
+        {Token::ILLEGAL, R"("${x" y)"},
+        {Token::END, ""},
+    };
+
+    Lexer lexer(input);
+
+    for (auto& expect_token: expect_tokens) {
+        auto token = lexer.next_token();
+        EXPECT_EQ(expect_token.literal, token.literal);
+        EXPECT_EQ(expect_token.type, token.type);
+    }
+}
+
+// 嵌套很深的插值不会耗尽栈
+TEST(Lexer, TestDeepInterpolation) {
+    size_t depth = 200000;
+    std::string input;
+    for (size_t i = 0; i < depth; ++i) {
+        input.append("\"${");
+    }
+    input.append("1");
+    for (size_t i = 0; i < depth; ++i) {
+        input.append("}\"");
+    }
+
+    Lexer lexer(input);
+    auto token = lexer.next_token();
+    EXPECT_EQ(Token::STRING, token.type);
+    EXPECT_EQ(input.size() - 2, token.literal.size());
+    EXPECT_EQ(Token::END, lexer.next_token().type);
+
+    // 少一个 } 时没有匹配
+    Lexer unterminated(input.substr(0, input.size() - 2));
+    EXPECT_EQ(Token::ILLEGAL, unterminated.next_token().type);
+}
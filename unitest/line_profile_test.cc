@@ -0,0 +1,105 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "evaluator.h"
+#include "line_profile.h"
+
+using namespace autumn;
+
+namespace {
+
+TEST(LineProfile, TestLineCounts) {
+    auto path = (std::filesystem::temp_directory_path() / "autumn_line_profile.au").string();
+    {
+        std::ofstream out(path);
+        out << "let sum = fn(n) {\n"
+               "    if (n == 0) { return 0; }\n"
+               "    n + sum(n - 1);\n"
+               "};\n"
+               "\n"
+               "let x = sum(3); let y = 1;\n"
+               "if (false) { puts(x); }\n";
+    }
+
+    line_profile::enable(false);
+    line_profile::reset();
+    Evaluator evaluator;
+    evaluator.eval_file(path);
+
+    std::stringstream ss;
+    line_profile::report(ss);
+    // 第 2 行的 if 执行 4 次，return 执行 1 次
+    std::string expected =
+        "        -:    0:Source:" + path + "\n"
+        "        1:    1:let sum = fn(n) {\n"
+        "        5:    2:    if (n == 0) { return 0; }\n"
+        "        3:    3:    n + sum(n - 1);\n"
+        "        -:    4:};\n"
+        "        -:    5:\n"
+        "        2:    6:let x = sum(3); let y = 1;\n"
+        "        1:    7:if (false) { puts(x); }\n";
+    EXPECT_EQ(expected, ss.str());
+}
+
+// 每个线程各自计数，输出时合并
+TEST(LineProfile, TestThreads) {
+    auto path = (std::filesystem::temp_directory_path() / "autumn_line_profile_threads.au").string();
+    {
+        std::ofstream out(path);
+        out << "let count = fn(n) { if (n == 0) { 0 } else { count(n - 1) } };\n"
+               "count(99);\n";
+    }
+
+    line_profile::enable(false);
+    line_profile::reset();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&path]() {
+            Evaluator evaluator;
+            evaluator.eval_file(path);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::stringstream ss;
+    line_profile::report(ss);
+    // 每个线程：第 1 行的 let 执行 1 次，if 和分支里的语句各执行 100 次
+    std::string expected =
+        "        -:    0:Source:" + path + "\n"
+        "      804:    1:let count = fn(n) { if (n == 0) { 0 } else { count(n - 1) } };\n"
+        "        4:    2:count(99);\n";
+    EXPECT_EQ(expected, ss.str());
+}
+
+TEST(LineProfile, TestTimeColumn) {
+    auto path = (std::filesystem::temp_directory_path() / "autumn_line_profile.au").string();
+    {
+        std::ofstream out(path);
+        out << "if (false) {\n"
+               "    1;\n"
+               "}\n";
+    }
+
+    line_profile::enable(true);
+    line_profile::reset();
+    Evaluator evaluator;
+    evaluator.eval_file(path);
+
+    std::stringstream ss;
+    line_profile::report(ss);
+    std::string line;
+    std::getline(ss, line);
+    std::getline(ss, line);
+    EXPECT_EQ("        1:", line.substr(0, 10));
+    EXPECT_EQ("ms:    1:if (false) {", line.substr(line.size() - 21));
+    std::getline(ss, line);
+    EXPECT_EQ("        -:           -:    2:    1;", line);
+}
+
+}
@@ -0,0 +1,155 @@
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "lsp.h"
+
+using namespace autumn;
+using lsp::Json;
+
+namespace {
+
+Json parse(const std::string& text) {
+    Json json;
+    EXPECT_TRUE(Json::parse(text, &json)) << text;
+    return json;
+}
+
+std::string did_open(const std::string& uri, const std::string& text) {
+    return Json(Json::Object{
+        {"jsonrpc", "2.0"},
+        {"method", "textDocument/didOpen"},
+        {"params", Json(Json::Object{
+            {"textDocument", Json(Json::Object{{"uri", uri}, {"text", text}})},
+        })},
+    }).dump();
+}
+
+Json range(size_t start_line, size_t start_character, size_t end_line, size_t end_character) {
+    return Json(Json::Object{
+        {"start", Json(Json::Object{{"line", start_line}, {"character", start_character}})},
+        {"end", Json(Json::Object{{"line", end_line}, {"character", end_character}})},
+    });
+}
+
+std::string did_change(const std::string& uri, Json::Array changes) {
+    return Json(Json::Object{
+        {"jsonrpc", "2.0"},
+        {"method", "textDocument/didChange"},
+        {"params", Json(Json::Object{
+            {"textDocument", Json(Json::Object{{"uri", uri}, {"version", 2}})},
+            {"contentChanges", Json(std::move(changes))},
+        })},
+    }).dump();
+}
+
+TEST(Lsp, TestJson) {
+    auto json = parse(R"({"a": [1, -2.5, true, false, null], "b": "x\n\"é😀"})");
+    ASSERT_EQ(json.type(), Json::OBJECT);
+    auto& a = json["a"].array();
+    ASSERT_EQ(a.size(), 5);
+    EXPECT_EQ(a[0].number(), 1);
+    EXPECT_EQ(a[1].number(), -2.5);
+    EXPECT_TRUE(a[2].boolean());
+    EXPECT_FALSE(a[3].boolean());
+    EXPECT_TRUE(a[4].is_null());
+    EXPECT_EQ(json["b"].string(), "x\n\"\xc3\xa9\xf0\x9f\x98\x80");
+    EXPECT_TRUE(json["missing"].is_null());
+    EXPECT_EQ(json.dump(), "{\"a\":[1,-2.5,true,false,null],\"b\":\"x\\n\\\"\xc3\xa9\xf0\x9f\x98\x80\"}");
+
+    Json out;
+    EXPECT_FALSE(Json::parse("{\"a\": }", &out));
+    EXPECT_FALSE(Json::parse("[1, 2", &out));
+    EXPECT_FALSE(Json::parse("1 2", &out));
+    EXPECT_FALSE(Json::parse(std::string(1000, '['), &out));
+}
+
+TEST(Lsp, TestPosition) {
+    // é 占 2 字节、1 个 UTF-16 码元，😀 占 4 字节、2 个码元
+    std::string text = "ab\n\xc3\xa9x\xf0\x9f\x98\x80y\n";
+    EXPECT_EQ(lsp::offset_of(text, {0, 1}), 1);
+    EXPECT_EQ(lsp::offset_of(text, {1, 0}), 3);
+    EXPECT_EQ(lsp::offset_of(text, {1, 1}), 5);
+    EXPECT_EQ(lsp::offset_of(text, {1, 4}), 10);
+    // 超出行尾截断到换行符，超出行数截断到末尾
+    EXPECT_EQ(lsp::offset_of(text, {0, 10}), 2);
+    EXPECT_EQ(lsp::offset_of(text, {5, 0}), text.size());
+
+    auto position = lsp::position_of(text, 10);
+    EXPECT_EQ(position.line, 1);
+    EXPECT_EQ(position.character, 4);
+    position = lsp::position_of(text, text.size());
+    EXPECT_EQ(position.line, 2);
+    EXPECT_EQ(position.character, 0);
+}
+
+TEST(Lsp, TestLifecycle) {
+    lsp::Server server;
+    auto out = server.handle(R"({"jsonrpc":"2.0","id":1,"method":"initialize","params":{}})");
+    ASSERT_EQ(out.size(), 1);
+    auto init = parse(out[0]);
+    EXPECT_EQ(init["id"].number(), 1);
+    EXPECT_EQ(init["result"]["capabilities"]["textDocumentSync"]["change"].number(), 2);
+    EXPECT_EQ(init["result"]["serverInfo"]["name"].string(), "autumn-lsp");
+
+    EXPECT_TRUE(server.handle(R"({"jsonrpc":"2.0","method":"initialized","params":{}})").empty());
+
+    out = server.handle(R"({"jsonrpc":"2.0","id":2,"method":"textDocument/hover","params":{}})");
+    ASSERT_EQ(out.size(), 1);
+    EXPECT_EQ(parse(out[0])["error"]["code"].number(), -32601);
+
+    out = server.handle("not json");
+    ASSERT_EQ(out.size(), 1);
+    EXPECT_EQ(parse(out[0])["error"]["code"].number(), -32700);
+
+    out = server.handle(R"({"jsonrpc":"2.0","id":3,"method":"shutdown"})");
+    ASSERT_EQ(out.size(), 1);
+    EXPECT_TRUE(parse(out[0])["result"].is_null());
+    EXPECT_FALSE(server.exited());
+    server.handle(R"({"jsonrpc":"2.0","method":"exit"})");
+    EXPECT_TRUE(server.exited());
+    EXPECT_EQ(server.exit_code(), 0);
+
+    lsp::Server abrupt;
+    abrupt.handle(R"({"jsonrpc":"2.0","method":"exit"})");
+    EXPECT_EQ(abrupt.exit_code(), 1);
+}
+
+TEST(Lsp, TestDiagnostics) {
+    const std::string uri = "file:///tmp/a.au";
+    lsp::Server server;
+    auto out = server.handle(did_open(uri, "let a = 1;\nlet b = ;\nlet c = 3;\n"));
+    ASSERT_EQ(out.size(), 1);
+    auto notification = parse(out[0]);
+    EXPECT_EQ(notification["method"].string(), "textDocument/publishDiagnostics");
+    EXPECT_EQ(notification["params"]["uri"].string(), uri);
+    auto& diagnostics = notification["params"]["diagnostics"].array();
+    ASSERT_EQ(diagnostics.size(), 1);
+    EXPECT_EQ(diagnostics[0]["severity"].number(), 1);
+    EXPECT_EQ(diagnostics[0]["source"].string(), "autumn");
+    EXPECT_EQ(diagnostics[0]["message"].string(), "no prefix parse function found for `;`");
+    EXPECT_EQ(diagnostics[0]["range"]["start"]["line"].number(), 1);
+    EXPECT_EQ(diagnostics[0]["range"]["start"]["character"].number(), 0);
+    EXPECT_EQ(diagnostics[0]["range"]["end"]["line"].number(), 1);
+    EXPECT_EQ(diagnostics[0]["range"]["end"]["character"].number(), 9);
+
+    // 增量修改修复错误
+    out = server.handle(did_change(uri, {Json(Json::Object{{"range", range(1, 8, 1, 8)}, {"text", "2"}})}));
+    ASSERT_EQ(out.size(), 1);
+    EXPECT_TRUE(parse(out[0])["params"]["diagnostics"].array().empty());
+    EXPECT_EQ(server.document(uri)->source(), "let a = 1;\nlet b = 2;\nlet c = 3;\n");
+    EXPECT_EQ(server.document(uri)->reused(), 1);
+
+    // 全量修改
+    out = server.handle(did_change(uri, {Json(Json::Object{{"text", "let = 1;\n"}})}));
+    ASSERT_EQ(out.size(), 1);
+    EXPECT_FALSE(parse(out[0])["params"]["diagnostics"].array().empty());
+    EXPECT_EQ(server.document(uri)->source(), "let = 1;\n");
+
+    // 关闭后清空诊断
+    out = server.handle(R"({"jsonrpc":"2.0","method":"textDocument/didClose","params":{"textDocument":{"uri":"file:///tmp/a.au"}}})");
+    ASSERT_EQ(out.size(), 1);
+    EXPECT_TRUE(parse(out[0])["params"]["diagnostics"].array().empty());
+    EXPECT_EQ(server.document(uri), nullptr);
+}
+
+}
@@ -0,0 +1,139 @@
+#include <string>
+#include <tuple>
+#include <vector>
+#include <gtest/gtest.h>
+#include "evaluator.h"
+#include "optimizer.h"
+#include "parser.h"
+
+using namespace autumn;
+
+namespace {
+
+TEST(Optimizer, TestFoldPureCall) {
+    std::vector<std::tuple<std::string, std::string, size_t>> tests = {
+        {
+            "let square = fn(x) { x * x }; square(4);",
+            "let square = fn(x) { (x * x) };16",
+            1,
+        },
+        // 参数中的调用先被替换
+        {
+            "let add = fn(a, b) { a + b }; add(add(1, 2), -3);",
+            "let add = fn(a, b) { (a + b) };0",
+            2,
+        },
+        {
+            R"(let greet = fn(name) { "hi " + name }; greet("autumn");)",
+            "let greet = fn(name) { (hi  + name) };hi autumn",
+            1,
+        },
+        {
+            "let size = fn(a) { len(a) }; let f = fn(n) { n + size([1, 2]) }; f(1);",
+            "let size = fn(a) { len(a) };let f = fn(n) { (n + size([1, 2])) };3",
+            1,
+        },
+        // 相互递归
+        {
+            R"(let even = fn(n) { if (n == 0) { true } else { odd(n - 1) } };
+               let odd = fn(n) { if (n == 0) { false } else { even(n - 1) } };
+               even(10);)",
+            "let even = fn(n) { if ((n == 0)) {true} else {odd((n - 1))} };"
+            "let odd = fn(n) { if ((n == 0)) {false} else {even((n - 1))} };true",
+            1,
+        },
+        // 纯函数体内的常量调用也会被替换
+        {
+            "let k = fn() { 10 }; let g = fn(x) { x + k() };",
+            "let k = fn() { 10 };let g = fn(x) { (x + 10) };",
+            1,
+        },
+    };
+
+    for (auto& test : tests) {
+        Parser parser;
+        auto program = parser.parse(std::get<0>(test));
+        ASSERT_TRUE(program != nullptr);
+        ASSERT_EQ(0u, parser.errors().size());
+
+        Optimizer optimizer;
+        optimizer.optimize(program.get());
+        EXPECT_EQ(std::get<1>(test), program->to_string());
+        EXPECT_EQ(std::get<2>(test), optimizer.folded());
+    }
+}
+
+TEST(Optimizer, TestKeepCall) {
+    std::vector<std::string> tests = {
+        // 有副作用
+        "let say = fn(x) { puts(x); x }; say(1);",
+        // 依赖不纯的函数
+        "let say = fn(x) { puts(x) }; let f = fn(x) { say(x) }; f(1);",
+        // 参数不是常量
+        "let square = fn(x) { x * x }; let n = 2; square(n);",
+        // 调用在定义之前
+        "square(2); let square = fn(x) { x * x };",
+        "let f = fn(x) { g(x) }; f(1); let g = fn(x) { x };",
+        // 名字被重新绑定或被用作参数
+        "let square = fn(x) { x * x }; let square = fn(x) { x }; square(2);",
+        "let square = fn(x) { x * x }; let f = fn(square) { square(2) }; square(2);",
+        // 引用外部变量
+        "let base = 10; let f = fn(x) { x + base }; f(1);",
+        // 包含 import
+        R"(let f = fn(x) { import "m.au" }; f(1);)",
+        // 超出步数预算
+        "let loop = fn(n) { loop(n + 1) }; loop(0);",
+        // 深度递归在调用深度上限处停止
+        "let down = fn(n) { if (n == 0) { 0 } else { down(n - 1) } }; down(5000);",
+        // 出错
+        "let f = fn(x) { x + true }; f(1);",
+        // 不会执行的分支中除以 0
+        "let f = fn(x) { 10 / x }; if (false) { f(0) } else { 1 };",
+        // 结果不是标量
+        "let f = fn(x) { [x] }; f(1);",
+    };
+
+    for (auto& input : tests) {
+        Parser parser;
+        auto program = parser.parse(input);
+        ASSERT_TRUE(program != nullptr);
+        ASSERT_EQ(0u, parser.errors().size());
+
+        auto expect = program->to_string();
+        Optimizer optimizer;
+        optimizer.optimize(program.get());
+        EXPECT_EQ(0u, optimizer.folded()) << input;
+        EXPECT_EQ(expect, program->to_string());
+    }
+}
+
+// 全局环境中重新绑定的内置函数不是纯函数
+TEST(Optimizer, TestGlobalBinding) {
+    Evaluator evaluator;
+    evaluator.eval("let len = fn(x) { 42 };");
+
+    Parser parser;
+    auto program = parser.parse(R"(let f = fn(s) { len(s) }; f("ab");)");
+    ASSERT_TRUE(program != nullptr);
+    Optimizer optimizer(evaluator._env.get());
+    optimizer.optimize(program.get());
+    EXPECT_EQ(0u, optimizer.folded());
+
+    auto object = evaluator.eval(R"(let f = fn(s) { len(s) }; f("ab");)");
+    ASSERT_TRUE(object != nullptr);
+    EXPECT_EQ("42", object->inspect());
+}
+
+TEST(Optimizer, TestEvaluatorResult) {
+    std::string input = R"(
+        let fact = fn(n) { if (n < 2) { 1 } else { n * fact(n - 1) } };
+        let table = [fact(5), fact(6)];
+        table[0] + table[1];
+    )";
+    Evaluator evaluator;
+    auto object = evaluator.eval(input);
+    ASSERT_TRUE(object != nullptr);
+    EXPECT_EQ("840", object->inspect());
+}
+
+}
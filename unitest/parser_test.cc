@@ -200,6 +200,20 @@ TEST(Parser, TestIntegerLiteralExpression) {
     EXPECT_EQ(123, int_literal->value());
 }
 
+// 超出 32 位的整数字面量
+TEST(Parser, TestInt64LiteralExpression) {
+    Parser parser;
+    auto program = parser.parse("5000000000;");
+    ASSERT_TRUE(program != nullptr);
+    ASSERT_EQ(1u, program->statments().size());
+
+    auto stmt = program->statments()[0]->cast<ExpressionStatment>();
+    ASSERT_TRUE(stmt != nullptr);
+    auto int_literal = stmt->expression()->cast<IntegerLiteral>();
+    ASSERT_TRUE(int_literal != nullptr);
+    EXPECT_EQ(5000000000LL, int_literal->value());
+}
+
 TEST(Parser, TestStringLiteralExpression) {
     // 类似于这各只有一个标志符的，也是表达式
     std::string input = R"("hello world")";
@@ -505,6 +519,42 @@ TEST(Parser, TestFunctionParameterParsing) {
     }
 }
 
+TEST(Parser, TestFunctionPrototype) {
+    std::string input = R"(
+        let outer = fn(a, b) {
+            let c = a + b;
+            if (c > limit) { let d = 1; }
+            fn(x) { x + c + scale(y) };
+        };
+    )";
+
+    Parser parser;
+    auto program = parser.parse(input);
+    ASSERT_TRUE(program != nullptr);
+    ASSERT_EQ(0u, parser.errors().size());
+
+    auto stmt = program->statments()[0]->cast<LetStatment>();
+    ASSERT_TRUE(stmt != nullptr);
+    auto prototype = stmt->expression()->cast<FunctionLiteral>()->prototype();
+    EXPECT_EQ("outer", prototype->name);
+    EXPECT_EQ(2u, prototype->arity);
+    // a, b, c, d
+    EXPECT_EQ(4u, prototype->local_count);
+    // 内层函数引用的 c 在外层绑定，scale 和 y 是外层的自由变量
+    std::vector<std::string> expect = {"limit", "scale", "y"};
+    EXPECT_EQ(expect, prototype->free_variables);
+
+    auto& body = prototype->body->statments();
+    auto inner_stmt = body[2]->cast<ExpressionStatment>();
+    ASSERT_TRUE(inner_stmt != nullptr);
+    auto inner = inner_stmt->expression()->cast<FunctionLiteral>()->prototype();
+    EXPECT_EQ("", inner->name);
+    EXPECT_EQ(1u, inner->arity);
+    EXPECT_EQ(1u, inner->local_count);
+    expect = {"c", "scale", "y"};
+    EXPECT_EQ(expect, inner->free_variables);
+}
+
 TEST(Parser, TestCallExpressionParsing) {
     std::string input = "add(1, 2 * 3, 4 + 5)";
 
@@ -671,4 +721,234 @@ TEST(Parser, TestIndexExpression) {
     test_literal("arr", left);
 }
 
+
+TEST(Parser, TestConcatExpression) {
+    std::vector<std::tuple<std::string, size_t, std::string>> tests = {
+        {"a + b", 0, "(a + b)"},
+        {"a + b + c", 3, "((a + b) + c)"},
+        {"a + b + c + d", 4, "(((a + b) + c) + d)"},
+        {"a + b * c + d", 3, "((a + (b * c)) + d)"},
+        {"a - b + c", 0, "((a - b) + c)"},
+        {"a + (b + c) + d", 3, "((a + (b + c)) + d)"},
+    };
+
+    Parser parser;
+    for (auto& test : tests) {
+        auto& input = std::get<0>(test);
+        auto operands = std::get<1>(test);
+        auto& expect = std::get<2>(test);
+
+        auto program = parser.parse(input);
+        ASSERT_TRUE(program != nullptr);
+        ASSERT_EQ(0u, parser.errors().size());
+        EXPECT_EQ(expect, program->to_string());
+
+        auto stmt = program->statments()[0]->cast<ExpressionStatment>();
+        ASSERT_TRUE(stmt != nullptr);
+        auto concat = stmt->expression()->cast<ConcatExpression>();
+        if (operands == 0) {
+            EXPECT_TRUE(concat == nullptr);
+        } else {
+            ASSERT_TRUE(concat != nullptr);
+            EXPECT_EQ(operands, concat->operands().size());
+        }
+    }
+}
+
+TEST(Parser, TestInterpolatedString) {
+    std::vector<std::tuple<std::string, size_t, std::string>> tests = {
+        {R"("x=${x}, y=${y}")", 2, "x=${x}, y=${y}"},
+        {R"("${a + b * c}")", 1, "${(a + (b * c))}"},
+        {R"("${h["k"]}!")", 1, "${(h[k])}!"},
+        {R"("${ "in ${n}" }")", 1, "${in ${n}}"},
+        {R"("${f(1, 2)}${x}")", 2, "${f(1, 2)}${x}"},
+        {R"("no interpolation $ {x}")", 0, "no interpolation $ {x}"},
+        {R"("\${x} is ${x}")", 1, R"(\${x} is ${x})"},
+        {R"("escaped \${x}")", 0, R"(escaped \${x})"},
+    };
+
+    Parser parser;
+    for (auto& test : tests) {
+        auto& input = std::get<0>(test);
+        auto expressions = std::get<1>(test);
+        auto program = parser.parse(input);
+        ASSERT_TRUE(program != nullptr);
+        ASSERT_EQ(0u, parser.errors().size()) << input;
+        EXPECT_EQ(std::get<2>(test), program->to_string());
+
+        auto stmt = program->statments()[0]->cast<ExpressionStatment>();
+        auto interpolated = stmt->expression()->cast<InterpolatedString>();
+        if (expressions == 0) {
+            EXPECT_TRUE(interpolated == nullptr);
+        } else {
+            ASSERT_TRUE(interpolated != nullptr);
+            EXPECT_EQ(expressions, interpolated->expressions().size());
+            EXPECT_EQ(expressions + 1, interpolated->literals().size());
+        }
+    }
+
+    // 插值中引用的变量是函数的自由变量
+    auto program = parser.parse(R"(fn() { "${a}${b}" })");
+    auto fn = program->statments()[0]->cast<ExpressionStatment>()->expression()->cast<FunctionLiteral>();
+    ASSERT_TRUE(fn != nullptr);
+    EXPECT_EQ(std::vector<std::string>({"a", "b"}), fn->prototype()->free_variables);
+
+    std::vector<std::tuple<std::string, std::string>> errors = {
+        {"\n\"${}\"", "empty interpolation in string literal at line 2"},
+        {R"("${a b}")", "unexpected `b` in string interpolation at line 1"},
+        {R"("${#}")", "no prefix parse function found for `#`"},
+    };
+    for (auto& test : errors) {
+        parser.parse(std::get<0>(test));
+        ASSERT_EQ(1u, parser.errors().size()) << std::get<0>(test);
+        EXPECT_EQ(std::get<1>(test), parser.errors()[0]);
+    }
+}
+
+TEST(Parser, TestSliceExpression) {
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {"arr[1:2]", "(arr[1:2])"},
+        {"arr[:2]", "(arr[:2])"},
+        {"arr[1:]", "(arr[1:])"},
+        {"arr[:]", "(arr[:])"},
+        {"arr[1 + 1:len(arr) - 1]", "(arr[(1 + 1):(len(arr) - 1)])"},
+        {"s[0:1][0]", "((s[0:1])[0])"},
+    };
+
+    Parser parser;
+
+    for (auto& test : tests) {
+        auto& input = std::get<0>(test);
+        auto& expect = std::get<1>(test);
+
+        auto program = parser.parse(input);
+        for (auto& error : parser.errors()) {
+            std::cout << error << std::endl;
+        }
+        ASSERT_TRUE(program != nullptr);
+        ASSERT_TRUE(parser.errors().empty());
+
+        auto& statments = program->statments();
+        ASSERT_EQ(1u, statments.size());
+        auto stmt = statments[0]->cast<ExpressionStatment>();
+        ASSERT_TRUE(stmt != nullptr);
+        EXPECT_EQ(expect, stmt->to_string());
+    }
+}
+
+
+TEST(Parser, TestImportExpression) {
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {R"(import "lib/math.au")", R"(import "lib/math.au")"},
+        {R"(let m = import "math.au";)", R"(let m = import "math.au";)"},
+        {R"(import "math.au"["square"](2))", R"((import "math.au"[square])(2))"},
+    };
+
+    Parser parser;
+
+    for (auto& test : tests) {
+        auto& input = std::get<0>(test);
+        auto& expect = std::get<1>(test);
+
+        auto program = parser.parse(input);
+        ASSERT_TRUE(parser.errors().empty());
+        EXPECT_EQ(expect, program->to_string());
+    }
+
+    parser.parse("import foo");
+    EXPECT_EQ(1u, parser.errors().size());
+}
+
+TEST(Parser, TestNestingDepth) {
+    Parser parser;
+    parser.set_max_depth(100);
+
+    // 每层数组、调用、分组、前缀表达式占一层
+    auto nested = [](const std::string& open, const std::string& inner, const std::string& close, size_t n) {
+        std::string ret;
+        for (size_t i = 0; i < n; ++i) {
+            ret.append(open);
+        }
+        ret.append(inner);
+        for (size_t i = 0; i < n; ++i) {
+            ret.append(close);
+        }
+        return ret;
+    };
+
+    std::vector<std::tuple<std::string, std::string, std::string>> tests = {
+        {"[", "1", "]"},
+        {"f(", "1", ")"},
+        {"(", "1", ")"},
+        {"-", "1", ""},
+        {"{\"a\": ", "1", "}"},
+        {"if (true) { ", "1", " }"},
+        {"fn() { ", "1", " }"},
+        {"\"${", "1", "}\""},
+    };
+    for (auto& test : tests) {
+        auto& open = std::get<0>(test);
+        auto& inner = std::get<1>(test);
+        auto& close = std::get<2>(test);
+
+        auto program = parser.parse(nested(open, inner, close, 40));
+        EXPECT_TRUE(program != nullptr) << open;
+        EXPECT_TRUE(parser.errors().empty()) << open;
+
+        // 超出上限时只报一个错误，不会耗尽栈
+        program = parser.parse("let x = 1;\n" + nested(open, inner, close, 100000));
+        EXPECT_TRUE(program == nullptr) << open;
+        ASSERT_EQ(1u, parser.errors().size()) << open;
+        EXPECT_EQ("nesting too deep: more than 100 levels at line 2", parser.errors()[0]);
+    }
+
+    // 长的运算符链不增加嵌套层数
+    std::string chain = "1";
+    for (size_t i = 0; i < 10000; ++i) {
+        chain.append(i % 2 == 0 ? " + 1" : " * 2");
+    }
+    auto program = parser.parse(chain);
+    EXPECT_TRUE(program != nullptr);
+    EXPECT_TRUE(parser.errors().empty());
+
+    // 其它左结合的链每个运算符深一层
+    for (auto& op : {" - ", " == ", " * ", " < "}) {
+        chain = "1";
+        for (size_t i = 0; i < 20000; ++i) {
+            chain.append(op).append("1");
+        }
+        program = parser.parse(chain);
+        EXPECT_TRUE(program == nullptr) << op;
+        ASSERT_EQ(1u, parser.errors().size()) << op;
+        EXPECT_EQ("nesting too deep: more than 100 levels at line 1", parser.errors()[0]);
+    }
+    chain = "f";
+    for (size_t i = 0; i < 20000; ++i) {
+        chain.append("()");
+    }
+    program = parser.parse(chain);
+    EXPECT_TRUE(program == nullptr);
+    EXPECT_EQ(1u, parser.errors().size());
+}
+
+TEST(Parser, TestIllegalToken) {
+    Parser parser;
+    parser.parse("let a = 1 @ 2; let b = #;");
+    ASSERT_FALSE(parser.errors().empty());
+    EXPECT_EQ("no prefix parse function found for `#`", parser.errors().back());
+
+    // 没有结尾的引号
+    parser.parse(R"(let s = "abc)");
+    ASSERT_EQ(1u, parser.errors().size());
+    EXPECT_EQ("unterminated string literal at line 1", parser.errors()[0]);
+
+    parser.parse("let a = 1;\nlet s = \"x = ${x + \"y\";");
+    ASSERT_EQ(1u, parser.errors().size());
+    EXPECT_EQ("unterminated string interpolation at line 2", parser.errors()[0]);
+
+    parser.parse(R"(let s = "x = \${x)");
+    ASSERT_EQ(1u, parser.errors().size());
+    EXPECT_EQ("unterminated string literal at line 1", parser.errors()[0]);
+}
+
 }
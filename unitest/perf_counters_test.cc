@@ -0,0 +1,66 @@
+#include <sstream>
+#include <string>
+#include <gtest/gtest.h>
+#include "evaluator.h"
+#include "perf_counters.h"
+
+using namespace autumn;
+
+namespace {
+
+TEST(PerfCounters, TestValues) {
+    perf_counters::Values a;
+    perf_counters::Values b;
+    a.value[perf_counters::CYCLES] = 10;
+    a.value[perf_counters::CACHE_MISSES] = 3;
+    b.value[perf_counters::CYCLES] = 4;
+
+    auto delta = a - b;
+    EXPECT_EQ(6, delta.value[perf_counters::CYCLES]);
+    EXPECT_EQ(3, delta.value[perf_counters::CACHE_MISSES]);
+    delta += b;
+    EXPECT_EQ(10, delta.value[perf_counters::CYCLES]);
+    EXPECT_STREQ("branch-misses", perf_counters::event_name(perf_counters::BRANCH_MISSES));
+}
+
+// 计数器在容器或虚拟机中经常不可用，两种情况都要能正常执行
+TEST(PerfCounters, TestPhases) {
+    perf_counters::enable();
+    perf_counters::reset();
+    Evaluator evaluator;
+    // set 不是纯函数，len 不会在编译期被折叠
+    auto obj = evaluator.eval("let a = set([1, 2, 3]); len(a)");
+    EXPECT_EQ("3", obj->inspect());
+
+    perf_counters::Values values;
+    EXPECT_EQ(perf_counters::available(), perf_counters::read(&values));
+
+    std::stringstream ss;
+    perf_counters::report(ss);
+    auto report = ss.str();
+    if (perf_counters::available()) {
+        EXPECT_NE(std::string::npos, report.find("lex")) << report;
+        EXPECT_NE(std::string::npos, report.find("parse")) << report;
+        EXPECT_NE(std::string::npos, report.find("eval")) << report;
+        EXPECT_NE(std::string::npos, report.find("builtin:len")) << report;
+    } else {
+        EXPECT_EQ(0, report.find("perf counters unavailable: ")) << report;
+        EXPECT_FALSE(perf_counters::unavailable_reason().empty());
+    }
+    perf_counters::reset();
+}
+
+TEST(PerfCounters, TestBench) {
+    perf_counters::enable();
+    Evaluator evaluator;
+    auto obj = evaluator.eval(R"(let r = bench(fn() { [1, 2] }, 10); [r["iterations"], r["instructions"]])");
+    if (perf_counters::available() && perf_counters::supported(perf_counters::INSTRUCTIONS)) {
+        EXPECT_EQ(0, obj->inspect().find("[10, ")) << obj->inspect();
+        EXPECT_NE("[10, null]", obj->inspect());
+    } else {
+        EXPECT_EQ("[10, null]", obj->inspect());
+    }
+    perf_counters::reset();
+}
+
+}
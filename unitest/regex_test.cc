@@ -0,0 +1,204 @@
+#include <chrono>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <gtest/gtest.h>
+#include "evaluator.h"
+#include "regexp.h"
+
+using namespace autumn;
+using namespace autumn::object;
+
+namespace {
+
+std::string run(Evaluator& evaluator, const std::string& input) {
+    auto obj = evaluator.eval(input);
+    if (obj == nullptr) {
+        return std::string();
+    }
+    auto error = obj->cast<Error>();
+    return error != nullptr ? error->message() : obj->inspect();
+}
+
+// 第一个匹配的各个分组，没有参与匹配的写成 -，没有匹配时返回 "no match"
+std::string search(const std::string& pattern, const std::string& input) {
+    std::string error;
+    auto regex = regexp::Regex::compile(pattern, &error);
+    if (regex == nullptr) {
+        return "error: " + error;
+    }
+    std::vector<size_t> captures;
+    if (!regex->search(input, 0, &captures)) {
+        return "no match";
+    }
+    std::string ret;
+    for (size_t i = 0; i < captures.size(); i += 2) {
+        if (i > 0) {
+            ret += "|";
+        }
+        if (captures[i] == regexp::Regex::npos) {
+            ret += "-";
+        } else {
+            ret += input.substr(captures[i], captures[i + 1] - captures[i]);
+        }
+    }
+    return ret;
+}
+
+TEST(Regex, TestSearch) {
+    std::vector<std::tuple<std::string, std::string, std::string>> tests = {
+        {"abc", "xxabcxx", "abc"},
+        {"abc", "ab", "no match"},
+        {"a.c", "a\nc abc", "abc"},
+        {"a|b|c", "xcba", "c"},
+        {"a*", "baa", ""},
+        {"a+", "baa", "aa"},
+        {"a+?", "baa", "a"},
+        {"colou?r", "color", "color"},
+        {"a{2}", "aaaa", "aa"},
+        {"a{2,}", "aaaa", "aaaa"},
+        {"a{1,3}", "aaaa", "aaa"},
+        {"a{1,3}?", "aaaa", "a"},
+        {"a{,2}", "a{,2}", "a{,2}"},
+        {"(a)(b)?", "ac", "a|a|-"},
+        {"(\\w+)@(\\w+)\\.com", "mail bob@example.com now", "bob@example.com|bob|example"},
+        {"(?:ab)+", "ababa", "abab"},
+        {"(a|ab)(c|bcd)", "abcd", "abcd|a|bcd"},
+        {"(ab|a)(c|bcd)?", "abcd", "abc|ab|c"},
+        {"(ab|a)(x)?", "abcd", "ab|ab|-"},
+        {"(a+)(a*)", "aaa", "aaa|aaa|"},
+        {"(a*?)(a*)", "aaa", "aaa||aaa"},
+        {"[a-c]+", "xxbcay", "bca"},
+        {"[^a-c]+", "abxyc", "xy"},
+        {"[]a]+", "x]a]", "]a]"},
+        {"[a-]+", "-a-b", "-a-"},
+        {"[\\d.]+", "v1.25", "1.25"},
+        {"[\\D]+", "12ab3", "ab"},
+        {"\\d+", "abc 123", "123"},
+        {"\\s+", "a \t\nb", " \t\n"},
+        {"\\W+", "ab, cd", ", "},
+        {"\\.\\*", "a.*b", ".*"},
+        {"^ab", "xab", "no match"},
+        {"^ab", "abx", "ab"},
+        {"ab$", "abab", "ab"},
+        {"^$", "", ""},
+        {"\\bcat\\b", "concat cat", "cat"},
+        {"\\Bcat", "cat concat", "cat"},
+        {"秋.", "春秋天", "秋天"},
+        {"[秋天]+", "春秋天", "秋天"},
+        {"^.$", "秋", "秋"},
+    };
+    for (auto& test : tests) {
+        EXPECT_EQ(std::get<2>(test), search(std::get<0>(test), std::get<1>(test)))
+            << std::get<0>(test) << " ~ " << std::get<1>(test);
+    }
+}
+
+TEST(Regex, TestCompileErrors) {
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {"(ab", "error: missing `)` at offset 3"},
+        {"ab)", "error: unmatched `)` at offset 2"},
+        {"*a", "error: nothing to repeat before `*` at offset 0"},
+        {"a|+", "error: nothing to repeat before `+` at offset 2"},
+        {"[ab", "error: missing `]` at offset 3"},
+        {"[z-a]", "error: invalid class range at offset 4"},
+        {"a\\", "error: trailing `\\` at offset 2"},
+        {"\\q", "error: unknown escape `\\q` at offset 1"},
+        {"a{3,2}", "error: invalid repeat count at offset 6"},
+        {"a{1001}", "error: repeat count exceeds 1000 at offset 7"},
+        {"(a{1000}){1000}", "error: pattern too large at offset 15"},
+        {std::string(300, '(') + std::string(300, ')'), "error: nesting too deep at offset 251"},
+    };
+    for (auto& test : tests) {
+        EXPECT_EQ(std::get<1>(test), search(std::get<0>(test), "a")) << std::get<0>(test);
+    }
+}
+
+// 回溯实现在这些模式上是指数时间的
+TEST(Regex, TestLinearTime) {
+    std::string input(20000, 'a');
+    auto begin = std::chrono::steady_clock::now();
+    EXPECT_EQ("no match", search("(a*)*b", input));
+    EXPECT_EQ("no match", search("(a|a)*b", input));
+    EXPECT_EQ("no match", search("(a|aa)+$x", input));
+    EXPECT_EQ(input + "|a", search("(a?){20}a{20}.*", input));
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    EXPECT_LT(elapsed, std::chrono::seconds(10));
+}
+
+TEST(Regex, TestCache) {
+    regexp::Cache cache(2);
+    std::string error;
+    auto a = cache.get("a+", &error);
+    ASSERT_NE(nullptr, a);
+    EXPECT_EQ(a, cache.get("a+", &error));
+    EXPECT_EQ(1u, cache.hits());
+    EXPECT_EQ(1u, cache.misses());
+
+    cache.get("b+", &error);
+    // a+ 最近用过，淘汰的是 b+
+    EXPECT_EQ(a, cache.get("a+", &error));
+    cache.get("c+", &error);
+    EXPECT_EQ(2u, cache.size());
+    EXPECT_EQ(a, cache.get("a+", &error));
+    size_t misses = cache.misses();
+    cache.get("b+", &error);
+    EXPECT_EQ(misses + 1, cache.misses());
+
+    // 编译失败的模式不缓存
+    EXPECT_EQ(nullptr, cache.get("(", &error));
+    EXPECT_EQ("missing `)` at offset 1", error);
+    EXPECT_EQ(2u, cache.size());
+}
+
+TEST(Regex, TestBuiltins) {
+    Evaluator evaluator;
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {R"(match("(\w+)=(\d+)?", "x key= y"))", R"(["key=", "key", null])"},
+        {R"(match("\d", "abc"))", "null"},
+        {R"(match("b", "abc")[0])", R"("b")"},
+        {R"(find_all("\d+", "a1b22c333"))", R"(["1", "22", "333"])"},
+        {R"(find_all("x*", "axb"))", R"(["", "x", "", ""])"},
+        {R"(find_all("", "秋天"))", R"(["", "", ""])"},
+        {R"(find_all("z", "abc"))", "[]"},
+        {R"x(regex_replace("(\w+)@(\w+)", "bob@home, amy@work", "$2:$1"))x", R"("home:bob, work:amy")"},
+        {R"(regex_replace("a", "banana", "[$0$$]"))", R"("b[a$]n[a$]n[a$]")"},
+        {R"(regex_replace("x", "abc", "y"))", R"("abc")"},
+        {R"(regex_replace("", "ab", "-"))", R"("-a-b-")"},
+        {R"(regex_replace("\d+", "a1b22", fn(m) { len(m[0]) * 10 }))", R"("a10b20")"},
+        {R"(regex_replace("a(b)?", "ac", "<$1>"))", R"("<>c")"},
+        {R"(regex_replace("a", "a$", "$"))", R"("$$")"},
+        {R"(regex_split(",\s*", "a, b,c"))", R"(["a", "b", "c"])"},
+        {R"(regex_split(",", ",a,"))", R"(["", "a", ""])"},
+        {R"(regex_split("x", "abc"))", R"(["abc"])"},
+        {R"(match("(", "a"))", "match: missing `)` at offset 1"},
+        {R"(find_all("[", "a"))", "find_all: missing `]` at offset 1"},
+        {R"(regex_replace("a", "a", "$3"))", "regex_replace: invalid group reference $3"},
+        {R"(regex_replace("a", "a", 1))", "argument to `regex_replace` not supported, got INTEGER"},
+        {R"(regex_replace("a", "a", fn(m) { m + 1 }))", "type mismatch: `ARRAY + INTEGER`"},
+        {R"(regex_split(1, "a"))", "argument to `regex_split` not supported, got INTEGER"},
+        {R"(match("a", [1]))", "argument to `match` not supported, got ARRAY"},
+        {R"(match("a"))", "wrong number of arguments. expected 2, got 1"},
+    };
+    for (auto& test : tests) {
+        EXPECT_EQ(std::get<1>(test), run(evaluator, std::get<0>(test))) << std::get<0>(test);
+    }
+}
+
+// 同一个 evaluator 中重复使用的模式只编译一次
+TEST(Regex, TestEvaluatorCache) {
+    Evaluator evaluator;
+    evaluator.eval(R"(
+        let words = ["a1", "b2", "c"];
+        let count = fn(i, n) {
+            if (i == len(words)) { n } else { count(i + 1, n + len(find_all("\d", words[i]))) }
+        };
+        count(0, 0);
+    )");
+    EXPECT_EQ(1u, evaluator.regex_cache().misses());
+    EXPECT_EQ(2u, evaluator.regex_cache().hits());
+    EXPECT_EQ("2", run(evaluator, "count(0, 0)"));
+    EXPECT_EQ(1u, evaluator.regex_cache().size());
+}
+
+}
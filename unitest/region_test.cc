@@ -0,0 +1,244 @@
+#include <string>
+#include <gtest/gtest.h>
+#include "evaluator.h"
+#include "region.h"
+
+using namespace autumn;
+
+namespace {
+
+TEST(Region, TestAllocateReset) {
+    auto region = region::create();
+    std::shared_ptr<object::Object> obj;
+    {
+        region::Scope scope(region.get());
+        obj = object::make<object::Integer>(42);
+    }
+    ASSERT_TRUE(region->contains(obj.get()));
+    ASSERT_EQ(1u, region->live());
+    ASSERT_FALSE(region->reset());
+
+    auto heap = object::make<object::Integer>(1);
+    ASSERT_FALSE(region->contains(heap.get()));
+
+    obj.reset();
+    ASSERT_EQ(0u, region->live());
+    ASSERT_TRUE(region->reset());
+    ASSERT_EQ(0u, region->used());
+
+    // 回卷后复用同一个块
+    auto capacity = region->capacity();
+    {
+        region::Scope scope(region.get());
+        obj = object::make<object::Integer>(7);
+    }
+    ASSERT_EQ(capacity, region->capacity());
+    ASSERT_TRUE(region->contains(obj.get()));
+}
+
+TEST(Region, TestLargeAllocation) {
+    auto region = region::create();
+    region::Scope scope(region.get());
+    auto p = region->allocate(region::Region::BLOCK_SIZE * 2, 16);
+    ASSERT_TRUE(region->contains(p));
+    ASSERT_TRUE(region->contains(static_cast<char*>(p) + region::Region::BLOCK_SIZE * 2 - 1));
+    region->deallocate();
+    ASSERT_TRUE(region->reset());
+}
+
+// 区域被弃用后，对象仍然可以安全使用，最后一个对象释放时归还内存
+TEST(Region, TestAbandon) {
+    std::shared_ptr<object::Object> obj;
+    {
+        auto region = region::create();
+        region::Scope scope(region.get());
+        obj = object::make<object::String>(std::string("outlives its region"));
+    }
+    ASSERT_EQ("\"outlives its region\"", obj->inspect());
+}
+
+std::string run(Evaluator& evaluator, const std::string& input) {
+    auto obj = evaluator.eval(input);
+    return obj == nullptr ? std::string() : obj->inspect();
+}
+
+TEST(Region, TestPromoteGlobals) {
+    Evaluator evaluator;
+    evaluator.set_region_mode(true);
+    run(evaluator, R"(
+        let a = [1, 2, {"x": "a string longer than fifteen bytes", "y": [3]}];
+        let h = {1: "one", 2: "two", 3: "three"};
+        let s = set([1]);
+        add(s, 5);
+        let d = deque([1]);
+        push_back(d, 7);
+        let q = priority_queue(fn(x, y) { x > y });
+        pq_push(q, 3);
+        pq_push(q, 9);
+    )");
+
+    auto a = evaluator._env->get("a");
+    ASSERT_NE(nullptr, a);
+    ASSERT_FALSE(evaluator._region->contains(a.get()));
+
+    // 下一个请求会复用并覆盖区域的内存，之前的值必须已经搬到堆上
+    ASSERT_EQ("[100, 200, 300, 400, 500]", run(evaluator, "[100, 200, 300, 400, 500]"));
+    ASSERT_EQ("\"a string longer than fifteen bytes\"", run(evaluator, R"(a[2]["x"])"));
+    ASSERT_EQ("[3]", run(evaluator, R"(a[2]["y"])"));
+    ASSERT_EQ("\"three\"", run(evaluator, "h[3]"));
+    ASSERT_EQ("true", run(evaluator, "has(s, 5)"));
+    ASSERT_EQ("7", run(evaluator, "pop_back(d)"));
+    ASSERT_EQ("9", run(evaluator, "pq_pop(q)"));
+    ASSERT_EQ("3", run(evaluator, "pq_pop(q)"));
+
+    // 堆上的可变容器在请求中写入的区域对象也要提升
+    run(evaluator, "add(s, 11); push_front(d, [8]);");
+    ASSERT_EQ("true", run(evaluator, "has(s, 11)"));
+    ASSERT_EQ("[8]", run(evaluator, "pop_front(d)"));
+
+    auto& stats = evaluator.region_stats();
+    ASSERT_EQ(stats.requests, stats.resets);
+    ASSERT_EQ(0u, stats.retired);
+    ASSERT_LT(0u, stats.promoted);
+    ASSERT_LT(0u, stats.bytes);
+}
+
+TEST(Region, TestPromoteClosures) {
+    Evaluator evaluator;
+    evaluator.set_region_mode(true);
+    run(evaluator, R"(
+        let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } };
+        let adder = fn(c) { fn(x) { x + c } };
+        let plus = adder(10);
+        let counter = fn() {
+            let loop = fn(n) { if (n == 0) { 0 } else { loop(n - 1) } };
+            loop;
+        }();
+    )");
+    ASSERT_EQ("55", run(evaluator, "fib(10)"));
+    ASSERT_EQ("15", run(evaluator, "plus(5)"));
+    ASSERT_EQ("0", run(evaluator, "counter(3)"));
+
+    // 只在请求内部存活的递归闭包形成环，结束时被断开，区域可以回卷
+    run(evaluator, R"(
+        let f = fn() {
+            let loop = fn(n) { if (n == 0) { 0 } else { loop(n - 1) } };
+            loop(5);
+        };
+        f();
+    )");
+
+    auto fn = evaluator._env->get("plus");
+    ASSERT_FALSE(evaluator._region->contains(fn.get()));
+    auto& stats = evaluator.region_stats();
+    ASSERT_EQ(stats.requests, stats.resets);
+    ASSERT_EQ(0u, stats.retired);
+
+    // 请求结束后存活的闭包都已提升，归入 Evaluator
+    size_t request_closures = 0;
+    evaluator._request_closures.for_each([&request_closures](const object::Function*) {
+        ++request_closures;
+    });
+    ASSERT_EQ(0u, request_closures);
+    evaluator._closures.for_each([&evaluator](const object::Function* fn) {
+        ASSERT_FALSE(evaluator._region->contains(fn));
+    });
+}
+
+// 堆上的数组和 hash 里的可变容器在请求中放入了区域内的闭包
+TEST(Region, TestPromoteThroughHeapContainers) {
+    Evaluator evaluator;
+    evaluator.set_region_mode(true);
+    run(evaluator, R"(let holder = [deque()]; let table = {"q": deque()};)");
+    run(evaluator, R"(
+        let add = fn() {
+            let y = 41;
+            push_back(holder[0], fn() { y + 1 });
+            push_back(table["q"], fn() { y + 2 });
+            0
+        };
+        add();
+    )");
+    ASSERT_EQ("42", run(evaluator, "let f = pop_front(holder[0]); f();"));
+    ASSERT_EQ("43", run(evaluator, R"(let g = pop_front(table["q"]); g();)"));
+}
+
+// 请求结束时只修正写入过区域对象的堆上容器，不遍历整个全局环境
+TEST(Region, TestFixOnlyWrittenContainers) {
+    Evaluator evaluator;
+    evaluator.set_region_mode(true);
+    run(evaluator, "let ds = [deque(), deque(), deque()]; let ss = [set([1]), set([2])];");
+    auto& stats = evaluator.region_stats();
+    auto fixed = stats.fixed;
+
+    run(evaluator, "push_back(ds[1], [5]); 0");
+    ASSERT_EQ(fixed + 1, stats.fixed);
+    run(evaluator, "len(ss)");
+    ASSERT_EQ(fixed + 1, stats.fixed);
+    ASSERT_EQ("[5]", run(evaluator, "pop_front(ds[1])"));
+    ASSERT_EQ(stats.requests, stats.resets);
+}
+
+// 经过双端队列回到自身的 hash 只拷贝一次
+TEST(Region, TestPromoteHashCycle) {
+    for (bool shaped : {false, true}) {
+        auto region = region::create();
+        std::shared_ptr<object::Object> hash;
+        std::shared_ptr<object::Object> deque;
+        {
+            region::Scope scope(region.get());
+            deque = object::make<object::Deque>();
+            if (shaped) {
+                std::vector<std::shared_ptr<object::Object>> slots{deque};
+                hash = object::make<object::Hash>(object::Shape::intern({"d"}), std::move(slots));
+            } else {
+                auto h = object::make<object::Hash>();
+                h->append(object::String::make("d"), deque);
+                hash = h;
+            }
+            deque->cast<object::Deque>()->push_back(hash);
+        }
+
+        region::Promoter promoter(region.get());
+        auto copy = promoter.promote(hash);
+        ASSERT_EQ(2u, promoter.promoted());
+        auto copied_deque = copy->cast<object::Hash>()->get("d");
+        ASSERT_EQ(copy.get(), copied_deque->cast<object::Deque>()->at(0).get());
+
+        // 断开两边的环
+        copied_deque->cast<object::Deque>()->pop_front();
+        deque->cast<object::Deque>()->pop_front();
+    }
+}
+
+TEST(Region, TestResultOutlivesRequest) {
+    Evaluator evaluator;
+    evaluator.set_region_mode(true);
+    auto first = evaluator.eval("[1, 2, 3]");
+    ASSERT_NE(nullptr, first);
+    ASSERT_FALSE(evaluator._region->contains(first.get()));
+    evaluator.eval("[4, 5, 6]");
+    ASSERT_EQ("[1, 2, 3]", first->inspect());
+
+    auto error = evaluator.eval("1 + true");
+    ASSERT_EQ(typeid(object::Error), typeid(*error));
+    ASSERT_EQ(evaluator.region_stats().requests, evaluator.region_stats().resets);
+}
+
+// 冻结的对象就地保留在区域里，区域被弃用而不是回卷
+TEST(Region, TestFreezeInRegion) {
+    Evaluator evaluator;
+    evaluator.set_region_mode(true);
+    run(evaluator, "let s = freeze(set([1, 2]));");
+    auto s = evaluator._env->get("s");
+    ASSERT_TRUE(s->frozen());
+    ASSERT_EQ(1u, evaluator.region_stats().retired);
+    ASSERT_FALSE(evaluator._region->contains(s.get()));
+
+    run(evaluator, "[1, 2, 3]");
+    ASSERT_EQ("true", run(evaluator, "has(s, 2)"));
+    ASSERT_EQ("error: argument to `add` is frozen, got SET", run(evaluator, "add(s, 3)"));
+    ASSERT_EQ(1u, evaluator.region_stats().retired);
+}
+
+}
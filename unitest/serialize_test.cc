@@ -0,0 +1,223 @@
+#include <string>
+#include <tuple>
+#include <vector>
+#include <gtest/gtest.h>
+#include "evaluator.h"
+#include "serialize.h"
+
+using namespace autumn;
+using namespace autumn::object;
+
+namespace {
+
+std::string run(Evaluator& evaluator, const std::string& input) {
+    auto obj = evaluator.eval(input);
+    if (obj == nullptr) {
+        return std::string();
+    }
+    auto error = obj->cast<Error>();
+    return error != nullptr ? error->message() : obj->inspect();
+}
+
+// 带上文件头的原始字节
+std::string raw(std::initializer_list<int> bytes) {
+    std::string ret("AU\x01", 3);
+    for (auto b : bytes) {
+        ret.push_back(static_cast<char>(b));
+    }
+    return ret;
+}
+
+std::string encode(const std::shared_ptr<Object>& value) {
+    std::string bytes;
+    auto error = serialize::encode(value.get(), &bytes);
+    EXPECT_EQ(nullptr, error);
+    return bytes;
+}
+
+TEST(Serialize, TestRoundTrip) {
+    std::vector<std::string> tests = {
+        "1",
+        "-1",
+        "0",
+        "9223372036854775807",
+        "true",
+        "false",
+        "null",
+        R"("")",
+        R"("a")",
+        R"("hello autumn")",
+        R"("秋天的风吹过了一个很长很长的下午")",
+        R"([1, "two", [3, [4, []]], true, null])",
+        R"({"name": "autumn", "tags": ["a", "b"], "meta": {"id": 7}})",
+        R"({1: "one", 2: "two", 3: "three"})",
+        R"({"a": 1, 2: "b", true: [1]})",
+        "set([1, 2, 3])",
+        R"(deque([1, "x", [2]]))",
+    };
+
+    Evaluator evaluator;
+    for (auto& input : tests) {
+        auto expect = run(evaluator, input);
+        auto output = run(evaluator, "deserialize(serialize(" + input + "))");
+        EXPECT_EQ(expect, output) << input;
+        auto zero_copy = run(evaluator, "deserialize(serialize(" + input + "), true)");
+        EXPECT_EQ(expect, zero_copy) << input;
+    }
+}
+
+// shape 方式的 hash 解码后仍是 shape 方式，与字面量共享同一个 shape
+TEST(Serialize, TestRecord) {
+    Evaluator evaluator;
+    auto literal = evaluator.eval(R"({"x": 1, "y": 2})");
+    auto hash = literal->cast<Hash>();
+    ASSERT_EQ(Hash::SHAPED, hash->storage());
+
+    auto decoded = serialize::decode(encode(std::const_pointer_cast<Object>(literal)));
+    auto copy = decoded->cast<Hash>();
+    ASSERT_NE(nullptr, copy);
+    EXPECT_EQ(Hash::SHAPED, copy->storage());
+    EXPECT_EQ(hash->shape(), copy->shape());
+    EXPECT_EQ("2", copy->get("y")->inspect());
+}
+
+// 解码不新建 shape，没见过的键布局按普通 hash 解码
+TEST(Serialize, TestRecordUnseenShape) {
+    Evaluator evaluator;
+    std::string input = "[";
+    for (size_t i = 0; i < 40; ++i) {
+        input += "{" + format(R"("seen_{}": {})", i + 10, i) + "}, ";
+    }
+    input += R"({"x": 1, "y": 2}])";
+    auto value = evaluator.eval(input);
+    ASSERT_NE(nullptr, value->cast<Array>()) << value->inspect();
+
+    // 把键换成等长的、还没有 shape 的名字
+    auto bytes = encode(std::const_pointer_cast<Object>(value));
+    for (size_t pos = bytes.find("seen_"); pos != std::string::npos; pos = bytes.find("seen_", pos)) {
+        bytes.replace(pos, 5, "new__");
+    }
+    for (size_t round = 0; round < 2; ++round) {
+        auto decoded = serialize::decode(bytes);
+        auto elems = decoded->cast<Array>()->elements();
+        ASSERT_EQ(41u, elems.size());
+        for (size_t i = 0; i < 40; ++i) {
+            auto hash = elems[i]->cast<Hash>();
+            EXPECT_EQ(format("{}", i), hash->get(format("new__{}", i + 10))->inspect());
+            EXPECT_NE(Hash::SHAPED, hash->storage());
+            EXPECT_EQ(nullptr, Shape::lookup({format("new__{}", i + 10)}));
+        }
+        // 已经存在的 shape 照常复用
+        EXPECT_EQ(Hash::SHAPED, elems[40]->cast<Hash>()->storage());
+        EXPECT_EQ(value->cast<Array>()->elements()[40]->cast<Hash>()->shape(),
+                elems[40]->cast<Hash>()->shape());
+    }
+}
+
+// 共享的子图只编码一次，解码后仍然共享
+TEST(Serialize, TestSharedReferences) {
+    Evaluator evaluator;
+    evaluator.eval(R"(
+        let row = [1, 2, 3, 4, 5, 6, 7, 8, 9, 10, "a string that is long enough"];
+        let shared = [row, row, row, row];
+        let single = [row];
+    )");
+    auto shared = evaluator._env->get("shared");
+    auto single = evaluator._env->get("single");
+    auto shared_bytes = encode(shared);
+    auto single_bytes = encode(single);
+    // 每多引用一次只多一个 REF（2 个字节）
+    EXPECT_EQ(single_bytes.size() + 3 * 2, shared_bytes.size());
+
+    auto decoded = serialize::decode(shared_bytes);
+    auto elems = decoded->cast<Array>()->elements();
+    ASSERT_EQ(4u, elems.size());
+    EXPECT_EQ(elems[0].get(), elems[3].get());
+}
+
+// 双端队列与数组之间的环可以还原
+TEST(Serialize, TestCycle) {
+    Evaluator evaluator;
+    evaluator.eval(R"(
+        let d = deque([1]);
+        let a = [d, "x"];
+        push_back(d, a);
+    )");
+    auto decoded = serialize::decode(encode(evaluator._env->get("a")));
+    auto array = decoded->cast<Array>();
+    ASSERT_NE(nullptr, array);
+    auto deque = array->elements()[0]->cast<Deque>();
+    ASSERT_NE(nullptr, deque);
+    ASSERT_EQ(2u, deque->size());
+    EXPECT_EQ(array, deque->at(1).get());
+
+    // 断开环，避免泄漏
+    const_cast<Deque*>(deque)->pop_back();
+}
+
+TEST(Serialize, TestZeroCopy) {
+    Evaluator evaluator;
+    auto value = evaluator.eval(R"(["short", "a string longer than the inline size"])");
+    auto bytes = std::make_shared<String>(encode(std::const_pointer_cast<Object>(value)));
+
+    auto copied = serialize::decode(bytes, false);
+    auto long_copy = copied->cast<Array>()->elements()[1]->cast<String>();
+    EXPECT_EQ(nullptr, long_copy->_owner);
+
+    auto viewed = serialize::decode(bytes, true);
+    auto elems = viewed->cast<Array>()->elements();
+    auto short_view = elems[0]->cast<String>();
+    auto long_view = elems[1]->cast<String>();
+    // 短字符串直接拷贝，长字符串引用输入缓冲区
+    EXPECT_EQ(nullptr, short_view->_owner);
+    EXPECT_EQ(bytes, long_view->_owner);
+    EXPECT_GE(long_view->value().data(), bytes->value().data());
+    EXPECT_LT(long_view->value().data(), bytes->value().data() + bytes->value().size());
+    EXPECT_EQ("a string longer than the inline size", long_view->value());
+}
+
+TEST(Serialize, TestErrors) {
+    Evaluator evaluator;
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {"serialize(fn(x) { x })", "argument to `serialize` not supported, got FUNCTION"},
+        {"serialize([1, len])", "argument to `serialize` not supported, got BUILTIN"},
+        {"serialize(priority_queue())", "argument to `serialize` not supported, got PRIORITY_QUEUE"},
+        {"serialize()", "wrong number of arguments. expected 1, got 0"},
+        {"deserialize(1)", "argument to `deserialize` not supported, got INTEGER"},
+        {R"(deserialize("x", 1))", "argument to `deserialize` not supported, got INTEGER"},
+        {R"(deserialize("AB"))", "deserialize: not serialized data at offset 0"},
+        {R"(deserialize(serialize([1, 2, 3])[0:6]))", "deserialize: truncated input at offset 5"},
+        {R"(deserialize(serialize(1) + "x"))", "deserialize: trailing bytes at offset 5"},
+    };
+    for (auto& test : tests) {
+        EXPECT_EQ(std::get<1>(test), run(evaluator, std::get<0>(test))) << std::get<0>(test);
+    }
+
+    EXPECT_EQ("deserialize: unknown tag at offset 3",
+            serialize::decode(raw({0x7f}))->cast<Error>()->message());
+    EXPECT_EQ("deserialize: bad reference at offset 7",
+            serialize::decode(raw({0x05, 0x01, 0x0a, 0x05}))->cast<Error>()->message());
+    // 数组不能直接包含自己
+    EXPECT_EQ("deserialize: cyclic reference without a deque at offset 7",
+            serialize::decode(raw({0x05, 0x01, 0x0a, 0x00}))->cast<Error>()->message());
+    EXPECT_EQ("deserialize: unusable as set key at offset 7",
+            serialize::decode(raw({0x08, 0x01, 0x05, 0x00}))->cast<Error>()->message());
+    EXPECT_EQ("deserialize: unsupported version at offset 0",
+            serialize::decode(std::string("AU\x02\x00", 4))->cast<Error>()->message());
+    // 个数超过剩余字节数
+    EXPECT_EQ("deserialize: truncated input at offset 5",
+            serialize::decode(raw({0x05, 0x7f, 0x00}))->cast<Error>()->message());
+
+    // 嵌套过深的输入不会耗尽栈
+    std::string deep = raw({});
+    for (int i = 0; i < 100000; ++i) {
+        deep += "\x05\x01";
+    }
+    deep.push_back('\x00');
+    auto result = serialize::decode(deep);
+    auto error = result->cast<Error>();
+    ASSERT_NE(nullptr, error);
+    EXPECT_EQ("deserialize: nesting too deep at offset 2005", error->message());
+}
+
+}
@@ -0,0 +1,258 @@
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <unistd.h>
+#include <gtest/gtest.h>
+#include "batch.h"
+#include "evaluator.h"
+#include "table.h"
+
+using namespace autumn;
+using namespace autumn::object;
+
+namespace {
+
+std::string run(Evaluator& evaluator, const std::string& input) {
+    auto obj = evaluator.eval(input);
+    if (obj == nullptr) {
+        return std::string();
+    }
+    auto error = obj->cast<Error>();
+    return error != nullptr ? error->message() : obj->inspect();
+}
+
+// 测试用的临时文件，结束时删除
+class TempFile {
+public:
+    TempFile(const std::string& name) :
+        _path(format("/tmp/autumn_table_test_{}_{}", getpid(), name)) {
+    }
+
+    ~TempFile() {
+        std::remove(_path.c_str());
+    }
+
+    const std::string& path() const {
+        return _path;
+    }
+private:
+    std::string _path;
+};
+
+void write_sample(const std::string& path) {
+    std::vector<table::ColumnData> columns(3);
+    columns[0].name = "id";
+    columns[0].type = table::INT64;
+    columns[0].integers = {1, 2, 3, -4};
+    columns[1].name = "name";
+    columns[1].type = table::STRING;
+    columns[1].strings = {"a", "", "a string longer than the inline size", "秋天"};
+    columns[2].name = "qty";
+    columns[2].type = table::INT64;
+    columns[2].integers = {10, 20, 30, 40};
+    std::string error;
+    ASSERT_TRUE(table::write(path, columns, &error)) << error;
+}
+
+TEST(Table, TestLoad) {
+    TempFile file("load");
+    write_sample(file.path());
+
+    Evaluator evaluator;
+    evaluator.eval(format(R"(let t = load_table("{}");)", file.path()));
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {"len(t)", "4"},
+        {R"(len(t["name"]))", "4"},
+        {R"(t["id"][0])", "1"},
+        {R"(t["id"][-1])", "-4"},
+        {R"(t["id"][4])", "null"},
+        {R"(t["name"][1])", R"("")"},
+        {R"(t["name"][2])", R"("a string longer than the inline size")"},
+        {R"(len(t["name"][3]))", "2"},
+        {R"(t["missing"])", "null"},
+        {R"(to_array(t["qty"]))", "[10, 20, 30, 40]"},
+        {R"(to_array(t["qty"][1:3]))", "[20, 30]"},
+        {R"(len(t["qty"][-2:]))", "2"},
+        {R"(t[1]["qty"])", "20"},
+        {R"(t[0])", R"({"id":1, "name":"a", "qty":10})"},
+        {"t[10]", "null"},
+        {R"(t["id"][0] + t["qty"][0])", "11"},
+        {"t", "table(rows: 4, columns: [id, name, qty])"},
+        {R"(t["qty"])", "column(qty, size: 4)"},
+    };
+    for (auto& test : tests) {
+        EXPECT_EQ(std::get<1>(test), run(evaluator, std::get<0>(test))) << std::get<0>(test);
+    }
+}
+
+// 程序中有同样键序列的 hash 字面量时，行对象共享它的 shape
+TEST(Table, TestRowShape) {
+    TempFile file("shape");
+    write_sample(file.path());
+
+    Evaluator evaluator;
+    evaluator.eval(R"(let proto = {"id": 0, "name": "", "qty": 0};)");
+    evaluator.eval(format(R"(let t = load_table("{}");)", file.path()));
+    auto proto = evaluator.eval("proto");
+    auto a = evaluator.eval("t[0]");
+    auto b = evaluator.eval("t[3]");
+    ASSERT_EQ(Hash::SHAPED, a->cast<Hash>()->storage());
+    EXPECT_EQ(proto->cast<Hash>()->shape(), a->cast<Hash>()->shape());
+    EXPECT_EQ(a->cast<Hash>()->shape(), b->cast<Hash>()->shape());
+}
+
+// 文件中的列名不会创建新的 shape，行对象使用普通的 hash
+TEST(Table, TestRowWithoutShape) {
+    TempFile file("no_shape");
+    std::vector<table::ColumnData> columns(2);
+    columns[0].name = "table_test_only_x";
+    columns[0].type = table::INT64;
+    columns[0].integers = {1, 2};
+    columns[1].name = "table_test_only_y";
+    columns[1].type = table::INT64;
+    columns[1].integers = {3, 4};
+    std::string error;
+    ASSERT_TRUE(table::write(file.path(), columns, &error)) << error;
+
+    Evaluator evaluator;
+    evaluator.eval(format(R"(let t = load_table("{}");)", file.path()));
+    auto row = evaluator.eval("t[1]");
+    ASSERT_NE(Hash::SHAPED, row->cast<Hash>()->storage());
+    EXPECT_EQ(R"([2, 4])", run(evaluator, R"([t[1]["table_test_only_x"], t[1]["table_test_only_y"]])"));
+    EXPECT_EQ(nullptr, Shape::lookup({"table_test_only_x", "table_test_only_y"}));
+}
+
+// 长字符串引用映射的内存，短字符串直接拷贝
+TEST(Table, TestZeroCopy) {
+    TempFile file("zero_copy");
+    write_sample(file.path());
+
+    std::string error;
+    auto mapping = table::Mapping::open(file.path(), &error);
+    ASSERT_NE(nullptr, mapping) << error;
+    auto column = std::make_shared<Column>(mapping, mapping->find("name"), 0, mapping->rows());
+
+    auto short_value = column->at(0);
+    EXPECT_EQ(nullptr, short_value->cast<String>()->_owner);
+
+    auto long_value = column->at(2);
+    auto str = long_value->cast<String>();
+    EXPECT_EQ(mapping, str->_owner);
+    std::string_view expect;
+    ASSERT_TRUE(mapping->string(column->column(), 2, &expect));
+    EXPECT_EQ(expect.data(), str->value().data());
+
+    // 列释放后，值仍然持有映射
+    column.reset();
+    mapping.reset();
+    EXPECT_EQ("a string longer than the inline size", str->value());
+}
+
+// 区域模式下逃逸的表、列和映射内存上的字符串视图被提升到堆上，仍然引用同一个映射
+TEST(Table, TestRegion) {
+    TempFile file("region");
+    write_sample(file.path());
+
+    Evaluator evaluator;
+    evaluator.set_region_mode(true);
+    evaluator.eval(format(R"(
+        let t = load_table("{}");
+        let names = t["name"];
+        let s = names[2];
+    )", file.path()));
+    auto s = evaluator._env->get("s");
+    ASSERT_FALSE(evaluator._region->contains(s.get()));
+    auto t = evaluator._env->get("t")->cast<Table>();
+    EXPECT_EQ(t->mapping(), s->cast<String>()->_owner);
+
+    evaluator.eval("[1, 2, 3]");
+    EXPECT_EQ(R"("a string longer than the inline size")", run(evaluator, "s"));
+    EXPECT_EQ(R"("秋天")", run(evaluator, "names[-1]"));
+    auto& stats = evaluator.region_stats();
+    EXPECT_EQ(stats.requests, stats.resets);
+}
+
+// 整数列直接交给 BatchExpression 按列求值
+TEST(Table, TestBatch) {
+    TempFile file("batch");
+    write_sample(file.path());
+
+    std::string error;
+    auto mapping = table::Mapping::open(file.path(), &error);
+    ASSERT_NE(nullptr, mapping) << error;
+    std::vector<std::string> errors;
+    auto exp = BatchExpression::compile("id * qty > 30", &errors);
+    ASSERT_NE(nullptr, exp);
+
+    std::vector<Span<int64_t>> columns;
+    for (auto& name : exp->variables()) {
+        columns.push_back(mapping->integers(mapping->find(name)));
+    }
+    auto result = exp->eval(columns, mapping->rows());
+    ASSERT_EQ(BatchResult::BOOLEAN, result.kind);
+    EXPECT_EQ(std::vector<int64_t>({0, 1, 1, 0}), result.values);
+    // 字符串列没有整数数据
+    EXPECT_EQ(0u, mapping->integers(mapping->find("name")).size());
+}
+
+TEST(Table, TestSave) {
+    TempFile file("save");
+    Evaluator evaluator;
+    evaluator.eval(format(R"(let path = "{}";)", file.path()));
+    EXPECT_EQ("null", run(evaluator, R"(save_table(path, {"x": [1, 2], "y": ["p", "q"]}))"));
+    EXPECT_EQ(R"({"x":2, "y":"q"})", run(evaluator, "load_table(path)[1]"));
+
+    std::vector<std::tuple<std::string, std::string>> tests = {
+        {R"(save_table(path, {"x": [1, "a"]}))", "argument to `save_table` not supported, got STRING"},
+        {R"(save_table(path, {"x": 1}))", "argument to `save_table` not supported, got INTEGER"},
+        {R"(save_table(path, {"x": [1], "y": [1, 2]}))", "save_table: column `y` has 2 rows, expected 1"},
+        {"save_table(path, [1])", "argument to `save_table` not supported, got ARRAY"},
+        {"save_table(path)", "wrong number of arguments. expected 2, got 1"},
+    };
+    for (auto& test : tests) {
+        EXPECT_EQ(std::get<1>(test), run(evaluator, std::get<0>(test))) << std::get<0>(test);
+    }
+}
+
+TEST(Table, TestErrors) {
+    TempFile file("errors");
+    Evaluator evaluator;
+    auto load = [&]() {
+        return run(evaluator, format(R"(load_table("{}"))", file.path()));
+    };
+
+    EXPECT_EQ(format("load_table: cannot open {}: No such file or directory", file.path()), load());
+    EXPECT_EQ("argument to `load_table` not supported, got INTEGER", run(evaluator, "load_table(1)"));
+    EXPECT_EQ("wrong number of arguments. expected 1, got 0", run(evaluator, "load_table()"));
+
+    {
+        std::ofstream out(file.path(), std::ios::binary);
+        out << "not a table file at all";
+    }
+    EXPECT_EQ(format("load_table: not a table file: {}", file.path()), load());
+
+    // 截断的文件：列数据超出文件末尾
+    write_sample(file.path());
+    std::string bytes;
+    {
+        std::ifstream in(file.path(), std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(file.path(), std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), bytes.size() - 16);
+    }
+    EXPECT_EQ(format("load_table: corrupt table {}: column `qty` out of range", file.path()), load());
+
+    // 版本号不支持
+    bytes[4] = 2;
+    {
+        std::ofstream out(file.path(), std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), bytes.size());
+    }
+    EXPECT_EQ(format("load_table: unsupported table version 2: {}", file.path()), load());
+}
+
+}
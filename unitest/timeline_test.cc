@@ -0,0 +1,92 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <gtest/gtest.h>
+#include "evaluator.h"
+#include "timeline.h"
+
+using namespace autumn;
+
+namespace {
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+TEST(Timeline, TestTraceEvents) {
+    auto path = (std::filesystem::temp_directory_path() / "autumn_timeline.json").string();
+    timeline::enable(path);
+    ASSERT_TRUE(timeline::enabled());
+
+    Evaluator evaluator;
+    evaluator.eval(R"(
+        let fib = fn(n) { if (n < 2) { n } else { fib(n - 1) + fib(n - 2) } };
+        len("autumn");
+        fib(15);
+    )");
+
+    // 其它线程的事件写入各自的缓冲区
+    std::thread t([]() {
+        timeline::Span span("test", "worker");
+    });
+    t.join();
+
+    {
+        timeline::Span span("test", R"(say "hi")");
+    }
+
+    ASSERT_TRUE(timeline::flush(path));
+    auto json = read_file(path);
+
+    EXPECT_EQ(0u, json.find(R"({"displayTimeUnit":"ms","traceEvents":[)"));
+    EXPECT_NE(std::string::npos, json.find(R"("name":"Parser::parse","cat":"parse","ph":"X")"));
+    EXPECT_NE(std::string::npos, json.find(R"("name":"Evaluator::eval","cat":"eval")"));
+    EXPECT_NE(std::string::npos, json.find(R"x("name":"fib(15)","cat":"statment")x"));
+    EXPECT_NE(std::string::npos, json.find(R"("name":"len","cat":"builtin")"));
+    EXPECT_NE(std::string::npos, json.find(R"("name":"fib","cat":"call")"));
+    EXPECT_NE(std::string::npos, json.find(R"("name":"worker","cat":"test","ph":"X","pid":1,"tid":2)"));
+    // 事件名中的引号被转义
+    EXPECT_NE(std::string::npos, json.find(R"x(say \"hi\")x"));
+    EXPECT_EQ("]}\n", json.substr(json.size() - 3));
+}
+
+// 超长的名字在 UTF-8 字符边界截断
+TEST(Timeline, TestTruncateName) {
+    auto path = (std::filesystem::temp_directory_path() / "autumn_timeline.json").string();
+    timeline::enable(path);
+
+    // 63 个 ASCII 字符之后的 "秋" 占 3 个字节，跨过 64 字节的上限
+    std::string name = std::string(63, 'a') + "秋天";
+    {
+        timeline::Span span("test", name);
+    }
+
+    ASSERT_TRUE(timeline::flush(path));
+    auto json = read_file(path);
+    EXPECT_NE(std::string::npos, json.find("\"name\":\"" + std::string(63, 'a') + "\""));
+    EXPECT_EQ(std::string::npos, json.find(std::string(63, 'a') + "\xe7"));
+}
+
+TEST(Timeline, TestSpanThreshold) {
+    auto path = (std::filesystem::temp_directory_path() / "autumn_timeline.json").string();
+    timeline::enable(path);
+
+    {
+        timeline::Span span("test", "short span", 1000ull * 1000 * 1000);
+    }
+    {
+        timeline::Span span("test", "long span");
+    }
+
+    ASSERT_TRUE(timeline::flush(path));
+    auto json = read_file(path);
+    EXPECT_EQ(std::string::npos, json.find("short span"));
+    EXPECT_NE(std::string::npos, json.find("long span"));
+}
+
+}
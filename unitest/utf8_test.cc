@@ -0,0 +1,46 @@
+#include <string>
+#include <gtest/gtest.h>
+#include "utf8.h"
+
+using namespace autumn;
+
+namespace {
+
+TEST(Utf8, TestIsAscii) {
+    EXPECT_TRUE(utf8::is_ascii(""));
+    EXPECT_TRUE(utf8::is_ascii("hello autumn"));
+    EXPECT_TRUE(utf8::is_ascii(std::string(100, 'a')));
+    EXPECT_FALSE(utf8::is_ascii("秋天"));
+
+    // 非 ASCII 字节分别落在 SIMD 块内、8 字节块内以及尾部
+    for (size_t pos : {0u, 15u, 16u, 20u, 31u, 38u}) {
+        std::string str(39, 'a');
+        str[pos] = '\xe7';
+        EXPECT_FALSE(utf8::is_ascii(str)) << pos;
+    }
+}
+
+TEST(Utf8, TestLength) {
+    EXPECT_EQ(0u, utf8::length(""));
+    EXPECT_EQ(6u, utf8::length("autumn"));
+    EXPECT_EQ(2u, utf8::length("秋天"));
+    EXPECT_EQ(4u, utf8::length("a秋b😀"));
+}
+
+TEST(Utf8, TestIndex) {
+    std::string str;
+    for (int i = 0; i < 200; ++i) {
+        str += (i % 2 == 0) ? "秋" : "a";
+    }
+
+    std::vector<uint32_t> index;
+    EXPECT_EQ(200u, utf8::build_index(str, &index));
+    ASSERT_EQ(4u, index.size());
+    // 每 64 个码点中有 32 个占 3 字节，32 个占 1 字节
+    EXPECT_EQ(0u, index[0]);
+    EXPECT_EQ(128u, index[1]);
+    EXPECT_EQ(256u, index[2]);
+    EXPECT_EQ(128u + 3u, utf8::advance(str, index[1], 1));
+}
+
+}